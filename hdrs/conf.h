@@ -93,7 +93,6 @@
 #define SPILLOVER_THRESHOLD 0
 /* #define SPILLOVER_THRESHOLD  (MAX_OUTPUT / 2) */
 #define COMMAND_TIME_MSEC 1000 /* time slice length in milliseconds */
-#define COMMAND_BURST_SIZE 100 /* commands allowed per user in a burst */
 #define COMMANDS_PER_TIME 1    /* commands per time slice after burst */
 
 /* From conf.c */
@@ -156,6 +155,8 @@ struct options_table {
   int use_ws;                   /**< True to enable websockets */
   char ws_url[FILE_PATH_LEN];   /**< path to recognize as websocket one in HTTP
                                    requests. */
+  int ws_deflate_bits;      /**< Window bits for websocket compression */
+  int ws_deflate_mem_level; /**< zlib memLevel for websocket compression */
   char input_db[FILE_PATH_LEN]; /**< Name of the input database file */
   char output_db[FILE_PATH_LEN]; /**< Name of the output database file */
   char crash_db[FILE_PATH_LEN];  /**< Name of the panic database file */
@@ -190,6 +191,10 @@ struct options_table {
                          sockets is waiting */
   int active_q_chunk; /**< Number of commands run from queue when input from
                          sockets is waiting */
+  int command_burst;  /**< Commands a player can send in a burst */
+  int command_weight; /**< Commands run for a player at a time */
+  int unconnected_command_burst;  /**< command_burst at the connect screen */
+  int unconnected_command_weight; /**< command_weight at the connect screen */
   int func_nest_lim;  /**< Maximum function recursion depth */
   int func_invk_lim;  /**< Maximum number of function invocations */
   int call_lim;       /**< Maximum parser calls allowed in a queue cycle */
@@ -245,6 +250,11 @@ struct options_table {
   dbref base_room;    /**< Room which floating checks consider as the base */
   dbref default_home; /**< Home for the homeless */
   int use_dns;        /**< Should we use DNS lookups? */
+  int dns_cache_ttl;  /**< Longest time to remember a hostname lookup */
+  int dns_cache_size; /**< Number of hostname lookups to remember */
+  int accept_batch;   /**< Connections to accept at once per listening port */
+  int connect_rate;   /**< Connections a minute allowed from one address */
+  int connect_burst;  /**< Connections allowed from one address at once */
   int safer_ufun;     /**< Should we require security for ufun calls? */
   char dump_warning_1min[256]; /**< 1 minute nonforking dump warning message */
   char dump_warning_5min[256]; /**< 5 minute nonforking dump warning message */
@@ -279,6 +289,8 @@ struct options_table {
     zone_control; /**< Are only ZMPs allowed to determine zone-based control? */
   int link_to_object; /**< Can exits be linked to objects? */
   int owner_queues;   /**< Are queues tracked by owner or individual object? */
+  int fair_queue;     /**< Do owners take turns running queued commands? */
+  int queue_stats;    /**< Keep histograms of queue latencies? */
   int wiz_noaenter;   /**< Do DARK wizards trigger aenters? */
   char ip_addr[64];   /**< What ip address should the server bind to? */
   char ssl_ip_addr[64];   /**< What ip address should the server bind to? */
@@ -341,6 +353,8 @@ struct options_table {
   int use_quota;                 /**< Are quotas enabled? */
   int empty_attrs;               /**< Are empty attributes preserved? */
   int function_side_effects;     /**< Turn on side effect functions? */
+  int compiled_eval;             /**< Cache compiled attributes? */
+  int compiled_eval_check;       /**< Check compiled attributes? */
   char error_log[FILE_PATH_LEN]; /**< File to log connections */
   char connect_log[FILE_PATH_LEN]; /**< File to log connections */
   char wizard_log[FILE_PATH_LEN];  /**< File to log wizard commands */
@@ -501,6 +515,11 @@ int can_view_config_option(dbref player, PENNCONF *opt);
 #define QUEUE_PER_OWNER (options.owner_queues)
 #define WIZ_NOAENTER (options.wiz_noaenter)
 #define USE_DNS (options.use_dns)
+#define DNS_CACHE_TTL (options.dns_cache_ttl)
+#define DNS_CACHE_SIZE (options.dns_cache_size)
+#define ACCEPT_BATCH (options.accept_batch)
+#define CONNECT_RATE (options.connect_rate)
+#define CONNECT_BURST (options.connect_burst)
 #define MUSH_IP_ADDR (options.ip_addr)
 #define SSL_IP_ADDR (options.ssl_ip_addr)
 #define MAX_ATTRCOUNT (options.max_attrcount)
@@ -514,6 +533,8 @@ int can_view_config_option(dbref player, PENNCONF *opt);
 #define USE_QUOTA (options.use_quota)
 #define EMPTY_ATTRS (options.empty_attrs)
 #define FUNCTION_SIDE_EFFECTS (options.function_side_effects)
+#define COMPILED_EVAL (options.compiled_eval)
+#define COMPILED_EVAL_CHECK (options.compiled_eval_check)
 #define ERRLOG (options.error_log)
 #define CONNLOG (options.connect_log)
 #define WIZLOG (options.wizard_log)
@@ -70,6 +70,10 @@ dbref guest_to_connect(dbref player);
 void dump_reboot_db(void);
 void close_ssl_connections(void);
 DESC *least_idle_desc(dbref player, int priv);
+DESC *player_descs(dbref player);
+/** Iterate through the descriptors associated with a player */
+#define DESC_ITER_PLAYER(d, player)                                            \
+  for (d = player_descs(player); (d); d = (d)->next_by_player)
 int least_idle_time(dbref player);
 int least_idle_time_priv(dbref player);
 int most_conn_time(dbref player);
@@ -79,6 +83,7 @@ char *least_idle_hostname(dbref player);
 void do_who_mortal(dbref player, char *name);
 void do_who_admin(dbref player, char *name);
 void do_who_session(dbref player, char *name);
+void accept_stats(dbref player);
 char *json_to_string_real(JSON *json, int verbose, int recurse);
 #define json_to_string(j, v) json_to_string_real(j, v, 0)
 JSON *string_to_json_real(char *input, char **ip, int recurse);
@@ -86,6 +91,7 @@ JSON *string_to_json_real(char *input, char **ip, int recurse);
 char *json_unescape_string(char *input);
 char *json_escape_string(char *input);
 void json_free(JSON *json);
+void json_cache_stats(dbref player);
 void register_gmcp_handler(char *package, gmcp_handler_func func);
 void send_oob(DESC *d, char *package, JSON *data);
 
@@ -168,6 +174,7 @@ char *text_compress(char const *) __attribute_malloc__;
 struct _ansi_string;
 
 void do_second(void);
+void do_wait_timers(void);
 int do_top(int ncom);
 void do_halt(dbref owner, const char *ncom, dbref victim);
 #define SYSEVENT -1
@@ -452,8 +459,9 @@ typedef struct _ufun_attrib {
   char attrname[ATTRIBUTE_NAME_LIMIT + 1];
   /**< Name of attribute */
   int pe_flags; /**< Flags to use when evaluating attr (for debug, no_debug) */
-  const char *errmess; /**< Error message, if attr couldn't be retrieved */
-  int ufun_flags;      /**< UFUN_* flags, for how to parse/eval the attr */
+  const char *errmess;    /**< Error message, if attr couldn't be retrieved */
+  int ufun_flags;         /**< UFUN_* flags, for how to parse/eval the attr */
+  chunk_reference_t data; /**< Chunk the contents came from, if any */
 } ufun_attrib;
 
 dbref next_parent(dbref thing, dbref current, int *parent_count,
@@ -536,6 +544,8 @@ bool quick_regexp_match(const char *restrict s, const char *restrict d, bool cs,
                         const char **report_err);
 bool qcomp_regexp_match(const pcre *re, pcre_extra *study, const char *s,
                         size_t);
+void regexp_cache_stats(dbref player);
+void wild_cache_stats(dbref player);
 /** Default (case-insensitive) local wildcard match */
 #define local_wild_match(s, d, p) local_wild_match_case(s, d, 0, p)
 
@@ -100,6 +100,9 @@ void do_userfn(char *buff, char **bp, dbref obj, ATTR *attrib, int nargs,
                char **args, dbref executor, dbref caller, dbref enactor,
                NEW_PE_INFO *pe_info, int extra_flags);
 
+/** Changes whenever a name might look up a different function */
+extern int function_generation;
+
 FUN *func_hash_lookup(const char *name);
 FUN *builtin_func_hash_lookup(const char *name);
 int check_func(dbref player, FUN *fp);
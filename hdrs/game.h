@@ -64,6 +64,7 @@ void do_waitpid(dbref, const char *, const char *, bool);
 enum queue_type { QUEUE_ALL, QUEUE_NORMAL, QUEUE_SUMMARY, QUEUE_QUICK };
 void do_queue(dbref player, const char *what, enum queue_type flag);
 void do_queue_single(dbref player, char *pidstr, bool debug);
+void do_queue_stats(dbref player);
 void do_halt1(dbref player, const char *arg1, const char *arg2);
 void do_haltpid(dbref, const char *);
 void do_allhalt(dbref player);
@@ -253,7 +254,10 @@ void sq_register_loop(int n, sq_func f, void *d, const char *ev);
 void sq_cancel(struct squeue *sq);
 bool sq_run_one(void);
 bool sq_run_all(void);
-int sq_secs_till_next(void);
+int sq_msecs_till_next(void);
+void sq_stats(dbref player);
+uint64_t monotonic_msecs(void);
+uint64_t monotonic_usecs(void);
 
 void init_sys_events(void);
 
@@ -0,0 +1,37 @@
+/** \file hostcache.h
+ *
+ * \brief Cache of reverse DNS lookups.
+ *
+ * Shared by the mush and ssl_slave, so it doesn't depend on anything
+ * but the C library.
+ */
+
+#ifndef MUSH_HOSTCACHE_H
+#define MUSH_HOSTCACHE_H
+
+#include <time.h>
+
+/** How long a failed lookup is remembered, in seconds. */
+#define HOSTCACHE_FAILED_TTL 300
+
+void hostcache_init(int size);
+int hostcache_size(void);
+const char *hostcache_find(const char *ip, time_t now);
+void hostcache_add(const char *ip, const char *host, time_t now, int ttl);
+int hostcache_ttl(bool resolved, int dns_ttl, int max_ttl);
+
+/** Lookup totals since startup */
+struct hostcache_stats {
+  unsigned long hits;    /**< Lookups answered from the cache */
+  unsigned long misses;  /**< Lookups that had to go to DNS */
+  unsigned long evicted; /**< Live entries pushed out to make room */
+  int entries;           /**< Entries currently in the cache */
+};
+
+extern struct hostcache_stats hostcache_stats;
+
+#ifndef SLAVE
+void hostcache_report(dbref player);
+#endif
+
+#endif /* MUSH_HOSTCACHE_H */
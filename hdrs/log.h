@@ -50,11 +50,11 @@ void do_log_recall(dbref, enum log_type, int);
 
 /* Activity log types */
 enum log_act_type { LA_CMD, LA_PE, LA_LOCK };
-#define ACTIVITY_LOG_SIZE 3 /* In BUFFER_LEN-size lines */
+#define ACTIVITY_LOG_SIZE 16 /* In entries */
 void log_activity(enum log_act_type type, dbref player, const char *action);
+uint64_t activity_enter(dbref player, const char *expr);
+void activity_leave(uint64_t serial);
 void notify_activity(dbref player, int num_lines, int dump);
-const char *last_activity(void);
-int last_activity_type(void);
 
 void penn_perror(const char *);
 
@@ -42,6 +42,7 @@ struct response_dgram {
   char ipaddr[IPADDR_LEN]; /**< The ip address of the connection */
   char hostname[HOSTNAME_LEN]; /**< The resolved hostname of the connection */
   Port_t connected_to;         /**< The port connected to. */
+  int ttl; /**< Seconds DNS says the hostname is good for, 0 if unknown */
 };
 
 extern pid_t info_slave_pid;
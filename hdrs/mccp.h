@@ -0,0 +1,49 @@
+/** \file mccp.h
+ *
+ * \brief MUD Client Compression Protocol (MCCP2 and MCCP3) support.
+ *
+ * MCCP2 compresses everything the server sends to a telnet client with
+ * zlib, and MCCP3 does the same for what the client sends to us. See
+ * https://tintin.mudhalla.net/protocols/mccp/
+ */
+
+#ifndef MUSH_MCCP_H
+#define MUSH_MCCP_H
+
+/** Is output to this descriptor being compressed? */
+#define MCCP_OUT(d) ((d)->conn_flags & CONN_MCCP2)
+/** Is input from this descriptor being compressed? */
+#define MCCP_IN(d) ((d)->conn_flags & CONN_MCCP3)
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+
+/** Per-descriptor compression state */
+struct mccp_state {
+  z_stream out; /**< Deflate stream for MCCP2 */
+  z_stream in;  /**< Inflate stream for MCCP3 */
+  /** The last block in the descriptor's output queue that has already
+   * been compressed (or was queued before compression started), or NULL.
+   * Everything after it is raw text waiting to be compressed. */
+  struct text_block *done;
+  bool overflowed;          /**< Output was discarded since the last drain */
+  unsigned long raw_out;    /**< Bytes of output before compression */
+  unsigned long zipped_out; /**< Bytes of output after compression */
+  unsigned long zipped_in;  /**< Bytes of input before decompression */
+  unsigned long raw_in;     /**< Bytes of input after decompression */
+};
+
+void mccp_start_output(DESC *d);
+void mccp_compress_output(DESC *d);
+void mccp_output_sent(DESC *d);
+void mccp_overflow(DESC *d, const char *msg, int len);
+void mccp_start_input(DESC *d);
+int mccp_decompress_input(DESC *d, const char **in, int *inlen, char *out,
+                          int outlen);
+void mccp_end(DESC *d);
+void mccp_free(DESC *d);
+#endif /* HAVE_LIBZ */
+
+void mccp_stats(dbref player);
+
+#endif /* MUSH_MCCP_H */
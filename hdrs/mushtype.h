@@ -111,19 +111,31 @@ typedef struct _pe_reg_val {
   struct _pe_reg_val *next; /**< Pointer to next value */
 } PE_REG_VAL;
 
+/** The values held by a pe_regs. Copying a pe_regs for a new queue entry
+ * can just share the table; whichever side changes it first gets its own
+ * copy. Tables with more than a few values also get a hash index, keyed
+ * on the interned register name. */
+typedef struct _pe_reg_tab {
+  int refcount;      /**< Number of PE_REGS using this table */
+  int count;         /**< Total register count */
+  int qcount;        /**< Named Q-register count */
+  int hsize;         /**< Size of hash, or 0 if there is no index */
+  PE_REG_VAL **hash; /**< Open-addressed index of vals */
+  PE_REG_VAL *vals;  /**< The register values */
+} PE_REG_TAB;
+
 /** pe_regs structs store environment (%0-%9), q-registers, itext(),
  * stext() and regexp ($0-$9) context, as well as a few %-sub values. */
 typedef struct _pe_regs_ {
   struct _pe_regs_ *prev; /**< Previous PE_REGS, for chaining up the stack */
   int flags;              /**< REG_* flags */
-  int count;              /**< Total register count. This includes
-                           * inherited registers. */
-  int qcount;             /**< Q-register count, including inherited
-                           * registers. */
-  PE_REG_VAL *vals;       /**< The register values */
+  PE_REG_TAB *tab;        /**< The register values, NULL if none were set */
   const char *name;       /**< For debugging */
 } PE_REGS;
 
+/** The first of a PE_REGS's values, for walking through them */
+#define PE_REGS_VALS(r) ((r)->tab ? (r)->tab->vals : NULL)
+
 /** NEW_PE_INFO holds data about string evaluation via process_expression().  */
 struct new_pe_info {
   int fun_invocations; /**< The number of functions invoked (%?) */
@@ -169,8 +181,20 @@ struct mque {
 
   char
     *action_list; /**< The action list of commands to run in this queue entry */
-  time_t
-    wait_until; /**< Time (epoch in seconds) this \@wait'd queue entry runs */
+  uint64_t wait_until; /**< When this \@wait'd queue entry runs, in
+                          monotonic_msecs(), or 0 */
+  uint64_t wait_seq;   /**< Order entries with the same wait_until
+                          were queued in */
+  int wait_index;      /**< Position in the wait heap, or -1 */
+  MQUE *sem_prev;      /**< The previous entry in the semaphore queue */
+  MQUE *key_next;      /**< The next entry waiting on the same semaphore */
+  MQUE *key_prev; /**< The previous entry waiting on the same semaphore */
+  uint64_t sem_seq; /**< Order entries were put in the semaphore queue in,
+                       or 0 if this entry isn't in it */
+  uint64_t queued_at; /**< When this entry was put in the player or object
+                         queue, in monotonic_usecs(), or 0 */
+  int latency_queue;  /**< Which queue's latency histograms this entry is
+                         counted in, or -1 */
   uint32_t pid; /**< This queue's process id */
 
   int queue_type; /**< The type of queue entry, bitwise QUEUE_* values */
@@ -184,13 +208,25 @@ struct mque {
 typedef struct attr ATTR;
 typedef ATTR ALIST;
 
+/** An immutable, reference-counted chunk of rendered output.
+ * A message broadcast to many connections is copied into one of these
+ * once, and every recipient's text_block points into it.
+ */
+struct text_payload {
+  int refcount;     /**< Number of text blocks (and owners) using this */
+  int len;          /**< Length of data */
+  const char *data; /**< The text itself */
+};
+
 /** A text block
  */
 struct text_block {
   int nchars;             /**< Number of characters in the block */
   struct text_block *nxt; /**< Pointer to next block in queue */
   char *start;            /**< Start of text */
-  char *buf;              /**< Current position in text */
+  char *buf;              /**< Private copy of the text, or NULL if shared */
+  int size; /**< Space allocated for buf if more text can be added, or 0 */
+  struct text_payload *payload; /**< Shared text, or NULL if private */
 };
 /** A queue of text blocks.
  */
@@ -241,6 +277,12 @@ struct text_queue {
 /** Sending and receiving UTF-8 */
 #define CONN_UTF8 0x4000
 
+/** Compressing output with MCCP2 */
+#define CONN_MCCP2 0x8000
+
+/** Receiving input compressed with MCCP3 */
+#define CONN_MCCP3 0x10000
+
 #ifndef WITHOUT_WEBSOCKETS
 /* Flag for WebSocket client. */
 #define CONN_WEBSOCKETS_REQUEST 0x10000000
@@ -273,11 +315,15 @@ typedef enum conn_status {
 typedef bool (*sq_func)(void *);
 /** System queue event */
 struct squeue {
-  sq_func fun;         /** Function to run */
-  void *data;          /** Data to pass to function, or NULL */
-  time_t when;         /** When to run the function */
-  char *event;         /** Softcode Event name to trigger, or NULL if none */
-  struct squeue *next; /** Pointer to next squeue event in linked list */
+  sq_func fun;   /** Function to run */
+  void *data;    /** Data to pass to function, or NULL */
+  uint64_t when; /** When to run the function, in monotonic_msecs() */
+  int loop;      /** Milliseconds between runs of a looping event, or 0 */
+  char *event;   /** Softcode Event name to trigger, or NULL if none */
+  int level;     /** Timing wheel level it's on, or -1 if it's due */
+  int slot;      /** Slot in that level */
+  struct squeue *next;    /** Next event in the same slot */
+  struct squeue **pprev;  /** Pointer to the pointer to this event */
 };
 
 typedef struct descriptor_data DESC;
@@ -320,8 +366,20 @@ struct descriptor_data {
 #ifndef WITHOUT_WEBSOCKETS
   /* TODO: Need to add this state to reboot.db. */
   uint64_t ws_frame_len;
+  struct ws_deflate *ws_deflate; /**< permessage-deflate state, or NULL */
 #endif                /* undef WITHOUT_WEBSOCKETS */
   int64_t connlog_id; /**< ID for this connection's connlog entry */
+  int ev_mask; /**< Events registered with the event backend, or -1 */
+  struct mccp_state *mccp; /**< Compression state, or NULL */
+  struct descriptor_data
+    *next_by_player; /**< Next descriptor of the same player */
+  struct descriptor_data *run_next; /**< Next descriptor in the run queue */
+  struct descriptor_data *run_prev; /**< Previous descriptor in run queue */
+  bool runnable;           /**< Is this descriptor in the run queue? */
+  uint64_t run_since;      /**< When it joined the run queue, in msecs */
+  unsigned long run_turns; /**< Number of turns it's had in the run queue */
+  unsigned long run_wait;  /**< Total msecs spent waiting for a turn */
+  unsigned long run_wait_max; /**< Longest wait for a turn, in msecs */
 };
 
 enum json_type {
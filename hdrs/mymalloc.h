@@ -75,4 +75,23 @@ struct slab_stats {
 };
 void slab_describe(const slab *sl, struct slab_stats *stats);
 
+/** A saved position in the evaluation arena */
+typedef struct arena_mark {
+  struct arena_block *block; /**< Block in use when the mark was taken */
+  size_t used;               /**< Bytes of it that were in use */
+} ARENA_MARK;
+
+void *arena_alloc(size_t bytes) __attribute_malloc__;
+ARENA_MARK arena_mark(void);
+void arena_release(ARENA_MARK mark);
+
+struct arena_stats {
+  int blocks;               /**< Blocks held by the arena */
+  int max_blocks;           /**< Most blocks ever in use at once */
+  size_t size;              /**< Total bytes held */
+  unsigned long allocs;     /**< Number of arena_alloc() calls */
+  unsigned long new_blocks; /**< Number of blocks malloced */
+};
+void arena_describe(struct arena_stats *stats);
+
 #endif /* _MYMALLOC_H */
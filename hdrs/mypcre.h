@@ -22,6 +22,24 @@ pcre_extra *default_match_limit(void);
 extern int pcre_study_flags;
 extern int pcre_public_study_flags;
 
+/** A compiled regexp, shared through the regexp cache */
+typedef struct cached_regexp CACHED_REGEXP;
+struct cached_regexp {
+  pcre *re;                    /**< The compiled pattern */
+  pcre_extra *extra;           /**< Study data, or NULL */
+  char *key;                   /**< Cache key: options and pattern */
+  const unsigned char *tables; /**< Character tables it was compiled with */
+  int refs;                    /**< Callers using it right now */
+  bool cached;                 /**< Is it still in the cache? */
+  CACHED_REGEXP *newer;        /**< Next more recently used regexp */
+  CACHED_REGEXP *older;        /**< Next less recently used regexp */
+};
+
+CACHED_REGEXP *regexp_cache_get(const char *pattern, int flags,
+                                const char **errptr);
+void regexp_cache_release(CACHED_REGEXP *cre);
+pcre_extra *regexp_cache_extra(CACHED_REGEXP *cre);
+
 #else
 #error "You appear to have a system PCRE library but not the pcre.h header."
 #endif
@@ -77,6 +77,7 @@ ssize_t recv_with_creds(int, void *, size_t, int *, int *);
 
 void make_nonblocking(int s);
 void make_blocking(int s);
+int accept_nonblocking(int s, struct sockaddr *addr, socklen_t *len);
 void set_keepalive(int s, int timeout);
 bool is_blocking_err(int);
 
@@ -114,5 +115,7 @@ extern BOOL GetErrorMessage(const DWORD dwError, LPTSTR lpszError,
 #define TN_GMCP                                                                \
   201 /**< Generic MUD Communication Protocol; see                             \
          http://www.gammon.com.au/gmcp */
+#define TN_MCCP2 86 /**< MUD Client Compression Protocol, server to client */
+#define TN_MCCP3 87 /**< MUD Client Compression Protocol, client to server */
 
 #endif /* MYSOCKET_H */
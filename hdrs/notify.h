@@ -171,4 +171,14 @@ void notify_format(dbref player, const char *fmt, ...)
 
 int queue_newwrite(DESC *d, const char *b, int n);
 
+/** Counters for the output queues, for \@stats/net */
+struct output_stats {
+  unsigned long sends;   /**< send() and writev() calls writing output */
+  unsigned long bytes;   /**< Bytes of output written */
+  unsigned long blocks;  /**< Blocks of text added to output queues */
+  unsigned long buffers; /**< Buffers allocated to hold queued output */
+};
+extern struct output_stats output_stats;
+void output_queue_stats(dbref player);
+
 #endif /* __NOTIFY_H */
@@ -206,7 +206,10 @@ int pi_regs_get_envc(NEW_PE_INFO *pe_info);
 typedef struct fun FUN;
 #define HAVE_FUN_DEFINED
 #endif
-/** Common declaration for softcode function implementations */
+/** Common declaration for softcode function implementations.
+ * Functions can take scratch space from arena_alloc(); it's released
+ * when the function returns, so it needn't be freed.
+ */
 #define FUNCTION(fun_name)                                                     \
   /* ARGSUSED */ /* try to keep lint happy */                                  \
   void fun_name(FUN *fun, char *buff, char **bp, int nargs, char *args[],      \
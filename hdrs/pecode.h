@@ -0,0 +1,84 @@
+/** \file pecode.h
+ *
+ * \brief Compiled attribute expressions.
+ *
+ * An attribute that gets evaluated over and over is parsed the same
+ * way every time, so its parse can be worked out once and cached.
+ * A compiled expression is a tree of frames, one for each time
+ * process_expression() would recurse. Each frame holds a list of ops
+ * keyed on the offset in the attribute text where the parser will
+ * meet them: runs of text that need no evaluation, function calls
+ * whose name is already looked up, and the compiled frames of nested
+ * groups and function arguments.
+ *
+ * The ops are only hints. process_expression() still does all the
+ * work, and uses an op only when it is at the op's offset with the
+ * same flags the compiler expected, so anything the compiler didn't
+ * predict just falls back to the normal parse.
+ */
+
+#ifndef _PECODE_H_
+#define _PECODE_H_
+
+#include "copyrite.h"
+#include "chunk.h"
+#include "function.h"
+#include "mushtype.h"
+
+/** Kinds of compiled ops */
+enum pe_op_type {
+  PE_OP_TEXT,  /**< Text copied to the output as is */
+  PE_OP_GROUP, /**< Start of a {}, [], (), %q<> or $<> group */
+  PE_OP_CALL   /**< Function call */
+};
+
+struct pe_frame;
+
+/** One compiled op */
+struct pe_op {
+  int off;              /**< Offset in the source where the op starts */
+  int eflags;           /**< Parser eflags expected at that point */
+  enum pe_op_type type; /**< What the op does */
+  union {
+    struct {
+      const char *text; /**< Output text */
+      int len;          /**< Length of text */
+      int srclen;       /**< How much source it takes up */
+      bool space;       /**< Does it include a compressible space? */
+    } text;
+    struct pe_frame *group; /**< Frame of the group */
+    struct {
+      FUN *fp;                /**< The function */
+      int generation;         /**< function_generation when looked up */
+      const char *name;       /**< Name as it appears in the output */
+      int namelen;            /**< Length of name */
+      int nargs;              /**< Number of compiled args */
+      struct pe_frame **args; /**< Frames of the args, or NULLs */
+    } call;
+  } u;
+};
+
+/** A compiled call to process_expression() */
+struct pe_frame {
+  int start;         /**< Offset of *str on entry */
+  int eflags;        /**< eflags on entry */
+  int tflags;        /**< tflags on entry */
+  int nops;          /**< Number of ops */
+  struct pe_op *ops; /**< Ops, in source order */
+};
+
+typedef struct pe_code PE_CODE;
+
+int process_compiled_expression(char *buff, char **bp, char const **str,
+                                dbref executor, dbref caller, dbref enactor,
+                                int eflags, int tflags, NEW_PE_INFO *pe_info,
+                                PE_CODE *code);
+int process_attr_expression(char *buff, char **bp, char const **str,
+                            chunk_reference_t data, dbref executor,
+                            dbref caller, dbref enactor, int eflags,
+                            NEW_PE_INFO *pe_info);
+const struct pe_frame *pe_code_frame(PE_CODE *code);
+void pe_code_forget(chunk_reference_t data);
+void pe_code_stats(dbref player);
+
+#endif /* _PECODE_H_ */
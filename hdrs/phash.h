@@ -0,0 +1,42 @@
+/**
+ * \file phash.h
+ *
+ * \brief Case-insensitive perfect hash tables for fixed sets of names.
+ *
+ * A PHASH is built all at once from a list of names, and picks its
+ * hash so that no two names land in the same slot. Looking a name up
+ * then takes one hash of the name and at most one string comparison,
+ * with no need to copy or upcase the name first. It can't be added to
+ * or deleted from; rebuild it instead.
+ */
+
+#ifndef PHASH_H
+#define PHASH_H
+
+#include <stddef.h>
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+#include "mushtype.h"
+
+/** Perfect hash table. */
+typedef struct phash {
+  uint32_t slots;    /**< Number of slots, a power of two */
+  uint32_t buckets;  /**< Number of displacement buckets, a power of two */
+  uint32_t *disp;    /**< Displacement for each bucket */
+  const char **keys; /**< Name in each slot, or NULL */
+  void **data;       /**< Data for each slot */
+  char *names;       /**< Storage for the names */
+  uint64_t seed;     /**< Seed the hash was built with */
+  size_t entries;    /**< Number of names */
+  int tries;         /**< Seeds tried before one worked */
+} PHASH;
+
+void phash_init(PHASH *tab);
+void phash_free(PHASH *tab);
+bool phash_build(PHASH *tab, size_t n, const char *keys[], void *data[]);
+void *phash_find(const PHASH *tab, const char *key);
+void phash_stats_header(dbref player);
+void phash_stats(dbref player, const PHASH *tab, const char *pname);
+
+#endif /* PHASH_H */
@@ -0,0 +1,52 @@
+/** \file profile.h
+ *
+ * \brief Softcode profiler.
+ *
+ * While it's running, the profiler times every queue entry, builtin
+ * or @function call, and attribute evaluated as a ufun, and adds the
+ * time to a running total for each one. The totals are kept by name
+ * ("ADD()", "#123/ATTR"), and by the stack of names that led to the
+ * call, for flame graphs.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "copyrite.h"
+#include "mushtype.h"
+
+extern bool profiling;
+
+int profile_push(const char *name);
+int profile_push_attr(dbref thing, const char *attrname);
+void profile_pop(int frame);
+
+/** Start timing something, if the profiler is running.
+ * \param name what it's called in the profile.
+ * \return a frame to pass to profile_leave(), or 0.
+ */
+#define profile_enter(name) (profiling ? profile_push(name) : 0)
+/** Start timing an attribute, if the profiler is running.
+ * \param thing object the attribute is on.
+ * \param attrname name of the attribute.
+ * \return a frame to pass to profile_leave(), or 0.
+ */
+#define profile_enter_attr(thing, attrname)                                    \
+  (profiling ? profile_push_attr((thing), (attrname)) : 0)
+/** Stop timing something started with profile_enter().
+ * \param frame what profile_enter() returned.
+ */
+#define profile_leave(frame)                                                   \
+  do {                                                                         \
+    if (frame)                                                                 \
+      profile_pop(frame);                                                      \
+  } while (0)
+
+void do_profile_start(dbref player);
+void do_profile_stop(dbref player);
+void do_profile_clear(dbref player);
+void do_profile_status(dbref player);
+void do_profile_report(dbref player, const char *count);
+void do_profile_export(dbref player);
+
+#endif /* _PROFILE_H_ */
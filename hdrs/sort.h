@@ -66,7 +66,7 @@ ListTypeInfo *get_list_type_info(SortType sort_type);
 void free_list_type_info(ListTypeInfo *lti);
 s_rec *slist_build(dbref player, char *keys[], char *strs[], int n,
                    ListTypeInfo *lti);
-void slist_qsort(s_rec *sp, int n, ListTypeInfo *lti);
+void slist_sort(s_rec *sp, int n, ListTypeInfo *lti);
 int slist_uniq(s_rec *sp, int n, ListTypeInfo *lti);
 void slist_free(s_rec *sp, int n, ListTypeInfo *lti);
 int slist_comp(s_rec *s1, s_rec *s2, ListTypeInfo *lti);
@@ -79,9 +79,8 @@ void do_gensort(dbref player, char *keys[], char *strs[], int n,
 /** Type definition for a qsort comparison function */
 typedef int (*comp_func)(const void *, const void *, dbref, dbref,
                          struct _ufun_attrib *, NEW_PE_INFO *);
-void sane_qsort(void **array, int left, int right, comp_func compare,
-                dbref executor, dbref enactor, struct _ufun_attrib *ufun,
-                NEW_PE_INFO *pe_info);
+void sane_msort(void **array, int n, comp_func compare, dbref executor,
+                dbref enactor, struct _ufun_attrib *ufun, NEW_PE_INFO *pe_info);
 
 /* Comparison functions for qsort() and other routines.  */
 int int_comp(const void *s1, const void *s2);
@@ -23,6 +23,8 @@ struct ssl_slave_config {
   char ca_dir[FILE_PATH_LEN];
   int require_client_cert;
   int keepalive_timeout;
+  int dns_cache_ttl;
+  int dns_cache_size;
 };
 
 #endif
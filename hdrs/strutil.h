@@ -129,6 +129,9 @@ char *replace_string(const char *restrict old, const char *restrict newbit,
 
 char *replace_string2(const char *const old[2], const char *const newbits[2],
                       const char *restrict string) __attribute_malloc__;
+char *replace_string2_buf(const char *const old[2],
+                          const char *const newbits[2],
+                          const char *restrict string, char *restrict result);
 
 char *copy_up_to(char *RESTRICT dest, const char *RESTRICT src, char c);
 char *trim_space_sep(char *str, char sep);
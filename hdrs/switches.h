@@ -47,148 +47,155 @@
 #define SWITCH_EQSPLIT 44
 #define SWITCH_ERR 45
 #define SWITCH_EXITS 46
-#define SWITCH_EXTEND 47
-#define SWITCH_FILE 48
-#define SWITCH_FIRST 49
-#define SWITCH_FLAGS 50
-#define SWITCH_FOLDERS 51
-#define SWITCH_FORWARD 52
-#define SWITCH_FREESPACE 53
-#define SWITCH_FSTATS 54
-#define SWITCH_FULL 55
-#define SWITCH_FUNCTIONS 56
-#define SWITCH_FWD 57
-#define SWITCH_GAG 58
-#define SWITCH_GENERATE 59
-#define SWITCH_GLOBALS 60
-#define SWITCH_HEADER 61
-#define SWITCH_HERE 62
-#define SWITCH_HIDE 63
-#define SWITCH_IFELSE 64
-#define SWITCH_IGNORE 65
-#define SWITCH_IGSWITCH 66
-#define SWITCH_ILIST 67
-#define SWITCH_INLINE 68
-#define SWITCH_INPLACE 69
-#define SWITCH_INSIDE 70
-#define SWITCH_INVENTORY 71
-#define SWITCH_IPRINT 72
-#define SWITCH_JOIN 73
-#define SWITCH_LEAVE 74
-#define SWITCH_LETTER 75
-#define SWITCH_LIMIT 76
-#define SWITCH_LIST 77
-#define SWITCH_LOCAL 78
-#define SWITCH_LOCALIZE 79
-#define SWITCH_LOCKS 80
-#define SWITCH_LOWERCASE 81
-#define SWITCH_LSARGS 82
-#define SWITCH_ME 83
-#define SWITCH_MEMBERS 84
-#define SWITCH_MOD 85
-#define SWITCH_MOGRIFIER 86
-#define SWITCH_MORTAL 87
-#define SWITCH_MOTD 88
-#define SWITCH_MUTE 89
-#define SWITCH_NAME 90
-#define SWITCH_NO 91
-#define SWITCH_NOBREAK 92
-#define SWITCH_NOCASE 93
-#define SWITCH_NOEVAL 94
-#define SWITCH_NOFLAGCOPY 95
-#define SWITCH_NOFORK 96
-#define SWITCH_NOISY 97
-#define SWITCH_NOPARSE 98
-#define SWITCH_NOSIG 99
-#define SWITCH_NOSPACE 100
-#define SWITCH_NOSPOOF 101
-#define SWITCH_NOTIFY 102
-#define SWITCH_NUKE 103
-#define SWITCH_OEMIT 104
-#define SWITCH_OFF 105
-#define SWITCH_ON 106
-#define SWITCH_OPAQUE 107
-#define SWITCH_OUTSIDE 108
-#define SWITCH_OVERRIDE 109
-#define SWITCH_PAGING 110
-#define SWITCH_PANIC 111
-#define SWITCH_PARANOID 112
-#define SWITCH_PARENT 113
-#define SWITCH_PLAYER 114
-#define SWITCH_PLAYERS 115
-#define SWITCH_PORT 116
-#define SWITCH_POST 117
-#define SWITCH_POWERS 118
-#define SWITCH_PREFIX 119
-#define SWITCH_PRESERVE 120
-#define SWITCH_PRINT 121
-#define SWITCH_PRIVS 122
-#define SWITCH_PURGE 123
-#define SWITCH_PUT 124
-#define SWITCH_QUEUED 125
-#define SWITCH_QUICK 126
-#define SWITCH_QUIET 127
-#define SWITCH_READ 128
-#define SWITCH_REBOOT 129
-#define SWITCH_RECALL 130
-#define SWITCH_REGEXP 131
-#define SWITCH_REGIONS 132
-#define SWITCH_REGISTER 133
-#define SWITCH_REMIT 134
-#define SWITCH_REMOVE 135
-#define SWITCH_RENAME 136
-#define SWITCH_RESTART 137
-#define SWITCH_RESTORE 138
-#define SWITCH_RESTRICT 139
-#define SWITCH_RETRACT 140
-#define SWITCH_RETROACTIVE 141
-#define SWITCH_REVIEW 142
-#define SWITCH_ROOM 143
-#define SWITCH_ROOMS 144
-#define SWITCH_ROTATE 145
-#define SWITCH_RSARGS 146
-#define SWITCH_RSNOPARSE 147
-#define SWITCH_SAVE 148
-#define SWITCH_SEARCH 149
-#define SWITCH_SEE 150
-#define SWITCH_SEEFLAG 151
-#define SWITCH_SELF 152
-#define SWITCH_SEND 153
-#define SWITCH_SET 154
-#define SWITCH_SETQ 155
-#define SWITCH_SILENT 156
-#define SWITCH_SKIPDEFAULTS 157
-#define SWITCH_SPEAK 158
-#define SWITCH_SPOOF 159
-#define SWITCH_STATS 160
-#define SWITCH_STATUS 161
-#define SWITCH_SUMMARY 162
-#define SWITCH_TABLES 163
-#define SWITCH_TAG 164
-#define SWITCH_TELEPORT 165
-#define SWITCH_TF 166
-#define SWITCH_THINGS 167
-#define SWITCH_TITLE 168
-#define SWITCH_TRACE 169
-#define SWITCH_TRIM 170
-#define SWITCH_TYPE 171
-#define SWITCH_UNCLEAR 172
-#define SWITCH_UNCOMBINE 173
-#define SWITCH_UNFOLDER 174
-#define SWITCH_UNGAG 175
-#define SWITCH_UNHIDE 176
-#define SWITCH_UNMUTE 177
-#define SWITCH_UNREAD 178
-#define SWITCH_UNTAG 179
-#define SWITCH_UNTIL 180
-#define SWITCH_URGENT 181
-#define SWITCH_USEFLAG 182
-#define SWITCH_WHAT 183
-#define SWITCH_WHO 184
-#define SWITCH_WILD 185
-#define SWITCH_WIPE 186
-#define SWITCH_WIZ 187
-#define SWITCH_WIZARD 188
-#define SWITCH_YES 189
-#define SWITCH_ZONE 190
+#define SWITCH_EXPORT 47
+#define SWITCH_EXTEND 48
+#define SWITCH_FILE 49
+#define SWITCH_FIRST 50
+#define SWITCH_FLAGS 51
+#define SWITCH_FOLDERS 52
+#define SWITCH_FORWARD 53
+#define SWITCH_FREESPACE 54
+#define SWITCH_FSTATS 55
+#define SWITCH_FULL 56
+#define SWITCH_FUNCTIONS 57
+#define SWITCH_FWD 58
+#define SWITCH_GAG 59
+#define SWITCH_GENERATE 60
+#define SWITCH_GLOBALS 61
+#define SWITCH_HEADER 62
+#define SWITCH_HERE 63
+#define SWITCH_HIDE 64
+#define SWITCH_IFELSE 65
+#define SWITCH_IGNORE 66
+#define SWITCH_IGSWITCH 67
+#define SWITCH_ILIST 68
+#define SWITCH_INLINE 69
+#define SWITCH_INPLACE 70
+#define SWITCH_INSIDE 71
+#define SWITCH_INVENTORY 72
+#define SWITCH_IPRINT 73
+#define SWITCH_JOIN 74
+#define SWITCH_LEAVE 75
+#define SWITCH_LETTER 76
+#define SWITCH_LIMIT 77
+#define SWITCH_LIST 78
+#define SWITCH_LOCAL 79
+#define SWITCH_LOCALIZE 80
+#define SWITCH_LOCKS 81
+#define SWITCH_LOWERCASE 82
+#define SWITCH_LSARGS 83
+#define SWITCH_ME 84
+#define SWITCH_MEMBERS 85
+#define SWITCH_MOD 86
+#define SWITCH_MOGRIFIER 87
+#define SWITCH_MORTAL 88
+#define SWITCH_MOTD 89
+#define SWITCH_MUTE 90
+#define SWITCH_NAME 91
+#define SWITCH_NET 92
+#define SWITCH_NO 93
+#define SWITCH_NOBREAK 94
+#define SWITCH_NOCASE 95
+#define SWITCH_NOEVAL 96
+#define SWITCH_NOFLAGCOPY 97
+#define SWITCH_NOFORK 98
+#define SWITCH_NOISY 99
+#define SWITCH_NOPARSE 100
+#define SWITCH_NOSIG 101
+#define SWITCH_NOSPACE 102
+#define SWITCH_NOSPOOF 103
+#define SWITCH_NOTIFY 104
+#define SWITCH_NUKE 105
+#define SWITCH_OEMIT 106
+#define SWITCH_OFF 107
+#define SWITCH_ON 108
+#define SWITCH_OPAQUE 109
+#define SWITCH_OUTSIDE 110
+#define SWITCH_OVERRIDE 111
+#define SWITCH_PAGING 112
+#define SWITCH_PANIC 113
+#define SWITCH_PARANOID 114
+#define SWITCH_PARENT 115
+#define SWITCH_PLAYER 116
+#define SWITCH_PLAYERS 117
+#define SWITCH_PORT 118
+#define SWITCH_POST 119
+#define SWITCH_POWERS 120
+#define SWITCH_PREFIX 121
+#define SWITCH_PRESERVE 122
+#define SWITCH_PRINT 123
+#define SWITCH_PRIVS 124
+#define SWITCH_PURGE 125
+#define SWITCH_PUT 126
+#define SWITCH_QUEUE 127
+#define SWITCH_QUEUED 128
+#define SWITCH_QUICK 129
+#define SWITCH_QUIET 130
+#define SWITCH_READ 131
+#define SWITCH_REBOOT 132
+#define SWITCH_RECALL 133
+#define SWITCH_REGEXP 134
+#define SWITCH_REGIONS 135
+#define SWITCH_REGISTER 136
+#define SWITCH_REMIT 137
+#define SWITCH_REMOVE 138
+#define SWITCH_RENAME 139
+#define SWITCH_REPORT 140
+#define SWITCH_RESTART 141
+#define SWITCH_RESTORE 142
+#define SWITCH_RESTRICT 143
+#define SWITCH_RETRACT 144
+#define SWITCH_RETROACTIVE 145
+#define SWITCH_REVIEW 146
+#define SWITCH_ROOM 147
+#define SWITCH_ROOMS 148
+#define SWITCH_ROTATE 149
+#define SWITCH_RSARGS 150
+#define SWITCH_RSNOPARSE 151
+#define SWITCH_SAVE 152
+#define SWITCH_SEARCH 153
+#define SWITCH_SEE 154
+#define SWITCH_SEEFLAG 155
+#define SWITCH_SELF 156
+#define SWITCH_SEND 157
+#define SWITCH_SET 158
+#define SWITCH_SETQ 159
+#define SWITCH_SILENT 160
+#define SWITCH_SKIPDEFAULTS 161
+#define SWITCH_SPEAK 162
+#define SWITCH_SPOOF 163
+#define SWITCH_START 164
+#define SWITCH_STATS 165
+#define SWITCH_STATUS 166
+#define SWITCH_STOP 167
+#define SWITCH_SUMMARY 168
+#define SWITCH_TABLES 169
+#define SWITCH_TAG 170
+#define SWITCH_TELEPORT 171
+#define SWITCH_TF 172
+#define SWITCH_THINGS 173
+#define SWITCH_TIMERS 174
+#define SWITCH_TITLE 175
+#define SWITCH_TRACE 176
+#define SWITCH_TRIM 177
+#define SWITCH_TYPE 178
+#define SWITCH_UNCLEAR 179
+#define SWITCH_UNCOMBINE 180
+#define SWITCH_UNFOLDER 181
+#define SWITCH_UNGAG 182
+#define SWITCH_UNHIDE 183
+#define SWITCH_UNMUTE 184
+#define SWITCH_UNREAD 185
+#define SWITCH_UNTAG 186
+#define SWITCH_UNTIL 187
+#define SWITCH_URGENT 188
+#define SWITCH_USEFLAG 189
+#define SWITCH_WHAT 190
+#define SWITCH_WHO 191
+#define SWITCH_WILD 192
+#define SWITCH_WIPE 193
+#define SWITCH_WIZ 194
+#define SWITCH_WIZARD 195
+#define SWITCH_YES 196
+#define SWITCH_ZONE 197
 #endif /* SWITCHES_H */
@@ -45,6 +45,7 @@ bool tzfile_exists(const char *name);
 struct tzinfo *read_tzfile(const char *tz);
 void free_tzinfo(struct tzinfo *);
 int32_t offset_for_tzinfo(struct tzinfo *tz, time_t when);
+void flush_tz_cache(void);
 
 /** Structure used to store information about a timezone's offset. */
 struct tz_result {
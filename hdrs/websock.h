@@ -16,6 +16,30 @@
 #define WEBSOCKET_CHANNEL_PUEBLO ('p')
 #define WEBSOCKET_CHANNEL_PROMPT ('>')
 
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+
+/** permessage-deflate (RFC 7692) state for a websocket connection */
+struct ws_deflate {
+  z_stream out;           /**< Compresses messages to the client */
+  z_stream in;            /**< Decompresses messages from the client */
+  unsigned char out_bits; /**< Window bits we compress with */
+  unsigned char in_bits;  /**< Window bits the client compresses with */
+  bool out_reset;         /**< Client asked for server_no_context_takeover */
+  bool in_limited;        /**< Client accepts client_max_window_bits */
+  bool started;           /**< Both zlib streams are initialized */
+  bool inflating;         /**< The incoming message is compressed */
+  unsigned long msg_in;   /**< Decompressed size of the incoming message */
+  unsigned long raw_out;    /**< Bytes of output before compression */
+  unsigned long zipped_out; /**< Bytes of output after compression */
+  unsigned long zipped_in;  /**< Bytes of input before decompression */
+  unsigned long raw_in;     /**< Bytes of input after decompression */
+};
+#endif /* HAVE_LIBZ */
+
+/* bsd.c */
+void process_input_text(DESC *d, char *tbuf1, int got);
+
 /* notify.c */
 int queue_newwrite_channel(DESC *d, const char *b, int n, char ch);
 
@@ -23,7 +47,11 @@ int queue_newwrite_channel(DESC *d, const char *b, int n, char ch);
 int is_websocket(const char *command);
 int process_websocket_request(DESC *d, const char *command);
 int process_websocket_frame(DESC *d, char *tbuf1, int got);
-void to_websocket_frame(const char **bp, int *np, char channel);
+void to_websocket_frame(DESC *d, const char **bp, int *np, char channel);
+int ws_deflate_params(DESC *d);
+void ws_deflate_restore(DESC *d, int params);
+int ws_deflate_overflow(DESC *d);
+void ws_deflate_free(DESC *d);
 
 int markup_websocket(char *buff, char **bp, char *data, int datalen, char *alt,
                      int altlen, char channel);
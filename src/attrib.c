@@ -26,6 +26,7 @@
 #include "mymalloc.h"
 #include "notify.h"
 #include "parse.h"
+#include "pecode.h"
 #include "privtab.h"
 #include "sort.h"
 #include "strtree.h"
@@ -777,6 +778,7 @@ atr_new_add(dbref thing, const char *RESTRICT atr, const char *RESTRICT s,
     AL_CREATOR(ptr) = player;
 
     if (ptr->data) {
+      pe_code_forget(ptr->data);
       chunk_delete(ptr->data);
       ptr->data = NULL_CHUNK_REFERENCE;
     }
@@ -997,8 +999,10 @@ atr_add(dbref thing, const char *RESTRICT atr, const char *RESTRICT s,
   AL_FLAGS(ptr) &= ~AF_COMMAND & ~AF_LISTEN;
 
   /* replace string with new string */
-  if (ptr->data)
+  if (ptr->data) {
+    pe_code_forget(ptr->data);
     chunk_delete(ptr->data);
+  }
   if (!s || !*s) {
     ptr->data = NULL_CHUNK_REFERENCE;
   } else {
@@ -1571,8 +1575,10 @@ atr_free_all(dbref thing)
   }
 
   ATTR_FOR_EACH (thing, ptr) {
-    if (ptr->data)
+    if (ptr->data) {
+      pe_code_forget(ptr->data);
       chunk_delete(ptr->data);
+    }
     st_delete(AL_NAME(ptr), &atr_names);
   }
 
@@ -2508,8 +2514,10 @@ atr_free_one(dbref thing, ATTR *a)
   if (!a)
     return;
   st_delete(AL_NAME(a), &atr_names);
-  if (a->data)
+  if (a->data) {
+    pe_code_forget(a->data);
     chunk_delete(a->data);
+  }
 
   pos = a - List(thing);
   atr_move_up(thing, pos);
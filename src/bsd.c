@@ -40,6 +40,9 @@
 #ifdef HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #endif
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
 #ifdef HAVE_SYS_STAT_H
 #include <sys/stat.h>
 #endif
@@ -70,6 +73,11 @@
 #ifdef HAVE_POLL_H
 #include <poll.h>
 #endif
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE1)
+#include <sys/epoll.h>
+/** Use the epoll event backend instead of rebuilding a pollfd array */
+#define USE_EPOLL 1
+#endif
 #ifdef HAVE_LIBCURL
 #include <curl/curl.h>
 #endif
@@ -103,11 +111,14 @@
 #include "sig.h"
 #include "strtree.h"
 #include "strutil.h"
+#include "tz.h"
 #include "version.h"
 #include "charconv.h"
 #include "mushsql.h"
 #include "connlog.h"
 #include "charclass.h"
+#include "mccp.h"
+#include "hostcache.h"
 
 #ifndef WIN32
 #include "wait.h"
@@ -286,6 +297,7 @@ dummy_msgs()
 
 DESC *descriptor_list = NULL; /**< The linked list of descriptors */
 intmap *descs_by_fd = NULL;   /**< Map of ports to DESC* objects */
+intmap *descs_by_player = NULL; /**< Map of players to their DESC* chains */
 
 static int sock;
 static int sslsock = 0;
@@ -296,6 +308,7 @@ static const char ssl_shutdown_message[] __attribute__((__unused__)) =
 static int localsock = -1;
 #endif
 static int ndescriptors = 0;
+static int avail_descriptors = 0; /**< Most descriptors we can use */
 #ifdef WIN32
 static WSADATA wsadata;
 #endif
@@ -330,7 +343,7 @@ static void win_gettimeofday(struct timeval *now);
 #endif
 static long int msec_diff(struct timeval now, struct timeval then);
 static struct timeval msec_add(struct timeval t, int x);
-static void update_quotas(struct timeval last, struct timeval current);
+static void update_quotas(struct timeval *last, struct timeval current);
 
 int how_many_fds(void);
 static void shovechars(Port_t port, Port_t sslport);
@@ -340,7 +353,9 @@ typedef int SOCKET;
 #endif
 
 static int test_connection(SOCKET newsock);
-static DESC *new_connection(int oldsock, int *result, conn_source source);
+static DESC *new_connection(int newsock, union sockaddr_u *addr,
+                            socklen_t addr_len, conn_source source);
+static uint64_t now_msecs(void);
 
 static void clearstrings(DESC *d);
 
@@ -373,6 +388,9 @@ static int fcache_dump_attr(DESC *d, dbref thing, const char *attr, int html,
 static int fcache_read(FBLOCK *cp, const char *filename);
 static void logout_sock(DESC *d);
 static void shutdownsock(DESC *d, const char *reason, dbref executor);
+static void index_player_desc(DESC *d);
+static void unindex_player_desc(DESC *d);
+static void set_desc_player(DESC *d, dbref player);
 DESC *initializesock(int s, char *addr, char *ip, conn_source source);
 int process_output(DESC *d);
 /* Notify.c */
@@ -391,8 +409,15 @@ static void dump_info(DESC *call_by);
 static void save_command(DESC *d, char *command);
 static int process_input(DESC *d, int output_ready);
 static void process_input_helper(DESC *d, char *tbuf1, int got);
+void process_input_text(DESC *d, char *tbuf1, int got);
+#ifdef HAVE_LIBZ
+static void process_compressed_input(DESC *d, char *buf, int len);
+#endif
 static void set_userstring(char **userstring, const char *command);
 static void process_commands(void);
+static int command_burst(DESC *d);
+static void run_queue_add(DESC *d);
+static void run_queue_remove(DESC *d);
 enum comm_res {
   CRES_OK = 0,
   CRES_LOGOUT,
@@ -667,6 +692,8 @@ main(int argc, char **argv)
   }
 #endif
 
+  hostcache_init(DNS_CACHE_SIZE);
+
   if (!init_conndb(restarting)) {
     do_rawlog(LT_ERR, "ERROR: Couldn't initialize connlog! Exiting.");
     exit(2);
@@ -688,6 +715,7 @@ main(int argc, char **argv)
 #endif
 
   descs_by_fd = im_new();
+  descs_by_player = im_new();
 
   if (restarting) {
     /* go do it */
@@ -857,20 +885,14 @@ timeval_sub(struct timeval now, struct timeval then)
 /** Return the difference between two timeval structs in milliseconds.
  * \param now pointer to the timeval to subtract from.
  * \param then pointer to the timeval to subtract.
- * \return milliseconds of difference between them.
+ * \return milliseconds of difference between them, negative if then is
+ * later than now.
  */
 static long int
 msec_diff(struct timeval now, struct timeval then)
 {
-  long int secs = now.tv_sec - then.tv_sec;
-  if (secs == 0)
-    return (now.tv_usec - then.tv_usec) / 1000;
-  else if (secs == 1)
-    return (now.tv_usec + (1000000 - then.tv_usec)) / 100;
-  else if (secs > 1)
-    return (secs * 1000) + ((now.tv_usec + (1000000 - then.tv_usec)) / 1000);
-  else
-    return 0;
+  return (long int) (now.tv_sec - then.tv_sec) * 1000 +
+         (now.tv_usec - then.tv_usec) / 1000;
 }
 
 /** Add a given number of milliseconds to a timeval.
@@ -896,21 +918,32 @@ msec_add(struct timeval t, int x)
  * number of commands per time slice. This function is run periodically
  * to refresh each descriptor's available command quota based on how
  * many slices have passed since it was last updated.
- * \param last pointer to timeval struct of last time quota was updated.
- * \param current pointer to timeval struct of current time.
+ * \param last pointer to timeval struct of last time quota was updated,
+ * which is moved forward by the whole slices used.
+ * \param current timeval struct of current time.
  */
 static void
-update_quotas(struct timeval last, struct timeval current)
+update_quotas(struct timeval *last, struct timeval current)
 {
   int nslices;
   DESC *d;
-  nslices = (int) msec_diff(current, last) / COMMAND_TIME_MSEC;
-
-  if (nslices > 0) {
+  nslices = (int) msec_diff(current, *last) / COMMAND_TIME_MSEC;
+
+  if (nslices < 0) {
+    /* The clock went backwards */
+    *last = current;
+  } else if (nslices > 0) {
+    /* Keep the part of a slice that hasn't finished yet, or a busy
+     * loop would never get to a whole one. */
+    *last = msec_add(*last, nslices * COMMAND_TIME_MSEC);
     for (d = descriptor_list; d; d = d->next) {
+      int burst = command_burst(d);
+
       d->quota += COMMANDS_PER_TIME * nslices;
-      if (d->quota > COMMAND_BURST_SIZE)
-        d->quota = COMMAND_BURST_SIZE;
+      if (d->quota > burst)
+        d->quota = burst;
+      if (d->input.head)
+        run_queue_add(d);
     }
   }
 }
@@ -954,48 +987,255 @@ is_ws_desc(DESC *d)
 #endif
 }
 
-static void
-setup_desc(int sockfd, conn_source source)
+/* Accepting new connections
+ *
+ * When a listening socket is readable, everything waiting on it is
+ * accepted in one go, up to accept_batch connections, so a burst of
+ * reconnects after a network hiccup doesn't sit in the backlog for one
+ * connection per trip through the main loop.
+ *
+ * Each remote address (Or IPv6 /64 network) gets a token bucket that
+ * holds connect_burst connections and refills at connect_rate a minute.
+ * A connection that finds its bucket empty is closed right after
+ * accept(), before any DNS, site lock or connlog work is done for it.
+ */
+
+/** Connection rate limit state for one address. */
+struct conn_bucket {
+  double tokens;    /**< Connections the address can make right now */
+  uint64_t updated; /**< When tokens was last refilled, in milliseconds */
+  bool logged;      /**< True if a refused connection has been logged */
+};
+
+static HASHTAB conn_buckets; /**< Rate limit buckets, by address */
+
+/** Connection acceptance totals, for \@stats/net */
+static struct {
+  unsigned long accepted; /**< Connections accepted */
+  unsigned long limited;  /**< Connections closed by the rate limit */
+  unsigned long batches;  /**< Times a listening socket was drained */
+  int biggest;            /**< Most connections accepted in one batch */
+} accept_totals;
+
+/** Work out the rate limit key for an address: The address itself for
+ * IPv4, and the /64 network for IPv6.
+ * \param sa the address.
+ * \param key buffer to store the key in.
+ * \param len size of key.
+ * \return true if a key was made, false for loopback addresses (Which
+ * are usually local proxies) and other address families.
+ */
+static bool
+conn_bucket_key(const struct sockaddr *sa, char *key, size_t len)
 {
-  DESC *newd;
-  int result;
+  if (sa->sa_family == AF_INET) {
+    const struct sockaddr_in *a = (const struct sockaddr_in *) sa;
+    if ((ntohl(a->sin_addr.s_addr) >> 24) == 127) {
+      return false;
+    }
+    return inet_ntop(AF_INET, &a->sin_addr, key, len) != NULL;
+  } else if (sa->sa_family == AF_INET6) {
+    struct in6_addr net = ((const struct sockaddr_in6 *) sa)->sin6_addr;
 
-  if (!(newd = new_connection(sockfd, &result, source))) {
-    if (test_connection(result) < 0)
-      return;
+    if (IN6_IS_ADDR_V4MAPPED(&net)) {
+      if (net.s6_addr[12] == 127) {
+        return false;
+      }
+      return inet_ntop(AF_INET, net.s6_addr + 12, key, len) != NULL;
+    } else if (IN6_IS_ADDR_LOOPBACK(&net)) {
+      return false;
+    }
+    memset(net.s6_addr + 8, 0, 8);
+    if (!inet_ntop(AF_INET6, &net, key, len - 3)) {
+      return false;
+    }
+    strcat(key, "/64");
+    return true;
+  }
+  return false;
+}
+
+/** Take a connection from an address's rate limit bucket.
+ * \param sa the remote address.
+ * \param fd the new socket, for logging.
+ * \return true if the connection is allowed, false if it should be
+ * dropped.
+ */
+static bool
+conn_rate_ok(const struct sockaddr *sa, int fd)
+{
+  char key[INET6_ADDRSTRLEN + 4];
+  struct conn_bucket *b;
+  uint64_t now;
+
+  if (CONNECT_RATE <= 0 || !conn_bucket_key(sa, key, sizeof key)) {
+    return true;
+  }
+
+  now = now_msecs();
+  b = hashfind(key, &conn_buckets);
+  if (!b) {
+    b = mush_malloc(sizeof *b, "conn_bucket");
+    b->tokens = CONNECT_BURST;
+    b->updated = now;
+    b->logged = 0;
+    hashadd(key, b, &conn_buckets);
   } else {
-    ndescriptors++;
-    if (newd->descriptor >= maxd)
-      maxd = newd->descriptor + 1;
+    b->tokens += (double) (now - b->updated) * CONNECT_RATE / 60000.0;
+    if (b->tokens > CONNECT_BURST) {
+      b->tokens = CONNECT_BURST;
+    }
+    b->updated = now;
+  }
+
+  if (b->tokens >= 1.0) {
+    b->tokens -= 1.0;
+    b->logged = 0;
+    return true;
   }
+
+  if (!b->logged) {
+    do_rawlog(LT_CONN, "[%d/%s] Refused connection (Too many connections)",
+              fd, key);
+    b->logged = 1;
+  }
+  accept_totals.limited += 1;
+  return false;
 }
 
-#ifdef INFO_SLAVE
+/** The same as conn_rate_ok(), for an address in text form. */
+static bool
+conn_rate_ok_ip(const char *ip, int fd)
+{
+  struct sockaddr_storage ss;
+
+  memset(&ss, 0, sizeof ss);
+  if (inet_pton(AF_INET, ip, &((struct sockaddr_in *) &ss)->sin_addr) == 1) {
+    ss.ss_family = AF_INET;
+  } else if (inet_pton(AF_INET6, ip,
+                       &((struct sockaddr_in6 *) &ss)->sin6_addr) == 1) {
+    ss.ss_family = AF_INET6;
+  } else {
+    return true;
+  }
+  return conn_rate_ok((struct sockaddr *) &ss, fd);
+}
+
+/** Forget about addresses whose buckets have filled up again. */
+static bool
+expire_conn_buckets(void *arg __attribute__((__unused__)))
+{
+  struct conn_bucket *b;
+  const char *key;
+  char **full;
+  int n, nfull = 0;
+  uint64_t now = now_msecs();
+
+  if (!conn_buckets.entries) {
+    return true;
+  }
+
+  full = mush_calloc(conn_buckets.entries, sizeof *full, "conn_bucket.keys");
+  for (key = hash_firstentry_key(&conn_buckets); key;
+       key = hash_nextentry_key(&conn_buckets)) {
+    b = hashfind(key, &conn_buckets);
+    if (CONNECT_RATE <= 0 ||
+        b->tokens + (double) (now - b->updated) * CONNECT_RATE / 60000.0 >=
+          CONNECT_BURST) {
+      full[nfull++] = mush_strdup(key, "conn_bucket.keys");
+    }
+  }
+  for (n = 0; n < nfull; n++) {
+    hashdelete(full[n], &conn_buckets);
+    mush_free(full[n], "conn_bucket.keys");
+  }
+  mush_free(full, "conn_bucket.keys");
+  return true;
+}
 
 static void
-got_new_connection(int sockfd, conn_source source)
+free_conn_bucket(void *b)
+{
+  mush_free(b, "conn_bucket");
+}
+
+/** Set up the connection rate limiter. */
+static void
+init_conn_buckets(void)
+{
+  hash_init(&conn_buckets, 64, free_conn_bucket);
+  sq_register_loop(300, expire_conn_buckets, NULL, NULL);
+}
+
+/** Accept waiting connections on a listening socket.
+ * \param sockfd the listening socket.
+ * \param source what kind of socket it is.
+ */
+static void
+accept_connections(int sockfd, conn_source source)
 {
   union sockaddr_u addr;
   socklen_t addr_len;
-  int newsock;
+  int newsock, count = 0;
+  int limit = ACCEPT_BATCH > 0 ? ACCEPT_BATCH : 1;
+  DESC *newd;
 
-  if (!info_slave_halted) {
-    addr_len = sizeof(addr);
-    newsock = accept(sockfd, (struct sockaddr *) &addr, &addr_len);
+  while (count < limit && (count == 0 || ndescriptors < avail_descriptors)) {
+    addr_len = sizeof addr;
+    newsock = accept_nonblocking(sockfd, &addr.addr, &addr_len);
     if (newsock < 0) {
-      if (test_connection(newsock) < 0)
-        return;
+      if (!is_blocking_err(errno)) {
+        test_connection(newsock);
+      }
+      break;
     }
-    ndescriptors++;
-    query_info_slave(newsock);
-    if (newsock >= maxd)
-      maxd = newsock + 1;
-  } else
-    setup_desc(sockfd, source);
-}
+    count += 1;
 
+    if (is_remote_source(source) && !conn_rate_ok(&addr.addr, newsock)) {
+      closesocket(newsock);
+      continue;
+    }
+
+#ifdef INFO_SLAVE
+    if (is_remote_source(source) && !info_slave_halted) {
+      ndescriptors++;
+      query_info_slave(newsock);
+      if (newsock >= maxd)
+        maxd = newsock + 1;
+      continue;
+    }
 #endif
 
+    if ((newd = new_connection(newsock, &addr, addr_len, source))) {
+      ndescriptors++;
+      if (newd->descriptor >= maxd)
+        maxd = newd->descriptor + 1;
+    }
+  }
+
+  if (count) {
+    accept_totals.accepted += count;
+    accept_totals.batches += 1;
+    if (count > accept_totals.biggest) {
+      accept_totals.biggest = count;
+    }
+  }
+}
+
+/** Show connection acceptance statistics, for \@stats/net.
+ * \param player the player to tell.
+ */
+void
+accept_stats(dbref player)
+{
+  notify_format(player,
+                T("Connections: %lu accepted in %lu batches (Largest %d). "
+                  "%lu refused by rate limit, %d addresses tracked."),
+                accept_totals.accepted, accept_totals.batches,
+                accept_totals.biggest, accept_totals.limited,
+                conn_buckets.entries);
+}
+
 #if defined(INFO_SLAVE) || defined(SSL_SLAVE)
 static char *
 exit_report(const char *prog, pid_t pid, WAIT_TYPE code)
@@ -1106,6 +1346,358 @@ handle_curl_msg(CURLMsg *msg)
 
 #endif
 
+/* Event backend.
+ *
+ * The poll() path in shovechars() rebuilds the whole pollfd array from
+ * descriptor_list on every pass through the main loop. Where epoll is
+ * available, interest sets are instead kept persistently in the kernel
+ * and only changed when a descriptor's wants actually change: POLLOUT
+ * when its output queue goes between empty and non-empty, and POLLIN
+ * when it has (or no longer has) a command waiting to be run. Each fd's
+ * currently registered mask is cached (in the DESC for connections) so
+ * that redundant epoll_ctl() calls are skipped.
+ *
+ * If epoll_create1() fails at startup, the poll() path is used instead.
+ */
+
+/** Number of descriptors with a command waiting in their input queue */
+static int ndescs_pending_input = 0;
+
+/** Recompute which events a descriptor is waiting for and, if the event
+ * backend is in use and they've changed, update its registration.
+ * \param d the descriptor.
+ */
+void update_desc_interest(DESC *d);
+
+#ifdef USE_EPOLL
+/** Kinds of fds registered with epoll, stored in the high word of the
+ * event data */
+enum ev_kind { EV_DESC, EV_OTHER, EV_CURL };
+
+#define EV_MAX_EVENTS 256 /**< Most events returned by one epoll_wait() */
+
+static int epoll_fd = -1;
+static struct epoll_event ev_events[EV_MAX_EVENTS];
+
+/** Registration state of the non-descriptor fds in the main loop */
+struct ev_watch {
+  int fd;   /**< The fd last registered */
+  int mask; /**< Its registered events, or -1 if not registered */
+};
+
+static struct ev_watch ev_sock = {-1, -1};
+static struct ev_watch ev_sslsock = {-1, -1};
+#ifdef LOCAL_SOCKET
+static struct ev_watch ev_localsock = {-1, -1};
+#endif
+#ifdef INFO_SLAVE
+static struct ev_watch ev_info_slave = {-1, -1};
+#endif
+static struct ev_watch ev_notify = {-1, -1};
+static struct ev_watch ev_sigrecv = {-1, -1};
+
+/** Change the events an fd is registered for.
+ * \param fd the fd.
+ * \param kind what sort of fd it is.
+ * \param cur pointer to the cached mask of currently registered events,
+ *   -1 if the fd isn't registered. Updated on success.
+ * \param want the events wanted, or -1 to remove the fd.
+ */
+static void
+ev_set(int fd, enum ev_kind kind, int *cur, int want)
+{
+  struct epoll_event ev;
+  int op, r;
+
+  if (epoll_fd < 0 || fd < 0 || *cur == want)
+    return;
+
+  memset(&ev, 0, sizeof ev);
+  ev.data.u64 = ((uint64_t) kind << 32) | (uint32_t) fd;
+
+  if (want < 0) {
+    /* It's fine if this fails; closing an fd removes it anyways. */
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+    *cur = -1;
+    return;
+  }
+
+  ev.events = want;
+  op = (*cur < 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  r = epoll_ctl(epoll_fd, op, fd, &ev);
+  /* The cached state can be stale if an fd was closed and reopened
+   * behind our back (Or a forked child still has a copy of it open). */
+  if (r < 0 && op == EPOLL_CTL_ADD && errno == EEXIST)
+    r = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+  else if (r < 0 && op == EPOLL_CTL_MOD && errno == ENOENT)
+    r = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  if (r < 0) {
+    penn_perror("epoll_ctl");
+    return;
+  }
+  *cur = want;
+}
+
+/** Watch or stop watching one of the non-descriptor fds for input.
+ * \param w the watch state for the fd.
+ * \param fd the fd, which might have changed since the last call.
+ * \param on true to watch for input, false to stop.
+ */
+static void
+ev_watch_fd(struct ev_watch *w, int fd, bool on)
+{
+  if (w->fd != fd) {
+    ev_set(w->fd, EV_OTHER, &w->mask, -1);
+    w->fd = fd;
+    w->mask = -1;
+  }
+  ev_set(fd, EV_OTHER, &w->mask, (on && fd >= 0) ? EPOLLIN : -1);
+}
+
+/** Forget the cached registration of a non-descriptor fd that's been
+ * closed and reopened, so it gets added again. */
+static void
+ev_forget_fd(struct ev_watch *w)
+{
+  w->fd = -1;
+  w->mask = -1;
+}
+
+#ifdef HAVE_LIBCURL
+static bool curl_timer_set = 0;
+static struct timeval curl_timer; /**< When curl next wants to be called */
+
+/** libcurl callback to add, change, or remove one of its sockets */
+static int
+ev_curl_socket(CURL *easy __attribute__((__unused__)), curl_socket_t s,
+               int what, void *userp __attribute__((__unused__)),
+               void *socketp)
+{
+  int mask = socketp ? (int) (intptr_t) socketp - 1 : -1;
+  int want = 0;
+
+  if (what == CURL_POLL_REMOVE) {
+    ev_set(s, EV_CURL, &mask, -1);
+  } else {
+    if (what & CURL_POLL_IN)
+      want |= EPOLLIN;
+    if (what & CURL_POLL_OUT)
+      want |= EPOLLOUT;
+    ev_set(s, EV_CURL, &mask, want);
+    curl_multi_assign(curl_handle, s, (void *) (intptr_t) (mask + 1));
+  }
+  return 0;
+}
+
+/** libcurl callback to set the time it next wants to be woken up */
+static int
+ev_curl_timer(CURLM *multi __attribute__((__unused__)), long timeout_ms,
+              void *userp __attribute__((__unused__)))
+{
+  if (timeout_ms < 0) {
+    curl_timer_set = 0;
+  } else {
+    struct timeval now;
+    our_gettimeofday(&now);
+    curl_timer = msec_add(now, timeout_ms);
+    curl_timer_set = 1;
+  }
+  return 0;
+}
+
+/** Let curl act on a socket (Or CURL_SOCKET_TIMEOUT), and handle any
+ * requests that finished as a result. */
+static void
+ev_curl_action(curl_socket_t s, int flags)
+{
+  int running = 0;
+  CURLMsg *msg;
+
+  if (curl_multi_socket_action(curl_handle, s, flags, &running) != CURLM_OK)
+    return;
+  while ((msg = curl_multi_info_read(curl_handle, &running)) != NULL)
+    handle_curl_msg(msg);
+}
+#endif /* HAVE_LIBCURL */
+
+/** Set up the epoll backend and register any descriptors that already
+ * exist (From a reboot).
+ * \return true if epoll is usable, false to fall back on poll().
+ */
+static bool
+ev_init(void)
+{
+  DESC *d;
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    penn_perror("epoll_create1");
+    return 0;
+  }
+  do_rawlog(LT_ERR, "Using epoll for network events.");
+
+  DESC_ITER (d) {
+    d->ev_mask = -1;
+    update_desc_interest(d);
+  }
+
+#ifdef HAVE_LIBCURL
+  curl_multi_setopt(curl_handle, CURLMOPT_SOCKETFUNCTION, ev_curl_socket);
+  curl_multi_setopt(curl_handle, CURLMOPT_TIMERFUNCTION, ev_curl_timer);
+#endif
+  return 1;
+}
+
+/** Wait for network events.
+ * \param timeout the longest to wait.
+ * \return the number of events, or -1 on a fatal error.
+ */
+static int
+ev_wait(struct timeval timeout)
+{
+  int msecs, found;
+
+  msecs = (timeout.tv_sec * 1000) + (timeout.tv_usec / 1000);
+#ifdef HAVE_LIBCURL
+  if (curl_timer_set) {
+    struct timeval now, left;
+    our_gettimeofday(&now);
+    left = timeval_sub(curl_timer, now);
+    if (left.tv_sec < 0)
+      msecs = 0;
+    else if ((left.tv_sec * 1000) + (left.tv_usec / 1000) < msecs)
+      msecs = (left.tv_sec * 1000) + (left.tv_usec / 1000);
+  }
+#endif
+
+  found = epoll_wait(epoll_fd, ev_events, EV_MAX_EVENTS, msecs);
+  if (found < 0) {
+    if (errno != EINTR) {
+      penn_perror("epoll_wait");
+      return -1;
+    }
+    found = 0;
+  }
+
+#ifdef HAVE_LIBCURL
+  if (curl_timer_set) {
+    struct timeval now, left;
+    our_gettimeofday(&now);
+    left = timeval_sub(curl_timer, now);
+    if (left.tv_sec < 0 || (left.tv_sec == 0 && left.tv_usec == 0)) {
+      curl_timer_set = 0;
+      ev_curl_action(CURL_SOCKET_TIMEOUT, 0);
+    }
+  }
+#endif
+
+  return found;
+}
+/** Act on the events returned by ev_wait().
+ * \param found the number of events.
+ */
+static void
+handle_events(int found)
+{
+  int i;
+
+  for (i = 0; i < found; i++) {
+    uint32_t events = ev_events[i].events;
+    int fd = (int) (ev_events[i].data.u64 & 0xFFFFFFFF);
+    DESC *d;
+
+    switch ((enum ev_kind)(ev_events[i].data.u64 >> 32)) {
+    case EV_CURL:
+#ifdef HAVE_LIBCURL
+      ev_curl_action(fd, ((events & EPOLLIN) ? CURL_CSELECT_IN : 0) |
+                           ((events & EPOLLOUT) ? CURL_CSELECT_OUT : 0) |
+                           ((events & EPOLLERR) ? CURL_CSELECT_ERR : 0));
+#endif
+      break;
+    case EV_OTHER:
+      if (!(events & EPOLLIN))
+        break;
+      if (fd == ev_sock.fd)
+        accept_connections(sock, CS_IP_SOCKET);
+      else if (fd == ev_sslsock.fd)
+        accept_connections(sslsock, CS_OPENSSL_SOCKET);
+#ifdef LOCAL_SOCKET
+      else if (fd == ev_localsock.fd)
+        accept_connections(localsock, CS_LOCAL_SOCKET);
+#endif
+#ifdef INFO_SLAVE
+      else if (fd == ev_info_slave.fd) {
+        if (info_slave_state == INFO_SLAVE_PENDING)
+          reap_info_slave();
+      }
+#endif
+      else if (fd == ev_notify.fd)
+        file_watch_event(fd);
+#ifndef WIN32
+      else if (fd == ev_sigrecv.fd)
+        sigrecv_ack();
+#endif
+      break;
+    case EV_DESC:
+      /* An earlier event in this batch might have closed it. */
+      d = im_find(descs_by_fd, fd);
+      if (!d)
+        break;
+      if (events & EPOLLERR) {
+        /* Socket error; kill this connection. */
+        shutdownsock(d, "socket error", d->player >= 0 ? d->player : GOD);
+        break;
+      }
+      if (events & (EPOLLIN | EPOLLHUP)) {
+        if (!process_input(d, events & EPOLLOUT)) {
+          shutdownsock(d, "disconnect", d->player);
+          break;
+        }
+      }
+      if (events & EPOLLOUT) {
+        if (!process_output(d)) {
+          shutdownsock(d, "disconnect", d->player);
+          break;
+        }
+      }
+      /* Compression and websocket framing errors are flagged rather than
+       * returned; the poll() loop catches them on its next pass over the
+       * descriptor list, which epoll doesn't make. */
+      if (d->conn_flags & CONN_SOCKET_ERROR)
+        shutdownsock(d, "socket error", GOD);
+      break;
+    }
+  }
+
+#ifdef INFO_SLAVE
+  if (info_slave_state == INFO_SLAVE_PENDING &&
+      mudtime > info_queue_time + 30) {
+    /* rerun any pending queries that got lost */
+    update_pending_info_slaves();
+  }
+#endif
+}
+#endif /* USE_EPOLL */
+
+void
+update_desc_interest(DESC *d)
+{
+#ifdef USE_EPOLL
+  int want = 0;
+
+  if (epoll_fd < 0)
+    return;
+  /* Don't get more input while this desc has a command ready to eval. */
+  if (!d->input.head)
+    want |= EPOLLIN;
+  if (d->output.head)
+    want |= EPOLLOUT;
+  ev_set(d->descriptor, EV_DESC, &d->ev_mask, want);
+#else
+  (void) d;
+#endif
+}
+
 static void
 shovechars(Port_t port, Port_t sslport)
 {
@@ -1118,7 +1710,6 @@ shovechars(Port_t port, Port_t sslport)
   int found;
   int queue_timeout, sq_timeout;
   DESC *d, *dnext, *dprev;
-  int avail_descriptors;
   int notify_fd = -1;
 #ifdef HAVE_LIBCURL
   struct curl_waitfd *fds = NULL;
@@ -1138,6 +1729,9 @@ shovechars(Port_t port, Port_t sslport)
 #define PENN_POLLOUT POLLOUT
 #endif
   int polltimeout;
+#ifdef USE_EPOLL
+  bool use_epoll;
+#endif
 
   if (!restarting) {
 
@@ -1158,6 +1752,17 @@ shovechars(Port_t port, Port_t sslport)
     }
   }
 
+  /* accept_connections() keeps going until a listening socket's backlog
+   * is empty. */
+  make_nonblocking(sock);
+  if (sslsock)
+    make_nonblocking(sslsock);
+#ifdef LOCAL_SOCKET
+  if (localsock >= 0)
+    make_nonblocking(localsock);
+#endif
+  init_conn_buckets();
+
 #ifdef HAVE_LIBCURL
   curl_handle = curl_multi_init();
   curl_multi_setopt(curl_handle, CURLMOPT_MAXCONNECTS, 500);
@@ -1178,14 +1783,17 @@ shovechars(Port_t port, Port_t sslport)
 
   notify_fd = file_watch_init();
 
+#ifdef USE_EPOLL
+  use_epoll = ev_init();
+#endif
+
   our_gettimeofday(&current_time);
   last_slice = current_time;
 
   while (shutdown_flag == 0) {
     our_gettimeofday(&current_time);
 
-    update_quotas(last_slice, current_time);
-    last_slice = current_time;
+    update_quotas(&last_slice, current_time);
 
     process_commands();
 
@@ -1250,10 +1858,14 @@ shovechars(Port_t port, Port_t sslport)
       do_rawlog(LT_ERR, "SIGHUP received: reloading .txt and .cnf files");
       config_file_startup(NULL, 0);
       config_file_startup(NULL, 1);
-      file_watch_init();
+      notify_fd = file_watch_init();
+#ifdef USE_EPOLL
+      ev_forget_fd(&ev_notify);
+#endif
       fcache_load(NOTHING);
       help_rebuild(NOTHING);
       read_access_file();
+      flush_tz_cache();
       reopen_logs();
       hup_triggered = 0;
     }
@@ -1282,9 +1894,9 @@ shovechars(Port_t port, Port_t sslport)
     /* run pending events */
     sq_run_all();
 
-    /* any queued commands or events waiting? */
+    /* any queued commands or events waiting? Both in milliseconds. */
     queue_timeout = que_next();
-    sq_timeout = sq_secs_till_next();
+    sq_timeout = sq_msecs_till_next();
     if (sq_timeout < queue_timeout)
       queue_timeout = sq_timeout;
     if (queue_timeout < 0)
@@ -1299,7 +1911,35 @@ shovechars(Port_t port, Port_t sslport)
     if (slice_timeout.tv_usec < 0)
       slice_timeout.tv_usec = 0;
 
-    timeout = (struct timeval){.tv_sec = queue_timeout, .tv_usec = 0};
+    timeout = (struct timeval){.tv_sec = queue_timeout / 1000,
+                               .tv_usec = (queue_timeout % 1000) * 1000};
+
+#ifdef USE_EPOLL
+    if (use_epoll) {
+      bool listening = ndescriptors < avail_descriptors;
+
+      ev_watch_fd(&ev_sock, sock, listening);
+      ev_watch_fd(&ev_sslsock, sslsock ? sslsock : -1, listening);
+#ifdef LOCAL_SOCKET
+      ev_watch_fd(&ev_localsock, localsock, listening);
+#endif
+#ifdef INFO_SLAVE
+      ev_watch_fd(&ev_info_slave, info_slave,
+                  info_slave_state == INFO_SLAVE_PENDING);
+#endif
+      ev_watch_fd(&ev_notify, notify_fd, 1);
+#ifndef WIN32
+      ev_watch_fd(&ev_sigrecv, sigrecv_fd, 1);
+#endif
+      if (ndescs_pending_input > 0 && msec_diff(slice_timeout, timeout) < 0)
+        timeout = slice_timeout;
+
+      found = ev_wait(timeout);
+      if (found < 0)
+        return;
+      goto events_ready;
+    }
+#endif /* USE_EPOLL */
 
     if (((int) fd_size) < ((int) im_count(descs_by_fd) + 6)) {
       fd_size = im_count(descs_by_fd) + 16;
@@ -1355,7 +1995,8 @@ shovechars(Port_t port, Port_t sslport)
       fds[fds_used].events = 0;
       if (d->input.head) { /* Don't get more input while this desc has a
                               command ready to eval. */
-        timeout = slice_timeout;
+        if (msec_diff(slice_timeout, timeout) < 0)
+          timeout = slice_timeout;
       } else {
         fds[fds_used].events = PENN_POLLIN;
       }
@@ -1410,6 +2051,9 @@ shovechars(Port_t port, Port_t sslport)
     }
 #endif
 
+#ifdef USE_EPOLL
+  events_ready:
+#endif
 #ifdef INFO_SLAVE
     if (info_slave_state == INFO_SLAVE_PENDING) {
       update_pending_info_slaves();
@@ -1417,6 +2061,7 @@ shovechars(Port_t port, Port_t sslport)
 #endif
 
     time(&mudtime);
+    do_wait_timers();
 
     if (found >= 0) {
 
@@ -1428,6 +2073,13 @@ shovechars(Port_t port, Port_t sslport)
         do_top(options.active_q_chunk);
       }
 
+#ifdef USE_EPOLL
+      if (use_epoll) {
+        handle_events(found);
+        continue;
+      }
+#endif
+
       fds_used = 0;
 
 #ifdef INFO_SLAVE
@@ -1436,17 +2088,17 @@ shovechars(Port_t port, Port_t sslport)
       if (ndescriptors < avail_descriptors) {
         if (found > 0 && fds[fds_used++].revents & PENN_POLLIN) {
           found -= 1;
-          got_new_connection(sock, CS_IP_SOCKET);
+          accept_connections(sock, CS_IP_SOCKET);
         }
         if (found > 0 && sslsock && fds[fds_used++].revents & PENN_POLLIN) {
           found -= 1;
-          got_new_connection(sslsock, CS_OPENSSL_SOCKET);
+          accept_connections(sslsock, CS_OPENSSL_SOCKET);
         }
 #ifdef LOCAL_SOCKET
         if (found > 0 && localsock >= 0 &&
             fds[fds_used++].revents & PENN_POLLIN) {
           found -= 1;
-          setup_desc(localsock, CS_LOCAL_SOCKET);
+          accept_connections(localsock, CS_LOCAL_SOCKET);
         }
 #endif /* LOCAL_SOCKET */
       }
@@ -1465,17 +2117,17 @@ shovechars(Port_t port, Port_t sslport)
         if (ndescriptors < avail_descriptors) {
           if (found > 0 && fds[fds_used++].revents & PENN_POLLIN) {
             found -= 1;
-            setup_desc(sock, CS_IP_SOCKET);
+            accept_connections(sock, CS_IP_SOCKET);
           }
           if (found > 0 && sslsock && fds[fds_used++].revents & PENN_POLLIN) {
             found -= 1;
-            setup_desc(sslsock, CS_OPENSSL_SOCKET);
+            accept_connections(sslsock, CS_OPENSSL_SOCKET);
           }
 #ifdef LOCAL_SOCKET
           if (found > 0 && localsock >= 0 &&
               fds[fds_used++].revents & PENN_POLLIN) {
             found -= 1;
-            setup_desc(localsock, CS_LOCAL_SOCKET);
+            accept_connections(localsock, CS_LOCAL_SOCKET);
           }
 #endif /* LOCAL_SOCKET */
         }
@@ -1535,6 +2187,13 @@ shovechars(Port_t port, Port_t sslport)
   if (fds)
     mush_free(fds, "pollfds");
 
+#ifdef USE_EPOLL
+  if (epoll_fd >= 0) {
+    close(epoll_fd);
+    epoll_fd = -1;
+  }
+#endif
+
 #ifdef HAVE_LIBCURL
   curl_multi_cleanup(curl_handle);
 #endif
@@ -1574,32 +2233,33 @@ source_to_s(conn_source source)
 }
 
 static DESC *
-new_connection(int oldsock, int *result, conn_source source)
+new_connection(int newsock, union sockaddr_u *addr, socklen_t addr_len,
+               conn_source source)
 {
-  int newsock;
-  union sockaddr_u addr;
   struct hostname_info *hi = NULL;
-  socklen_t addr_len;
   char ipbuf[BUFFER_LEN];
   char hostbuf[BUFFER_LEN];
   char *bp;
+  const char *cached = NULL;
 
-  *result = 0;
-  addr_len = MAXSOCKADDR;
-  newsock = accept(oldsock, (struct sockaddr *) (addr.data), &addr_len);
-  if (newsock < 0) {
-    *result = newsock;
-    return 0;
-  }
   if (is_remote_source(source)) {
     bp = ipbuf;
-    hi = ip_convert(&addr.addr, addr_len);
+    hi = ip_convert(&addr->addr, addr_len);
     safe_str(hi ? hi->hostname : "", ipbuf, &bp);
     *bp = '\0';
     bp = hostbuf;
-    hi = hostname_convert(&addr.addr, addr_len);
-    safe_str(hi ? hi->hostname : "", hostbuf, &bp);
+    if (USE_DNS && (cached = hostcache_find(ipbuf, mudtime))) {
+      safe_str(cached, hostbuf, &bp);
+    } else {
+      hi = hostname_convert(&addr->addr, addr_len);
+      safe_str(hi ? hi->hostname : "", hostbuf, &bp);
+    }
     *bp = '\0';
+    if (USE_DNS && !cached && *hostbuf) {
+      hostcache_add(ipbuf, hostbuf, mudtime,
+                    hostcache_ttl(strcmp(ipbuf, hostbuf) != 0, DNS_CACHE_TTL,
+                                  DNS_CACHE_TTL));
+    }
   } else { /* source == CS_LOCAL_SOCKET */
     int len;
     char *split;
@@ -1662,6 +2322,11 @@ new_connection(int oldsock, int *result, conn_source source)
       }
     }
 
+    if (!conn_rate_ok_ip(ipbuf, newsock)) {
+      closesocket(newsock);
+      return 0;
+    }
+
 /* Use credential passing to tell if a local socket connection was
    made by ssl_slave or something else (Like a web-based client's
    server side). At the moment, this is only implemented on linux
@@ -2026,6 +2691,81 @@ fcache_init(void)
   fcache_load(NOTHING);
 }
 
+/** Add a descriptor to the index of its player's connections.
+ * Descriptors are kept in a chain per player, most recent first, so
+ * looking up a player's connections doesn't mean walking the entire
+ * descriptor_list.
+ * \param d the descriptor.
+ */
+static void
+index_player_desc(DESC *d)
+{
+  DESC *head;
+
+  d->next_by_player = NULL;
+  if (d->player < 0)
+    return;
+  head = im_find(descs_by_player, d->player);
+  if (head) {
+    im_delete(descs_by_player, d->player);
+    d->next_by_player = head;
+  }
+  im_insert(descs_by_player, d->player, d);
+}
+
+/** Remove a descriptor from the index of its player's connections.
+ * \param d the descriptor.
+ */
+static void
+unindex_player_desc(DESC *d)
+{
+  DESC *head, *prev;
+
+  if (d->player < 0)
+    return;
+  head = im_find(descs_by_player, d->player);
+  if (head == d) {
+    im_delete(descs_by_player, d->player);
+    if (d->next_by_player)
+      im_insert(descs_by_player, d->player, d->next_by_player);
+  } else {
+    for (prev = head; prev; prev = prev->next_by_player) {
+      if (prev->next_by_player == d) {
+        prev->next_by_player = d->next_by_player;
+        break;
+      }
+    }
+  }
+  d->next_by_player = NULL;
+}
+
+/** Change the player a descriptor is associated with, keeping the
+ * per-player index up to date.
+ * \param d the descriptor.
+ * \param player the new player, or NOTHING.
+ */
+static void
+set_desc_player(DESC *d, dbref player)
+{
+  unindex_player_desc(d);
+  d->player = player;
+  index_player_desc(d);
+}
+
+/** Return the first descriptor associated with a player. Use
+ * DESC_ITER_PLAYER() to walk them all. This includes descriptors that
+ * are in the middle of logging in, so check d->connected.
+ * \param player dbref of the player.
+ * \return pointer to the player's most recent descriptor, or NULL.
+ */
+DESC *
+player_descs(dbref player)
+{
+  if (player < 0 || !descs_by_player)
+    return NULL;
+  return im_find(descs_by_player, player);
+}
+
 /** Logout a descriptor from the player it's connected to,
  * without dropping the connection. Run when a player uses LOGOUT
  * \param d descriptor
@@ -2059,22 +2799,23 @@ logout_sock(DESC *d)
   d->connected = CONN_SCREEN;
   d->output_prefix = 0;
   d->output_suffix = 0;
-  d->output_size = 0;
-  d->player = NOTHING;
+  set_desc_player(d, NOTHING);
   init_text_queue(&d->input);
-  init_text_queue(&d->output);
+  if (!MCCP_OUT(d)) {
+    /* Unsent compressed output can't be dropped without corrupting the
+     * stream */
+    d->output_size = 0;
+    init_text_queue(&d->output);
+  }
   d->raw_input = 0;
   d->raw_input_at = 0;
-  d->quota = COMMAND_BURST_SIZE;
+  d->quota = command_burst(d);
   d->last_time = mudtime;
   d->cmds = 0;
   d->hide = 0;
   welcome_user(d, 0);
 }
 
-/* Has to be file scope because of interactions with @boot */
-static DESC *pc_dnext = NULL;
-
 /** Disconnect a descriptor.
  * This sends appropriate disconnection text, flushes output, and
  * then closes the associated socket.
@@ -2121,10 +2862,14 @@ shutdownsock(DESC *d, const char *reason, dbref executor)
     sq_cancel(d->conn_timer);
     d->conn_timer = NULL;
   }
+  if (d->input.head)
+    ndescs_pending_input--;
+  run_queue_remove(d);
+#ifdef USE_EPOLL
+  ev_set(d->descriptor, EV_DESC, &d->ev_mask, -1);
+#endif
   shutdown(d->descriptor, 2);
   closesocket(d->descriptor);
-  if (pc_dnext == d)
-    pc_dnext = d->next;
   if (d->prev)
     d->prev->next = d->next;
   else /* d was the first one! */
@@ -2133,6 +2878,7 @@ shutdownsock(DESC *d, const char *reason, dbref executor)
     d->next->prev = d->prev;
 
   im_delete(descs_by_fd, d->descriptor);
+  unindex_player_desc(d);
 
   if (sslsock && d->ssl) {
     ssl_close_connection(d->ssl);
@@ -2143,6 +2889,12 @@ shutdownsock(DESC *d, const char *reason, dbref executor)
 
   {
     freeqs(d);
+#ifdef HAVE_LIBZ
+    mccp_free(d);
+#endif
+#ifndef WITHOUT_WEBSOCKETS
+    ws_deflate_free(d);
+#endif
     if (d->ttype && d->ttype != default_ttype)
       mush_free(d->ttype, "terminal description");
     memset(d, 0xFF, sizeof *d);
@@ -2173,7 +2925,7 @@ initializesock(int s, char *addr, char *ip, conn_source source)
   d->player = NOTHING;
   d->raw_input = 0;
   d->raw_input_at = 0;
-  d->quota = COMMAND_BURST_SIZE;
+  d->quota = command_burst(d);
   d->last_time = mudtime;
   d->cmds = 0;
   d->hide = 0;
@@ -2191,6 +2943,15 @@ initializesock(int s, char *addr, char *ip, conn_source source)
   d->ssl = NULL;
   d->ssl_state = 0;
   d->source = source;
+  d->ev_mask = -1;
+  d->mccp = NULL;
+#ifndef WITHOUT_WEBSOCKETS
+  d->ws_deflate = NULL;
+#endif
+  d->next_by_player = NULL;
+  d->run_next = d->run_prev = NULL;
+  d->runnable = false;
+  d->run_turns = d->run_wait = d->run_wait_max = 0;
   if (descriptor_list)
     descriptor_list->prev = d;
   d->next = descriptor_list;
@@ -2206,6 +2967,7 @@ initializesock(int s, char *addr, char *ip, conn_source source)
     }
   }
   im_insert(descs_by_fd, d->descriptor, d);
+  update_desc_interest(d);
   d->connlog_id = connlog_connection(ip, addr);
   d->conn_timer = sq_register_in(1, test_telnet_wrapper, (void *) d, NULL);
   queue_event(SYSEVENT, "SOCKET`CONNECT", "%d,%s", d->descriptor, d->ip);
@@ -2287,6 +3049,7 @@ network_send_ssl(DESC *d)
     need_write = 0;
     d->ssl_state = ssl_write(d->ssl, d->ssl_state, input_ready, 1, cur->start,
                              cur->nchars, &cnt);
+    output_stats.sends += 1;
     if (ssl_want_write(d->ssl_state)) {
       need_write = 1;
       break; /* Need to retry */
@@ -2307,37 +3070,50 @@ network_send_ssl(DESC *d)
     d->output.tail = NULL;
   d->output_size -= written;
   d->output_chars += written;
+  output_stats.bytes += written;
 
   return written + need_write;
 }
 
 #ifdef HAVE_WRITEV
+/** Most blocks of output to hand to a single writev() */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define OUTPUT_IOV_MAX IOV_MAX
+#else
+#define OUTPUT_IOV_MAX 1024
+#endif
+
 static int
 network_send_writev(DESC *d)
 {
   int written = 0;
 
   while (d->output.head) {
-    int cnt, n;
-    struct iovec lines[10];
+    int cnt, n, len = 0;
+    struct iovec lines[OUTPUT_IOV_MAX];
     struct text_block *cur = d->output.head;
 
-    for (n = 0; cur && n < 10; cur = cur->nxt) {
+    for (n = 0; cur && n < OUTPUT_IOV_MAX; cur = cur->nxt) {
       lines[n].iov_base = cur->start;
       lines[n].iov_len = cur->nchars;
+      len += cur->nchars;
       n += 1;
     }
 
     cnt = writev(d->descriptor, lines, n);
+    output_stats.sends += 1;
     if (cnt < 0) {
-      if (is_blocking_err(errno))
-        return 1;
-      else {
+      if (is_blocking_err(errno)) {
+        if (!written)
+          return 1;
+        break;
+      } else {
         d->conn_flags |= CONN_SOCKET_ERROR;
         return 0;
       }
     }
     written += cnt;
+    len -= cnt;
     while (cnt > 0) {
       cur = d->output.head;
       if (cur->nchars <= cnt) {
@@ -2352,6 +3128,8 @@ network_send_writev(DESC *d)
         goto output_done;
       }
     }
+    if (len > 0)
+      break; /* The socket's full */
   }
 
 output_done:
@@ -2359,6 +3137,7 @@ output_done:
     d->output.tail = NULL;
   d->output_size -= written;
   d->output_chars += written;
+  output_stats.bytes += written;
 
   return written;
 }
@@ -2383,6 +3162,7 @@ network_send(DESC *d)
   while ((cur = d->output.head) != NULL) {
     int cnt = send(d->descriptor, cur->start, cur->nchars, 0);
 
+    output_stats.sends += 1;
     if (cnt < 0) {
       if (is_blocking_err(errno))
         return 1;
@@ -2409,6 +3189,7 @@ network_send(DESC *d)
     d->output.tail = NULL;
   d->output_size -= written;
   d->output_chars += written;
+  output_stats.bytes += written;
   return written;
 }
 
@@ -2422,10 +3203,22 @@ network_send(DESC *d)
 int
 process_output(DESC *d)
 {
+  int ret;
+
+#ifdef HAVE_LIBZ
+  if (MCCP_OUT(d))
+    mccp_compress_output(d);
+#endif
   if (d->ssl)
-    return network_send_ssl(d);
+    ret = network_send_ssl(d);
   else
-    return network_send(d);
+    ret = network_send(d);
+#ifdef HAVE_LIBZ
+  if (d->mccp)
+    mccp_output_sent(d);
+#endif
+  update_desc_interest(d);
+  return ret;
 }
 
 /** A wrapper around test_telnet(), which is called via the
@@ -2475,6 +3268,8 @@ welcome_user(DESC *d, int telnet)
 static void
 save_command(DESC *d, char *command)
 {
+  bool was_empty = !d->input.head;
+
   if (d->conn_flags & CONN_UTF8) {
     char *latin1;
     int llen;
@@ -2507,6 +3302,12 @@ save_command(DESC *d, char *command)
     }
     add_to_queue(&d->input, command, strlen(command) + 1);
   }
+  if (was_empty && d->input.head) {
+    ndescs_pending_input++;
+    update_desc_interest(d);
+    if (d->quota > 0)
+      run_queue_add(d);
+  }
 }
 
 /** Send a telnet command to a descriptor to test for telnet support.
@@ -2766,6 +3567,19 @@ TELNET_HANDLER(telnet_mssp)
 
 TELNET_HANDLER(telnet_gmcp) { d->conn_flags |= CONN_GMCP; }
 
+#ifdef HAVE_LIBZ
+/* Client agreed to MCCP2; compress everything from here on */
+TELNET_HANDLER(telnet_mccp2)
+{
+  if (*cmd == DO)
+    mccp_start_output(d);
+}
+
+/* IAC SB MCCP3 IAC SE; everything the client sends after this is
+ * compressed */
+TELNET_HANDLER(telnet_mccp3_sb) { mccp_start_input(d); }
+#endif /* HAVE_LIBZ */
+
 TELNET_HANDLER(telnet_gmcp_sb)
 {
   struct gmcp_handler *g;
@@ -3019,8 +3833,8 @@ FUNCTION(fun_oob)
     return;
   }
 
-  DESC_ITER_CONN (d) {
-    if (d->player != who || !(d->conn_flags & CONN_GMCP))
+  DESC_ITER_PLAYER (d, who) {
+    if (!d->connected || !(d->conn_flags & CONN_GMCP))
       continue;
     send_oob(d, args[1], json);
     i++;
@@ -3086,6 +3900,22 @@ init_telnet_opts(void)
   telopt->sb = telnet_gmcp_sb;
   telnet_options[i] = telopt;
 
+#ifdef HAVE_LIBZ
+  telopt = mush_malloc(sizeof(struct telnet_opt), "telopt");
+  telopt->optcode = i = TN_MCCP2;
+  telopt->offer = WILL;
+  telopt->handler = telnet_mccp2;
+  telopt->sb = NULL;
+  telnet_options[i] = telopt;
+
+  telopt = mush_malloc(sizeof(struct telnet_opt), "telopt");
+  telopt->optcode = i = TN_MCCP3;
+  telopt->offer = WILL;
+  telopt->handler = NULL;
+  telopt->sb = telnet_mccp3_sb;
+  telnet_options[i] = telopt;
+#endif /* HAVE_LIBZ */
+
   /* Store the telnet options we negotiate for new connections,
    * to avoid looking them up every time someone connects */
   len = 0;
@@ -3212,14 +4042,29 @@ handle_telnet(DESC *d, char **q, char *qend)
 static void
 process_input_helper(DESC *d, char *tbuf1, int got)
 {
-  char *p, *pend, *q, *qend;
-
 #ifndef WITHOUT_WEBSOCKETS
   if ((d->conn_flags & CONN_WEBSOCKETS)) {
     /* Process using WebSockets framing. */
     got = process_websocket_frame(d, tbuf1, got);
   }
 #endif /* undef WITHOUT_WEBSOCKETS */
+  process_input_text(d, tbuf1, got);
+}
+
+/** Split text received from a connection into commands, and handle any
+ * telnet codes in it.
+ * \param d the descriptor.
+ * \param tbuf1 the text, after any websocket framing is removed.
+ * \param got length of tbuf1.
+ */
+void
+process_input_text(DESC *d, char *tbuf1, int got)
+{
+  char *p, *pend, *q, *qend;
+#ifdef HAVE_LIBZ
+  bool compressed = MCCP_IN(d);
+#endif
+
   if (!d->raw_input) {
     d->raw_input = mush_malloc(MAX_COMMAND_LEN, "descriptor_raw_input");
     if (!d->raw_input)
@@ -3263,6 +4108,13 @@ process_input_helper(DESC *d, char *tbuf1, int got)
         if (p < pend)
           *p++ = *q;
       }
+#ifdef HAVE_LIBZ
+      else if (MCCP_IN(d) && !compressed) {
+        /* The client just started MCCP3; the rest is compressed. */
+        q++;
+        break;
+      }
+#endif
     } else if (p < pend) {
       *p++ = *q;
     }
@@ -3276,7 +4128,44 @@ process_input_helper(DESC *d, char *tbuf1, int got)
   }
 
   d->conn_flags &= ~CONN_AWAITING_FIRST_DATA;
+
+#ifdef HAVE_LIBZ
+  if (q < qend)
+    process_compressed_input(d, q, qend - q);
+#endif
+}
+
+#ifdef HAVE_LIBZ
+/** Decompress MCCP3 input from a connection and process it.
+ * \param d the descriptor.
+ * \param buf the compressed input.
+ * \param len length of buf.
+ */
+static void
+process_compressed_input(DESC *d, char *buf, int len)
+{
+  char tbuf1[BUFFER_LEN];
+  const char *in = buf;
+  int got = 0, before;
+
+  /* Keep going while there's input left, or zlib filled the buffer and
+   * may have more output waiting. */
+  while (MCCP_IN(d) && (len > 0 || got == (int) sizeof tbuf1)) {
+    before = len;
+    got = mccp_decompress_input(d, &in, &len, tbuf1, sizeof tbuf1);
+    if (got < 0)
+      return;
+    if (got > 0)
+      process_input_helper(d, tbuf1, got);
+    else if (len == before)
+      break; /* No progress possible */
+  }
+
+  /* If the client ended its compressed stream, anything left is plain. */
+  if (!MCCP_IN(d) && len > 0)
+    process_input_helper(d, (char *) in, len);
 }
+#endif /* HAVE_LIBZ */
 
 /* ARGSUSED */
 static int
@@ -3342,7 +4231,12 @@ process_input(DESC *d, int output_ready __attribute__((__unused__)))
     }
   }
 
-  process_input_helper(d, tbuf1, got);
+#ifdef HAVE_LIBZ
+  if (MCCP_IN(d))
+    process_compressed_input(d, tbuf1, got);
+  else
+#endif
+    process_input_helper(d, tbuf1, got);
 
   return 1;
 }
@@ -3363,60 +4257,167 @@ set_userstring(char **userstring, const char *command)
   }
 }
 
-static void
-process_commands(void)
-{
-  int nprocessed;
+/* The run queue.
+ *
+ * Descriptors with a command waiting, and the quota to run it, are kept
+ * in a queue in the order they became ready, so process_commands() only
+ * looks at connections that have something to do. Each descriptor at the
+ * front of the queue gets a turn of up to command_weight commands (a
+ * deficit round robin where every command costs the same), and goes to
+ * the back if it still has more. Quota works as a token bucket on top of
+ * that: command_burst commands at once, then COMMANDS_PER_TIME each
+ * COMMAND_TIME_MSEC, refilled by update_quotas(), which puts descriptors
+ * that ran out back in the queue.
+ */
 
-  pc_dnext = NULL;
+static DESC *run_queue_head = NULL; /**< Next descriptor to get a turn */
+static DESC *run_queue_tail = NULL; /**< Last descriptor in the run queue */
 
-  do {
-    DESC *cdesc;
+/** The current time, in milliseconds. */
+static uint64_t
+now_msecs(void)
+{
+  struct timeval now;
 
-    nprocessed = 0;
-    for (cdesc = descriptor_list; cdesc; cdesc = pc_dnext) {
-      struct text_block *t;
+  our_gettimeofday(&now);
+  return (uint64_t) now.tv_sec * 1000 + now.tv_usec / 1000;
+}
 
-      pc_dnext = cdesc->next;
+/** How many commands a descriptor can send in a burst.
+ * \param d the descriptor.
+ * \return its command quota when full.
+ */
+static int
+command_burst(DESC *d)
+{
+  int burst = d->connected ? options.command_burst
+                           : options.unconnected_command_burst;
+  return burst > 0 ? burst : 1;
+}
 
-      if (cdesc->quota > 0 && (t = cdesc->input.head) != NULL) {
-        enum comm_res retval;
+/** How many commands a descriptor gets to run in each turn.
+ * \param d the descriptor.
+ * \return its scheduling weight.
+ */
+static int
+command_weight(DESC *d)
+{
+  int weight = d->connected ? options.command_weight
+                            : options.unconnected_command_weight;
+  return weight > 0 ? weight : 1;
+}
 
-        cdesc->quota -= 1;
-        nprocessed += 1;
-        start_cpu_timer();
-        retval = do_command(cdesc, (char *) t->start);
-        reset_cpu_timer();
+/** Add a descriptor to the end of the run queue, if it isn't already in
+ * it.
+ * \param d the descriptor.
+ */
+static void
+run_queue_add(DESC *d)
+{
+  if (d->runnable)
+    return;
+  d->runnable = true;
+  d->run_since = now_msecs();
+  d->run_next = NULL;
+  d->run_prev = run_queue_tail;
+  if (run_queue_tail)
+    run_queue_tail->run_next = d;
+  else
+    run_queue_head = d;
+  run_queue_tail = d;
+}
 
-        switch (retval) {
-        case CRES_QUIT:
-          shutdownsock(cdesc, "quit", cdesc->player);
-          break;
-        case CRES_HTTP:
-          shutdownsock(cdesc, "http disconnect", NOTHING);
-          break;
-        case CRES_SITELOCK:
-          shutdownsock(cdesc, "sitelocked", NOTHING);
-          break;
-        case CRES_LOGOUT:
-          logout_sock(cdesc);
-        /* Falls through - to free input buffer */
-        case CRES_OK:
-          cdesc->input.head = t->nxt;
-          if (!cdesc->input.head)
-            cdesc->input.tail = NULL;
+/** Take a descriptor out of the run queue, if it's in it.
+ * \param d the descriptor.
+ */
+static void
+run_queue_remove(DESC *d)
+{
+  if (!d->runnable)
+    return;
+  if (d->run_prev)
+    d->run_prev->run_next = d->run_next;
+  else
+    run_queue_head = d->run_next;
+  if (d->run_next)
+    d->run_next->run_prev = d->run_prev;
+  else
+    run_queue_tail = d->run_prev;
+  d->run_next = d->run_prev = NULL;
+  d->runnable = false;
+}
+
+/** Run the first command in a descriptor's input queue.
+ * \param d the descriptor.
+ * \retval true the descriptor is still open.
+ * \retval false the descriptor was closed, and d has been freed.
+ */
+static bool
+run_next_command(DESC *d)
+{
+  struct text_block *t = d->input.head;
+  enum comm_res retval;
+
+  d->quota -= 1;
+  start_cpu_timer();
+  retval = do_command(d, (char *) t->start);
+  reset_cpu_timer();
+
+  switch (retval) {
+  case CRES_QUIT:
+    shutdownsock(d, "quit", d->player);
+    return false;
+  case CRES_HTTP:
+    shutdownsock(d, "http disconnect", NOTHING);
+    return false;
+  case CRES_SITELOCK:
+    shutdownsock(d, "sitelocked", NOTHING);
+    return false;
+  case CRES_LOGOUT:
+    logout_sock(d);
+  /* Falls through - to free input buffer */
+  case CRES_OK:
+    d->input.head = t->nxt;
+    if (!d->input.head) {
+      d->input.tail = NULL;
+      ndescs_pending_input--;
+      update_desc_interest(d);
+    }
 #ifdef DEBUG
-          do_rawlog(LT_TRACE, "free_text_block(%p) at 5.", (void *) t);
+    do_rawlog(LT_TRACE, "free_text_block(%p) at 5.", (void *) t);
 #endif /* DEBUG */
-          free_text_block(t);
-          break;
-        case CRES_BOOTED:
-          break;
-        }
+    free_text_block(t);
+    return true;
+  case CRES_BOOTED:
+    return false;
+  }
+  return true;
+}
+
+static void
+process_commands(void)
+{
+  DESC *d;
+
+  while ((d = run_queue_head) != NULL) {
+    int n = command_weight(d);
+    uint64_t wait = now_msecs() - d->run_since;
+
+    run_queue_remove(d);
+    d->run_turns += 1;
+    d->run_wait += wait;
+    if (wait > d->run_wait_max)
+      d->run_wait_max = wait;
+
+    while (n-- > 0 && d->quota > 0 && d->input.head) {
+      if (!run_next_command(d)) {
+        d = NULL;
+        break;
       }
     }
-    pc_dnext = NULL;
-  } while (nprocessed > 0);
+    if (d && d->quota > 0 && d->input.head)
+      run_queue_add(d);
+  }
 }
 
 /** Send a descriptor's output prefix */
@@ -3635,7 +4636,7 @@ dump_messages(DESC *d, dbref player, int isnew)
 
   d->connected = CONN_PLAYER;
   d->connected_at = mudtime;
-  d->player = player;
+  set_desc_player(d, player);
 
   connlog_login(d->connlog_id, player);
 
@@ -3674,8 +4675,8 @@ dump_messages(DESC *d, dbref player, int isnew)
   }
 
   /* check to see if this is a reconnect */
-  DESC_ITER_CONN (tmpd) {
-    if (tmpd->player == player) {
+  DESC_ITER_PLAYER (tmpd, player) {
+    if (tmpd->connected) {
       num++;
     }
   }
@@ -3769,7 +4770,7 @@ check_connect(DESC *d, const char *msg)
       d->connected = CONN_PLAYER;
       if (Can_Hide(player))
         d->hide = 1;
-      d->player = player;
+      set_desc_player(d, player);
       set_flag(player, player, "DARK", 0, 0, 0);
       if ((dump_messages(d, player, 0)) == 0) {
         d->connected = CONN_DENIED;
@@ -3790,7 +4791,7 @@ check_connect(DESC *d, const char *msg)
                 Name(Location(player)), Location(player));
       /* Set player !dark */
       d->connected = CONN_PLAYER;
-      d->player = player;
+      set_desc_player(d, player);
       set_flag(player, player, "DARK", 1, 0, 0);
       if ((dump_messages(d, player, 0)) == 0) {
         d->connected = CONN_DENIED;
@@ -3810,7 +4811,7 @@ check_connect(DESC *d, const char *msg)
                 Name(Location(player)), Location(player));
       /* Set player hidden */
       d->connected = CONN_PLAYER;
-      d->player = player;
+      set_desc_player(d, player);
       if (Can_Hide(player))
         d->hide = 1;
       if ((dump_messages(d, player, 0)) == 0) {
@@ -4060,12 +5061,12 @@ boot_player(dbref player, int idleonly, int silent, dbref booter)
   if (idleonly)
     ignore = least_idle_desc(player, 1);
 
-  DESC_ITER_CONN (d) {
+  DESC_ITER_PLAYER (d, player) {
     if (boot) {
       boot_desc(boot, "boot", booter);
       boot = NULL;
     }
-    if (d->player == player &&
+    if (d->connected &&
         (!ignore || (d != ignore && difftime(now, d->last_time) > 60.0))) {
       if (!idleonly && !silent && !count)
         notify(player, T("You are politely shown to the door."));
@@ -4211,6 +5212,32 @@ sockset_show(DESC *d, char *nl)
   safe_strl(nl, nllen, buff, &bp);
   safe_format(buff, &bp, "%-15s:  %s", "Prompt Newlines",
               (d->conn_flags & CONN_PROMPT_NEWLINES ? "Yes" : "No"));
+  safe_strl(nl, nllen, buff, &bp);
+  safe_format(buff, &bp, "%-15s:  %lu ms average, %lu ms max (%lu turns)",
+              "Command Wait", d->run_turns ? d->run_wait / d->run_turns : 0,
+              d->run_wait_max, d->run_turns);
+#ifdef HAVE_LIBZ
+  if (d->mccp) {
+    safe_strl(nl, nllen, buff, &bp);
+    safe_format(buff, &bp, "%-15s:  %s (%lu bytes sent as %lu)",
+                "MCCP2 Output", (MCCP_OUT(d) ? "Yes" : "No"),
+                d->mccp->raw_out, d->mccp->zipped_out);
+    safe_strl(nl, nllen, buff, &bp);
+    safe_format(buff, &bp, "%-15s:  %s (%lu bytes received as %lu)",
+                "MCCP3 Input", (MCCP_IN(d) ? "Yes" : "No"), d->mccp->raw_in,
+                d->mccp->zipped_in);
+  }
+#endif
+#if defined(HAVE_LIBZ) && !defined(WITHOUT_WEBSOCKETS)
+  if (d->ws_deflate) {
+    safe_strl(nl, nllen, buff, &bp);
+    safe_format(buff, &bp,
+                "%-15s:  Yes (%lu bytes sent as %lu, %lu received as %lu)",
+                "WS Deflate", d->ws_deflate->raw_out,
+                d->ws_deflate->zipped_out, d->ws_deflate->raw_in,
+                d->ws_deflate->zipped_in);
+  }
+#endif
 
   *bp = '\0';
   return buff;
@@ -4380,8 +5407,8 @@ player_desc(dbref player)
 {
   DESC *d;
 
-  for (d = descriptor_list; d; d = d->next) {
-    if (d->connected && (d->player == player)) {
+  DESC_ITER_PLAYER (d, player) {
+    if (d->connected) {
       return d;
     }
   }
@@ -4535,8 +5562,8 @@ inactive_desc(dbref player)
   time_t now;
   int numd = 0;
   now = mudtime;
-  DESC_ITER_CONN (d) {
-    if (d->player == player) {
+  DESC_ITER_PLAYER (d, player) {
+    if (d->connected) {
       numd++;
       if (difftime(now, d->last_time) > 60.0)
         in = d;
@@ -5333,8 +6360,9 @@ announce_disconnect(DESC *saved, const char *reason, bool reboot,
   if (!GoodObject(loc))
     return;
 
-  for (num = 0, d = descriptor_list; d; d = d->next)
-    if (d->connected && (d->player == player))
+  num = 0;
+  DESC_ITER_PLAYER (d, player)
+    if (d->connected)
       num += 1;
 
   if (reboot)
@@ -5940,8 +6968,8 @@ lookup_desc(dbref executor, const char *name)
       return NULL;
     else {
       /* walk the descriptor list looking for a match of a dbref */
-      DESC_ITER_CONN (d) {
-        if ((d->player == target) && (!Hidden(d) || Priv_Who(executor)) &&
+      DESC_ITER_PLAYER (d, target) {
+        if (d->connected && (!Hidden(d) || Priv_Who(executor)) &&
             (!match || (d->last_time > match->last_time)))
           match = d;
       }
@@ -5955,8 +6983,8 @@ can_see_connected(dbref player, dbref target)
 {
   DESC *d;
 
-  DESC_ITER_CONN (d) {
-    if ((d->player == target) && (!Hidden(d) || Priv_Who(player)))
+  DESC_ITER_PLAYER (d, target) {
+    if (d->connected && (!Hidden(d) || Priv_Who(player)))
       return 1;
   }
   return 0;
@@ -5972,8 +7000,8 @@ DESC *
 least_idle_desc(dbref player, int priv)
 {
   DESC *d, *match = NULL;
-  DESC_ITER_CONN (d) {
-    if ((d->player == player) && (priv || !Hidden(d)) &&
+  DESC_ITER_PLAYER (d, player) {
+    if (d->connected && (priv || !Hidden(d)) &&
         (!match || (d->last_time > match->last_time)))
       match = d;
   }
@@ -5990,8 +7018,8 @@ int
 most_conn_time(dbref player)
 {
   DESC *d, *match = NULL;
-  DESC_ITER_CONN (d) {
-    if ((d->player == player) && !Hidden(d) &&
+  DESC_ITER_PLAYER (d, player) {
+    if (d->connected && !Hidden(d) &&
         (!match || (d->connected_at > match->connected_at)))
       match = d;
   }
@@ -6011,8 +7039,8 @@ int
 most_conn_time_priv(dbref player)
 {
   DESC *d, *match = NULL;
-  DESC_ITER_CONN (d) {
-    if ((d->player == player) &&
+  DESC_ITER_PLAYER (d, player) {
+    if (d->connected &&
         (!match || (d->connected_at > match->connected_at)))
       match = d;
   }
@@ -6437,8 +7465,8 @@ FUNCTION(fun_ports)
   }
   /* Walk descriptor chain. */
   first = 1;
-  DESC_ITER_CONN (d) {
-    if (d->player == target) {
+  DESC_ITER_PLAYER (d, target) {
+    if (d->connected) {
       if (first)
         first = 0;
       else
@@ -6513,16 +7541,16 @@ hide_player(dbref player, int hide, char *victim)
 
   if (hide == 2) {
     hide = 0;
-    DESC_ITER_CONN (d) {
-      if (d->player == thing && !d->hide) {
+    DESC_ITER_PLAYER (d, thing) {
+      if (d->connected && !d->hide) {
         hide = 1;
         break;
       }
     }
   }
 
-  DESC_ITER_CONN (d) {
-    if (d->player == thing)
+  DESC_ITER_PLAYER (d, thing) {
+    if (d->connected)
       d->hide = hide;
   }
   if (hide) {
@@ -6610,8 +7638,8 @@ hidden(dbref player)
 {
   DESC *d;
   int i = 0;
-  DESC_ITER_CONN (d) {
-    if (d->player == player) {
+  DESC_ITER_PLAYER (d, player) {
+    if (d->connected) {
       if (!Hidden(d))
         return 0;
       else
@@ -6671,7 +7699,7 @@ dump_reboot_db(void)
 #endif
 
 #ifndef WITHOUT_WEBSOCKETS
-  flags |= RDBF_WEBSOCKET_FRAME;
+  flags |= RDBF_WEBSOCKET_FRAME | RDBF_WS_DEFLATE;
 #endif
 
   if (setjmp(db_err)) {
@@ -6701,6 +7729,9 @@ dump_reboot_db(void)
      * which is now in the d variable.
      */
     for (; d != NULL; d = d->prev) {
+#ifdef HAVE_LIBZ
+      mccp_end(d);
+#endif
       putref(f, d->descriptor);
       putref(f, d->connected_at);
       putref(f, d->hide);
@@ -6731,6 +7762,7 @@ dump_reboot_db(void)
       putstring(f, d->checksum);
 #ifndef WITHOUT_WEBSOCKETS
       putref_u64(f, d->ws_frame_len);
+      putref(f, ws_deflate_params(d));
 #endif
       putref_u64(f, d->connlog_id);
     } /* for loop */
@@ -6857,6 +7889,18 @@ load_reboot_db(void)
         d->ws_frame_len = 0;
       }
 #endif
+      if (flags & RDBF_WS_DEFLATE) {
+#ifdef WITHOUT_WEBSOCKETS
+        (void) getref(f);
+#else
+        ws_deflate_restore(d, getref(f));
+#endif
+      }
+#ifndef WITHOUT_WEBSOCKETS
+      else {
+        d->ws_deflate = NULL;
+      }
+#endif
 
       if (flags & RDBF_CONNLOG_ID) {
         d->connlog_id = getref_u64(f);
@@ -6871,9 +7915,15 @@ load_reboot_db(void)
       init_text_queue(&d->output);
       d->raw_input = NULL;
       d->raw_input_at = NULL;
-      d->quota = options.starting_quota;
       d->ssl = NULL;
       d->ssl_state = 0;
+      d->ev_mask = -1;
+      d->mccp = NULL;
+      d->conn_flags &= ~(CONN_MCCP2 | CONN_MCCP3);
+      d->next_by_player = NULL;
+      d->run_next = d->run_prev = NULL;
+      d->runnable = false;
+      d->run_turns = d->run_wait = d->run_wait_max = 0;
 
       if (d->conn_flags & CONN_CLOSE_READY) {
         /* This isn't really an open descriptor, we're just tracking
@@ -6899,7 +7949,9 @@ load_reboot_db(void)
           d->connected = CONN_SCREEN;
           d->player = NOTHING;
         }
+        index_player_desc(d);
       }
+      d->quota = command_burst(d);
     } /* while loop */
 
     strcpy(poll_msg, getstring_noalloc(f));
@@ -6954,6 +8006,9 @@ load_reboot_db(void)
       mush_free(closed->output_prefix, "userstring");
     if (closed->output_suffix)
       mush_free(closed->output_suffix, "userstring");
+#ifndef WITHOUT_WEBSOCKETS
+    ws_deflate_free(closed);
+#endif
     mush_free(closed, "descriptor");
     closed = nextclosed;
   }
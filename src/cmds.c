@@ -44,11 +44,14 @@
 #include "lookup.h"
 #include "malias.h"
 #include "match.h"
+#include "mccp.h"
+#include "hostcache.h"
 #include "memcheck.h"
 #include "mushdb.h"
 #include "mymalloc.h"
 #include "mysocket.h"
 #include "parse.h"
+#include "profile.h"
 #include "ssl_slave.h"
 #include "strutil.h"
 #include "version.h"
@@ -761,6 +764,7 @@ extern slab *lock_slab;
 extern slab *mail_slab;
 extern slab *memcheck_slab;
 extern slab *pe_reg_slab;
+extern slab *pe_reg_tab_slab;
 extern slab *pe_reg_val_slab;
 extern slab *text_block_slab;
 
@@ -782,10 +786,10 @@ do_list_allocations(dbref player)
        time. */
     bvm_asmnode_slab,
 #endif
-    chanlist_slab,    chanuser_slab, flag_slab,   function_slab,
-    huffman_slab,     lock_slab,     mail_slab,   memcheck_slab,
-    text_block_slab,  intmap_slab,   pe_reg_slab, pe_reg_val_slab,
-    flagbucket_slab};
+    chanlist_slab,   chanuser_slab,   flag_slab,       function_slab,
+    huffman_slab,    lock_slab,       mail_slab,       memcheck_slab,
+    text_block_slab, intmap_slab,     pe_reg_slab,     pe_reg_tab_slab,
+    pe_reg_val_slab, flagbucket_slab};
   size_t i;
 
   if (!Hasprivs(player)) {
@@ -828,6 +832,18 @@ do_list_allocations(dbref player)
     }
   }
 
+  {
+    struct arena_stats astats;
+    arena_describe(&astats);
+    notify(player, "Evaluation arena:");
+    notify_format(player,
+                  "         blocks held: %-6d     most blocks in use: %-6d",
+                  astats.blocks, astats.max_blocks);
+    notify_format(player, "          bytes held: %-10lu  allocations: %lu",
+                  (unsigned long) astats.size, astats.allocs);
+    notify_format(player, "    blocks allocated: %lu", astats.new_blocks);
+  }
+
   if (options.mem_check) {
     notify(player, "malloc allocations:");
     list_mem_check(&list_mem_check_callback, &player);
@@ -1277,6 +1293,22 @@ COMMAND(cmd_poll) { do_poll(executor, arg_left, SW_ISSET(sw, SWITCH_CLEAR)); }
 
 COMMAND(cmd_poor) { do_poor(executor, arg_left); }
 
+COMMAND(cmd_profile)
+{
+  if (SW_ISSET(sw, SWITCH_START))
+    do_profile_start(executor);
+  else if (SW_ISSET(sw, SWITCH_STOP))
+    do_profile_stop(executor);
+  else if (SW_ISSET(sw, SWITCH_CLEAR))
+    do_profile_clear(executor);
+  else if (SW_ISSET(sw, SWITCH_REPORT))
+    do_profile_report(executor, arg_left);
+  else if (SW_ISSET(sw, SWITCH_EXPORT))
+    do_profile_export(executor);
+  else
+    do_profile_status(executor);
+}
+
 COMMAND(cmd_power)
 {
   if (SW_ISSET(sw, SWITCH_LIST))
@@ -1481,7 +1513,25 @@ COMMAND(cmd_stats)
     chunk_stats(executor, CSTATS_FREESPACEG);
   else if (SW_ISSET(sw, SWITCH_FLAGS))
     flag_stats(executor);
-  else
+  else if (SW_ISSET(sw, SWITCH_NET)) {
+    if (Hasprivs(executor)) {
+      accept_stats(executor);
+      output_queue_stats(executor);
+      mccp_stats(executor);
+      hostcache_report(executor);
+    } else
+      notify(executor, T("Permission denied."));
+  } else if (SW_ISSET(sw, SWITCH_QUEUE)) {
+    if (LookQueue(executor))
+      do_queue_stats(executor);
+    else
+      notify(executor, T("Permission denied."));
+  } else if (SW_ISSET(sw, SWITCH_TIMERS)) {
+    if (Hasprivs(executor))
+      sq_stats(executor);
+    else
+      notify(executor, T("Permission denied."));
+  } else
     do_stats(executor, arg_left);
 }
 
@@ -33,6 +33,7 @@
 #include "mushdb.h"
 #include "mymalloc.h"
 #include "parse.h"
+#include "phash.h"
 #include "ptab.h"
 #include "sort.h"
 #include "strtree.h"
@@ -41,6 +42,8 @@
 
 PTAB ptab_command;       /**< Prefix table for command names. */
 PTAB ptab_command_perms; /**< Prefix table for command permissions */
+PHASH phash_command;     /**< Perfect hash of full command names */
+static bool command_index_stale = 1; /**< Has ptab_command changed? */
 
 HASHTAB htab_reserved_aliases; /**< Hash table for reserved command aliases */
 
@@ -48,6 +51,7 @@ static const char *command_isattr(char *command);
 static int switch_find(COMMAND_INFO *cmd, const char *sw);
 static void strccat(char *buff, char **bp, const char *from);
 static COMMAND_INFO *clone_command(char *original, char *clone);
+static void command_index_build(void);
 static int has_hook(struct hook_data *hook);
 extern int global_fun_invocations; /**< Counter for function invocations */
 extern int global_fun_recursions;  /**< Counter for function recursion */
@@ -261,6 +265,8 @@ COMLIST commands[] = {
   {"@POWER",
    "ADD TYPE LETTER LIST RESTRICT DELETE ALIAS DISABLE ENABLE DECOMPILE",
    cmd_power, CMD_T_ANY | CMD_T_EQSPLIT | CMD_T_RS_ARGS, 0, 0},
+  {"@PROFILE", "START STOP CLEAR REPORT EXPORT", cmd_profile, CMD_T_ANY,
+   "WIZARD", 0},
   {"@PROMPT", "SILENT NOISY NOEVAL SPOOF", cmd_prompt,
    CMD_T_ANY | CMD_T_EQSPLIT | CMD_T_NOGAGGED, 0, 0},
   {"@PS", "ALL SUMMARY COUNT QUICK DEBUG", cmd_ps, CMD_T_ANY, 0, 0},
@@ -293,8 +299,8 @@ COMLIST commands[] = {
   {"@SQL", NULL, cmd_sql, CMD_T_ANY, "WIZARD", "SQL_OK"},
   {"@SITELOCK", "BAN CHECK REGISTER REMOVE NAME PLAYER", cmd_sitelock,
    CMD_T_ANY | CMD_T_EQSPLIT | CMD_T_RS_ARGS, "WIZARD", 0},
-  {"@STATS", "CHUNKS FREESPACE PAGING REGIONS TABLES FLAGS", cmd_stats,
-   CMD_T_ANY, 0, 0},
+  {"@STATS", "CHUNKS FREESPACE PAGING REGIONS TABLES FLAGS NET QUEUE TIMERS",
+   cmd_stats, CMD_T_ANY, 0, 0},
   {"@SUGGEST", "ADD DELETE LIST", cmd_suggest, CMD_T_ANY | CMD_T_EQSPLIT, 0, 0},
   {"@SWEEP", "CONNECTED HERE INVENTORY EXITS", cmd_sweep, CMD_T_ANY, 0, 0},
   {"@SWITCH",
@@ -611,6 +617,7 @@ command_add(const char *name, int type, const char *flagstr,
 {
   ptab_insert_one(&ptab_command, name,
                   make_command(name, type, flagstr, powerstr, switchstr, func));
+  command_index_stale = 1;
   return command_find(name);
 }
 
@@ -664,9 +671,17 @@ command_find(const char *name)
 {
 
   char cmdname[BUFFER_LEN];
+  COMMAND_INFO *cmd;
   strupper_r(name, cmdname, sizeof cmdname);
   if (hash_find(&htab_reserved_aliases, cmdname))
     return NULL;
+  if (command_index_stale)
+    command_index_build();
+  /* Most commands are typed in full; only fall back on the prefix
+   * search when they aren't. */
+  cmd = phash_find(&phash_command, cmdname);
+  if (cmd)
+    return cmd;
   return (COMMAND_INFO *) ptab_find(&ptab_command, cmdname);
 }
 
@@ -686,9 +701,43 @@ command_find_exact(const char *name)
   strupper_r(name, cmdname, sizeof cmdname);
   if (hash_find(&htab_reserved_aliases, cmdname))
     return NULL;
+  if (command_index_stale)
+    command_index_build();
+  if (phash_command.entries)
+    return phash_find(&phash_command, cmdname);
   return (COMMAND_INFO *) ptab_find_exact(&ptab_command, cmdname);
 }
 
+/** Rebuild the perfect hash of command names and aliases from the
+ * prefix table. While the prefix table is being loaded, or if the hash
+ * can't be built, it's left empty and lookups use the prefix table. */
+static void
+command_index_build(void)
+{
+  const char **keys;
+  void **data;
+  const char *key;
+  COMMAND_INFO *cmd;
+  size_t n = 0;
+
+  if (ptab_command.state) {
+    phash_free(&phash_command);
+    return;
+  }
+  keys = mush_calloc(ptab_command.len + 1, sizeof(char *), "command.index");
+  data = mush_calloc(ptab_command.len + 1, sizeof(void *), "command.index");
+  for (cmd = ptab_firstentry_new(&ptab_command, &key); cmd;
+       cmd = ptab_nextentry_new(&ptab_command, &key)) {
+    keys[n] = key;
+    data[n] = cmd;
+    n++;
+  }
+  phash_build(&phash_command, n, keys, data);
+  mush_free(keys, "command.index");
+  mush_free(data, "command.index");
+  command_index_stale = 0;
+}
+
 /** Convert a switch string to a switch mask.
  * Given a space-separated list of switches in string form, return
  * a pointer to a static switch mask.
@@ -790,6 +839,7 @@ command_init_preconfig(void)
                              cmd->switches, cmd->func));
   }
   ptab_end_inserts(&ptab_command);
+  command_index_stale = 1;
 
   ptab_init(&ptab_command_perms);
   ptab_start_inserts(&ptab_command_perms);
@@ -895,6 +945,7 @@ alias_command(const char *command, const char *alias)
     return 0;
 
   ptab_insert_one(&ptab_command, strupper(alias), cmd);
+  command_index_stale = 1;
   return 1;
 }
 
@@ -2014,6 +2065,7 @@ clone_command(char *original, char *clone)
     c2->hooks.extend = new_hook(c1->hooks.extend);
 
   ptab_insert_one(&ptab_command, clone, c2);
+  command_index_stale = 1;
   return command_find(clone);
 }
 
@@ -2057,6 +2109,7 @@ do_command_delete(dbref player, char *name)
       while (cptr) {
         if (cptr == command) {
           ptab_delete(&ptab_command, alias);
+          command_index_stale = 1;
           acount++;
           cptr = ptab_firstentry_new(&ptab_command, &alias);
         } else
@@ -2073,6 +2126,7 @@ do_command_delete(dbref player, char *name)
   } else {
     /* This is an alias. Just remove it */
     ptab_delete(&ptab_command, name);
+    command_index_stale = 1;
     notify_format(player, T("Removed %s from command table."), name);
   }
 }
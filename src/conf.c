@@ -141,7 +141,15 @@ PENNCONF conftable[] = {
    "net"},
   {"use_ws", cf_bool, &options.use_ws, sizeof options.use_ws, 0, "net"},
   {"ws_url", cf_str, options.ws_url, sizeof options.ws_url, 0, "net"},
+  {"ws_deflate_window_bits", cf_int, &options.ws_deflate_bits, 15, 0, "net"},
+  {"ws_deflate_mem_level", cf_int, &options.ws_deflate_mem_level, 9, 0,
+   "net"},
   {"use_dns", cf_bool, &options.use_dns, 2, 0, "net"},
+  {"dns_cache_ttl", cf_time, &options.dns_cache_ttl, 86400, 0, "net"},
+  {"dns_cache_size", cf_int, &options.dns_cache_size, 100000, 0, "net"},
+  {"accept_batch", cf_int, &options.accept_batch, 10000, 0, "net"},
+  {"connect_rate", cf_int, &options.connect_rate, 100000, 0, "net"},
+  {"connect_burst", cf_int, &options.connect_burst, 100000, 0, "net"},
   {"logins", cf_bool, &options.login_allow, 2, 0, "net"},
   {"player_creation", cf_bool, &options.create_allow, 2, 0, "net"},
   {"guests", cf_bool, &options.guest_allow, 2, 0, "net"},
@@ -225,6 +233,12 @@ PENNCONF conftable[] = {
   {"queue_loss", cf_int, &options.queue_loss, 10000, 0, "limits"},
   {"queue_chunk", cf_int, &options.queue_chunk, 100000, 0, "limits"},
   {"active_queue_chunk", cf_int, &options.active_q_chunk, 100000, 0, "limits"},
+  {"command_burst", cf_int, &options.command_burst, 100000, 0, "limits"},
+  {"command_weight", cf_int, &options.command_weight, 1000, 0, "limits"},
+  {"unconnected_command_burst", cf_int, &options.unconnected_command_burst,
+   100000, 0, "limits"},
+  {"unconnected_command_weight", cf_int, &options.unconnected_command_weight,
+   1000, 0, "limits"},
   {"function_recursion_limit", cf_int, &options.func_nest_lim, 100000, 0,
    "limits"},
   {"function_invocation_limit", cf_int, &options.func_invk_lim, 100000, 0,
@@ -267,12 +281,17 @@ PENNCONF conftable[] = {
   {"safer_ufun", cf_bool, &options.safer_ufun, 2, 0, "funcs"},
   {"function_side_effects", cf_bool, &options.function_side_effects, 2, 0,
    "funcs"},
+  {"compiled_eval", cf_bool, &options.compiled_eval, 2, 0, "funcs"},
+  {"compiled_eval_check", cf_bool, &options.compiled_eval_check, 2, 0,
+   "funcs"},
 
   {"noisy_whisper", cf_bool, &options.noisy_whisper, 2, 0, "cmds"},
   {"possessive_get", cf_bool, &options.possessive_get, 2, 0, "cmds"},
   {"possessive_get_d", cf_bool, &options.possessive_get_d, 2, 0, "cmds"},
   {"link_to_object", cf_bool, &options.link_to_object, 2, 0, "cmds"},
   {"owner_queues", cf_bool, &options.owner_queues, 2, 0, "cmds"},
+  {"fair_queue", cf_bool, &options.fair_queue, 2, 0, "cmds"},
+  {"queue_stats", cf_bool, &options.queue_stats, 2, 0, "cmds"},
   {"full_invis", cf_bool, &options.full_invis, 2, 0, "cmds"},
   {"wiz_noaenter", cf_bool, &options.wiz_noaenter, 2, 0, "cmds"},
   {"really_safe", cf_bool, &options.really_safe, 2, 0, "cmds"},
@@ -1162,6 +1181,8 @@ conf_default_set(void)
   strcpy(options.socket_file, "data/netmush.sock");
   options.use_ws = 1;
   strcpy(options.ws_url, "/wsclient");
+  options.ws_deflate_bits = 13;
+  options.ws_deflate_mem_level = 6;
   strcpy(options.input_db, "data/indb");
   strcpy(options.output_db, "data/outdb");
   strcpy(options.crash_db, "data/PANIC.db");
@@ -1202,11 +1223,17 @@ conf_default_set(void)
   options.player_queue_limit = 100;
   options.queue_chunk = 3;
   options.active_q_chunk = 0;
+  options.command_burst = 100;
+  options.command_weight = 1;
+  options.unconnected_command_burst = 100;
+  options.unconnected_command_weight = 1;
   options.func_nest_lim = 50;
   options.func_invk_lim = 2500;
   options.call_lim = 0;
   options.use_quota = 1;
   options.function_side_effects = 1;
+  options.compiled_eval = 1;
+  options.compiled_eval_check = 0;
   options.empty_attrs = 1;
   set_string_option(options.money_singular, T("Penny"));
   set_string_option(options.money_plural, T("Pennies"));
@@ -1248,6 +1275,11 @@ conf_default_set(void)
   strcpy(options.channel_flags, "");
   options.warn_interval = 3600;
   options.use_dns = 1;
+  options.dns_cache_ttl = 3600;
+  options.dns_cache_size = 1024;
+  options.accept_batch = 32;
+  options.connect_rate = 30;
+  options.connect_burst = 10;
   options.safer_ufun = 1;
   set_string_option(options.dump_warning_1min,
                     T("GAME: Database save in 1 minute."));
@@ -1279,6 +1311,8 @@ conf_default_set(void)
   options.zone_control = 1;
   options.link_to_object = 1;
   options.owner_queues = 0;
+  options.fair_queue = 1;
+  options.queue_stats = 1;
   options.wiz_noaenter = 0;
   strcpy(options.ip_addr, "");
   strcpy(options.ssl_ip_addr, "");
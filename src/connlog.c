@@ -24,6 +24,7 @@
 #include "strutil.h"
 #include "mymalloc.h"
 #include "charconv.h"
+#include "hostcache.h"
 
 #define CONNLOG_APPID 0x42010FF2
 #define CONNLOG_VERSION 3
@@ -57,6 +58,47 @@ checkpoint_event(void *arg __attribute__((__unused__)))
   return 1;
 }
 
+/** Fill the hostname cache with the addresses that connected most
+ * recently, so they don't have to wait on DNS after a restart.
+ */
+static void
+warm_hostcache(void)
+{
+  sqlite3_stmt *recent;
+  int status, count = 0;
+
+  if (!USE_DNS || !hostcache_size()) {
+    return;
+  }
+
+  recent = prepare_statement_cache(
+    connlog_db,
+    "SELECT ipaddr, hostname, last FROM (SELECT ipaddr, hostname, max(conn) "
+    "AS last FROM connlog WHERE conn >= ? AND ipaddr != hostname GROUP BY "
+    "ipaddr ORDER BY last DESC LIMIT ?) ORDER BY last",
+    "connlog.hostcache", 0);
+  if (!recent) {
+    return;
+  }
+  sqlite3_bind_int64(recent, 1, time(NULL) - DNS_CACHE_TTL);
+  sqlite3_bind_int(recent, 2, hostcache_size());
+
+  do {
+    status = sqlite3_step(recent);
+    if (status == SQLITE_ROW) {
+      hostcache_add((const char *) sqlite3_column_text(recent, 0),
+                    (const char *) sqlite3_column_text(recent, 1),
+                    sqlite3_column_int64(recent, 2), DNS_CACHE_TTL);
+      count += 1;
+    }
+  } while (status == SQLITE_ROW || is_busy_status(status));
+  sqlite3_finalize(recent);
+
+  if (count) {
+    do_rawlog(LT_ERR, "Loaded %d recent hostnames from connlog.", count);
+  }
+}
+
 /** Intialize connlog database.
  *
  * \param rebooting true if coming up from a reboot.
@@ -205,6 +247,8 @@ init_conndb(bool rebooting)
   sq_register_loop(90, checkpoint_event, NULL, NULL);
   sq_register_loop(25 * 60 * 60 + 300, optimize_db, connlog_db, NULL);
 
+  warm_hostcache();
+
   return 1;
 
 error_cleanup:
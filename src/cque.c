@@ -11,6 +11,7 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <math.h>
 #include <signal.h>
 #include <string.h>
 #include <stdarg.h>
@@ -50,6 +51,7 @@
 #include "mushdb.h"
 #include "mymalloc.h"
 #include "parse.h"
+#include "profile.h"
 #include "ptab.h"
 #include "strtree.h"
 #include "strutil.h"
@@ -59,10 +61,80 @@ intmap *queue_map = NULL; /**< Intmap for looking up queue entries by pid */
 static uint32_t top_pid = 1;
 #define MAX_PID (1U << 15)
 
-static MQUE *qfirst = NULL, *qlast = NULL, *qwait = NULL;
 static MQUE *qlfirst = NULL, *qllast = NULL;
+
+/* The player queue holds entries that are ready to run. It's split up
+ * by the owner of the executor, with each owner's entries kept in the
+ * order they were queued, and do_top() picks which owner goes next
+ * with weighted fair queueing: every owner has a virtual time, which
+ * goes up each time one of their commands runs, and the owner with the
+ * lowest virtual time goes next. An owner who starts queueing again
+ * starts at the current virtual time, so it can't save up a burst. */
+struct queue_owner {
+  dbref owner;             /**< Owner, or NOTHING when fair_queue is off */
+  MQUE *first;             /**< Oldest runnable entry */
+  MQUE *last;              /**< Newest runnable entry */
+  int depth;               /**< Number of runnable entries */
+  uint64_t vtime;          /**< Virtual time of its next command */
+  uint64_t seq;            /**< Order owners joined the heap in */
+  int heap_index;          /**< Position in owner_heap, or -1 */
+  uint64_t ran;            /**< Commands run */
+  uint64_t wait_total;     /**< Total milliseconds those waited to run */
+  uint64_t wait_max;       /**< Longest wait to run, in milliseconds */
+  struct queue_owner *next; /**< Next in the list of all owners */
+};
+static intmap *owner_map = NULL; /**< Owners to their queue_owners */
+static struct queue_owner *queue_owners = NULL; /**< All queue_owners */
+static struct queue_owner **owner_heap = NULL;  /**< Owners with commands */
+static int owner_heap_len = 0, owner_heap_size = 0;
+static uint64_t owner_seq = 0;    /**< Last queue_owner seq handed out */
+static uint64_t queue_vclock = 0; /**< Virtual time of the last command */
+static int queue_runnable = 0;    /**< Entries in the player queue */
+
+/** How much an owner's virtual time goes up for each command. Owners
+ * allowed a huge queue get a bigger share. */
+#define FAIR_SHARE_COST 4
+#define FAIR_SHARE_HUGE_COST 1
 static MQUE *qsemfirst = NULL, *qsemlast = NULL;
 
+/* The semaphore queue is also indexed by the object and attribute
+ * being waited on. sem_map maps each object to a list of the
+ * attributes it has waiters on, and each of those keeps its waiters in
+ * the order they were queued. */
+struct sem_key {
+  char *attr;          /**< Semaphore attribute name */
+  MQUE *first;         /**< Oldest entry waiting on it */
+  MQUE *last;          /**< Newest entry waiting on it */
+  struct sem_key *next; /**< Next attribute on the same object */
+};
+intmap *sem_map = NULL;       /**< Semaphore objects to their sem_keys */
+static uint64_t sem_seq = 0;   /**< Last sem_seq handed out */
+
+/* Everything with a timeout, @waits and timed semaphores alike, is
+ * kept in a binary min-heap ordered by wait_until, and then by
+ * wait_seq so entries due at the same time run in the order they were
+ * queued. */
+static MQUE **wait_heap = NULL; /**< The heap */
+static int wait_heap_len = 0;   /**< Number of entries in the heap */
+static int wait_heap_size = 0;  /**< Allocated size of the heap */
+static uint64_t wait_seq = 0;   /**< Last wait_seq handed out */
+
+static void wait_heap_add(MQUE *entry);
+static void wait_heap_remove(MQUE *entry);
+static void wait_heap_update(MQUE *entry);
+static int wait_heap_sorted(MQUE ***list);
+static bool parse_wait_time(const char *str, double *secs);
+static uint64_t wait_deadline(double secs, bool until);
+static long wait_secs_left(const MQUE *entry);
+static struct sem_key *sem_find_key(dbref thing, const char *aname);
+static void sem_link(MQUE *entry);
+static void sem_unlink(MQUE *entry);
+static MQUE *sem_first(dbref thing, const char *aname);
+static void player_queue_add(MQUE *entry);
+static void object_queue_add(MQUE *entry);
+static MQUE *player_queue_pop(void);
+static const char *queue_owner_name(struct queue_owner *qo);
+
 static int add_to_generic(dbref player, int am, const char *name,
                           uint32_t flags);
 static int add_to(dbref player, int am);
@@ -70,12 +142,15 @@ static int add_to_sem(dbref player, int am, const char *name);
 static int queue_limit(dbref player);
 void free_qentry(MQUE *point);
 static int pay_queue(dbref player, const char *command);
-void wait_que(dbref executor, int waittill, char *command, dbref enactor,
+void wait_que(dbref executor, double waittill, char *command, dbref enactor,
               dbref sem, const char *semattr, int until, MQUE *parent_queue);
 int que_next(void);
 
 static void show_queue(dbref player, dbref victim, int q_type, int q_quiet,
                        int q_all, MQUE *q_ptr, int *tot, int *self, int *del);
+static void show_queue_entry(dbref player, dbref victim, int q_type,
+                             int q_quiet, int q_all, MQUE *tmp, int *tot,
+                             int *self, int *del);
 static void show_queue_single(dbref player, MQUE *q, int q_type);
 static void show_queue_env(dbref player, MQUE *q);
 static void do_raw_restart(dbref victim);
@@ -93,6 +168,47 @@ int32_t queue_load_record[QUEUE_LOAD_SECS]
 
 double average32(const int32_t *arr, int count);
 
+/* Latency histograms.
+ *
+ * Each queue entry is counted in the histograms for the queue it went
+ * into: how long it waited between being queued and starting to run,
+ * and how long it ran. They're log-linear, like an HdrHistogram: every
+ * value under LAT_SUB_BUCKETS microseconds has its own bucket, and each
+ * power of two above that is split into LAT_SUB_BUCKETS buckets, so a
+ * value is known to within about 3%.
+ */
+
+/** Queues with their own latency histograms. */
+enum latency_queue {
+  LQ_PLAYER,    /**< Player queue */
+  LQ_OBJECT,    /**< Object queue */
+  LQ_WAIT,      /**< \@wait */
+  LQ_SEMAPHORE, /**< Semaphores */
+  LQ_INPLACE,   /**< Inplace entries, from \@include and friends */
+  LQ_COUNT
+};
+
+static const char *latency_queue_names[LQ_COUNT] = {
+  "player", "object", "wait", "semaphore", "inplace"};
+
+#define LAT_SUB_BITS 5
+#define LAT_SUB_BUCKETS (1 << LAT_SUB_BITS)
+#define LAT_MAX_BITS 40 /* 2^40 microseconds is about 12 days */
+#define LAT_BUCKETS ((LAT_MAX_BITS - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS)
+
+/** A histogram of latencies, in microseconds. */
+struct latency_hist {
+  uint64_t count;                /**< Number of values */
+  uint64_t total;                /**< Sum of the values */
+  uint64_t max;                  /**< Largest value */
+  uint64_t buckets[LAT_BUCKETS]; /**< Number of values in each bucket */
+};
+
+enum { LAT_WAIT, LAT_RUN };
+
+/** Time spent waiting to run and running, for each queue */
+static struct latency_hist queue_latency[LQ_COUNT][2];
+
 extern volatile sig_atomic_t
   cpu_time_limit_hit; /**< Have we used too much CPU? */
 
@@ -112,6 +228,571 @@ void
 init_queue(void)
 {
   queue_map = im_new();
+  sem_map = im_new();
+  owner_map = im_new();
+}
+
+/** Which histogram bucket a latency goes in. */
+static int
+lat_bucket(uint64_t usecs)
+{
+  int k;
+
+  if (usecs < LAT_SUB_BUCKETS)
+    return (int) usecs;
+  if (usecs >> LAT_MAX_BITS)
+    usecs = (UINT64_C(1) << LAT_MAX_BITS) - 1;
+  k = 63 - __builtin_clzll(usecs);
+  return (k - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS +
+         (int) ((usecs >> (k - LAT_SUB_BITS)) - LAT_SUB_BUCKETS);
+}
+
+/** The largest latency that goes in a histogram bucket. */
+static uint64_t
+lat_bucket_top(int b)
+{
+  int shift = b / LAT_SUB_BUCKETS - 1;
+
+  if (shift < 0)
+    return b;
+  return ((uint64_t) (b % LAT_SUB_BUCKETS + LAT_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+/** Count a latency in a histogram. */
+static inline void
+lat_record(struct latency_hist *h, uint64_t usecs)
+{
+  h->count++;
+  h->total += usecs;
+  if (usecs > h->max)
+    h->max = usecs;
+  h->buckets[lat_bucket(usecs)]++;
+}
+
+/** Add one histogram's counts to another's. */
+static void
+lat_merge(struct latency_hist *to, const struct latency_hist *from)
+{
+  int b;
+
+  to->count += from->count;
+  to->total += from->total;
+  if (from->max > to->max)
+    to->max = from->max;
+  for (b = 0; b < LAT_BUCKETS; b++)
+    to->buckets[b] += from->buckets[b];
+}
+
+/** Find a percentile of a histogram.
+ * \param h the histogram.
+ * \param pct the percentile, from 0 to 100.
+ * \return the latency in microseconds that pct percent of the values
+ * are at or under, or 0 if there aren't any.
+ */
+static uint64_t
+lat_percentile(const struct latency_hist *h, double pct)
+{
+  uint64_t rank, seen = 0;
+  int b;
+
+  if (!h->count)
+    return 0;
+  rank = (uint64_t) ceil(pct * h->count / 100.0);
+  if (rank < 1)
+    rank = 1;
+  for (b = 0; b < LAT_BUCKETS; b++) {
+    seen += h->buckets[b];
+    if (seen >= rank)
+      return lat_bucket_top(b) < h->max ? lat_bucket_top(b) : h->max;
+  }
+  return h->max;
+}
+
+/** Is queue entry a due before queue entry b? */
+#define WAIT_BEFORE(a, b)                                                      \
+  ((a)->wait_until < (b)->wait_until ||                                        \
+   ((a)->wait_until == (b)->wait_until && (a)->wait_seq < (b)->wait_seq))
+
+/** Put an entry at a position in the wait heap. */
+static inline void
+wait_heap_set(int i, MQUE *entry)
+{
+  wait_heap[i] = entry;
+  entry->wait_index = i;
+}
+
+/** Move an entry towards the top of the wait heap until it's in order. */
+static void
+wait_heap_up(int i)
+{
+  MQUE *entry = wait_heap[i];
+
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!WAIT_BEFORE(entry, wait_heap[parent]))
+      break;
+    wait_heap_set(i, wait_heap[parent]);
+    i = parent;
+  }
+  wait_heap_set(i, entry);
+}
+
+/** Move an entry towards the bottom of the wait heap until it's in
+ * order. */
+static void
+wait_heap_down(int i)
+{
+  MQUE *entry = wait_heap[i];
+
+  for (;;) {
+    int child = i * 2 + 1;
+    if (child >= wait_heap_len)
+      break;
+    if (child + 1 < wait_heap_len &&
+        WAIT_BEFORE(wait_heap[child + 1], wait_heap[child]))
+      child++;
+    if (!WAIT_BEFORE(wait_heap[child], entry))
+      break;
+    wait_heap_set(i, wait_heap[child]);
+    i = child;
+  }
+  wait_heap_set(i, entry);
+}
+
+/** Add a queue entry with a wait_until to the wait heap.
+ * \param entry the queue entry.
+ */
+static void
+wait_heap_add(MQUE *entry)
+{
+  if (wait_heap_len == wait_heap_size) {
+    wait_heap_size = wait_heap_size ? wait_heap_size * 2 : 64;
+    wait_heap = mush_realloc(wait_heap, sizeof(MQUE *) * wait_heap_size,
+                             "mque.wait_heap");
+  }
+  entry->wait_seq = ++wait_seq;
+  wait_heap_set(wait_heap_len, entry);
+  wait_heap_up(wait_heap_len++);
+}
+
+/** Take a queue entry out of the wait heap.
+ * \param entry the queue entry.
+ */
+static void
+wait_heap_remove(MQUE *entry)
+{
+  int i = entry->wait_index;
+  MQUE *last;
+
+  if (i < 0)
+    return;
+  entry->wait_index = -1;
+  last = wait_heap[--wait_heap_len];
+  if (last == entry)
+    return;
+  wait_heap_set(i, last);
+  wait_heap_up(i);
+  wait_heap_down(last->wait_index);
+}
+
+/** Move a queue entry in the wait heap after changing its wait_until.
+ * It goes after anything else due at the same time.
+ * \param entry the queue entry.
+ */
+static void
+wait_heap_update(MQUE *entry)
+{
+  entry->wait_seq = ++wait_seq;
+  wait_heap_up(entry->wait_index);
+  wait_heap_down(entry->wait_index);
+}
+
+static int
+wait_heap_cmp(const void *a, const void *b)
+{
+  const MQUE *qa = *(MQUE *const *) a;
+  const MQUE *qb = *(MQUE *const *) b;
+
+  if (WAIT_BEFORE(qa, qb))
+    return -1;
+  return WAIT_BEFORE(qb, qa);
+}
+
+/** Get the entries in the wait heap in the order they're due.
+ * \param list where to store a newly allocated array of the entries,
+ * which the caller frees with mush_free(..., "mque.wait_list").
+ * \return the number of entries.
+ */
+static int
+wait_heap_sorted(MQUE ***list)
+{
+  if (!wait_heap_len) {
+    *list = NULL;
+    return 0;
+  }
+  *list = mush_calloc(wait_heap_len, sizeof(MQUE *), "mque.wait_list");
+  memcpy(*list, wait_heap, sizeof(MQUE *) * wait_heap_len);
+  qsort(*list, wait_heap_len, sizeof(MQUE *), wait_heap_cmp);
+  return wait_heap_len;
+}
+
+/** Parse a wait time or timeout, which can have a fractional part.
+ * \param str the string to parse.
+ * \param secs where to store the number of seconds.
+ * \return true if str is a valid time.
+ */
+static bool
+parse_wait_time(const char *str, double *secs)
+{
+  NVAL val;
+
+  if (!is_strict_number(str))
+    return false;
+  val = parse_number(str);
+  if (!is_good_number(val))
+    return false;
+  *secs = val;
+  return true;
+}
+
+/** Work out the monotonic_msecs() time a wait is due.
+ * \param secs seconds to wait, or the time to wait until.
+ * \param until true if secs is an absolute time in seconds since the
+ * epoch.
+ * \return the time, which is never earlier than now.
+ */
+static uint64_t
+wait_deadline(double secs, bool until)
+{
+  uint64_t now = monotonic_msecs();
+
+  if (until) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    secs -= tv.tv_sec + tv.tv_usec / 1000000.0;
+  }
+  if (secs <= 0)
+    return now;
+  if (secs > INT_MAX)
+    secs = INT_MAX;
+  return now + (uint64_t) (secs * 1000.0 + 0.5);
+}
+
+/** How many seconds until a queue entry is due, rounded up.
+ * \param entry the queue entry.
+ * \return the number of seconds.
+ */
+static long
+wait_secs_left(const MQUE *entry)
+{
+  uint64_t now = monotonic_msecs();
+
+  if (entry->wait_until <= now)
+    return 0;
+  return (long) ((entry->wait_until - now + 999) / 1000);
+}
+
+/** Find the waiters on one semaphore.
+ * \param thing the semaphore object.
+ * \param aname the semaphore attribute.
+ * \return the sem_key for them, or NULL if there aren't any.
+ */
+static struct sem_key *
+sem_find_key(dbref thing, const char *aname)
+{
+  struct sem_key *key;
+
+  for (key = im_find(sem_map, thing); key; key = key->next)
+    if (strcmp(key->attr, aname) == 0)
+      return key;
+  return NULL;
+}
+
+/** Put an entry at the end of the semaphore queue.
+ * Its semaphore_obj and semaphore_attr must be set.
+ * \param entry the queue entry.
+ */
+static void
+sem_link(MQUE *entry)
+{
+  struct sem_key *key, *head;
+
+  key = sem_find_key(entry->semaphore_obj, entry->semaphore_attr);
+  if (!key) {
+    key = mush_malloc(sizeof *key, "mque.semaphore_key");
+    key->attr = mush_strdup(entry->semaphore_attr, "mque.semaphore_key");
+    key->first = key->last = NULL;
+    key->next = NULL;
+    head = im_find(sem_map, entry->semaphore_obj);
+    if (head) {
+      while (head->next)
+        head = head->next;
+      head->next = key;
+    } else
+      im_insert(sem_map, entry->semaphore_obj, key);
+  }
+  entry->key_next = NULL;
+  entry->key_prev = key->last;
+  if (key->last)
+    key->last->key_next = entry;
+  else
+    key->first = entry;
+  key->last = entry;
+
+  entry->next = NULL;
+  entry->sem_prev = qsemlast;
+  if (qsemlast)
+    qsemlast->next = entry;
+  else
+    qsemfirst = entry;
+  qsemlast = entry;
+  entry->sem_seq = ++sem_seq;
+}
+
+/** Take an entry out of the semaphore queue, if it's in it.
+ * \param entry the queue entry.
+ */
+static void
+sem_unlink(MQUE *entry)
+{
+  struct sem_key *key;
+
+  if (!entry->sem_seq)
+    return;
+  entry->sem_seq = 0;
+
+  if (entry->sem_prev)
+    entry->sem_prev->next = entry->next;
+  else
+    qsemfirst = entry->next;
+  if (entry->next)
+    entry->next->sem_prev = entry->sem_prev;
+  else
+    qsemlast = entry->sem_prev;
+  entry->next = entry->sem_prev = NULL;
+
+  key = sem_find_key(entry->semaphore_obj, entry->semaphore_attr);
+  if (!key)
+    return;
+  if (entry->key_prev)
+    entry->key_prev->key_next = entry->key_next;
+  else
+    key->first = entry->key_next;
+  if (entry->key_next)
+    entry->key_next->key_prev = entry->key_prev;
+  else
+    key->last = entry->key_prev;
+  entry->key_next = entry->key_prev = NULL;
+
+  if (!key->first) {
+    /* Nothing else waiting on this attribute */
+    struct sem_key *head = im_find(sem_map, entry->semaphore_obj);
+
+    im_delete(sem_map, entry->semaphore_obj);
+    if (head == key) {
+      head = key->next;
+    } else {
+      struct sem_key *prev;
+      for (prev = head; prev->next != key; prev = prev->next)
+        ;
+      prev->next = key->next;
+    }
+    if (head)
+      im_insert(sem_map, entry->semaphore_obj, head);
+    mush_free(key->attr, "mque.semaphore_key");
+    mush_free(key, "mque.semaphore_key");
+  }
+}
+
+/** Find the oldest entry waiting on a semaphore.
+ * \param thing the semaphore object.
+ * \param aname the semaphore attribute, or NULL for any attribute.
+ * \return the queue entry, or NULL if nothing's waiting.
+ */
+static MQUE *
+sem_first(dbref thing, const char *aname)
+{
+  struct sem_key *key;
+  MQUE *first = NULL;
+
+  if (aname) {
+    key = sem_find_key(thing, aname);
+    return key ? key->first : NULL;
+  }
+  for (key = im_find(sem_map, thing); key; key = key->next)
+    if (!first || key->first->sem_seq < first->sem_seq)
+      first = key->first;
+  return first;
+}
+
+/** Is queue owner a due before queue owner b? */
+#define OWNER_BEFORE(a, b)                                                     \
+  ((a)->vtime < (b)->vtime || ((a)->vtime == (b)->vtime && (a)->seq < (b)->seq))
+
+/** Put a queue owner at a position in the owner heap. */
+static inline void
+owner_heap_set(int i, struct queue_owner *qo)
+{
+  owner_heap[i] = qo;
+  qo->heap_index = i;
+}
+
+/** Move a queue owner down the owner heap until it's in order. */
+static void
+owner_heap_down(int i)
+{
+  struct queue_owner *qo = owner_heap[i];
+
+  for (;;) {
+    int child = i * 2 + 1;
+    if (child >= owner_heap_len)
+      break;
+    if (child + 1 < owner_heap_len &&
+        OWNER_BEFORE(owner_heap[child + 1], owner_heap[child]))
+      child++;
+    if (!OWNER_BEFORE(owner_heap[child], qo))
+      break;
+    owner_heap_set(i, owner_heap[child]);
+    i = child;
+  }
+  owner_heap_set(i, qo);
+}
+
+/** Add a queue owner that has commands to run to the owner heap. */
+static void
+owner_heap_add(struct queue_owner *qo)
+{
+  int i;
+
+  if (owner_heap_len == owner_heap_size) {
+    owner_heap_size = owner_heap_size ? owner_heap_size * 2 : 32;
+    owner_heap =
+      mush_realloc(owner_heap, sizeof *owner_heap * owner_heap_size,
+                   "mque.owner_heap");
+  }
+  qo->seq = ++owner_seq;
+  i = owner_heap_len++;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!OWNER_BEFORE(qo, owner_heap[parent]))
+      break;
+    owner_heap_set(i, owner_heap[parent]);
+    i = parent;
+  }
+  owner_heap_set(i, qo);
+}
+
+/** Take the first queue owner off the owner heap. */
+static void
+owner_heap_pop(void)
+{
+  owner_heap[0]->heap_index = -1;
+  if (--owner_heap_len > 0) {
+    owner_heap_set(0, owner_heap[owner_heap_len]);
+    owner_heap_down(0);
+  }
+}
+
+/** Find, or make, the player queue for a queue entry's owner. */
+static struct queue_owner *
+queue_owner_of(MQUE *entry)
+{
+  struct queue_owner *qo;
+  dbref owner = NOTHING;
+
+  if (options.fair_queue && GoodObject(entry->executor))
+    owner = Owner(entry->executor);
+  qo = im_find(owner_map, owner);
+  if (!qo) {
+    qo = mush_calloc(1, sizeof *qo, "mque.owner");
+    qo->owner = owner;
+    qo->heap_index = -1;
+    qo->next = queue_owners;
+    queue_owners = qo;
+    im_insert(owner_map, owner, qo);
+  }
+  return qo;
+}
+
+/** Add a queue entry to the end of its owner's part of the player
+ * queue.
+ * \param entry the queue entry.
+ */
+static void
+player_queue_add(MQUE *entry)
+{
+  struct queue_owner *qo = queue_owner_of(entry);
+
+  if (!entry->queued_at)
+    entry->queued_at = monotonic_usecs();
+  entry->next = NULL;
+  if (qo->last)
+    qo->last->next = entry;
+  else
+    qo->first = entry;
+  qo->last = entry;
+  qo->depth++;
+  queue_runnable++;
+  if (qo->heap_index < 0) {
+    if (qo->vtime < queue_vclock)
+      qo->vtime = queue_vclock;
+    owner_heap_add(qo);
+  }
+}
+
+/** Add a queue entry to the end of the object queue.
+ * \param entry the queue entry.
+ */
+static void
+object_queue_add(MQUE *entry)
+{
+  if (!entry->queued_at)
+    entry->queued_at = monotonic_usecs();
+  entry->next = NULL;
+  if (qllast) {
+    qllast->next = entry;
+    qllast = entry;
+  } else
+    qllast = qlfirst = entry;
+}
+
+/** Take the next queue entry to run off the player queue.
+ * \return the queue entry, or NULL if the player queue is empty.
+ */
+static MQUE *
+player_queue_pop(void)
+{
+  struct queue_owner *qo;
+  MQUE *entry;
+  uint64_t waited, now;
+
+  if (!owner_heap_len)
+    return NULL;
+  qo = owner_heap[0];
+  entry = qo->first;
+  if (!(qo->first = entry->next))
+    qo->last = NULL;
+  entry->next = NULL;
+  qo->depth--;
+  queue_runnable--;
+
+  now = monotonic_usecs();
+  waited = now > entry->queued_at ? (now - entry->queued_at) / 1000 : 0;
+  qo->ran++;
+  qo->wait_total += waited;
+  if (waited > qo->wait_max)
+    qo->wait_max = waited;
+
+  queue_vclock = qo->vtime;
+  if (GoodObject(qo->owner) && HugeQueue(qo->owner))
+    qo->vtime += FAIR_SHARE_HUGE_COST;
+  else
+    qo->vtime += FAIR_SHARE_COST;
+  if (qo->depth)
+    owner_heap_down(0);
+  else
+    owner_heap_pop();
+  return entry;
 }
 
 /** Returns true if the attribute on thing can be used as a semaphore.
@@ -248,6 +929,10 @@ free_qentry(MQUE *entry)
 {
   MQUE *tmp;
 
+  if (entry->wait_index >= 0)
+    wait_heap_remove(entry);
+  sem_unlink(entry);
+
   if (entry->inplace) {
     tmp = entry->inplace;
     entry->inplace = NULL;
@@ -370,6 +1055,12 @@ new_queue_entry(NEW_PE_INFO *pe_info)
   entry->semaphore_obj = NOTHING;
   entry->semaphore_attr = NULL;
   entry->wait_until = 0;
+  entry->wait_seq = 0;
+  entry->wait_index = -1;
+  entry->sem_prev = entry->key_next = entry->key_prev = NULL;
+  entry->sem_seq = 0;
+  entry->queued_at = 0;
+  entry->latency_queue = -1;
   entry->pid = 0;
   entry->action_list = NULL;
   entry->queue_type = QUEUE_DEFAULT;
@@ -490,6 +1181,7 @@ queue_event(dbref enactor, const char *event, const char *fmt, ...)
   tmp->enactor = enactor;
   tmp->caller = enactor;
   tmp->queue_type |= QUEUE_EVENT;
+  tmp->latency_queue = LQ_PLAYER;
 
   /* safe_atr_value returns a mush_strdup'd buffer, which is freed in
    * free_qentry */
@@ -510,19 +1202,9 @@ queue_event(dbref enactor, const char *event, const char *fmt, ...)
    * For now, yes, but leaving code here anyway.
    */
   if (1) {
-    if (qlast) {
-      qlast->next = tmp;
-      qlast = tmp;
-    } else {
-      qlast = qfirst = tmp;
-    }
+    player_queue_add(tmp);
   } else {
-    if (qllast) {
-      qllast->next = tmp;
-      qllast = tmp;
-    } else {
-      qllast = qlfirst = tmp;
-    }
+    object_queue_add(tmp);
   }
 
   /* All good! */
@@ -575,22 +1257,17 @@ insert_que(MQUE *queue_entry, MQUE *parent_queue)
   switch (
     (queue_entry->queue_type & (QUEUE_PLAYER | QUEUE_OBJECT | QUEUE_INPLACE))) {
   case QUEUE_PLAYER:
-    if (qlast) {
-      qlast->next = queue_entry;
-      qlast = queue_entry;
-    } else {
-      qlast = qfirst = queue_entry;
-    }
+    queue_entry->latency_queue = LQ_PLAYER;
+    player_queue_add(queue_entry);
     break;
   case QUEUE_OBJECT:
-    if (qllast) {
-      qllast->next = queue_entry;
-      qllast = queue_entry;
-    } else {
-      qllast = qlfirst = queue_entry;
-    }
+    queue_entry->latency_queue = LQ_OBJECT;
+    object_queue_add(queue_entry);
     break;
   case QUEUE_INPLACE:
+    queue_entry->latency_queue = LQ_INPLACE;
+    if (options.queue_stats)
+      queue_entry->queued_at = monotonic_usecs();
     if (parent_queue->inplace) {
       MQUE *tmp;
       tmp = parent_queue->inplace;
@@ -879,11 +1556,13 @@ queue_attribute_useatr(dbref executor, ATTR *a, dbref enactor, PE_REGS *pe_regs,
 
 /** Queue an entry on the wait or semaphore queues.
  * This function creates and adds a queue entry to the wait queue
- * or the semaphore queue. Wait queue entries are sorted by when
- * they're due to expire; semaphore queue entries are just added
- * to the back of the queue.
+ * or the semaphore queue. Wait queue entries are kept in a heap by
+ * when they're due to expire; semaphore queue entries are just added
+ * to the back of the queue, and to the heap as well if they have a
+ * timeout.
  * \param executor the enqueuing object.
- * \param waittill time to wait, or 0.
+ * \param waittill seconds to wait, which may be fractional, or 0. For
+ * a semaphore, a negative time means no timeout.
  * \param command command to enqueue.
  * \param enactor object that caused command to be enqueued.
  * \param sem object to serve as a semaphore, or NOTHING.
@@ -892,8 +1571,8 @@ queue_attribute_useatr(dbref executor, ATTR *a, dbref enactor, PE_REGS *pe_regs,
  * \param parent_queue the queue entry the \@wait command was executed in
  */
 void
-wait_que(dbref executor, int waittill, char *command, dbref enactor, dbref sem,
-         const char *semattr, int until, MQUE *parent_queue)
+wait_que(dbref executor, double waittill, char *command, dbref enactor,
+         dbref sem, const char *semattr, int until, MQUE *parent_queue)
 {
   MQUE *tmp;
   NEW_PE_INFO *pe_info;
@@ -926,55 +1605,61 @@ wait_que(dbref executor, int waittill, char *command, dbref enactor, dbref sem,
   tmp->enactor = enactor;
   tmp->caller = enactor;
   tmp->queue_type |= queue_type;
+  tmp->latency_queue = sem != NOTHING ? LQ_SEMAPHORE : LQ_WAIT;
 
-  if (until) {
-    tmp->wait_until = (time_t) waittill;
-  } else {
-    if (waittill >= 0)
-      tmp->wait_until = mudtime + waittill;
-    else
-      tmp->wait_until = 0; /* semaphore wait without a timeout */
-  }
+  if (sem != NOTHING && waittill < 0)
+    tmp->wait_until = 0; /* semaphore wait without a timeout */
+  else
+    tmp->wait_until = wait_deadline(waittill, until);
+  if (tmp->wait_until)
+    wait_heap_add(tmp);
   tmp->semaphore_obj = sem;
-  if (sem == NOTHING) {
-    /* No semaphore, put on normal wait queue, sorted by time */
-    MQUE *point, *trail = NULL;
-
-    for (point = qwait; point && (point->wait_until <= tmp->wait_until);
-         point = point->next)
-      trail = point;
-
-    tmp->next = point;
-    if (trail != NULL)
-      trail->next = tmp;
-    else
-      qwait = tmp;
-  } else {
+  if (sem != NOTHING) {
 
     /* Put it on the end of the semaphore queue */
     tmp->semaphore_attr =
       mush_strdup(semattr ? semattr : "SEMAPHORE", "mque.semaphore_attr");
-    if (qsemlast != NULL) {
-      qsemlast->next = tmp;
-      qsemlast = tmp;
-    } else {
-      qsemfirst = qsemlast = tmp;
-    }
+    sem_link(tmp);
   }
   im_insert(queue_map, tmp->pid, tmp);
 }
 
+/** Move queue entries whose time has come onto the player queue.
+ * This function is called from the main loop whenever it wakes up,
+ * and runs \@waits and times out semaphores. Unlike other object
+ * commands, these skip the low priority queue; they've already
+ * waited as long as they asked to.
+ */
+void
+do_wait_timers(void)
+{
+  MQUE *point;
+  uint64_t now;
+
+  if (!wait_heap_len)
+    return;
+  now = monotonic_msecs();
+  while (wait_heap_len && wait_heap[0]->wait_until <= now) {
+    point = wait_heap[0];
+    wait_heap_remove(point);
+    point->wait_until = 0;
+    if (point->semaphore_obj != NOTHING) {
+      sem_unlink(point);
+      add_to_sem(point->semaphore_obj, -1, point->semaphore_attr);
+      point->semaphore_obj = NOTHING;
+    }
+    player_queue_add(point);
+  }
+}
+
 /** Once-a-second check for queued commands.
- * This function is called every second to check for commands
- * on the wait queue or semaphore queue, and to move a command
- * off the low priority object queue and onto the normal priority
- * player queue.
+ * This function is called every second to move a command off the
+ * low priority object queue and onto the normal priority player
+ * queue.
  */
 void
 do_second(void)
 {
-  MQUE *trail = NULL, *point, *next;
-
   /* Advance the queue load average count */
   memmove(queue_load_record + 1, queue_load_record,
           sizeof(queue_load_record) - sizeof(int32_t));
@@ -987,70 +1672,19 @@ do_second(void)
    * by scrolling text.
    */
   if (qlfirst) {
-    if (qlast)
-      qlast->next = qlfirst;
-    else
-      qfirst = qlfirst;
-    qlast = qllast;
-    qllast = qlfirst = NULL;
-  }
-  /* check regular wait queue */
+    MQUE *entry, *next;
 
-  while (qwait && qwait->wait_until <= mudtime) {
-    point = qwait;
-    qwait = point->next;
-    point->next = NULL;
-    point->wait_until = 0;
-    if ((point->enactor < 0) || IsPlayer(point->enactor)) {
-      if (qlast) {
-        qlast->next = point;
-        qlast = point;
-      } else
-        qlast = qfirst = point;
-    } else {
-      if (qllast) {
-        qllast->next = point;
-        qllast = point;
-      } else
-        qllast = qlfirst = point;
-    }
-  }
-
-  /* check for semaphore timeouts */
-
-  for (point = qsemfirst, trail = NULL; point; point = next) {
-    if (point->wait_until == 0 || point->wait_until > mudtime) {
-      next = (trail = point)->next;
-      continue; /* skip non-timed and those that haven't gone off yet */
-    }
-    if (trail != NULL)
-      trail->next = next = point->next;
-    else
-      qsemfirst = next = point->next;
-    if (point == qsemlast)
-      qsemlast = trail;
-    add_to_sem(point->semaphore_obj, -1, point->semaphore_attr);
-    point->semaphore_obj = NOTHING;
-    point->next = NULL;
-    if (IsPlayer(point->enactor)) {
-      if (qlast) {
-        qlast->next = point;
-        qlast = point;
-      } else
-        qlast = qfirst = point;
-    } else {
-      if (qllast) {
-        qllast->next = point;
-        qllast = point;
-      } else
-        qllast = qlfirst = point;
+    for (entry = qlfirst; entry; entry = next) {
+      next = entry->next;
+      player_queue_add(entry);
     }
+    qllast = qlfirst = NULL;
   }
 }
 
 /** Execute some commands from the top of the queue.
  * This function dequeues and executes commands on the normal
- * priority (player) queue.
+ * priority (player) queue, letting each owner take their turn.
  * \param ncom number of commands to execute.
  * \return number of commands executed.
  */
@@ -1061,15 +1695,12 @@ do_top(int ncom)
   MQUE *entry;
 
   for (i = 0; i < ncom; i++) {
-    if (!qfirst)
-      return i;
-
     /* We must dequeue before execution, so that things like
      * queued @kick or @ps get a sane queue image.
      */
-    entry = qfirst;
-    if (!(qfirst = entry->next))
-      qlast = NULL;
+    entry = player_queue_pop();
+    if (!entry)
+      return i;
     do_entry(entry, 0);
     free_qentry(entry);
   }
@@ -1105,6 +1736,9 @@ do_entry(MQUE *entry, int include_recurses)
   MQUE *tmp;
   int pt_flag = PT_SEMI;
   PE_REGS *pe_regs;
+  ARENA_MARK mark;
+  int pframe;
+  uint64_t started = 0;
 
   if (entry->queue_type & QUEUE_NOLIST)
     pt_flag = PT_NOTHING;
@@ -1122,6 +1756,17 @@ do_entry(MQUE *entry, int include_recurses)
     return 0;
 
   queue_load_record[0] += 1;
+  if (options.queue_stats && entry->latency_queue >= 0) {
+    started = monotonic_usecs();
+    if (entry->queued_at)
+      lat_record(&queue_latency[entry->latency_queue][LAT_WAIT],
+                 started > entry->queued_at ? started - entry->queued_at : 0);
+  }
+  /* Anything left in the evaluation arena by this entry goes away
+   * when it's done. */
+  mark = arena_mark();
+  pframe = entry->pe_info->attrname ? profile_enter(entry->pe_info->attrname)
+                                    : profile_enter_attr(executor, NULL);
 
   s = entry->action_list;
   if (!include_recurses) {
@@ -1233,60 +1878,46 @@ do_entry(MQUE *entry, int include_recurses)
   if (!include_recurses)
     reset_cpu_timer();
 
+  profile_leave(pframe);
+  arena_release(mark);
+  if (started)
+    lat_record(&queue_latency[entry->latency_queue][LAT_RUN],
+               monotonic_usecs() - started);
   return ((entry->queue_type & QUEUE_BREAK) || inplace_break_called);
 }
 
 /** Determine whether it's time to run a queued command.
- * This function returns the number of seconds we expect to wait
+ * This function returns the number of milliseconds we expect to wait
  * before it's time to run a queued command.
  * If there are commands in the player queue, that's 0.
- * If there are commands in the object queue, that's 1.
- * Otherwise, we check wait and semaphore queues to see what's next.
- * \return seconds left before a queue entry will be ready.
+ * If there are commands in the object queue, that's a second.
+ * Otherwise, it's however long until the first \@wait or semaphore
+ * timeout in the wait heap is due.
+ * \return milliseconds left before a queue entry will be ready.
  */
 int
 que_next(void)
 {
-  int min, curr;
-  MQUE *point;
+  uint64_t now;
+
   /* If there are commands in the player queue, they should be run
    * immediately.
    */
-  if (qfirst != NULL)
+  if (queue_runnable)
     return 0;
   /* If there are commands in the object queue, they should be run in
    * one second.
    */
   if (qlfirst != NULL)
-    return 1;
-  /* Check out the wait and semaphore queues, looking for the smallest
-   * wait value. Return that - 1, since commands get moved to the player
-   * queue when they have one second to go.
-   */
-  min = 500;
-
-  /* Wait queue is in sorted order so we only have to look at the first
-     item on it. Anything else is wasted time. */
-  if (qwait) {
-    curr = (int) difftime(qwait->wait_until, mudtime);
-    if (curr <= 2)
-      return 1;
-    if (curr < min)
-      min = curr;
-  }
-
-  for (point = qsemfirst; point; point = point->next) {
-    if (point->wait_until == 0) /* no timeout */
-      continue;
-    curr = (int) difftime(point->wait_until, mudtime);
-    if (curr <= 2)
-      return 1;
-    if (curr < min) {
-      min = curr;
-    }
-  }
-
-  return (min - 1);
+    return 1000;
+  if (!wait_heap_len)
+    return 500000;
+  now = monotonic_msecs();
+  if (wait_heap[0]->wait_until <= now)
+    return 0;
+  if (wait_heap[0]->wait_until - now > 500000)
+    return 500000;
+  return (int) (wait_heap[0]->wait_until - now);
 }
 
 static int
@@ -1312,31 +1943,18 @@ drain_helper(dbref player __attribute__((__unused__)), dbref thing,
 int
 execute_one_semaphore(dbref thing, char const *aname, PE_REGS *pe_regs)
 {
-  MQUE **point;
   MQUE *entry;
 
-  /* Go through the semaphore queue and do it */
-  point = &qsemfirst;
-  while (*point) {
-    entry = *point;
-    if (entry->semaphore_obj != thing ||
-        (aname && strcmp(entry->semaphore_attr, aname))) {
-      point = &(entry->next);
-      continue;
-    }
-
+  /* Find the oldest waiter and do it */
+  entry = sem_first(thing, aname);
+  if (entry) {
     /* Remove the queue entry from the semaphore list */
-    *point = entry->next;
-    entry->next = NULL;
-    if (qsemlast == entry) {
-      qsemlast = qsemfirst;
-      if (qsemlast)
-        while (qsemlast->next)
-          qsemlast = qsemlast->next;
-    }
+    sem_unlink(entry);
 
     /* Update bookkeeping */
     add_to_sem(entry->semaphore_obj, -1, entry->semaphore_attr);
+    wait_heap_remove(entry);
+    entry->wait_until = 0;
 
     if (pe_regs) {
       if (entry->pe_info == NULL) {
@@ -1347,19 +1965,9 @@ execute_one_semaphore(dbref thing, char const *aname, PE_REGS *pe_regs)
 
     /* Place entry into the player or object queue. */
     if (IsPlayer(entry->enactor)) {
-      if (qlast) {
-        qlast->next = entry;
-        qlast = entry;
-      } else {
-        qlast = qfirst = entry;
-      }
+      player_queue_add(entry);
     } else {
-      if (qllast) {
-        qllast->next = entry;
-        qllast = entry;
-      } else {
-        qllast = qlfirst = entry;
-      }
+      object_queue_add(entry);
     }
     return 1;
   }
@@ -1380,35 +1988,21 @@ dequeue_semaphores(dbref thing, char const *aname, int count, int all,
                    int drain)
 {
 
-  MQUE **point;
   MQUE *entry;
 
   if (all)
     count = INT_MAX;
 
-  /* Go through the semaphore queue and do it */
-  point = &qsemfirst;
-  while (*point && count > 0) {
-    entry = *point;
-    if (entry->semaphore_obj != thing ||
-        (aname && strcmp(entry->semaphore_attr, aname))) {
-      point = &(entry->next);
-      continue;
-    }
-
+  /* Take waiters off the semaphore, oldest first */
+  while (count > 0 && (entry = sem_first(thing, aname))) {
     /* Remove the queue entry from the semaphore list */
-    *point = entry->next;
-    entry->next = NULL;
-    if (qsemlast == entry) {
-      qsemlast = qsemfirst;
-      if (qsemlast)
-        while (qsemlast->next)
-          qsemlast = qsemlast->next;
-    }
+    sem_unlink(entry);
 
     /* Update bookkeeping */
     count--;
     add_to_sem(entry->semaphore_obj, -1, entry->semaphore_attr);
+    wait_heap_remove(entry);
+    entry->wait_until = 0;
 
     /* Dispose of the entry as appropriate: discard if @drain, or put
      * into either the player or the object queue. */
@@ -1417,19 +2011,9 @@ dequeue_semaphores(dbref thing, char const *aname, int count, int all,
       add_to(entry->executor, -1);
       free_qentry(entry);
     } else if (IsPlayer(entry->enactor)) {
-      if (qlast) {
-        qlast->next = entry;
-        qlast = entry;
-      } else {
-        qlast = qfirst = entry;
-      }
+      player_queue_add(entry);
     } else {
-      if (qllast) {
-        qllast->next = entry;
-        qllast = entry;
-      } else {
-        qllast = qlfirst = entry;
-      }
+      object_queue_add(entry);
     }
   }
 
@@ -1567,13 +2151,14 @@ do_wait(dbref executor, dbref enactor, char *arg1, const char *cmd, bool until,
 {
   dbref thing;
   char *tcount = NULL, *aname = NULL;
-  int waitfor, num;
+  double waitfor;
+  int num;
   ATTR *a;
 
-  if (is_strict_integer(arg1)) {
+  if (parse_wait_time(arg1, &waitfor)) {
     /* normal wait */
-    wait_que(executor, parse_integer(arg1), (char *) cmd, enactor, NOTHING,
-             NULL, until, parent_queue);
+    wait_que(executor, waitfor, (char *) cmd, enactor, NOTHING, NULL, until,
+             parent_queue);
     return;
   }
   /* semaphore wait with optional timeout */
@@ -1595,7 +2180,7 @@ do_wait(dbref executor, dbref enactor, char *arg1, const char *cmd, bool until,
   if (aname) {
     tcount = strchr(aname, '/');
     if (!tcount) {
-      if (is_strict_integer(aname)) { /* Timeout */
+      if (parse_wait_time(aname, &waitfor)) { /* Timeout */
         tcount = aname;
         aname = (char *) "SEMAPHORE";
       } else { /* Attribute */
@@ -1615,9 +2200,7 @@ do_wait(dbref executor, dbref enactor, char *arg1, const char *cmd, bool until,
     return;
   }
   /* get timeout, default of -1 */
-  if (tcount && *tcount)
-    waitfor = parse_integer(tcount);
-  else
+  if (!tcount || !*tcount || !parse_wait_time(tcount, &waitfor))
     waitfor = -1;
   add_to_sem(thing, 1, aname);
   a = atr_get_noparent(thing, aname);
@@ -1644,8 +2227,8 @@ void
 do_waitpid(dbref player, const char *pidstr, const char *timestr, bool until)
 {
   uint32_t pid;
-  MQUE *q, *tmp, *last;
-  bool found;
+  MQUE *q;
+  double secs;
 
   if (!is_strict_uinteger(pidstr)) {
     notify(player, T("That is not a valid pid!"));
@@ -1671,72 +2254,31 @@ do_waitpid(dbref player, const char *pidstr, const char *timestr, bool until)
     return;
   }
 
-  if (!is_strict_integer(timestr)) {
+  if (!parse_wait_time(timestr, &secs)) {
     notify(player, T("That is not a valid timestamp."));
     return;
   }
 
-  if (until) {
-    int when;
-
-    when = parse_integer(timestr);
-
-    if (when < 0)
-      when = 0;
-
-    q->wait_until = (time_t) when;
+  if (q->wait_index < 0) {
+    notify(player, T("That queue entry isn't waiting."));
+    return;
+  }
 
+  if (until) {
+    q->wait_until = wait_deadline(secs, true);
   } else {
-    int offset = parse_integer(timestr);
-
     /* If timestr looks like +NNN or -NNN, add or subtract a number
        of seconds to the current timeout. Otherwise, change timeout.
      */
-    if (timestr[0] == '+' || timestr[0] == '-')
-      q->wait_until += offset;
-    else
-      q->wait_until = mudtime + offset;
+    if (timestr[0] == '+' || timestr[0] == '-') {
+      int64_t when = (int64_t) q->wait_until + llround(secs * 1000.0);
+      int64_t now = (int64_t) monotonic_msecs();
 
-    if (q->wait_until < 0)
-      q->wait_until = 0;
-  }
-
-  /* Now adjust it in the wait queue. Not a clever approach, but I
-     wrote it at 3 am and clever was not an option. */
-  found = false;
-  for (tmp = qwait, last = NULL; tmp; last = tmp, tmp = tmp->next) {
-    if (tmp == q) {
-      if (last)
-        last->next = q->next;
-      else
-        qwait = qwait->next;
-      found = true;
-      break;
-    }
-  }
-  if (found) {
-    found = false;
-    for (tmp = qwait, last = NULL; tmp; last = tmp, tmp = tmp->next) {
-      if (tmp->wait_until > q->wait_until) {
-        if (last) {
-          last->next = q;
-          q->next = tmp;
-        } else {
-          q->next = qwait;
-          qwait = q;
-        }
-        found = true;
-        break;
-      }
-    }
-    if (!found) {
-      if (last)
-        last->next = q;
-      else
-        qwait = q;
-      q->next = NULL;
-    }
+      q->wait_until = when < now ? now : when;
+    } else
+      q->wait_until = wait_deadline(secs, false);
   }
+  wait_heap_update(q);
 
   notify_format(player, T("Queue entry with pid %u updated."),
                 (unsigned int) pid);
@@ -1801,7 +2343,7 @@ FUNCTION(fun_pidinfo)
       if (q->wait_until == 0)
         safe_integer(-1, buff, bp);
       else
-        safe_integer(difftime(q->wait_until, mudtime), buff, bp);
+        safe_integer(wait_secs_left(q), buff, bp);
     } else if (string_prefix("object", r)) {
       if (!first)
         safe_str(osep, buff, bp);
@@ -1899,7 +2441,14 @@ FUNCTION(fun_lpids)
     }
   }
   if (qmask & LPIDS_WAIT) {
-    for (tmp = qwait; tmp; tmp = tmp->next) {
+    MQUE **waits;
+    int n, i;
+
+    n = wait_heap_sorted(&waits);
+    for (i = 0; i < n; i++) {
+      tmp = waits[i];
+      if (tmp->semaphore_obj != NOTHING)
+        continue;
       if (GoodObject(player) && GoodObject(tmp->executor) &&
           ((qmask & LPIDS_INDEPENDENT) ? (tmp->executor != player)
                                        : !Owns(tmp->executor, player))) {
@@ -1910,8 +2459,24 @@ FUNCTION(fun_lpids)
       safe_integer(tmp->pid, buff, bp);
       first = false;
     }
+    if (waits)
+      mush_free(waits, "mque.wait_list");
   }
-  if (qmask & LPIDS_SEMAPHORE) {
+  if ((qmask & LPIDS_SEMAPHORE) && GoodObject(thing) && attrib && *attrib) {
+    /* Just the waiters on one semaphore */
+    struct sem_key *key = sem_find_key(thing, upcasestr(attrib));
+
+    for (tmp = key ? key->first : NULL; tmp; tmp = tmp->key_next) {
+      if (GoodObject(player) && GoodObject(tmp->executor) &&
+          ((qmask & LPIDS_INDEPENDENT) ? (tmp->executor != player)
+                                       : !Owns(tmp->executor, player)))
+        continue;
+      if (!first)
+        safe_chr(' ', buff, bp);
+      safe_integer(tmp->pid, buff, bp);
+      first = false;
+    }
+  } else if (qmask & LPIDS_SEMAPHORE) {
     for (tmp = qsemfirst; tmp; tmp = tmp->next) {
       if (GoodObject(player) && GoodObject(tmp->executor) &&
           ((qmask & LPIDS_INDEPENDENT) ? (tmp->executor != player)
@@ -1934,16 +2499,39 @@ show_queue(dbref player, dbref victim, int q_type, int q_quiet, int q_all,
            MQUE *q_ptr, int *tot, int *self, int *del)
 {
   MQUE *tmp;
-  for (tmp = q_ptr; tmp; tmp = tmp->next) {
-    (*tot)++;
-    if (!GoodObject(tmp->executor))
-      (*del)++;
-    else if (q_all || (Owner(tmp->executor) == victim)) {
-      if ((LookQueue(player) || Owns(tmp->executor, player))) {
-        (*self)++;
-        if (!q_quiet)
-          show_queue_single(player, tmp, q_type);
-      }
+
+  if (q_type == 1) {
+    /* The wait queue, in the order entries are due */
+    MQUE **waits;
+    int n, i;
+
+    n = wait_heap_sorted(&waits);
+    for (i = 0; i < n; i++)
+      if (waits[i]->semaphore_obj == NOTHING)
+        show_queue_entry(player, victim, q_type, q_quiet, q_all, waits[i],
+                         tot, self, del);
+    if (waits)
+      mush_free(waits, "mque.wait_list");
+    return;
+  }
+  for (tmp = q_ptr; tmp; tmp = tmp->next)
+    show_queue_entry(player, victim, q_type, q_quiet, q_all, tmp, tot, self,
+                     del);
+}
+
+/* Count, and maybe show, one entry for show_queue() */
+static void
+show_queue_entry(dbref player, dbref victim, int q_type, int q_quiet,
+                 int q_all, MQUE *tmp, int *tot, int *self, int *del)
+{
+  (*tot)++;
+  if (!GoodObject(tmp->executor))
+    (*del)++;
+  else if (q_all || (Owner(tmp->executor) == victim)) {
+    if ((LookQueue(player) || Owns(tmp->executor, player))) {
+      (*self)++;
+      if (!q_quiet)
+        show_queue_single(player, tmp, q_type);
     }
   }
 }
@@ -1955,7 +2543,7 @@ show_queue_single(dbref player, MQUE *q, int q_type)
   switch (q_type) {
   case 1: /* wait queue */
     notify_format(player, "(Pid: %u) [%ld]%s: %s", (unsigned int) q->pid,
-                  (long) difftime(q->wait_until, mudtime),
+                  wait_secs_left(q),
                   unparse_object(player, q->executor, AN_UNPARSE),
                   q->action_list);
     break;
@@ -1963,7 +2551,7 @@ show_queue_single(dbref player, MQUE *q, int q_type)
     if (q->wait_until != 0) {
       notify_format(player, "(Pid: %u) [#%d/%s/%ld]%s: %s",
                     (unsigned int) q->pid, q->semaphore_obj, q->semaphore_attr,
-                    (long) difftime(q->wait_until, mudtime),
+                    wait_secs_left(q),
                     unparse_object(player, q->executor, AN_UNPARSE),
                     q->action_list);
     } else {
@@ -2024,7 +2612,7 @@ show_queue_env(dbref player, MQUE *q)
   ptab_start_inserts(&qregs);
   for (regs = q->pe_info->regvals; regs; regs = regs->prev) {
     PE_REG_VAL *val;
-    for (val = regs->vals; val; val = val->next) {
+    for (val = PE_REGS_VALS(regs); val; val = val->next) {
       if ((val->type & PE_REGS_STR) && (val->type & PE_REGS_Q) &&
           *(val->val.sval))
         ptab_insert(&qregs, val->name, (char *) val->val.sval);
@@ -2062,6 +2650,7 @@ void
 do_queue(dbref player, const char *what, enum queue_type flag)
 {
   dbref victim = NOTHING;
+  struct queue_owner *qo;
   int all = 0;
   int quick = 0;
   int dpq = 0, doq = 0, dwq = 0, dsq = 0;
@@ -2101,16 +2690,32 @@ do_queue(dbref player, const char *what, enum queue_type flag)
     victim = Owner(victim);
     if (!quick)
       notify(player, T("Player Queue:"));
-    show_queue(player, victim, 0, quick, all, qfirst, &tpq, &pq, &dpq);
+    for (qo = queue_owners; qo; qo = qo->next)
+      show_queue(player, victim, 0, quick, all, qo->first, &tpq, &pq, &dpq);
     if (!quick)
       notify(player, T("Object Queue:"));
     show_queue(player, victim, 0, quick, all, qlfirst, &toq, &oq, &doq);
     if (!quick)
       notify(player, T("Wait Queue:"));
-    show_queue(player, victim, 1, quick, all, qwait, &twq, &wq, &dwq);
+    show_queue(player, victim, 1, quick, all, NULL, &twq, &wq, &dwq);
     if (!quick)
       notify(player, T("Semaphore Queue:"));
     show_queue(player, victim, 2, quick, all, qsemfirst, &tsq, &sq, &dsq);
+    if (all && !quick) {
+      uint64_t now = monotonic_usecs();
+
+      notify(player, T("Owner Queues:"));
+      for (qo = queue_owners; qo; qo = qo->next) {
+        if (!qo->depth)
+          continue;
+        notify_format(
+          player, T("%s: %d queued, oldest %lums, %lu run, average wait %lums"),
+          queue_owner_name(qo), qo->depth,
+          (unsigned long) ((now - qo->first->queued_at) / 1000),
+          (unsigned long) qo->ran,
+          (unsigned long) (qo->ran ? qo->wait_total / qo->ran : 0));
+      }
+    }
     if (!quick)
       notify(player, T("------------  Queue Done  ------------"));
     notify_format(player,
@@ -2124,6 +2729,177 @@ do_queue(dbref player, const char *what, enum queue_type flag)
   }
 }
 
+/** The name to show for a queue owner. */
+static const char *
+queue_owner_name(struct queue_owner *qo)
+{
+  static char buff[BUFFER_LEN];
+
+  if (qo->owner == NOTHING)
+    return T("(shared)");
+  if (!GoodObject(qo->owner) || IsGarbage(qo->owner)) {
+    snprintf(buff, sizeof buff, "#%d", qo->owner);
+    return buff;
+  }
+  snprintf(buff, sizeof buff, "%s(#%d)", AName(qo->owner, AN_SYS, NULL),
+           qo->owner);
+  return buff;
+}
+
+static int
+queue_owner_cmp(const void *a, const void *b)
+{
+  const struct queue_owner *qa = *(struct queue_owner *const *) a;
+  const struct queue_owner *qb = *(struct queue_owner *const *) b;
+
+  if (qa->ran != qb->ran)
+    return qa->ran > qb->ran ? -1 : 1;
+  return qb->depth - qa->depth;
+}
+
+/** Show how each owner's share of the player queue is doing, and how
+ * long queue entries wait and run.
+ * \verbatim
+ * This is the top-level function for @stats/queue.
+ * \endverbatim
+ * \param player the enactor.
+ */
+void
+do_queue_stats(dbref player)
+{
+  struct queue_owner *qo, **list;
+  uint64_t now = monotonic_usecs();
+  int n = 0, i, j;
+
+  notify_format(player,
+                T("Fair share queueing is %s. %d commands ready to run."),
+                options.fair_queue ? T("on") : T("off"), queue_runnable);
+  for (qo = queue_owners; qo; qo = qo->next)
+    n++;
+  if (n) {
+    list = mush_calloc(n, sizeof *list, "mque.owner_list");
+    for (n = 0, qo = queue_owners; qo; qo = qo->next)
+      list[n++] = qo;
+    qsort(list, n, sizeof *list, queue_owner_cmp);
+
+    notify(player, T("Owner                          Queued  Oldest       "
+                     "Run  AvgWait  MaxWait"));
+    for (i = 0; i < n; i++) {
+      qo = list[i];
+      notify_format(
+        player, "%-30.30s %6d %6lums %9lu %6lums %6lums", queue_owner_name(qo),
+        qo->depth,
+        (unsigned long) (qo->first ? (now - qo->first->queued_at) / 1000 : 0),
+        (unsigned long) qo->ran,
+        (unsigned long) (qo->ran ? qo->wait_total / qo->ran : 0),
+        (unsigned long) qo->wait_max);
+    }
+    mush_free(list, "mque.owner_list");
+  }
+
+  if (!options.queue_stats) {
+    notify(player, T("Queue latency histograms are off."));
+    return;
+  }
+  notify(player, T("Latency (ms)          Count      Mean       50%       "
+                   "90%       99%       Max"));
+  for (i = 0; i < LQ_COUNT; i++) {
+    for (j = LAT_WAIT; j <= LAT_RUN; j++) {
+      struct latency_hist *h = &queue_latency[i][j];
+
+      if (!h->count)
+        continue;
+      notify_format(player, "%-9s %-4s %11lu %9.3f %9.3f %9.3f %9.3f %9.3f",
+                    latency_queue_names[i], j == LAT_WAIT ? "wait" : "run",
+                    (unsigned long) h->count,
+                    (double) h->total / h->count / 1000.0,
+                    lat_percentile(h, 50) / 1000.0,
+                    lat_percentile(h, 90) / 1000.0,
+                    lat_percentile(h, 99) / 1000.0, h->max / 1000.0);
+    }
+  }
+}
+
+/* queuestats(<queue>[, <wait|run>[, <percentiles>]]) */
+FUNCTION(fun_queuestats)
+{
+  struct latency_hist all, *h;
+  int i, which = LAT_WAIT;
+  bool first = true;
+
+  if (!LookQueue(executor)) {
+    safe_str(T(e_perm), buff, bp);
+    return;
+  }
+
+  if (nargs > 1 && *args[1]) {
+    if (strcasecmp(args[1], "wait") == 0)
+      which = LAT_WAIT;
+    else if (strcasecmp(args[1], "run") == 0)
+      which = LAT_RUN;
+    else {
+      safe_str(T("#-1 INVALID ARGUMENT"), buff, bp);
+      return;
+    }
+  }
+
+  if (strcasecmp(args[0], "all") == 0) {
+    memset(&all, 0, sizeof all);
+    for (i = 0; i < LQ_COUNT; i++)
+      lat_merge(&all, &queue_latency[i][which]);
+    h = &all;
+  } else {
+    for (i = 0; i < LQ_COUNT; i++)
+      if (strcasecmp(args[0], latency_queue_names[i]) == 0)
+        break;
+    if (i == LQ_COUNT) {
+      safe_str(T("#-1 INVALID QUEUE"), buff, bp);
+      return;
+    }
+    h = &queue_latency[i][which];
+  }
+
+  if (nargs > 2 && *args[2]) {
+    char *list = trim_space_sep(args[2], ' ');
+    char *start = *bp;
+    char *elem;
+    double pct;
+
+    do {
+      elem = split_token(&list, ' ');
+      if (!is_strict_number(elem)) {
+        *bp = start;
+        safe_str(T(e_nums), buff, bp);
+        return;
+      }
+      pct = parse_number(elem);
+      if (pct < 0 || pct > 100) {
+        *bp = start;
+        safe_str(T(e_range), buff, bp);
+        return;
+      }
+      if (!first)
+        safe_chr(' ', buff, bp);
+      first = false;
+      safe_number(lat_percentile(h, pct) / 1000.0, buff, bp);
+    } while (list);
+    return;
+  }
+
+  /* count mean 50% 90% 99% max */
+  safe_uinteger(h->count, buff, bp);
+  safe_chr(' ', buff, bp);
+  safe_number(h->count ? (double) h->total / h->count / 1000.0 : 0, buff, bp);
+  safe_chr(' ', buff, bp);
+  safe_number(lat_percentile(h, 50) / 1000.0, buff, bp);
+  safe_chr(' ', buff, bp);
+  safe_number(lat_percentile(h, 90) / 1000.0, buff, bp);
+  safe_chr(' ', buff, bp);
+  safe_number(lat_percentile(h, 99) / 1000.0, buff, bp);
+  safe_chr(' ', buff, bp);
+  safe_number(h->max / 1000.0, buff, bp);
+}
+
 /** Display info for a single queue entry.
  * \verbatim
  * This is the top-level function for @ps <pid>.
@@ -2176,8 +2952,9 @@ do_queue_single(dbref player, char *pidstr, bool debug)
 void
 do_halt(dbref owner, const char *ncom, dbref victim)
 {
-  MQUE *tmp, *trail = NULL, *point, *next;
-  int num = 0;
+  MQUE *tmp, *point, *next;
+  struct queue_owner *qo;
+  int num = 0, i, j;
   dbref player;
   if (victim == NOTHING)
     player = owner;
@@ -2186,13 +2963,14 @@ do_halt(dbref owner, const char *ncom, dbref victim)
   if (!Quiet(Owner(player)))
     notify_format(Owner(player), "%s: %s(#%d)", T("Halted"),
                   AName(player, AN_SYS, NULL), player);
-  for (tmp = qfirst; tmp; tmp = tmp->next)
-    if (GoodObject(tmp->executor) &&
-        ((tmp->executor == player) || (Owner(tmp->executor) == player))) {
-      num--;
-      giveto(player, QUEUE_COST);
-      tmp->executor = NOTHING;
-    }
+  for (qo = queue_owners; qo; qo = qo->next)
+    for (tmp = qo->first; tmp; tmp = tmp->next)
+      if (GoodObject(tmp->executor) &&
+          ((tmp->executor == player) || (Owner(tmp->executor) == player))) {
+        num--;
+        giveto(player, QUEUE_COST);
+        tmp->executor = NOTHING;
+      }
   for (tmp = qlfirst; tmp; tmp = tmp->next)
     if (GoodObject(tmp->executor) &&
         ((tmp->executor == player) || (Owner(tmp->executor) == player))) {
@@ -2200,36 +2978,35 @@ do_halt(dbref owner, const char *ncom, dbref victim)
       giveto(player, QUEUE_COST);
       tmp->executor = NOTHING;
     }
-  /* remove wait q stuff */
-  for (point = qwait; point; point = next) {
-    if (((point->executor == player) || (Owner(point->executor) == player))) {
+  /* remove wait q stuff, then put what's left back in heap order */
+  for (i = j = 0; i < wait_heap_len; i++) {
+    point = wait_heap[i];
+    if (point->semaphore_obj == NOTHING &&
+        ((point->executor == player) || (Owner(point->executor) == player))) {
       num--;
       giveto(player, QUEUE_COST);
-      if (trail)
-        trail->next = next = point->next;
-      else
-        qwait = next = point->next;
+      point->wait_index = -1;
       free_qentry(point);
     } else
-      next = (trail = point)->next;
+      wait_heap_set(j++, point);
+  }
+  if (j < wait_heap_len) {
+    wait_heap_len = j;
+    for (i = wait_heap_len / 2 - 1; i >= 0; i--)
+      wait_heap_down(i);
   }
 
   /* clear semaphore queue */
 
-  for (point = qsemfirst, trail = NULL; point; point = next) {
+  for (point = qsemfirst; point; point = next) {
+    next = point->next;
     if (((point->executor == player) || (Owner(point->executor) == player))) {
       num--;
       giveto(player, QUEUE_COST);
-      if (trail)
-        trail->next = next = point->next;
-      else
-        qsemfirst = next = point->next;
-      if (point == qsemlast)
-        qsemlast = trail;
+      sem_unlink(point);
       add_to_sem(point->semaphore_obj, -1, point->semaphore_attr);
       free_qentry(point);
-    } else
-      next = (trail = point)->next;
+    }
   }
 
   add_to(player, num);
@@ -2328,20 +3105,8 @@ do_haltpid(dbref player, const char *arg1)
      turn comes up (Or show it in @ps, etc.).  Exception is for
      semaphores, which otherwise might wait forever. */
   q->executor = NOTHING;
-  if (q->semaphore_attr) {
-    MQUE *last = NULL, *tmp;
-    for (tmp = qsemfirst; tmp; last = tmp, tmp = tmp->next) {
-      if (tmp == q) {
-        if (last)
-          last->next = tmp->next;
-        else
-          qsemfirst = tmp->next;
-        if (qsemlast == tmp)
-          qsemlast = last;
-        break;
-      }
-    }
-
+  if (q->sem_seq) {
+    sem_unlink(q);
     giveto(victim, QUEUE_COST);
     add_to_sem(q->semaphore_obj, -1, q->semaphore_attr);
     free_qentry(q);
@@ -2471,10 +3236,37 @@ do_restart_com(dbref player, const char *arg1)
 void
 shutdown_queues(void)
 {
-  shutdown_a_queue(&qfirst, &qlast);
+  struct queue_owner *qo;
+
+  for (qo = queue_owners; qo; qo = qo->next) {
+    shutdown_a_queue(&qo->first, &qo->last);
+    qo->depth = 0;
+    qo->heap_index = -1;
+  }
+  owner_heap_len = 0;
+  queue_runnable = 0;
   shutdown_a_queue(&qlfirst, &qllast);
-  shutdown_a_queue(&qsemfirst, &qsemlast);
-  shutdown_a_queue(&qwait, NULL);
+  while (qsemfirst) {
+    MQUE *entry = qsemfirst;
+
+    sem_unlink(entry);
+    if (GoodObject(entry->executor) && !IsGarbage(entry->executor)) {
+      giveto(entry->executor, QUEUE_COST);
+      add_to(entry->executor, -1);
+    }
+    free_qentry(entry);
+  }
+  /* Whatever's left in the wait heap is plain @waits */
+  while (wait_heap_len) {
+    MQUE *entry = wait_heap[wait_heap_len - 1];
+
+    wait_heap_remove(entry);
+    if (GoodObject(entry->executor) && !IsGarbage(entry->executor)) {
+      giveto(entry->executor, QUEUE_COST);
+      add_to(entry->executor, -1);
+    }
+    free_qentry(entry);
+  }
 }
 
 static void
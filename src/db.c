@@ -48,6 +48,7 @@
 #include "mushdb.h"
 #include "mymalloc.h"
 #include "parse.h"
+#include "pecode.h"
 #include "privtab.h"
 #include "strtree.h"
 #include "strutil.h"
@@ -909,6 +910,7 @@ db_paranoid_write_object(PENNFILE *f, dbref i, int flag)
         if (!t)
           return 0;
 
+        pe_code_forget(list->data);
         chunk_delete(list->data);
         list->data = chunk_create(t, strlen(t), 0);
         free(t);
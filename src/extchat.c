@@ -76,6 +76,7 @@ static char *list_cuflags(CHANUSER *u, int verbose);
 static void channel_join_self(dbref player, const char *name);
 static void channel_leave_self(dbref player, const char *name);
 static void do_channel_who(dbref player, CHAN *chan);
+static dbref na_chanusers(dbref current, void *data);
 void chat_player_announce(DESC *desc_player, char *msg, int ungag);
 static void channel_send(CHAN *channel, dbref player, int flags,
                          const char *origmessage);
@@ -3686,6 +3687,42 @@ mogrify(dbref mogrifier, const char *attrname, dbref player, int numargs,
   return buff;
 }
 
+/** State for walking a channel's user list with na_chanusers() */
+struct na_chanusers_data {
+  CHANUSER *next; /**< Next user to consider */
+  dbref speaker;  /**< Who is speaking on the channel */
+  int flags;      /**< CB_* flags of the broadcast */
+};
+
+/** notify_anything() iterator for the users of a channel who should hear
+ * a broadcast. Sending the whole broadcast through one notify_anything()
+ * call lets every listener share the same rendered copies of the message.
+ * \param current unused.
+ * \param data a struct na_chanusers_data.
+ * \return dbref of next user to notify, or NOTHING when done.
+ */
+static dbref
+na_chanusers(dbref current __attribute__((__unused__)), void *data)
+{
+  struct na_chanusers_data *nad = data;
+  CHANUSER *u;
+  dbref who;
+
+  while ((u = nad->next)) {
+    nad->next = u->next;
+    who = CUdbref(u);
+    if ((nad->flags & CB_NOCOMBINE) && Chanuser_Combine(u))
+      continue;
+    if ((nad->flags & CB_SEEALL) && !See_All(who) && (who != nad->speaker))
+      continue;
+    if (((nad->flags & CB_CHECKQUIET) && Chanuser_Quiet(u)) ||
+        Chanuser_Gag(u) || (IsPlayer(who) && !Connected(who)))
+      continue;
+    return who;
+  }
+  return NOTHING;
+}
+
 /** Broadcast a message to a channel, using @chatformat if it's
  *  available, and mogrifying.
  * \param channel pointer to channel to broadcast to.
@@ -3711,10 +3748,9 @@ channel_send(CHAN *channel, dbref player, int flags, const char *origmessage)
   static char buff[BUFFER_LEN];
   static char speechtext[BUFFER_LEN];
   struct format_msg format;
+  struct na_chanusers_data nad;
 
-  CHANUSER *u;
   CHANUSER *speaker;
-  dbref current;
   char *bp;
   const char *blockstr = "";
   int na_flags = NA_INTER_LOCK;
@@ -3897,21 +3933,11 @@ channel_send(CHAN *channel, dbref player, int flags, const char *origmessage)
   format.args[5] = buff;
   format.args[6] = speechtext;
 
-  for (u = ChanUsers(channel); u; u = u->next) {
-    current = CUdbref(u);
-
-    if ((flags & CB_NOCOMBINE) && Chanuser_Combine(u)) {
-      continue;
-    }
-    if ((flags & CB_SEEALL) && !See_All(current) && (current != player))
-      continue;
-
-    if (!(((flags & CB_CHECKQUIET) && Chanuser_Quiet(u)) || Chanuser_Gag(u) ||
-          (IsPlayer(current) && !Connected(current)))) {
-      notify_anything(player, player, na_one, &current, NULL, na_flags, buff,
-                      NULL, AMBIGUOUS, (override_chatformat ? NULL : &format));
-    }
-  }
+  nad.next = ChanUsers(channel);
+  nad.speaker = player;
+  nad.flags = flags;
+  notify_anything(player, player, na_chanusers, &nad, NULL, na_flags, buff,
+                  NULL, AMBIGUOUS, (override_chatformat ? NULL : &format));
 
   if (ChanBufferQ(channel) && !skip_buffer)
     add_to_bufferq(ChanBufferQ(channel),
@@ -27,6 +27,7 @@
 #include "mushdb.h"
 #include "mymalloc.h"
 #include "parse.h"
+#include "phash.h"
 #include "sort.h"
 #include "strutil.h"
 #include "mushsql.h"
@@ -43,10 +44,14 @@ static int apply_restrictions(uint32_t result, const char *restriction);
 static char *build_function_report(dbref player, FUN *fp);
 static FUN *user_func_hash_lookup(const char *name);
 static FUN *any_func_hash_lookup(const char *name);
-
-HASHTAB htab_function;      /**< Function hash table */
-HASHTAB htab_user_function; /**< User-defined function hash table */
-slab *function_slab;        /**< slab for 'struct fun' allocations */
+static void func_index_build(void);
+
+HASHTAB htab_function;            /**< Function hash table */
+HASHTAB htab_user_function;       /**< User-defined function hash table */
+PHASH phash_function;             /**< Perfect hash index of htab_function */
+static bool func_index_stale = 1; /**< Has htab_function changed? */
+int function_generation = 0;      /**< Bumped when function lookups change */
+slab *function_slab;              /**< slab for 'struct fun' allocations */
 static bool functable = 0;
 
 /** Builds the tables used for giving spelling suggestions. */
@@ -677,6 +682,7 @@ FUNTAB flist[] = {
   {"POWERS", fun_powers, 0, 2, FN_REG | FN_STRIPANSI},
   {"PROMPT", fun_prompt, 2, -2, FN_REG},
   {"PUEBLO", fun_pueblo, 1, 1, FN_REG | FN_STRIPANSI},
+  {"QUEUESTATS", fun_queuestats, 1, 3, FN_REG | FN_STRIPANSI},
   {"QUOTA", fun_quota, 1, 1, FN_REG | FN_STRIPANSI},
   {"R", fun_r, 1, 2, FN_REG | FN_STRIPANSI},
   {"RAND", fun_rand, 0, 2, FN_REG | FN_STRIPANSI},
@@ -1057,15 +1063,46 @@ user_func_hash_lookup(const char *name)
 }
 
 /** Look up a function by name, builtins only.
+ * Lookups go through a perfect hash of htab_function, which is rebuilt
+ * the first time it's needed after a builtin or alias is added or
+ * removed.
  * \param name name of function to look up.
  * \return pointer to function data, or NULL.
  */
 FUN *
 builtin_func_hash_lookup(const char *name)
 {
-  FUN *f;
-  f = (FUN *) hashfind(strupper(name), &htab_function);
-  return f;
+  if (func_index_stale)
+    func_index_build();
+  if (phash_function.entries)
+    return (FUN *) phash_find(&phash_function, name);
+  return (FUN *) hashfind(strupper(name), &htab_function);
+}
+
+/** Rebuild the perfect hash index of the builtin function table. If it
+ * can't be built, lookups use htab_function directly. */
+static void
+func_index_build(void)
+{
+  const char **keys;
+  void **data;
+  const char *key;
+  size_t n = 0;
+
+  keys = mush_calloc(htab_function.entries + 1, sizeof(char *),
+                     "function.index");
+  data = mush_calloc(htab_function.entries + 1, sizeof(void *),
+                     "function.index");
+  for (key = hash_firstentry_key(&htab_function); key;
+       key = hash_nextentry_key(&htab_function)) {
+    keys[n] = key;
+    data[n] = hashfind(key, &htab_function);
+    n++;
+  }
+  phash_build(&phash_function, n, keys, data);
+  mush_free(keys, "function.index");
+  mush_free(data, "function.index");
+  func_index_stale = 0;
 }
 
 static void
@@ -1073,6 +1110,8 @@ func_hash_insert(const char *name, FUN *func)
 {
   add_private_vocab(name, "FUNCTIONS");
   hashadd(name, (void *) func, &htab_function);
+  func_index_stale = 1;
+  function_generation++;
 }
 
 static void delete_function(void *);
@@ -1544,6 +1583,7 @@ cnf_add_function(const char *name, const char *opts)
     if (fp->flags & FN_BUILTIN) {
       /* Override built-in function */
       fp->flags |= FN_OVERRIDE;
+      function_generation++;
       fp = NULL;
     } else {
       if (fp->where.ufun->name) {
@@ -1561,6 +1601,7 @@ cnf_add_function(const char *name, const char *opts)
     fp->maxargs = MAX_STACK_ARGS;
     hashadd(name, fp, &htab_user_function);
     add_private_vocab(name, "FUNCTIONS");
+    function_generation++;
   }
 
   fp->where.ufun->thing = thing;
@@ -1727,6 +1768,7 @@ do_function(dbref player, const char *name, char **argv, int preserve)
       fp->flags |= FN_LOCALIZE;
     hashadd(ucname, fp, &htab_user_function);
     add_private_vocab(ucname, "FUNCTIONS");
+    function_generation++;
 
     /* now add it to the user function table */
     fp->where.ufun = mush_malloc(sizeof(USERFN_ENTRY), "userfn");
@@ -1781,6 +1823,7 @@ delete_function(void *data)
 {
   FUN *fp = data;
 
+  function_generation++;
   mush_free((void *) fp->name, "func_hash.name");
   mush_free(fp->where.ufun->name, "userfn.name");
   mush_free(fp->where.ufun, "userfn");
@@ -1825,6 +1868,7 @@ do_function_restore(dbref player, const char *name)
   }
 
   fp->flags &= ~FN_OVERRIDE;
+  function_generation++;
   notify(player, T("Restored."));
 
   /* Delete any @function with the same name */
@@ -1862,6 +1906,8 @@ do_function_delete(dbref player, char *name)
       /* Function alias */
       hashdelete(strupper(name), &htab_function);
       delete_private_vocab(fp->name, "FUNCTIONS");
+      func_index_stale = 1;
+      function_generation++;
       notify(player, T("Function alias deleted."));
       return;
     } else if (fp->flags & FN_CLONE) {
@@ -1871,6 +1917,8 @@ do_function_delete(dbref player, char *name)
       slab_free(function_slab, fp);
       hashdelete(safename, &htab_function);
       delete_private_vocab(safename, "FUNCTIONS");
+      func_index_stale = 1;
+      function_generation++;
       notify(player, T("Function clone deleted."));
       return;
     }
@@ -1879,6 +1927,7 @@ do_function_delete(dbref player, char *name)
       return;
     }
     fp->flags |= FN_OVERRIDE;
+    function_generation++;
     notify(player, T("Function deleted."));
     return;
   }
@@ -18,7 +18,10 @@
 #include "notify.h"
 #include "mushsql.h"
 #include "charconv.h"
+#include "case.h"
 #include "charclass.h"
+#include "hash_function.h"
+#include "htab.h"
 
 char *json_vals[3] = {"false", "true", "null"};
 int json_val_lens[3] = {5, 4, 4};
@@ -407,6 +410,210 @@ string_to_json_real(char *input, char **ip, int recurse)
   }
 }
 
+/* Parsed JSON documents.
+ *
+ * Softcode that keeps JSON in an attribute tends to call json_query()
+ * on the same document several times in a row, once for each thing it
+ * wants out of it. The parsed trees of the last few documents are kept,
+ * looked up by a hash of their text, along with an index of the members
+ * of every object in them, so each lookup is a hash probe instead of a
+ * parse and a walk.
+ */
+
+/** Most parsed JSON documents to keep */
+#define JSON_CACHE_SIZE 16
+
+/** A parsed JSON document */
+struct json_doc {
+  uint32_t hash;       /**< Hash of text */
+  int len;             /**< Length of text */
+  char *text;          /**< The document, as given */
+  JSON *json;          /**< Its parse */
+  int refs;            /**< Number of callers using it */
+  bool cached;         /**< Is it still in json_docs? */
+  unsigned long used;  /**< json_doc_clock when last used */
+};
+
+static struct json_doc *json_docs[JSON_CACHE_SIZE];
+static unsigned long json_doc_clock = 0;
+
+/** Members of the objects in cached documents, keyed on the address of
+ * the object and the upcased member name. */
+static HASHTAB json_index;
+static bool json_index_inited = false;
+
+/** JSON cache statistics */
+static struct {
+  unsigned long hits;   /**< Lookups that found a parsed document */
+  unsigned long parses; /**< Lookups that had to parse one */
+} json_totals;
+
+/** Build the json_index key for a member of an object.
+ * \param obj the object.
+ * \param name the member name.
+ * \param key buffer of at least BUFFER_LEN + 32 bytes for the key.
+ */
+static void
+json_index_key(const JSON *obj, const char *name, char *key)
+{
+  char *kp;
+
+  kp = key + snprintf(key, 32, "%p/", (const void *) obj);
+  while (*name && kp < key + BUFFER_LEN + 31)
+    *kp++ = UPCASE(*name++);
+  *kp = '\0';
+}
+
+/** Add (or, if remove is true, take out) index entries for all the
+ * objects in a JSON tree. Members are indexed by name; if an object has
+ * the same name twice, the first one wins, as it does for a walk.
+ * \param json the tree.
+ * \param remove true to take the entries out.
+ * \param key scratch buffer for json_index_key().
+ */
+static void
+json_index_tree(JSON *json, bool remove, char *key)
+{
+  JSON *next;
+
+  if (json->type == JSON_ARRAY) {
+    for (next = json->data; next; next = next->next)
+      json_index_tree(next, remove, key);
+  } else if (json->type == JSON_OBJECT) {
+    for (next = json->data; next && next->next; next = next->next->next) {
+      json_index_key(json, (char *) next->data, key);
+      if (remove)
+        hashdelete(key, &json_index);
+      else
+        hashadd(key, next->next, &json_index);
+      json_index_tree(next->next, remove, key);
+    }
+  }
+}
+
+/** Free a parsed document. */
+static void
+json_doc_free(struct json_doc *doc)
+{
+  json_free(doc->json);
+  mush_free(doc->text, "json_doc.text");
+  mush_free(doc, "json_doc");
+}
+
+/** Get the parse of a JSON document, from the cache if possible. Call
+ * json_doc_release() when done with it, and don't change or free the
+ * tree.
+ * \param text the document.
+ * \param len length of text.
+ * \return the parsed document, or NULL if it isn't valid JSON.
+ */
+static struct json_doc *
+json_doc_get(const char *text, int len)
+{
+  uint32_t hash = city_hash(text, len, 0);
+  struct json_doc *doc;
+  char key[BUFFER_LEN + 32];
+  char *copy;
+  JSON *json;
+  int i, slot = 0;
+
+  for (i = 0; i < JSON_CACHE_SIZE; i++) {
+    doc = json_docs[i];
+    if (!doc) {
+      slot = i;
+      continue;
+    }
+    if (doc->hash == hash && doc->len == len && !memcmp(doc->text, text, len)) {
+      json_totals.hits++;
+      doc->used = ++json_doc_clock;
+      doc->refs++;
+      return doc;
+    }
+    if (json_docs[slot] && doc->used < json_docs[slot]->used)
+      slot = i;
+  }
+
+  /* string_to_json() writes into its input. */
+  copy = mush_malloc(len + 1, "json_doc.text");
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+  json = string_to_json(copy);
+  json_totals.parses++;
+  if (!json) {
+    mush_free(copy, "json_doc.text");
+    return NULL;
+  }
+  memcpy(copy, text, len);
+
+  if (!json_index_inited) {
+    hashinit(&json_index, 256);
+    json_index_inited = true;
+  }
+  if ((doc = json_docs[slot])) {
+    /* Evict the least recently used document. */
+    json_index_tree(doc->json, 1, key);
+    doc->cached = false;
+    if (!doc->refs)
+      json_doc_free(doc);
+  }
+
+  doc = mush_malloc_zero(sizeof *doc, "json_doc");
+  doc->hash = hash;
+  doc->len = len;
+  doc->text = copy;
+  doc->json = json;
+  doc->refs = 1;
+  doc->cached = true;
+  doc->used = ++json_doc_clock;
+  json_index_tree(json, 0, key);
+  json_docs[slot] = doc;
+  return doc;
+}
+
+/** Stop using a document from json_doc_get(). */
+static void
+json_doc_release(struct json_doc *doc)
+{
+  if (--doc->refs == 0 && !doc->cached)
+    json_doc_free(doc);
+}
+
+/** Find a member of an object in a cached document.
+ * \param obj the object.
+ * \param name the member name, matched case-insensitively.
+ * \return the member's value, or NULL.
+ */
+static JSON *
+json_doc_member(JSON *obj, const char *name)
+{
+  char key[BUFFER_LEN + 32];
+
+  json_index_key(obj, name, key);
+  return hashfind(key, &json_index);
+}
+
+/** Show JSON cache statistics.
+ * \param player who to tell.
+ */
+void
+json_cache_stats(dbref player)
+{
+  unsigned long lookups = json_totals.hits + json_totals.parses;
+  int i, n = 0;
+
+  for (i = 0; i < JSON_CACHE_SIZE; i++)
+    if (json_docs[i])
+      n++;
+  notify(player, "JSON Cache:");
+  notify_format(player,
+                " %d documents cached of %d, %d members indexed. %lu hits, "
+                "%lu parsed (%.1f%% hit rate).",
+                n, JSON_CACHE_SIZE,
+                json_index_inited ? json_index.entries : 0, json_totals.hits,
+                json_totals.parses,
+                lookups ? json_totals.hits * 100.0 / lookups : 0.0);
+}
+
 enum json_query {
   JSON_QUERY_TYPE,
   JSON_QUERY_SIZE,
@@ -418,6 +625,7 @@ enum json_query {
 
 FUNCTION(fun_json_query)
 {
+  struct json_doc *doc = NULL;
   JSON *json = NULL, *next, *curr;
   enum json_query query_type = JSON_QUERY_TYPE;
   int i, path;
@@ -449,11 +657,12 @@ FUNCTION(fun_json_query)
   }
 
   if (query_type != JSON_QUERY_PATCH) {
-    json = string_to_json(args[0]);
-    if (!json) {
+    doc = json_doc_get(args[0], arglens[0]);
+    if (!doc) {
       safe_str(T("#-1 INVALID JSON"), buff, bp);
       return;
     }
+    json = doc->json;
   }
 
   switch (query_type) {
@@ -552,25 +761,7 @@ FUNCTION(fun_json_query)
         curr = next;
         break;
       case JSON_OBJECT:
-        next = (JSON *) curr->data;
-        while (next) {
-          if (next->type != JSON_STR) {
-            /* We should have a string label */
-            next = NULL;
-            break;
-          }
-          if (!strcasecmp((char *) next->data, args[path])) {
-            /* Success! */
-            next = next->next;
-            break;
-          } else {
-            /* Skip */
-            next = next->next; /* Move to this entry's value */
-            if (next) {
-              next = next->next; /* Move to next entry's name */
-            }
-          }
-        }
+        next = json_doc_member(curr, args[path]);
         if (query_type == JSON_QUERY_EXISTS) {
           if (path == nargs - 1 || !next) {
             safe_chr((next) ? '1' : '0', buff, bp);
@@ -624,8 +815,8 @@ FUNCTION(fun_json_query)
     sqlite3_reset(patch);
   }
   }
-  if (json) {
-    json_free(json);
+  if (doc) {
+    json_doc_release(doc);
   }
 }
 
@@ -635,6 +826,7 @@ FUNCTION(fun_json_map)
   PE_REGS *pe_regs;
   int funccount;
   char *osep, osepd[2] = {' ', '\0'};
+  struct json_doc *doc;
   JSON *json, *next;
   int i;
   char rbuff[BUFFER_LEN];
@@ -644,11 +836,12 @@ FUNCTION(fun_json_map)
   if (!fetch_ufun_attrib(args[0], executor, &ufun, UFUN_DEFAULT))
     return;
 
-  json = string_to_json(args[1]);
-  if (!json) {
+  doc = json_doc_get(args[1], arglens[1]);
+  if (!doc) {
     safe_str(T("#-1 INVALID JSON"), buff, bp);
     return;
   }
+  json = doc->json;
 
   pe_regs = pe_regs_create(PE_REGS_ARG, "fun_json_map");
   for (i = 3; i <= nargs; i++) {
@@ -692,7 +885,7 @@ FUNCTION(fun_json_map)
     break;
   }
 
-  json_free(json);
+  json_doc_release(doc);
   pe_regs_free(pe_regs);
 }
 
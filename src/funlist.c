@@ -794,9 +794,7 @@ FUNCTION(fun_sortby)
 
   /* Split up the list, sort it, reconstruct it. */
   nptrs = list2arr_ansi(ptrs, MAX_SORTSIZE, args[1], sep, 1);
-  if (nptrs > 1) /* pointless to sort less than 2 elements */
-    sane_qsort((void **) ptrs, 0, nptrs - 1, u_comp, executor, enactor, &ufun,
-               pe_info);
+  sane_msort((void **) ptrs, nptrs, u_comp, executor, enactor, &ufun, pe_info);
 
   arr2list(ptrs, nptrs, buff, bp, osep);
   freearr(ptrs, nptrs);
@@ -884,9 +882,9 @@ FUNCTION(fun_setmanip)
   lti = get_list_type_info(sort_type);
   sp1 = slist_build(executor, a1, NULL, n1, lti);
   sp2 = slist_build(executor, a2, NULL, n2, lti);
-  slist_qsort(sp1, n1, lti);
+  slist_sort(sp1, n1, lti);
   n1 = slist_uniq(sp1, n1, lti);
-  slist_qsort(sp2, n2, lti);
+  slist_sort(sp2, n2, lti);
   n2 = slist_uniq(sp2, n2, lti);
 
   /* get the first value for the intersection, removing duplicates
@@ -2056,11 +2054,10 @@ FUNCTION(fun_iter)
   if (!delim_check(buff, bp, nargs, args, 3, &sep))
     return;
 
-  outsep = mush_malloc(BUFFER_LEN, "string");
-  list = mush_malloc(BUFFER_LEN, "string");
-  if (!outsep || !list) {
-    mush_panic("Unable to allocate memory in fun_iter");
-  }
+  /* Scratch space comes from the evaluation arena, and is released
+   * when we return. */
+  outsep = arena_alloc(BUFFER_LEN);
+  list = arena_alloc(BUFFER_LEN);
   if (nargs < 4) {
     strcpy(outsep, " ");
   } else {
@@ -2076,15 +2073,13 @@ FUNCTION(fun_iter)
                            PT_DEFAULT, pe_info);
   *lp = '\0';
   lp = trim_space_sep(list, sep);
-  if (per || !*lp) {
-    mush_free(outsep, "string");
-    mush_free(list, "string");
+  if (per || !*lp)
     return;
-  }
 
   /* Split lp up into an ansi-safe list */
-  ptrs = mush_calloc(MAX_SORTSIZE, sizeof(char *), "ptrarray");
+  ptrs = arena_alloc(MAX_SORTSIZE * sizeof(char *));
   nptrs = list2arr_ansi(ptrs, MAX_SORTSIZE, lp, sep, 1);
+  tbuf2 = arena_alloc(BUFFER_LEN);
 
   funccount = pe_info->fun_invocations;
 
@@ -2098,30 +2093,22 @@ FUNCTION(fun_iter)
     replace[0] = ptrs[i];
     replace[1] = unparse_integer(i + 1);
 
-    tbuf2 = replace_string2(standard_tokens, replace, args[1]);
+    replace_string2_buf(standard_tokens, replace, args[1], tbuf2);
     sp = tbuf2;
     if (process_expression(buff, bp, &sp, executor, caller, enactor, eflags,
-                           PT_DEFAULT, pe_info)) {
-      mush_free(tbuf2, "replace_string.buff");
+                           PT_DEFAULT, pe_info))
       break;
-    }
     if (*bp == (buff + BUFFER_LEN - 1) &&
-        pe_info->fun_invocations == funccount) {
-      mush_free(tbuf2, "replace_string.buff");
+        pe_info->fun_invocations == funccount)
       break;
-    }
     funccount = pe_info->fun_invocations;
-    mush_free(tbuf2, "replace_string.buff");
     if (pe_regs->flags & PE_REGS_IBREAK) {
       break;
     }
   }
   pe_regs_restore(pe_info, pe_regs);
   pe_regs_free(pe_regs);
-  mush_free(outsep, "string");
-  mush_free(list, "string");
   freearr(ptrs, nptrs);
-  mush_free(ptrs, "ptrarray");
 }
 
 /* ARGSUSED */
@@ -2326,7 +2313,7 @@ FUNCTION(fun_map)
 
   strcpy(place, "1");
 
-  ptrs = mush_calloc(MAX_SORTSIZE, sizeof(char *), "ptrarray");
+  ptrs = arena_alloc(MAX_SORTSIZE * sizeof(char *));
   nptrs = list2arr_ansi(ptrs, MAX_SORTSIZE, lp, sep, 1);
 
   /* Build our %0 args */
@@ -2353,7 +2340,6 @@ FUNCTION(fun_map)
   }
   pe_regs_free(pe_regs);
   freearr(ptrs, nptrs);
-  mush_free(ptrs, "ptrarray");
 }
 
 /* ARGSUSED */
@@ -2592,12 +2578,12 @@ FUNCTION(fun_table)
  * with an ig version */
 FUNCTION(fun_regreplace)
 {
+  CACHED_REGEXP *cre;
   pcre *re;
-  pcre_extra *extra, *study = NULL;
+  pcre_extra *extra;
   const char *errptr;
   int subpatterns;
   int offsets[99];
-  int erroffset;
   int flags = 0, all = 0, match_offset = 0;
   PE_REGS *pe_regs = NULL;
   int i;
@@ -2648,38 +2634,17 @@ FUNCTION(fun_regreplace)
       goto exit_sequence;
     *tbp = '\0';
 
-    if ((re = pcre_compile(remove_markup(tbuf, &searchlen), flags, &errptr,
-                           &erroffset, tables)) == NULL) {
+    if ((cre = regexp_cache_get(remove_markup(tbuf, &searchlen), flags,
+                                &errptr)) == NULL) {
       /* Matching error. */
       safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
       safe_str(errptr, buff, bp);
       goto exit_sequence;
     }
-    ADD_CHECK("pcre"); /* re */
     if (searchlen)
       searchlen--;
-
-    /* If we're doing a lot, study the regexp to make sure it's good */
-    if (all) {
-      study = pcre_study(re, pcre_public_study_flags, &errptr);
-      if (errptr != NULL) {
-        pcre_free(re);
-        DEL_CHECK("pcre");
-        safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
-        safe_str(errptr, buff, bp);
-        goto exit_sequence;
-      }
-      if (study != NULL)
-        /* study */
-        ADD_CHECK("pcre.extra");
-    }
-
-    if (study) {
-      extra = study;
-      set_match_limit(extra);
-    } else {
-      extra = default_match_limit();
-    }
+    re = cre->re;
+    extra = regexp_cache_extra(cre);
 
     /* Do all the searches and replaces we can */
 
@@ -2689,16 +2654,7 @@ FUNCTION(fun_regreplace)
     /* Match wasn't found... we're done */
     if (subpatterns < 0) {
       safe_str(prebuf, postbuf, &postp);
-      pcre_free(re);
-      DEL_CHECK("pcre");
-      if (study) {
-#ifdef PCRE_CONFIG_JIT
-        pcre_free_study(study);
-#else
-        pcre_free(study);
-#endif
-        DEL_CHECK("pcre.extra");
-      }
+      regexp_cache_release(cre);
       continue;
     }
 
@@ -2719,16 +2675,7 @@ FUNCTION(fun_regreplace)
 
       if (process_expression(postbuf, &postp, &obp, executor, caller, enactor,
                              eflags | PE_DOLLAR, PT_DEFAULT, pe_info)) {
-        pcre_free(re);
-        DEL_CHECK("pcre");
-        if (study) {
-#ifdef PCRE_CONFIG_JIT
-          pcre_free_study(study);
-#else
-          pcre_free(study);
-#endif
-          DEL_CHECK("pcre.extra");
-        }
+        regexp_cache_release(cre);
         goto exit_sequence;
       }
       if ((*bp == (buff + BUFFER_LEN - 1)) &&
@@ -2749,16 +2696,7 @@ FUNCTION(fun_regreplace)
     safe_str(start, postbuf, &postp);
     *postp = '\0';
 
-    pcre_free(re);
-    DEL_CHECK("pcre");
-    if (study != NULL) {
-#ifdef PCRE_CONFIG_JIT
-      pcre_free_study(study);
-#else
-      pcre_free(study);
-#endif
-      DEL_CHECK("pcre.extra");
-    }
+    regexp_cache_release(cre);
   }
 
   /* We get to this point if there is ansi in an 'orig' string */
@@ -2778,36 +2716,17 @@ FUNCTION(fun_regreplace)
 
       *tbp = '\0';
 
-      if ((re = pcre_compile(remove_markup(tbuf, &searchlen), flags, &errptr,
-                             &erroffset, tables)) == NULL) {
+      if ((cre = regexp_cache_get(remove_markup(tbuf, &searchlen), flags,
+                                  &errptr)) == NULL) {
         /* Matching error. */
         safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
         safe_str(errptr, buff, bp);
         goto exit_sequence;
       }
-      ADD_CHECK("pcre"); /* re */
       if (searchlen)
         searchlen--;
-
-      /* If we're doing a lot, study the regexp to make sure it's good */
-      if (all) {
-        study = pcre_study(re, pcre_public_study_flags, &errptr);
-        if (errptr != NULL) {
-          pcre_free(re);
-          DEL_CHECK("pcre");
-          safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
-          safe_str(errptr, buff, bp);
-          goto exit_sequence;
-        }
-        if (study != NULL)
-          /* study */
-          ADD_CHECK("pcre.extra");
-      }
-      if (study) {
-        extra = study;
-        set_match_limit(extra);
-      } else
-        extra = default_match_limit();
+      re = cre->re;
+      extra = regexp_cache_extra(cre);
 
       search = 0;
       /* Do all the searches and replaces we can */
@@ -2824,16 +2743,7 @@ FUNCTION(fun_regreplace)
           tbp = tbuf;
           if (process_expression(tbuf, &tbp, &r, executor, caller, enactor,
                                  eflags | PE_DOLLAR, PT_DEFAULT, pe_info)) {
-            pcre_free(re);
-            DEL_CHECK("pcre");
-            if (study) {
-#ifdef PCRE_CONFIG_JIT
-              pcre_free_study(study);
-#else
-              pcre_free(study);
-#endif
-              DEL_CHECK("pcre.extra");
-            }
+            regexp_cache_release(cre);
             goto exit_sequence;
           }
           *tbp = '\0';
@@ -2861,16 +2771,7 @@ FUNCTION(fun_regreplace)
           }
         }
       } while (subpatterns >= 0 && all);
-      pcre_free(re);
-      DEL_CHECK("pcre");
-      if (study != NULL) {
-#ifdef PCRE_CONFIG_JIT
-        pcre_free_study(study);
-#else
-        pcre_free(study);
-#endif
-        DEL_CHECK("pcre.extra");
-      }
+      regexp_cache_release(cre);
     }
     safe_ansi_string(orig, 0, orig->len, buff, bp);
     free_ansi_string(orig);
@@ -2900,10 +2801,9 @@ FUNCTION(fun_regmatch)
    */
   int i, nqregs;
   char *qregs[NUMQ], *holder[NUMQ];
+  CACHED_REGEXP *cre;
   pcre *re;
-  pcre_extra *extra;
   const char *errptr = NULL;
-  int erroffset;
   int offsets[99];
   int subpatterns;
   char lbuff[BUFFER_LEN], *lbp;
@@ -2932,17 +2832,17 @@ FUNCTION(fun_regmatch)
     return;
   }
 
-  if ((re = pcre_compile(needle, flags, &errptr, &erroffset, tables)) == NULL) {
+  if ((cre = regexp_cache_get(needle, flags, &errptr)) == NULL) {
     /* Matching error. */
     safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
     safe_str(errptr, buff, bp);
     free_ansi_string(as);
     return;
   }
-  ADD_CHECK("pcre");
-  extra = default_match_limit();
+  re = cre->re;
 
-  subpatterns = pcre_exec(re, extra, txt, arglens[0], 0, 0, offsets, 99);
+  subpatterns = pcre_exec(re, regexp_cache_extra(cre), txt, arglens[0], 0, 0,
+                          offsets, 99);
   safe_integer(subpatterns >= 0, buff, bp);
 
   /* We need to parse the list of registers.  Anything that we don't parse
@@ -3013,8 +2913,7 @@ FUNCTION(fun_regmatch)
   for (i = 0; i < nqregs; i++) {
     mush_free(holder[i], "regmatch");
   }
-  pcre_free(re);
-  DEL_CHECK("pcre");
+  regexp_cache_release(cre);
   free_ansi_string(as);
 }
 
@@ -3025,10 +2924,9 @@ FUNCTION(fun_regrab)
 {
   char *r, *s, *b, sep;
   size_t rlen;
-  pcre *re;
-  pcre_extra *study, *extra;
+  CACHED_REGEXP *cre;
+  pcre_extra *extra;
   const char *errptr;
-  int erroffset;
   int offsets[99];
   int flags = 0;
   char *osep, osepd[2] = {'\0', '\0'};
@@ -3058,36 +2956,21 @@ FUNCTION(fun_regrab)
   if (strstr(called_as, "MATCH"))
     pos = 1;
 
-  if ((re = pcre_compile(remove_markup(args[1], NULL), flags, &errptr,
-                         &erroffset, tables)) == NULL) {
+  if ((cre = regexp_cache_get(remove_markup(args[1], NULL), flags,
+                              &errptr)) == NULL) {
     /* Matching error. */
     safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
     safe_str(errptr, buff, bp);
     return;
   }
-  ADD_CHECK("pcre");
-
-  study = pcre_study(re, pcre_public_study_flags, &errptr);
-  if (errptr != NULL) {
-    safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
-    safe_str(errptr, buff, bp);
-    pcre_free(re);
-    DEL_CHECK("pcre");
-    return;
-  }
-  if (study) {
-    ADD_CHECK("pcre.extra");
-    extra = study;
-    set_match_limit(extra);
-  } else
-    extra = default_match_limit();
+  extra = regexp_cache_extra(cre);
   ptrs = mush_calloc(MAX_SORTSIZE, sizeof(char *), "ptrarray");
   if (!ptrs)
     mush_panic("Unable to allocate memory in fun_regrab");
   nptrs = list2arr_ansi(ptrs, MAX_SORTSIZE, s, sep, 1);
   for (i = 0; i < nptrs; i++) {
     r = remove_markup(ptrs[i], &rlen);
-    if (pcre_exec(re, extra, r, rlen - 1, 0, 0, offsets, 99) >= 0) {
+    if (pcre_exec(cre->re, extra, r, rlen - 1, 0, 0, offsets, 99) >= 0) {
       if (all && *bp != b)
         safe_str(osep, buff, bp);
       if (pos)
@@ -3101,16 +2984,7 @@ FUNCTION(fun_regrab)
   freearr(ptrs, nptrs);
   mush_free(ptrs, "ptrarray");
 
-  pcre_free(re);
-  DEL_CHECK("pcre");
-  if (study) {
-#ifdef PCRE_CONFIG_JIT
-    pcre_free_study(study);
-#else
-    pcre_free(study);
-#endif
-    DEL_CHECK("pcre.extra");
-  }
+  regexp_cache_release(cre);
 }
 
 FUNCTION(fun_isregexp)
@@ -504,7 +504,7 @@ FUNCTION(fun_listq)
 
   pe_regs = pe_info->regvals;
   while (pe_regs) {
-    val = pe_regs->vals;
+    val = PE_REGS_VALS(pe_regs);
     while (val) {
       if (!(val->type & types)) {
         val = val->next;
@@ -579,13 +579,14 @@ clear_allq(NEW_PE_INFO *pe_info)
     if (pe_regs->flags & PE_REGS_Q) {
       /* Do this for everything up to the lowest level q-reg that _isn't_ a
        * letq() */
-      for (pe_val = pe_regs->vals; pe_val; pe_val = pe_val->next) {
+      for (pe_val = PE_REGS_VALS(pe_regs); pe_val; pe_val = pe_val->next) {
         if (pe_val->type & PE_REGS_Q) {
           if (pe_val->type & PE_REGS_STR) {
             /* Quick and dirty: Set it to "". */
             pe_regs_set(pe_regs, pe_val->type, pe_val->name, "");
           } else {
-            pe_val->val.ival = 0;
+            /* Not pe_val->val.ival = 0: the values may be shared. */
+            pe_regs_set_int(pe_regs, pe_val->type, pe_val->name, 0);
           }
         }
       }
@@ -668,7 +669,7 @@ FUNCTION(fun_unsetq)
   /* Build the Q-reg tree */
   pe_regs = pe_info->regvals;
   while (pe_regs) {
-    val = pe_regs->vals;
+    val = PE_REGS_VALS(pe_regs);
     while (val) {
       /* Insert it into the tree if it's non-blank. */
       if ((val->type & PE_REGS_STR) && *(val->val.sval) &&
@@ -998,14 +999,13 @@ FUNCTION(fun_reswitch)
   char *tbuf1;
   int first = 1, found = 0, flags = 0;
   int search, subpatterns, offsets[99];
+  CACHED_REGEXP *cre;
   pcre *re;
   PE_REGS *pe_regs;
   ansi_string *mas = NULL;
   const char *haystack;
   int haystacklen;
   const char *errptr;
-  int erroffset;
-  pcre_extra *extra;
 
   if (strstr(called_as, "ALL"))
     first = 0;
@@ -1043,16 +1043,15 @@ FUNCTION(fun_reswitch)
       goto exit_sequence;
     *dp = '\0';
 
-    if ((re = pcre_compile(remove_markup(pstr, NULL), flags, &errptr,
-                           &erroffset, tables)) == NULL) {
+    if ((cre = regexp_cache_get(remove_markup(pstr, NULL), flags, &errptr)) ==
+        NULL) {
       /* Matching error. Ignore this one, move on. */
       continue;
     }
-    ADD_CHECK("pcre");
-    extra = default_match_limit();
+    re = cre->re;
     search = 0;
-    subpatterns =
-      pcre_exec(re, extra, haystack, haystacklen, search, 0, offsets, 99);
+    subpatterns = pcre_exec(re, regexp_cache_extra(cre), haystack, haystacklen,
+                            search, 0, offsets, 99);
     if (subpatterns >= 0) {
       /* If there's a #$ in a switch's action-part, replace it with
        * the value of the conditional (mstr) before evaluating it.
@@ -1072,8 +1071,7 @@ FUNCTION(fun_reswitch)
       mush_free(tbuf1, "replace_string.buff");
       found = 1;
     }
-    pcre_free(re);
-    DEL_CHECK("pcre");
+    regexp_cache_release(cre);
     if ((first && found) || per) {
       goto exit_sequence;
     }
@@ -22,6 +22,8 @@
 #include "mymalloc.h"
 #include "notify.h"
 #include "parse.h"
+#include "pecode.h"
+#include "profile.h"
 #include "strutil.h"
 
 /* ARGSUSED */
@@ -173,6 +175,7 @@ do_userfn(char *buff, char **bp, dbref obj, ATTR *attrib, int nargs,
   char const *tp;
   int pe_flags = PE_DEFAULT | extra_flags;
   PE_REGS *pe_regs;
+  int pframe;
 
   if (nargs > MAX_STACK_ARGS)
     nargs = MAX_STACK_ARGS; /* maximum no of args */
@@ -195,8 +198,10 @@ do_userfn(char *buff, char **bp, dbref obj, ATTR *attrib, int nargs,
   else if (AF_Debug(attrib))
     pe_flags |= PE_DEBUG;
 
-  process_expression(buff, bp, &tp, obj, executor, enactor, pe_flags,
-                     PT_DEFAULT, pe_info);
+  pframe = profile_enter_attr(obj, AL_NAME(attrib));
+  process_attr_expression(buff, bp, &tp, attrib->data, obj, executor, enactor,
+                          pe_flags, pe_info);
+  profile_leave(pframe);
 
   mush_free(tbuf, "atrval.do_userfn");
 
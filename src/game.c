@@ -61,10 +61,13 @@ void Win32MUSH_setup(void);
 #include "mymalloc.h"
 #include "mypcre.h"
 #include "parse.h"
+#include "pecode.h"
+#include "phash.h"
 #include "ptab.h"
 #include "sig.h"
 #include "strtree.h"
 #include "strutil.h"
+#include "tz.h"
 #include "version.h"
 #include "mushsql.h"
 
@@ -1017,6 +1020,7 @@ do_readcache(dbref player)
   }
   fcache_load(player);
   help_rebuild(player);
+  flush_tz_cache();
   file_watch_init();
 }
 
@@ -2580,7 +2584,9 @@ extern StrTree object_names;
 extern PTAB ptab_command;
 extern PTAB ptab_attrib;
 extern PTAB ptab_flag;
-extern intmap *queue_map, *descs_by_fd;
+extern PHASH phash_function;
+extern PHASH phash_command;
+extern intmap *queue_map, *sem_map, *descs_by_fd, *descs_by_player;
 #ifdef HAVE_INOTIFY_INIT1
 extern intmap *watchtable;
 #endif
@@ -2668,6 +2674,10 @@ do_list_memstats(dbref player)
   ptab_stats(player, &ptab_attrib, "AttrPerms");
   ptab_stats(player, &ptab_command, "Commands");
   ptab_stats(player, &ptab_flag, "Flags");
+  notify(player, "Perfect Hashes:");
+  phash_stats_header(player);
+  phash_stats(player, &phash_function, "Functions");
+  phash_stats(player, &phash_command, "Commands");
   notify(player, "String Trees:");
   st_stats_header(player);
   st_stats(player, &atr_names, "AttrNames");
@@ -2676,10 +2686,16 @@ do_list_memstats(dbref player)
   notify(player, "Integer Maps:");
   im_stats_header(player);
   im_stats(player, queue_map, "Queue IDs");
+  im_stats(player, sem_map, "Semaphores");
   im_stats(player, descs_by_fd, "Connections");
+  im_stats(player, descs_by_player, "Player Conns");
 #ifdef HAVE_INOTIFY_INIT1
   im_stats(player, watchtable, "Inotify");
 #endif
+  pe_code_stats(player);
+  regexp_cache_stats(player);
+  wild_cache_stats(player);
+  json_cache_stats(player);
 
   notify(player, "Sqlite3 Databases:");
   sqlmem = sqlite3_memory_used();
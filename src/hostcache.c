@@ -0,0 +1,256 @@
+/** \file hostcache.c
+ *
+ * \brief Cache of reverse DNS lookups.
+ *
+ * Most connections come from a small set of addresses that reconnect
+ * over and over, and asking DNS for the same PTR record every time
+ * just makes people wait longer for the connect screen. This keeps
+ * the results of recent lookups, failures included, in a hash table
+ * on the numeric address, with a LRU list to decide what to throw
+ * out when it fills up. Entries also expire after a while, so changes
+ * in DNS get noticed eventually.
+ *
+ * This file is also compiled into ssl_slave, so it only uses plain
+ * malloc() and friends.
+ */
+
+#include "copyrite.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "conf.h"
+#include "lookup.h"
+#include "hostcache.h"
+#ifndef SLAVE
+#include "externs.h"
+#include "notify.h"
+#endif
+
+/** A cached hostname */
+struct hostcache_entry {
+  struct hostcache_entry *chain; /**< Next entry in the same hash bucket */
+  struct hostcache_entry *newer; /**< Next more recently used entry */
+  struct hostcache_entry *older; /**< Next less recently used entry */
+  time_t expires;                /**< When to stop using this entry */
+  char ip[IPADDR_LEN];           /**< Numeric address */
+  char host[HOSTNAME_LEN];       /**< Hostname, or the address if unknown */
+};
+
+static struct hostcache_entry **buckets = NULL;
+static unsigned int nbuckets = 0;
+static int capacity = 0;
+static struct hostcache_entry *newest = NULL, *oldest = NULL;
+
+struct hostcache_stats hostcache_stats = {0, 0, 0, 0};
+
+/* FNV-1a */
+static unsigned int
+hash_ip(const char *ip)
+{
+  unsigned int h = 2166136261U;
+
+  while (*ip) {
+    h ^= (unsigned char) *ip++;
+    h *= 16777619U;
+  }
+  return h & (nbuckets - 1);
+}
+
+/* Returns the link that points to ip's entry, or to NULL if it's not
+ * in the cache. */
+static struct hostcache_entry **
+find_link(const char *ip)
+{
+  struct hostcache_entry **pe;
+
+  for (pe = &buckets[hash_ip(ip)]; *pe; pe = &(*pe)->chain) {
+    if (strcmp((*pe)->ip, ip) == 0) {
+      break;
+    }
+  }
+  return pe;
+}
+
+static void
+lru_unlink(struct hostcache_entry *e)
+{
+  if (e->newer) {
+    e->newer->older = e->older;
+  } else {
+    newest = e->older;
+  }
+  if (e->older) {
+    e->older->newer = e->newer;
+  } else {
+    oldest = e->newer;
+  }
+  e->newer = e->older = NULL;
+}
+
+static void
+lru_push(struct hostcache_entry *e)
+{
+  e->newer = NULL;
+  e->older = newest;
+  if (newest) {
+    newest->newer = e;
+  } else {
+    oldest = e;
+  }
+  newest = e;
+}
+
+static void
+remove_entry(struct hostcache_entry **pe)
+{
+  struct hostcache_entry *e = *pe;
+
+  *pe = e->chain;
+  lru_unlink(e);
+  free(e);
+  hostcache_stats.entries -= 1;
+}
+
+/** Set up the cache, throwing out anything already in it.
+ * \param size the most entries to keep. 0 turns the cache off.
+ */
+void
+hostcache_init(int size)
+{
+  while (oldest) {
+    remove_entry(find_link(oldest->ip));
+  }
+  free(buckets);
+  buckets = NULL;
+  nbuckets = 0;
+  capacity = 0;
+
+  if (size <= 0) {
+    return;
+  }
+
+  for (nbuckets = 16; nbuckets < (unsigned int) size; nbuckets <<= 1)
+    ;
+  buckets = calloc(nbuckets, sizeof *buckets);
+  if (!buckets) {
+    nbuckets = 0;
+    return;
+  }
+  capacity = size;
+}
+
+/** The most entries the cache can hold, or 0 if it's turned off. */
+int
+hostcache_size(void)
+{
+  return capacity;
+}
+
+/** Look up the hostname of an address.
+ * \param ip the numeric address.
+ * \param now the current time.
+ * \return the hostname (Which is ip again if it has none), or NULL if
+ * the address isn't cached.
+ */
+const char *
+hostcache_find(const char *ip, time_t now)
+{
+  struct hostcache_entry **pe, *e;
+
+  if (!capacity) {
+    return NULL;
+  }
+
+  pe = find_link(ip);
+  if (!*pe || (*pe)->expires <= now) {
+    if (*pe) {
+      remove_entry(pe);
+    }
+    hostcache_stats.misses += 1;
+    return NULL;
+  }
+
+  e = *pe;
+  lru_unlink(e);
+  lru_push(e);
+  hostcache_stats.hits += 1;
+  return e->host;
+}
+
+/** Remember the result of a lookup.
+ * \param ip the numeric address.
+ * \param host its hostname, or ip if the lookup failed.
+ * \param now the time of the lookup.
+ * \param ttl how many seconds the result is good for.
+ */
+void
+hostcache_add(const char *ip, const char *host, time_t now, int ttl)
+{
+  struct hostcache_entry **pe, *e;
+
+  if (!capacity || ttl <= 0 || strlen(ip) >= IPADDR_LEN) {
+    return;
+  }
+
+  pe = find_link(ip);
+  if (*pe) {
+    e = *pe;
+    lru_unlink(e);
+  } else {
+    if (hostcache_stats.entries >= capacity) {
+      if (oldest->expires > now) {
+        hostcache_stats.evicted += 1;
+      }
+      remove_entry(find_link(oldest->ip));
+      /* That might have been the entry right before ours in the bucket */
+      pe = find_link(ip);
+    }
+    e = malloc(sizeof *e);
+    if (!e) {
+      return;
+    }
+    strcpy(e->ip, ip);
+    e->chain = NULL;
+    *pe = e;
+    hostcache_stats.entries += 1;
+  }
+
+  strncpy(e->host, host, HOSTNAME_LEN - 1);
+  e->host[HOSTNAME_LEN - 1] = '\0';
+  e->expires = now + ttl;
+  lru_push(e);
+}
+
+/** Work out how long to cache a lookup for.
+ * \param resolved true if the address had a hostname.
+ * \param dns_ttl the TTL DNS gave for the answer.
+ * \param max_ttl the longest time to keep anything.
+ * \return the number of seconds to keep it.
+ */
+int
+hostcache_ttl(bool resolved, int dns_ttl, int max_ttl)
+{
+  int ttl = resolved ? dns_ttl : HOSTCACHE_FAILED_TTL;
+
+  return ttl < max_ttl ? ttl : max_ttl;
+}
+
+#ifndef SLAVE
+/** Show hostname cache statistics, for \@stats/net.
+ * \param player the player to tell.
+ */
+void
+hostcache_report(dbref player)
+{
+  if (!capacity) {
+    notify(player, T("Hostname cache: Disabled."));
+    return;
+  }
+  notify_format(player,
+                T("Hostname cache: %d of %d entries used. %lu hits, %lu "
+                  "misses, %lu evicted."),
+                hostcache_stats.entries, capacity, hostcache_stats.hits,
+                hostcache_stats.misses, hostcache_stats.evicted);
+}
+#endif
@@ -41,6 +41,7 @@
 #include "conf.h"
 #include "log.h"
 #include "lookup.h"
+#include "hostcache.h"
 #include "mysocket.h"
 #include "sig.h"
 #include "strutil.h"
@@ -213,12 +214,51 @@ make_info_slave(void)
   return true;
 }
 
+extern const char *source_to_s(conn_source);
+
+/** Set up a descriptor for a new connection once its hostname is known.
+ * \param fd the connection's socket.
+ * \param ip its numeric address.
+ * \param hostname its hostname.
+ * \param port the local port it connected to.
+ */
+static void
+open_resolved_connection(int fd, char *ip, char *hostname, int port)
+{
+  conn_source source;
+
+  if (Forbidden_Site(ip) || Forbidden_Site(hostname)) {
+    if (!Deny_Silent_Site(ip, AMBIGUOUS) ||
+        !Deny_Silent_Site(hostname, AMBIGUOUS)) {
+      do_log(LT_CONN, 0, 0, "[%d/%s/%s] Refused connection.", fd, hostname,
+             ip);
+    }
+    shutdown(fd, 2);
+    closesocket(fd);
+    return;
+  }
+
+  if (port == TINYPORT)
+    source = CS_IP_SOCKET;
+  else if (port == SSLPORT)
+    source = CS_OPENSSL_SOCKET;
+  else
+    source = CS_UNKNOWN;
+
+  do_log(LT_CONN, 0, 0, "[%d/%s/%s] Connection opened from %s.", fd, hostname,
+         ip, source_to_s(source));
+  set_keepalive(fd, options.keepalive_timeout);
+
+  initializesock(fd, hostname, ip, source);
+}
+
 void
 query_info_slave(int fd)
 {
   struct request_dgram req;
   struct hostname_info *hi;
   char buf[BUFFER_LEN], *bp;
+  const char *host;
   ssize_t slen;
 
   FD_SET(fd, &info_pending);
@@ -276,6 +316,18 @@ query_info_slave(int fd)
     return;
   }
 
+  /* Skip the slave entirely if we've looked this address up recently. */
+  if (USE_DNS && (host = hostcache_find(buf, time(NULL)))) {
+    char hostname[BUFFER_LEN];
+
+    FD_CLR(fd, &info_pending);
+    strcpy(hostname, host);
+    hi = ip_convert(&req.local.addr, req.llen);
+    open_resolved_connection(fd, buf, hostname,
+                             hi ? strtol(hi->port, NULL, 10) : -1);
+    return;
+  }
+
   req.fd = fd;
   req.use_dns = USE_DNS;
 
@@ -293,8 +345,6 @@ query_info_slave(int fd)
   info_slave_state = INFO_SLAVE_PENDING;
 }
 
-extern const char *source_to_s(conn_source);
-
 void
 reap_info_slave(void)
 {
@@ -302,7 +352,6 @@ reap_info_slave(void)
   ssize_t len;
   char hostname[BUFFER_LEN], *hp;
   int n, count;
-  conn_source source;
 
   if (info_slave_state != INFO_SLAVE_PENDING) {
     if (info_slave_state == INFO_SLAVE_DOWN)
@@ -343,29 +392,14 @@ reap_info_slave(void)
     safe_str(resp.ipaddr, hostname, &hp);
   *hp = '\0';
 
-  if (Forbidden_Site(resp.ipaddr) || Forbidden_Site(hostname)) {
-    if (!Deny_Silent_Site(resp.ipaddr, AMBIGUOUS) ||
-        !Deny_Silent_Site(hostname, AMBIGUOUS)) {
-      do_log(LT_CONN, 0, 0, "[%d/%s/%s] Refused connection.", resp.fd, hostname,
-             resp.ipaddr);
-    }
-    shutdown(resp.fd, 2);
-    closesocket(resp.fd);
-    return;
+  if (USE_DNS) {
+    hostcache_add(resp.ipaddr, hostname, time(NULL),
+                  hostcache_ttl(strcmp(resp.ipaddr, hostname) != 0,
+                                resp.ttl > 0 ? resp.ttl : DNS_CACHE_TTL,
+                                DNS_CACHE_TTL));
   }
 
-  if (resp.connected_to == TINYPORT)
-    source = CS_IP_SOCKET;
-  else if (resp.connected_to == SSLPORT)
-    source = CS_OPENSSL_SOCKET;
-  else
-    source = CS_UNKNOWN;
-
-  do_log(LT_CONN, 0, 0, "[%d/%s/%s] Connection opened from %s.", resp.fd,
-         hostname, resp.ipaddr, source_to_s(source));
-  set_keepalive(resp.fd, options.keepalive_timeout);
-
-  initializesock(resp.fd, hostname, resp.ipaddr, source);
+  open_resolved_connection(resp.fd, resp.ipaddr, hostname, resp.connected_to);
 }
 
 /** Kill the info_slave process, typically at shutdown.
@@ -163,8 +163,7 @@ send_resp(evutil_socket_t fd, short what __attribute__((__unused__)), void *arg)
 }
 
 static void
-address_resolved(int result, char type, int count,
-                 int ttl __attribute__((__unused__)), void *addresses,
+address_resolved(int result, char type, int count, int ttl, void *addresses,
                  void *arg)
 {
   struct is_data *data = arg;
@@ -174,6 +173,7 @@ address_resolved(int result, char type, int count,
   } else {
     mush_strncpy(data->resp.hostname, ((const char **) addresses)[0],
                  HOSTNAME_LEN);
+    data->resp.ttl = ttl;
   }
 
   /* One-shot event to write the response packet */
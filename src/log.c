@@ -53,7 +53,24 @@ static void start_log(struct log_stream *);
 static void end_log(struct log_stream *, bool);
 static void check_log_size(struct log_stream *);
 
-BUFFERQ *activity_bq = NULL;
+/** One entry in the activity log. */
+struct activity {
+  enum log_act_type type; /**< What kind of activity */
+  dbref player;           /**< Who did it */
+  time_t when;            /**< When it was logged */
+  uint64_t serial;        /**< Which entry this is, or 0 if unused */
+  const char *live;       /**< Expression still being evaluated, or NULL */
+  size_t len;             /**< Length of live */
+  char text[BUFFER_LEN];  /**< Saved text, once live is NULL */
+};
+
+/** The activity log, a ring of the last ACTIVITY_LOG_SIZE entries. */
+static struct activity activity_log[ACTIVITY_LOG_SIZE];
+/** Serial number of the newest entry in activity_log. */
+static uint64_t activity_serial = 0;
+
+static struct activity *new_activity(enum log_act_type type, dbref player);
+static void save_activity(struct activity *act);
 
 HASHTAB htab_logfiles; /**< Hash table of logfile names and descriptors */
 
@@ -604,6 +621,44 @@ do_logwipe(dbref player, enum log_type logtype, const char *pass,
   notify(player, T("Log wiped."));
 }
 
+/** Claim the next entry in the activity log, overwriting the oldest.
+ * \param type activity type (an LA_* constant).
+ * \param player object responsible for the activity.
+ * \return the entry.
+ */
+static struct activity *
+new_activity(enum log_act_type type, dbref player)
+{
+  struct activity *act;
+
+  act = &activity_log[++activity_serial % ACTIVITY_LOG_SIZE];
+  act->type = type;
+  act->player = player;
+  act->when = mudtime;
+  act->serial = activity_serial;
+  act->live = NULL;
+  act->len = 0;
+  act->text[0] = '\0';
+  return act;
+}
+
+/** Copy the text of an expression entry, so it no longer depends on
+ * the expression still being around.
+ * \param act the entry.
+ */
+static void
+save_activity(struct activity *act)
+{
+  size_t len;
+
+  if (!act->live)
+    return;
+  len = act->len < BUFFER_LEN ? act->len : BUFFER_LEN - 1;
+  memcpy(act->text, act->live, len);
+  act->text[len] = '\0';
+  act->live = NULL;
+}
+
 /** Log a message to the activity log.
  * \param type message type (an LA_* constant)
  * \param player object responsible for the message.
@@ -612,92 +667,107 @@ do_logwipe(dbref player, enum log_type logtype, const char *pass,
 void
 log_activity(enum log_act_type type, dbref player, const char *action)
 {
-  if (!activity_bq)
-    activity_bq = allocate_bufferq(ACTIVITY_LOG_SIZE);
-  add_to_bufferq(activity_bq, type, player, action);
+  struct activity *act = new_activity(type, player);
+  mush_strncpy(act->text, action, BUFFER_LEN);
 }
 
-/** Retrieve the last logged message from the activity log.
- * \return last logged message or an empty string.
+/** Note the start of an expression's evaluation in the activity log.
+ * Only the position of the expression is kept until it's finished,
+ * when activity_leave() saves a copy. If it's part of an expression
+ * that's already logged and still being evaluated, as function
+ * arguments usually are, nothing is logged.
+ * \param player object evaluating the expression.
+ * \param expr the expression.
+ * \return a value to pass to activity_leave().
  */
-const char *
-last_activity(void)
+uint64_t
+activity_enter(dbref player, const char *expr)
 {
-  if (!activity_bq)
-    return "";
-  else
-    return BufferQLast(activity_bq);
+  struct activity *act;
+  unsigned int n;
+
+  for (n = 0; n < ACTIVITY_LOG_SIZE; n++) {
+    act = &activity_log[(activity_serial - n) % ACTIVITY_LOG_SIZE];
+    if (act->type != LA_PE || !act->serial)
+      break;
+    if (act->live && expr >= act->live && expr <= act->live + act->len)
+      return 0;
+  }
+  act = new_activity(LA_PE, player);
+  act->live = expr;
+  act->len = strlen(expr);
+  return act->serial;
 }
 
-/** Retrieve the type of the last logged message from the activity log.
- * \return last type of last logged message or -1.
+/** Note the end of an expression's evaluation in the activity log.
+ * \param serial what activity_enter() returned.
  */
-int
-last_activity_type(void)
+void
+activity_leave(uint64_t serial)
 {
-  if (!activity_bq)
-    return -1;
-  else
-    return BufferQLastType(activity_bq);
+  struct activity *act;
+
+  if (!serial)
+    return;
+  act = &activity_log[serial % ACTIVITY_LOG_SIZE];
+  if (act->serial == serial)
+    save_activity(act);
 }
 
-/** Dump out (to a player or the error log) the activity buffer queue.
+/** Dump out (to a player or the error log) the activity log.
+ * Expressions that are still being evaluated are copied now.
  * \param player player to receive notification, if notifying.
- * \param num_lines number of lines of buffer to dump (0 = all).
+ * \param num_lines number of entries to dump (0 = all).
  * \param dump if 1, dump to error log; if 0, notify player.
  */
 void
 notify_activity(dbref player, int num_lines, int dump)
 {
-  int type;
-  dbref plr;
-  time_t timestamp;
-  char *buf;
-  char *p = NULL;
+  struct activity *act;
+  uint64_t n, count;
   char *stamp;
-  int skip;
   const char *typestr;
 
-  if (!activity_bq)
+  for (count = 0; count < ACTIVITY_LOG_SIZE && count < activity_serial;
+       count++)
+    if (!activity_log[(activity_serial - count) % ACTIVITY_LOG_SIZE].serial)
+      break;
+  if (!count)
     return;
-
-  if (dump || !num_lines)
-    num_lines = BufferQNum(activity_bq);
-  skip = BufferQNum(activity_bq) - num_lines;
+  if (!dump && num_lines > 0 && (unsigned int) num_lines < count)
+    count = num_lines;
 
   if (dump)
     do_rawlog(LT_ERR, "Dumping recent activity:");
   else
     notify(player, T("GAME: Recall from activity log"));
 
-  do {
-    buf = iter_bufferq(activity_bq, &p, &plr, &type, &timestamp);
-    if (skip <= 0) {
-      if (buf) {
-        stamp = show_time(timestamp, 0);
-        switch (type) {
-        case LA_CMD:
-          typestr = "CMD";
-          break;
-        case LA_PE:
-          typestr = "EXP";
-          break;
-        case LA_LOCK:
-          typestr = "LCK";
-          break;
-        default:
-          typestr = "???";
-          break;
-        }
-
-        if (dump)
-          do_rawlog(LT_ERR, "[%s/#%d/%s] %s", stamp, plr, typestr, buf);
-        else
-          notify_format(player, "[%s/#%d/%s] %s", stamp, plr, typestr, buf);
-      }
+  for (n = count; n > 0; n--) {
+    act = &activity_log[(activity_serial - n + 1) % ACTIVITY_LOG_SIZE];
+    save_activity(act);
+    stamp = show_time(act->when, 0);
+    switch (act->type) {
+    case LA_CMD:
+      typestr = "CMD";
+      break;
+    case LA_PE:
+      typestr = "EXP";
+      break;
+    case LA_LOCK:
+      typestr = "LCK";
+      break;
+    default:
+      typestr = "???";
+      break;
     }
-    skip--;
-  } while (buf);
+
+    if (dump)
+      do_rawlog(LT_ERR, "[%s/#%d/%s] %s", stamp, act->player, typestr,
+                act->text);
+    else
+      notify_format(player, "[%s/#%d/%s] %s", stamp, act->player, typestr,
+                    act->text);
+  }
 
   if (!dump)
     notify(player, T("GAME: End recall"));
@@ -0,0 +1,374 @@
+/** \file mccp.c
+ *
+ * \brief MUD Client Compression Protocol (MCCP2 and MCCP3) support.
+ *
+ * Output compression works on the descriptor's normal output queue.
+ * Text is queued uncompressed as usual, and process_output() calls
+ * mccp_compress_output() right before sending. That replaces all the
+ * not-yet-compressed blocks at the end of the queue with their deflated
+ * equivalent, and ends the batch with a Z_SYNC_FLUSH so the client can
+ * decompress everything sent so far - prompts and GOAHEADs included -
+ * without waiting for more.
+ *
+ * Input decompression happens as soon as data is read from the socket,
+ * before telnet codes and line breaks are looked at.
+ */
+
+#include "copyrite.h"
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "conf.h"
+#include "externs.h"
+#include "log.h"
+#include "mymalloc.h"
+#include "mysocket.h"
+#include "notify.h"
+#include "mccp.h"
+
+#ifdef HAVE_LIBZ
+
+extern DESC *descriptor_list;
+void add_to_queue(struct text_queue *q, const char *b, int n);
+void free_text_block(struct text_block *t);
+int process_output(DESC *d);
+
+/** Compression totals since startup, for \@stats/net */
+static struct {
+  unsigned long long raw_out;    /**< Bytes of output before compression */
+  unsigned long long zipped_out; /**< Bytes of output after compression */
+  unsigned long long zipped_in;  /**< Bytes of input before decompression */
+  unsigned long long raw_in;     /**< Bytes of input after decompression */
+} mccp_totals;
+
+static struct mccp_state *get_mccp_state(DESC *d);
+static void mccp_deflate(DESC *d, int flush);
+
+/** Return a descriptor's compression state, creating it if needed. */
+static struct mccp_state *
+get_mccp_state(DESC *d)
+{
+  if (!d->mccp) {
+    d->mccp = mush_calloc(1, sizeof(struct mccp_state), "mccp_state");
+    if (!d->mccp)
+      mush_panic("Out of memory");
+  }
+  return d->mccp;
+}
+
+/** Start compressing output to a descriptor, after the client has
+ * agreed to MCCP2.
+ * \param d the descriptor.
+ */
+void
+mccp_start_output(DESC *d)
+{
+  static const char start[5] = {IAC, SB, TN_MCCP2, IAC, SE};
+  struct mccp_state *st;
+
+  if (MCCP_OUT(d) || (d->conn_flags & CONN_SOCKET_ERROR))
+    return;
+
+  st = get_mccp_state(d);
+  memset(&st->out, 0, sizeof st->out);
+  if (deflateInit(&st->out, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    do_rawlog(LT_ERR, "[%d/%s/%s] Unable to start MCCP2 compression: %s",
+              d->descriptor, d->addr, d->ip,
+              st->out.msg ? st->out.msg : "unknown error");
+    return;
+  }
+
+  /* The start sequence itself, and anything queued before it, goes
+   * out uncompressed. */
+  queue_newwrite(d, start, sizeof start);
+  st->done = d->output.tail;
+  /* Raw text mustn't be added to the uncompressed blocks. */
+  if (st->done)
+    st->done->size = 0;
+  st->overflowed = 0;
+  d->conn_flags |= CONN_MCCP2;
+  do_rawlog(LT_CONN, "[%d/%s/%s] Starting MCCP2 compression.", d->descriptor,
+            d->addr, d->ip);
+}
+
+/** Deflate all the raw text at the end of a descriptor's output queue,
+ * replacing it with the compressed version.
+ * \param d the descriptor.
+ * \param flush Z_SYNC_FLUSH to make everything so far decompressable,
+ * Z_FINISH to end the stream.
+ */
+static void
+mccp_deflate(DESC *d, int flush)
+{
+  struct mccp_state *st = d->mccp;
+  struct text_block *raw, *next;
+  char buff[BUFFER_LEN];
+  unsigned long zipped = 0;
+
+  raw = st->done ? st->done->nxt : d->output.head;
+  if (!raw && flush != Z_FINISH)
+    return;
+
+  /* Detach the raw blocks; the compressed text takes their place. */
+  if (st->done) {
+    st->done->nxt = NULL;
+    d->output.tail = st->done;
+  } else
+    d->output.head = d->output.tail = NULL;
+
+  st->out.next_out = (Bytef *) buff;
+  st->out.avail_out = sizeof buff;
+  do {
+    int mode;
+
+    if (raw) {
+      next = raw->nxt;
+      st->out.next_in = (Bytef *) raw->start;
+      st->out.avail_in = raw->nchars;
+      d->output_size -= raw->nchars;
+      st->raw_out += raw->nchars;
+      mccp_totals.raw_out += raw->nchars;
+    } else {
+      next = NULL;
+      st->out.next_in = NULL;
+      st->out.avail_in = 0;
+    }
+    mode = next ? Z_NO_FLUSH : flush;
+
+    do {
+      deflate(&st->out, mode);
+      if (st->out.avail_out == 0) {
+        add_to_queue(&d->output, buff, sizeof buff);
+        zipped += sizeof buff;
+        st->out.next_out = (Bytef *) buff;
+        st->out.avail_out = sizeof buff;
+      }
+    } while (st->out.avail_out == 0 || st->out.avail_in > 0);
+
+    if (raw)
+      free_text_block(raw);
+    raw = next;
+  } while (raw);
+
+  if (st->out.avail_out < sizeof buff) {
+    int len = sizeof buff - st->out.avail_out;
+    add_to_queue(&d->output, buff, len);
+    zipped += len;
+  }
+
+  d->output_size += zipped;
+  st->zipped_out += zipped;
+  mccp_totals.zipped_out += zipped;
+  st->done = d->output.tail;
+}
+
+/** Compress any output queued since the last call, so it can be sent.
+ * \param d the descriptor.
+ */
+void
+mccp_compress_output(DESC *d)
+{
+  if (MCCP_OUT(d))
+    mccp_deflate(d, Z_SYNC_FLUSH);
+}
+
+/** Note that some output has been written to a descriptor's socket.
+ * \param d the descriptor.
+ */
+void
+mccp_output_sent(DESC *d)
+{
+  if (!d->output.head) {
+    d->mccp->done = NULL;
+    d->mccp->overflowed = 0;
+  }
+}
+
+/** Handle the output queue of a compressing descriptor filling up.
+ * Text that's already been compressed can't be thrown away without
+ * corrupting the stream, so drop the new text instead, leaving a note
+ * in its place the first time.
+ * \param d the descriptor.
+ * \param msg the note to leave.
+ * \param len length of msg.
+ */
+void
+mccp_overflow(DESC *d, const char *msg, int len)
+{
+  if (!d->mccp->overflowed) {
+    d->mccp->overflowed = 1;
+    add_to_queue(&d->output, msg, len);
+    d->output_size += len;
+  }
+}
+
+/** Start decompressing input from a descriptor, after the client has
+ * sent IAC SB MCCP3 IAC SE.
+ * \param d the descriptor.
+ */
+void
+mccp_start_input(DESC *d)
+{
+  struct mccp_state *st;
+
+  if (MCCP_IN(d))
+    return;
+
+  st = get_mccp_state(d);
+  memset(&st->in, 0, sizeof st->in);
+  if (inflateInit(&st->in) != Z_OK) {
+    /* Everything the client sends from now on will be gibberish to us. */
+    do_rawlog(LT_ERR, "[%d/%s/%s] Unable to start MCCP3 decompression: %s",
+              d->descriptor, d->addr, d->ip,
+              st->in.msg ? st->in.msg : "unknown error");
+    d->conn_flags |= CONN_SOCKET_ERROR;
+    return;
+  }
+  d->conn_flags |= CONN_MCCP3;
+  do_rawlog(LT_CONN, "[%d/%s/%s] Starting MCCP3 decompression.", d->descriptor,
+            d->addr, d->ip);
+}
+
+/** Decompress input read from a descriptor.
+ * Call repeatedly until *inlen is 0 and the return value is less than
+ * outlen. If the client ends its compressed stream, MCCP3 is turned off
+ * and anything left in the input is plain text.
+ * \param d the descriptor.
+ * \param in pointer to the compressed text, advanced past what was used.
+ * \param inlen pointer to the length of the compressed text, decreased by
+ * the amount used.
+ * \param out buffer for decompressed text.
+ * \param outlen size of out.
+ * \return number of bytes written to out, or -1 on error.
+ */
+int
+mccp_decompress_input(DESC *d, const char **in, int *inlen, char *out,
+                      int outlen)
+{
+  struct mccp_state *st = d->mccp;
+  int ret, used, made;
+
+  st->in.next_in = (Bytef *) *in;
+  st->in.avail_in = *inlen;
+  st->in.next_out = (Bytef *) out;
+  st->in.avail_out = outlen;
+  ret = inflate(&st->in, Z_SYNC_FLUSH);
+
+  used = *inlen - st->in.avail_in;
+  made = outlen - st->in.avail_out;
+  *in += used;
+  *inlen -= used;
+  st->zipped_in += used;
+  st->raw_in += made;
+  mccp_totals.zipped_in += used;
+  mccp_totals.raw_in += made;
+
+  if (ret == Z_STREAM_END) {
+    inflateEnd(&st->in);
+    d->conn_flags &= ~CONN_MCCP3;
+    do_rawlog(LT_CONN, "[%d/%s/%s] Client ended MCCP3 compression.",
+              d->descriptor, d->addr, d->ip);
+  } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+    do_rawlog(LT_CONN, "[%d/%s/%s] MCCP3 decompression error: %s",
+              d->descriptor, d->addr, d->ip,
+              st->in.msg ? st->in.msg : "unknown error");
+    inflateEnd(&st->in);
+    d->conn_flags &= ~CONN_MCCP3;
+    d->conn_flags |= CONN_SOCKET_ERROR;
+    return -1;
+  }
+  return made;
+}
+
+/** Cleanly end compression in both directions, before a reboot.
+ * The zlib state can't be carried over to the new process, so the
+ * output stream is finished and the client is asked to stop
+ * compressing its input. Either can be renegotiated afterwards.
+ * \param d the descriptor.
+ */
+void
+mccp_end(DESC *d)
+{
+  static const char wont[3] = {IAC, WONT, TN_MCCP3};
+
+  if (!d->mccp)
+    return;
+  if (MCCP_IN(d)) {
+    inflateEnd(&d->mccp->in);
+    d->conn_flags &= ~CONN_MCCP3;
+    queue_newwrite(d, wont, sizeof wont);
+  }
+  if (MCCP_OUT(d)) {
+    mccp_deflate(d, Z_FINISH);
+    deflateEnd(&d->mccp->out);
+    d->conn_flags &= ~CONN_MCCP2;
+  }
+  process_output(d);
+  mccp_free(d);
+}
+
+/** Free a descriptor's compression state.
+ * \param d the descriptor.
+ */
+void
+mccp_free(DESC *d)
+{
+  if (!d->mccp)
+    return;
+  if (MCCP_OUT(d))
+    deflateEnd(&d->mccp->out);
+  if (MCCP_IN(d))
+    inflateEnd(&d->mccp->in);
+  d->conn_flags &= ~(CONN_MCCP2 | CONN_MCCP3);
+  mush_free(d->mccp, "mccp_state");
+  d->mccp = NULL;
+}
+
+/** Percentage of the original size a compressed stream takes up. */
+static double
+mccp_ratio(unsigned long long zipped, unsigned long long raw)
+{
+  return raw ? (100.0 * zipped) / raw : 100.0;
+}
+
+/** Show compression statistics, for \@stats/net.
+ * \param player the enactor.
+ */
+void
+mccp_stats(dbref player)
+{
+  DESC *d;
+  int nout = 0, nin = 0;
+
+  for (d = descriptor_list; d; d = d->next) {
+    if (MCCP_OUT(d))
+      nout += 1;
+    if (MCCP_IN(d))
+      nin += 1;
+  }
+
+  notify_format(player, T("Connections using MCCP2: %d, MCCP3: %d"), nout,
+                nin);
+  notify_format(player,
+                T("Output: %llu bytes compressed to %llu (%.1f%%) since "
+                  "startup."),
+                mccp_totals.raw_out, mccp_totals.zipped_out,
+                mccp_ratio(mccp_totals.zipped_out, mccp_totals.raw_out));
+  notify_format(player,
+                T("Input: %llu bytes decompressed from %llu (%.1f%%) since "
+                  "startup."),
+                mccp_totals.raw_in, mccp_totals.zipped_in,
+                mccp_ratio(mccp_totals.zipped_in, mccp_totals.raw_in));
+}
+
+#else /* HAVE_LIBZ */
+
+void
+mccp_stats(dbref player)
+{
+  notify(player, T("This MUSH was compiled without zlib, and can't use MCCP."));
+}
+
+#endif /* HAVE_LIBZ */
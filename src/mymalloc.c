@@ -23,6 +23,11 @@
  *     more intelligent but less general-purpose and use a lot less
  *     overhead.
  *
+ *  -# It has the evaluation arena, a stack of scratch memory for
+ *     temporary buffers that live only as long as a function call or
+ *     queue entry. Allocation just bumps a pointer, and everything
+ *     allocated since a mark is thrown away at once by releasing it.
+ *
  */
 
 #include "mymalloc.h"
@@ -44,6 +49,7 @@
 
 #include "conf.h"
 #include "dbdefs.h"
+#include "externs.h"
 #include "log.h"
 #include "memcheck.h"
 #include "strutil.h"
@@ -556,6 +562,147 @@ slab_describe(const slab *sl, struct slab_stats *stats)
   }
 }
 
+/** Size of a normal arena block. Requests bigger than this get a
+ * block of their own. */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+/** Blocks kept around when the arena is emptied */
+#define ARENA_KEEP_BLOCKS 4
+/** Alignment of arena allocations */
+#define ARENA_ALIGN 16
+
+/** One block of arena memory */
+struct arena_block {
+  struct arena_block *next; /**< Next block up the stack */
+  size_t size;              /**< Usable bytes in data */
+  int depth;                /**< Position of the block in the list */
+  char *data;               /**< The memory itself */
+};
+
+static struct arena_block *arena_first = NULL; /**< Bottom block */
+static struct arena_block *arena_cur = NULL;   /**< Block being allocated from */
+static size_t arena_used = 0; /**< Bytes in use in arena_cur */
+static int arena_max_depth = 0;
+static unsigned long arena_allocs = 0;
+static unsigned long arena_new_blocks = 0;
+
+/** Make a new arena block and link it in after arena_cur.
+ * \param size usable bytes wanted.
+ * \return the new block.
+ */
+static struct arena_block *
+arena_new_block(size_t size)
+{
+  struct arena_block *b, *after;
+  size_t hdr = (sizeof *b + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+  b = malloc(hdr + size);
+  if (!b)
+    mush_panic("Couldn't allocate arena block");
+  add_check("arena_block");
+  arena_new_blocks++;
+  b->size = size;
+  b->data = (char *) b + hdr;
+  if (arena_cur) {
+    b->next = arena_cur->next;
+    arena_cur->next = b;
+  } else {
+    b->next = arena_first;
+    arena_first = b;
+  }
+  for (after = b, b->depth = arena_cur ? arena_cur->depth + 1 : 1;
+       after->next; after = after->next)
+    after->next->depth = after->depth + 1;
+  return b;
+}
+
+/** Allocate temporary memory from the evaluation arena.
+ * The memory is not initialized, and can't be passed to mush_free().
+ * It stays valid until a mark taken before it is released, so a
+ * caller that wants it gone sooner should take its own mark.
+ * \param bytes bytes to allocate.
+ * \return pointer to the memory.
+ */
+void *
+arena_alloc(size_t bytes)
+{
+  struct arena_block *next;
+  void *p;
+
+  bytes = (bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  arena_allocs++;
+  if (!arena_cur || arena_used + bytes > arena_cur->size) {
+    next = arena_cur ? arena_cur->next : arena_first;
+    if (next && next->size >= bytes)
+      arena_cur = next;
+    else
+      arena_cur = arena_new_block(bytes > ARENA_BLOCK_SIZE ? bytes
+                                                           : ARENA_BLOCK_SIZE);
+    arena_used = 0;
+    if (arena_cur->depth > arena_max_depth)
+      arena_max_depth = arena_cur->depth;
+  }
+  p = arena_cur->data + arena_used;
+  arena_used += bytes;
+  return p;
+}
+
+/** Remember the current top of the evaluation arena.
+ * \return a mark to hand to arena_release().
+ */
+ARENA_MARK
+arena_mark(void)
+{
+  ARENA_MARK mark;
+  mark.block = arena_cur;
+  mark.used = arena_used;
+  return mark;
+}
+
+/** Free everything allocated from the arena since a mark was taken.
+ * Marks must be released in the reverse order they were taken.
+ * Blocks are kept for reuse, but when the arena is emptied all the
+ * way, any beyond the first few are given back.
+ * \param mark the mark to go back to.
+ */
+void
+arena_release(ARENA_MARK mark)
+{
+  struct arena_block *b, *next;
+  int n;
+
+  arena_cur = mark.block;
+  arena_used = mark.used;
+  if (arena_cur)
+    return;
+  for (b = arena_first, n = 1; b; b = next, n++) {
+    next = b->next;
+    if (n == ARENA_KEEP_BLOCKS)
+      b->next = NULL;
+    else if (n > ARENA_KEEP_BLOCKS) {
+      free(b);
+      del_check("arena_block", __FILE__, __LINE__);
+    }
+  }
+}
+
+/** Retrieve stats about the evaluation arena.
+ * \param stats where to put them.
+ */
+void
+arena_describe(struct arena_stats *stats)
+{
+  const struct arena_block *b;
+
+  memset(stats, 0, sizeof(*stats));
+  for (b = arena_first; b; b = b->next) {
+    stats->blocks++;
+    stats->size += b->size;
+  }
+  stats->max_blocks = arena_max_depth;
+  stats->allocs = arena_allocs;
+  stats->new_blocks = arena_new_blocks;
+}
+
 /** Return the memory page size */
 int
 mush_getpagesize(void)
@@ -355,7 +355,7 @@ make_socket(Port_t port, int socktype, union sockaddr_u *addr, socklen_t *len,
   freeaddrinfo(save);
   fprintf(stderr, "Listening on port %d using IPv%d.\n", port, ipv);
   fflush(stderr);
-  listen(s, 5);
+  listen(s, SOMAXCONN);
   return s;
 }
 
@@ -389,7 +389,7 @@ make_unix_socket(const char *filename, int socktype)
     return -1;
   }
 
-  if (listen(s, 5) < 0) {
+  if (listen(s, SOMAXCONN) < 0) {
     perror("listen");
     close(s);
     return -1;
@@ -651,6 +651,29 @@ make_blocking(int s)
 #endif
 }
 
+/** Accept a connection on a listening socket, and make the new socket
+ * nonblocking. Uses accept4() to do it in one system call if possible.
+ * \param s the listening socket.
+ * \param addr filled in with the address of the remote end.
+ * \param len the size of addr on input, and its used length on output.
+ * \return the new socket, or -1 on error.
+ */
+int
+accept_nonblocking(int s, struct sockaddr *addr, socklen_t *len)
+{
+  int newsock;
+
+#ifdef HAVE_ACCEPT4
+  newsock = accept4(s, addr, len, SOCK_NONBLOCK);
+#else
+  newsock = accept(s, addr, len);
+  if (newsock >= 0) {
+    make_nonblocking(newsock);
+  }
+#endif
+  return newsock;
+}
+
 /** Enable TCP keepalive on the given socket if we can.
  * \param s socket.
  * \param keepidle how often to send keepalive
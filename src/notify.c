@@ -75,6 +75,7 @@
 #include "strutil.h"
 #include "charconv.h"
 #include "websock.h"
+#include "mccp.h"
 
 extern CHAN *channels;
 
@@ -111,9 +112,31 @@ extern CHAN *channels;
 
 static const char flushed_message[] = "\r\n<Output Flushed>\x1B[0m\r\n";
 
+/** Size of the buffers that queued output is copied into. Consecutive
+ * messages share a buffer until it fills up. */
+#define OUTPUT_CHUNK_LEN 8192
+/** Shared payloads shorter than this are copied into the output buffers
+ * instead of being referenced, to keep lines together for writev(). */
+#define OUTPUT_SHARE_MIN 512
+
+/* Line endings and telnet GA shared by every output queue. These are never
+ * released by their owner, so the refcount never drops to zero. */
+static struct text_payload crlf_payload = {1, 2, "\r\n"};
+static struct text_payload lf_payload = {1, 1, "\n"};
+static struct text_payload br_payload = {1, 5, "<BR>\n"};
+static struct text_payload telnet_ga_payload = {1, 2, "\xFF\xF9"};
+
 extern DESC *descriptor_list;
 
 static struct text_block *make_text_block(const char *s, int n);
+static void append_to_queue(struct text_queue *q, const char *b, int n);
+static struct text_block *make_shared_text_block(struct text_payload *p,
+                                                 const char *s, int n);
+static struct text_payload *make_text_payload(const char *s, int n);
+static void release_text_payload(struct text_payload *p);
+static int queue_output(DESC *d, const char *b, int n,
+                        struct text_payload *p);
+static int queue_shared(DESC *d, struct text_payload *p);
 void free_text_block(struct text_block *t);
 void add_to_queue(struct text_queue *q, const char *b, int n);
 static int flush_queue(struct text_queue *q, int n);
@@ -125,6 +148,7 @@ int WIN32_CDECL queue_string_eol(DESC *d, const char *s, ...)
 int queue_eol(DESC *d);
 void freeqs(DESC *d);
 int process_output(DESC *d);
+void update_desc_interest(DESC *d);
 void init_text_queue(struct text_queue *q);
 
 static int str_type(const char *str);
@@ -279,6 +303,7 @@ struct notify_strings {
   char const *message; /**< The message text. */
   size_t len;          /**< Length of message. */
   int made;            /**< True if message has been rendered. */
+  struct text_payload *payload; /**< Shared copy for output queues */
 };
 
 /** A message, in every possible rendering */
@@ -317,6 +342,9 @@ static void make_prefix_str(dbref thing, dbref enactor, const char *msg,
 static const char *notify_makestring_real(struct notify_message *message,
                                           int output_type);
 static char *notify_makestring_nocache(const char *message, int output_type);
+static struct text_payload *notify_makepayload(struct notify_message *message,
+                                               int output_type);
+static void free_notify_message(struct notify_message *message, int first);
 
 #define notify_makestring(msg, ot) notify_makestring_real(msg, ot)
 
@@ -593,14 +621,17 @@ init_notify_message_group(struct notify_message_group *real_message)
     real_message->messages.strs[i].message = NULL;
     real_message->messages.strs[i].made = 0;
     real_message->messages.strs[i].len = 0;
+    real_message->messages.strs[i].payload = NULL;
 
     real_message->nospoofs.strs[i].message = NULL;
     real_message->nospoofs.strs[i].made = 0;
     real_message->nospoofs.strs[i].len = 0;
+    real_message->nospoofs.strs[i].payload = NULL;
 
     real_message->paranoids.strs[i].message = NULL;
     real_message->paranoids.strs[i].made = 0;
     real_message->paranoids.strs[i].len = 0;
+    real_message->paranoids.strs[i].payload = NULL;
   }
   real_message->messages.type = 0;
   real_message->nospoofs.type = 0;
@@ -997,6 +1028,46 @@ notify_makestring_nocache(const char *message, int output_type)
   return mush_strdup(render_string(message, output_type), "notify_str");
 }
 
+/** Render a message into a given format, and return a shared copy of it
+ * that can be put on any number of output queues without being copied
+ * again. The copy is cached alongside the rendered string.
+ * \param message a notify_message structure
+ * \param output_type MSG_* flags of how to render the message
+ * \return pointer to the cached payload
+ */
+static struct text_payload *
+notify_makepayload(struct notify_message *message, int output_type)
+{
+  struct notify_strings *ns;
+  const char *str;
+
+  str = notify_makestring(message, output_type);
+  if (output_type & MSG_PLAYER)
+    output_type = (output_type & (message->type | MSG_PLAYER));
+  ns = &message->strs[msg_to_na(output_type)];
+  if (!ns->payload)
+    ns->payload = make_text_payload(str, strlen(str));
+  return ns->payload;
+}
+
+/** Free the cached renderings of a message.
+ * \param message the notify_message to clean up
+ * \param first the first rendering owned by the message. strs[0] is
+ * sometimes a string belonging to the caller.
+ */
+static void
+free_notify_message(struct notify_message *message, int first)
+{
+  int i;
+
+  for (i = 0; i < MESSAGE_TYPES; i++) {
+    if (i >= first && message->strs[i].made)
+      mush_free((void *) message->strs[i].message, "notify_str");
+    if (message->strs[i].payload)
+      release_text_payload(message->strs[i].payload);
+  }
+}
+
 /* notify_except() is #define'd to notify_except2() */
 
 /** Notify all objects in a location, except 2, and propagate the sound.
@@ -1049,7 +1120,6 @@ notify_anything(dbref executor, dbref speaker, na_lookup func, void *fdata,
 {
   struct notify_message_group real_message;
   struct notify_message_group *real_message_pointer = NULL;
-  int i;
 
   /* If we have no message, or noone to notify, do nothing */
   if (!func || ((!message || !*message) && !(flags & NA_PROMPT)))
@@ -1078,14 +1148,9 @@ notify_anything(dbref executor, dbref speaker, na_lookup func, void *fdata,
   if (!message || !*message)
     return;
   /* Cleanup */
-  for (i = 0; i < MESSAGE_TYPES; i++) {
-    if (i && real_message.messages.strs[i].made)
-      mush_free((void *) real_message.messages.strs[i].message, "notify_str");
-    if (real_message.nospoofs.strs[i].made)
-      mush_free((void *) real_message.nospoofs.strs[i].message, "notify_str");
-    if (real_message.paranoids.strs[i].made)
-      mush_free((void *) real_message.paranoids.strs[i].message, "notify_str");
-  }
+  free_notify_message(&real_message.messages, 1);
+  free_notify_message(&real_message.nospoofs, 0);
+  free_notify_message(&real_message.paranoids, 0);
 }
 
 /** Notify one or more objects with a message.
@@ -1130,11 +1195,13 @@ notify_anything_sub(dbref executor, dbref speaker, na_lookup func, void *fdata,
     real_prefix->strs[0].message = prefix;
     real_prefix->strs[0].made = 1;
     real_prefix->strs[0].len = strlen(prefix);
+    real_prefix->strs[0].payload = NULL;
     real_prefix->type = str_type(prefix);
     for (i = 1; i < MESSAGE_TYPES; i++) {
       real_prefix->strs[i].message = NULL;
       real_prefix->strs[i].made = 0;
       real_prefix->strs[i].len = 0;
+      real_prefix->strs[i].payload = NULL;
     }
   }
   /* Tell everyone */
@@ -1154,12 +1221,7 @@ notify_anything_sub(dbref executor, dbref speaker, na_lookup func, void *fdata,
   }
 
   if (real_prefix != NULL) {
-    int i;
-
-    for (i = 1; i < MESSAGE_TYPES; i++) {
-      if (real_prefix->strs[i].made)
-        mush_free((void *) real_prefix->strs[i].message, "notify_str");
-    }
+    free_notify_message(real_prefix, 1);
     mush_free(real_prefix, "notify_message");
   }
 
@@ -1203,13 +1265,12 @@ notify_internal(dbref target, dbref executor, dbref speaker, dbref *skips,
                                      current target/descriptor */
   int last_output_type = -1; /**< For players, the way the msg was rendered for
                                 the previous descriptor */
-  const char *spoofstr =
-    NULL;           /**< Pointer to the rendered nospoof prefix to use */
   int spooflen = 0; /**< Length of the rendered nospoof prefix */
   const char *msgstr = NULL; /**< Pointer to the rendered message */
   int msglen = 0;            /**< Length of the rendered message */
   const char *prefixstr = NULL;
   int prefixlen = 0;
+  struct text_payload *spoofp = NULL, *msgp = NULL, *prefixp = NULL;
   static char buff[BUFFER_LEN],
     *bp; /**< Buffer used for processing the format attr */
   char *formatmsg =
@@ -1240,9 +1301,8 @@ notify_internal(dbref target, dbref executor, dbref speaker, dbref *skips,
   if (message == NULL) {
     if (!(flags & NA_PROMPT) || !IsPlayer(target))
       return;
-    for (d = descriptor_list; d; d = d->next) {
-      if (!d->connected || d->player != target ||
-          !(d->conn_flags & (CONN_TELNET | CONN_WEBSOCKETS)))
+    DESC_ITER_PLAYER (d, target) {
+      if (!d->connected || !(d->conn_flags & (CONN_TELNET | CONN_WEBSOCKETS)))
         continue;
 
       if (d->conn_flags & (CONN_WEBSOCKETS))
@@ -1320,16 +1380,17 @@ notify_internal(dbref target, dbref executor, dbref speaker, dbref *skips,
     /* Make sure the player is connected, and we have something to show him */
     if (Connected(target) && (heard || (flags & NA_PROMPT))) {
       /* Send text to the player's descriptors */
-      for (d = descriptor_list; d; d = d->next) {
-        if (!d->connected || d->player != target)
+      DESC_ITER_PLAYER (d, target) {
+        if (!d->connected)
           continue;
         output_type = notify_type(d);
 
         if (heard && prefix != NULL) {
           /* Figure out */
           if (!prefixstr || output_type != last_output_type) {
-            prefixstr = notify_makestring(prefix, output_type);
-            prefixlen = strlen(prefixstr);
+            prefixp = notify_makepayload(prefix, output_type);
+            prefixstr = prefixp->data;
+            prefixlen = prefixp->len;
           }
         } else {
           prefixlen = 0;
@@ -1348,8 +1409,8 @@ notify_internal(dbref target, dbref executor, dbref speaker, dbref *skips,
               message->paranoids.type =
                 str_type((const char *) message->paranoids.strs[0].message);
             }
-            spoofstr = notify_makestring(&message->paranoids, output_type);
-            spooflen = strlen(spoofstr);
+            spoofp = notify_makepayload(&message->paranoids, output_type);
+            spooflen = spoofp->len;
           } else {
             if (!message->nospoofs.strs[0].made) {
               message->nospoofs.strs[0].message = make_nospoof(speaker, 0);
@@ -1359,8 +1420,8 @@ notify_internal(dbref target, dbref executor, dbref speaker, dbref *skips,
               message->nospoofs.type =
                 str_type((const char *) message->nospoofs.strs[0].message);
             }
-            spoofstr = notify_makestring(&message->nospoofs, output_type);
-            spooflen = strlen(spoofstr);
+            spoofp = notify_makepayload(&message->nospoofs, output_type);
+            spooflen = spoofp->len;
           }
         } else {
           spooflen = 0;
@@ -1374,7 +1435,8 @@ notify_internal(dbref target, dbref executor, dbref speaker, dbref *skips,
         if (heard) {
           if (!msgstr || output_type != last_output_type) {
             if (cache) {
-              msgstr = notify_makestring(&message->messages, output_type);
+              msgp = notify_makepayload(&message->messages, output_type);
+              msgstr = msgp->data;
             } else {
               if (formatmsg)
                 mush_free(formatmsg, "notify_str");
@@ -1386,18 +1448,23 @@ notify_internal(dbref target, dbref executor, dbref speaker, dbref *skips,
 
           if (msglen) {
             if (prefixlen) /* send prefix */
-              queue_newwrite(d, prefixstr, prefixlen);
+              queue_shared(d, prefixp);
             if (spooflen) /* send nospoof prefix */
-              queue_newwrite(d, spoofstr, spooflen);
+              queue_shared(d, spoofp);
 
             if (prompt) { /* send prompt */
               if (d->conn_flags & CONN_WEBSOCKETS) {
                 queue_newwrite_channel(d, msgstr, msglen,
                                        WEBSOCKET_CHANNEL_PROMPT);
               } else {
-                queue_newwrite(d, msgstr, msglen); /* send message */
-                queue_newwrite(d, "\xFF\xF9", 2);
+                if (cache)
+                  queue_shared(d, msgp);
+                else
+                  queue_newwrite(d, msgstr, msglen); /* send message */
+                queue_shared(d, &telnet_ga_payload);
               }
+            } else if (cache) {
+              queue_shared(d, msgp); /* send message */
             } else {
               queue_newwrite(d, msgstr, msglen); /* send message */
             }
@@ -1409,11 +1476,11 @@ notify_internal(dbref target, dbref executor, dbref speaker, dbref *skips,
           /* send lineending */
           if ((output_type & MSG_PUEBLO)) {
             if (flags & NA_NOPENTER)
-              queue_newwrite(d, "\n", 1);
+              queue_shared(d, &lf_payload);
             else
-              queue_newwrite(d, "<BR>\n", 5);
+              queue_shared(d, &br_payload);
           } else {
-            queue_newwrite(d, "\r\n", 2);
+            queue_shared(d, &crlf_payload);
           }
         }
       } /* for loop */
@@ -1727,13 +1794,27 @@ flag_broadcast(const char *flag1, const char *flag2, const char *fmt, ...)
 {
   va_list args;
   char tbuf1[BUFFER_LEN];
+  struct notify_message message;
   DESC *d;
-  int ok;
+  int ok, i;
 
   va_start(args, fmt);
   mush_vsnprintf(tbuf1, sizeof tbuf1, fmt, args);
   va_end(args);
 
+  /* Render the message once per output type and share it between
+   * descriptors */
+  for (i = 0; i < MESSAGE_TYPES; i++) {
+    message.strs[i].message = NULL;
+    message.strs[i].made = 0;
+    message.strs[i].len = 0;
+    message.strs[i].payload = NULL;
+  }
+  message.strs[0].message = tbuf1;
+  message.strs[0].made = 1;
+  message.strs[0].len = strlen(tbuf1);
+  message.type = str_type(tbuf1);
+
   DESC_ITER_CONN (d) {
     ok = 1;
     if (flag1)
@@ -1741,16 +1822,19 @@ flag_broadcast(const char *flag1, const char *flag2, const char *fmt, ...)
     if (flag2)
       ok = ok && (flaglist_check_long("FLAG", GOD, d->player, flag2, 0) == 1);
     if (ok) {
-      queue_string_eol(d, "%s", tbuf1);
+      queue_shared(d, notify_makepayload(&message, notify_type(d)));
+      queue_eol(d);
       process_output(d);
     }
   }
+  free_notify_message(&message, 1);
 }
 
 slab *text_block_slab = NULL; /**< Slab for 'struct text_block' allocations */
+struct output_stats output_stats; /**< Output queue counters */
 
 static struct text_block *
-make_text_block(const char *s, int n)
+alloc_text_block(void)
 {
   struct text_block *p;
   if (text_block_slab == NULL) {
@@ -1762,6 +1846,19 @@ make_text_block(const char *s, int n)
   p = slab_malloc(text_block_slab, NULL);
   if (!p)
     mush_panic("Out of memory");
+  p->nxt = NULL;
+  p->buf = NULL;
+  p->size = 0;
+  p->payload = NULL;
+  return p;
+}
+
+static struct text_block *
+make_text_block(const char *s, int n)
+{
+  struct text_block *p;
+
+  p = alloc_text_block();
   p->buf = mush_malloc(n, "text_block_buff");
   if (!p->buf)
     mush_panic("Out of memory");
@@ -1769,10 +1866,64 @@ make_text_block(const char *s, int n)
   memcpy(p->buf, s, n);
   p->nchars = n;
   p->start = p->buf;
-  p->nxt = NULL;
   return p;
 }
 
+/** Make a text block that refers to part of a shared payload instead of
+ * holding its own copy.
+ * \param p the payload.
+ * \param s start of the text to queue, somewhere in p->data.
+ * \param n length of the text to queue.
+ * \return a new text block holding a reference to p.
+ */
+static struct text_block *
+make_shared_text_block(struct text_payload *p, const char *s, int n)
+{
+  struct text_block *t;
+
+  t = alloc_text_block();
+  output_stats.blocks += 1;
+  p->refcount += 1;
+  t->payload = p;
+  t->start = (char *) s;
+  t->nchars = n;
+  return t;
+}
+
+/** Copy text into a new shared payload with a refcount of 1.
+ * \param s text to copy.
+ * \param n length of s.
+ * \return the new payload.
+ */
+static struct text_payload *
+make_text_payload(const char *s, int n)
+{
+  struct text_payload *p;
+  char *data;
+
+  p = mush_malloc(sizeof *p + n + 1, "text_payload");
+  if (!p)
+    mush_panic("Out of memory");
+  data = (char *) (p + 1);
+  memcpy(data, s, n);
+  data[n] = '\0';
+  p->refcount = 1;
+  p->len = n;
+  p->data = data;
+  return p;
+}
+
+/** Drop a reference to a shared payload, freeing it when the last
+ * reference goes away.
+ * \param p the payload.
+ */
+static void
+release_text_payload(struct text_payload *p)
+{
+  if (--p->refcount == 0)
+    mush_free(p, "text_payload");
+}
+
 /** Free a text_block structure.
  * \param t pointer to text_block to free.
  */
@@ -1780,7 +1931,9 @@ void
 free_text_block(struct text_block *t)
 {
   if (t) {
-    if (t->buf)
+    if (t->payload)
+      release_text_payload(t->payload);
+    else if (t->buf)
       mush_free(t->buf, "text_block_buff");
     slab_free(text_block_slab, t);
   }
@@ -1820,19 +1973,79 @@ add_to_queue(struct text_queue *q, const char *b, int n)
   }
 }
 
+/** Add text to the end of an output queue, copying it into the space left
+ * in the last block if it fits there, or into a new buffer big enough to
+ * take several more messages if it doesn't. A message is never split
+ * between two blocks, so that flush_queue() can drop whole messages.
+ * \param q pointer to text_queue to add the text to.
+ * \param b text to add to the queue.
+ * \param n length of text to add.
+ */
+static void
+append_to_queue(struct text_queue *q, const char *b, int n)
+{
+  struct text_block *p = q->tail;
+
+  if (n == 0)
+    return;
+
+  if (p && p->size && p->size - (p->start - p->buf) - p->nchars >= n) {
+    memcpy(p->start + p->nchars, b, n);
+    p->nchars += n;
+    return;
+  }
+
+  p = alloc_text_block();
+  p->size = n > OUTPUT_CHUNK_LEN ? n : OUTPUT_CHUNK_LEN;
+  p->buf = mush_malloc(p->size, "text_block_buff");
+  if (!p->buf)
+    mush_panic("Out of memory");
+  output_stats.blocks += 1;
+  output_stats.buffers += 1;
+  memcpy(p->buf, b, n);
+  p->nchars = n;
+  p->start = p->buf;
+
+  if (!q->head)
+    q->head = q->tail = p;
+  else {
+    q->tail->nxt = p;
+    q->tail = p;
+  }
+}
+
+/** Has part of a text block already been written to the socket?
+ * \param p the text block.
+ * \retval true the start of the block has been sent.
+ * \retval false none of the block has been sent.
+ */
+static bool
+text_block_started(struct text_block *p)
+{
+  if (p->payload)
+    return p->start != p->payload->data;
+  return p->start != p->buf;
+}
+
 static int
 flush_queue(struct text_queue *q, int n)
 {
-  struct text_block *p;
+  struct text_block *p, **pp;
   int really_flushed = 0, flen;
 
   flen = strlen(flushed_message);
   n += flen;
 
-  while (n > 0 && (p = q->head)) {
+  /* A block that's been partly written stays, so that the client never
+   * sees half a message (or half a websocket frame). */
+  pp = &q->head;
+  if (*pp && text_block_started(*pp))
+    pp = &(*pp)->nxt;
+
+  while (n > 0 && (p = *pp)) {
     n -= p->nchars;
     really_flushed += p->nchars;
-    q->head = p->nxt;
+    *pp = p->nxt;
     if (q->tail == p)
       q->tail = NULL;
 #ifdef DEBUG
@@ -1841,10 +2054,12 @@ flush_queue(struct text_queue *q, int n)
     free_text_block(p);
   }
   p = make_text_block(flushed_message, flen);
-  p->nxt = q->head;
-  q->head = p;
+  p->nxt = *pp;
+  *pp = p;
   if (!q->tail)
     q->tail = p;
+  else if (q->tail->nxt == p)
+    q->tail = p;
   really_flushed -= p->nchars;
   return really_flushed;
 }
@@ -1934,8 +2149,6 @@ int
 queue_newwrite_channel(DESC *d, const char *b, int n, char ch)
 #endif /* undef WITHOUT_WEBSOCKETS */
 {
-  int space;
-
   char *utf8 = NULL;
 
   if (d->conn_flags & CONN_SOCKET_ERROR)
@@ -1956,45 +2169,50 @@ queue_newwrite_channel(DESC *d, const char *b, int n, char ch)
    */
   if ((d->conn_flags & CONN_WEBSOCKETS)) {
     /* TODO: Uses a static buffer; probably safe in this case. */
-    to_websocket_frame(&b, &n, ch);
+    to_websocket_frame(d, &b, &n, ch);
   }
 #endif /* undef WITHOUT_WEBSOCKETS */
 
-  if (d->source != CS_OPENSSL_SOCKET && !d->output.head) {
-    /* If there's no data already buffered to write out, try writing
-       directly to the socket. Add whatever's left to the buffer to
-       queue for later. */
-    int written;
-
-    if ((written = send(d->descriptor, b, n, 0)) > 0) {
-      /* do_rawlog(LT_TRACE, "Wrote %d bytes directly.", written); */
-      d->output_chars += written;
-      if (written == n) {
-        if (utf8)
-          mush_free(utf8, "string");
-        return written;
-      }
-      n -= written;
-      b += written;
-    } else if (written < 0) {
-      if (!is_blocking_err(errno)) {
-        /* Ignore cases where the socket can't handle any bytes before blocking,
-         * report
-         * and fail on other errors.
-         */
-        do_rawlog(
-          LT_TRACE,
-          "send() returned %d (error %s) trying to write %d bytes to %d",
-          written, strerror(errno), n, d->descriptor);
-        d->conn_flags |= CONN_SOCKET_ERROR;
-        if (utf8)
-          mush_free(utf8, "string");
-        return 0;
-      }
-    } else { /* written == 0 */
-      do_rawlog(LT_TRACE, "send() wrote no bytes to %d", d->descriptor);
-    }
-  }
+  n = queue_output(d, b, n, NULL);
+  if (utf8)
+    mush_free(utf8, "string");
+  return n;
+}
+
+/** Add a shared, already-rendered payload to a descriptor's output queue.
+ * If the descriptor needs the text rewritten first (UTF-8 or websocket
+ * framing), this falls back to queue_newwrite() and makes a private copy;
+ * otherwise the queued block just takes a reference to the payload, unless
+ * it's short enough to be copied alongside the rest of the queued text.
+ * \param d pointer to descriptor to receive the text.
+ * \param p the payload to send.
+ * \return number of characters added.
+ */
+static int
+queue_shared(DESC *d, struct text_payload *p)
+{
+  if (d->conn_flags & CONN_SOCKET_ERROR)
+    return 0;
+  if (d->conn_flags & (CONN_UTF8 | CONN_WEBSOCKETS))
+    return queue_newwrite(d, p->data, p->len);
+  return queue_output(d, p->data, p->len, p);
+}
+
+/** Queue text to be written to a descriptor. The text isn't sent
+ * straight away: process_output() writes everything queued so far once
+ * the main loop gets back to the descriptor, so a burst of messages goes
+ * out in a few large writes instead of one send() per message.
+ * \param d pointer to descriptor to receive the text.
+ * \param b text to send, already in its final on-the-wire form.
+ * \param n length of b.
+ * \param p payload that b points into, or NULL to queue a private copy.
+ * \return number of characters added, or 0 on a socket error.
+ */
+static int
+queue_output(DESC *d, const char *b, int n, struct text_payload *p)
+{
+  int space;
+  bool was_empty;
 
   /* do_rawlog(LT_TRACE, "Queuing %d bytes.", n); */
 
@@ -2003,6 +2221,16 @@ queue_newwrite_channel(DESC *d, const char *b, int n, char ch)
     process_output(d);
     space = MAX_OUTPUT - d->output_size - n;
     if (space < 0) {
+#ifdef HAVE_LIBZ
+      if (MCCP_OUT(d)) {
+        mccp_overflow(d, flushed_message, strlen(flushed_message));
+        return 0;
+      }
+#ifndef WITHOUT_WEBSOCKETS
+      if (ws_deflate_overflow(d))
+        return 0;
+#endif
+#endif
 #ifdef HAVE_SSL
       if (d->ssl) {
         /* Now we have a problem, as SSL works in blocks and you can't
@@ -2014,10 +2242,21 @@ queue_newwrite_channel(DESC *d, const char *b, int n, char ch)
         d->output_size -= flush_queue(&d->output, -space);
     }
   }
-  add_to_queue(&d->output, b, n);
+  was_empty = !d->output.head;
+  if (p && n >= OUTPUT_SHARE_MIN) {
+    struct text_block *t = make_shared_text_block(p, b, n);
+
+    if (was_empty)
+      d->output.head = d->output.tail = t;
+    else {
+      d->output.tail->nxt = t;
+      d->output.tail = t;
+    }
+  } else
+    append_to_queue(&d->output, b, n);
   d->output_size += n;
-  if (utf8)
-    mush_free(utf8, "string");
+  if (was_empty)
+    update_desc_interest(d);
   return n;
 }
 
@@ -2029,9 +2268,9 @@ int
 queue_eol(DESC *d)
 {
   if ((d->conn_flags & CONN_HTML))
-    return queue_newwrite(d, "<BR>\n", 5);
+    return queue_shared(d, &br_payload);
   else
-    return queue_newwrite(d, "\r\n", 2);
+    return queue_shared(d, &crlf_payload);
 }
 
 /** Add a string and an end-of-line to a descriptor's text queue.
@@ -2072,6 +2311,19 @@ queue_string(DESC *d, const char *s)
   return ret;
 }
 
+/** Show output queue statistics, for \@stats/net.
+ * \param player the enactor.
+ */
+void
+output_queue_stats(dbref player)
+{
+  notify_format(player,
+                T("Output: %lu bytes in %lu writes. %lu blocks queued, using "
+                  "%lu buffers."),
+                output_stats.bytes, output_stats.sends, output_stats.blocks,
+                output_stats.buffers);
+}
+
 /** Free all text queues associated with a descriptor.
  * \param d pointer to descriptor.
  */
@@ -37,6 +37,8 @@
 #include "mymalloc.h"
 #include "mypcre.h"
 #include "notify.h"
+#include "pecode.h"
+#include "profile.h"
 #include "strtree.h"
 #include "strutil.h"
 
@@ -728,18 +730,30 @@ parse_uint64(const char *s, char **end, int base)
 
 /** PE_REGS: Named Q-registers. We have two strtrees: One for names,
  * one for values.
+ *
+ * Register names are always interned in pe_reg_names, so two registers
+ * with the same name share a pointer, and looking one up compares
+ * pointers instead of strings. A name that isn't in the tree can't be
+ * set anywhere, which makes misses cheap.
  */
 StrTree pe_reg_names;
 StrTree pe_reg_vals;
 
-/* Slabs for PE_REGS and PE_REG_VALs */
+/* Slabs for PE_REGS, their tables and PE_REG_VALs */
 slab *pe_reg_slab;
+slab *pe_reg_tab_slab;
 slab *pe_reg_val_slab;
 
 /* Lame speed-up so we don't constantly call tprintf :D */
 static const char *envid[10] = {"0", "1", "2", "3", "4",
                                 "5", "6", "7", "8", "9"};
 
+/* Interned names of the single-character registers, 0-9 and A-Z */
+static const char *pe_reg_charnames[UCHAR_MAX + 1];
+
+/* Tables with this many values get a hash index */
+#define PE_REGS_HASH_MIN 8
+
 void
 init_pe_regs_trees()
 {
@@ -747,6 +761,7 @@ init_pe_regs_trees()
   char qv[2] = "0";
 
   pe_reg_slab = slab_create("PE_REGS", sizeof(PE_REGS));
+  pe_reg_tab_slab = slab_create("PE_REG_TAB", sizeof(PE_REG_TAB));
   pe_reg_val_slab = slab_create("PE_REG_VAL", sizeof(PE_REG_VAL));
 
   st_init(&pe_reg_names, "pe_reg_names");
@@ -758,11 +773,11 @@ init_pe_regs_trees()
    */
   for (i = 0; i < 10; i++) {
     qv[0] = '0' + i;
-    st_insert(qv, &pe_reg_names);
+    pe_reg_charnames[(unsigned char) qv[0]] = st_insert(qv, &pe_reg_names);
   }
   for (i = 0; i < 26; i++) {
     qv[0] = 'A' + i;
-    st_insert(qv, &pe_reg_names);
+    pe_reg_charnames[(unsigned char) qv[0]] = st_insert(qv, &pe_reg_names);
   }
 }
 
@@ -805,7 +820,9 @@ pe_regs_dump(PE_REGS *pe_regs, dbref who)
       notify_format(who, "NULL pe_regs type found?! Quitting.");
       break;
     }
-    for (val = pe_regs->vals; val; val = val->next) {
+    if (pe_regs->tab && pe_regs->tab->refcount > 1)
+      notify_format(who, " (shared by %d)", pe_regs->tab->refcount);
+    for (val = PE_REGS_VALS(pe_regs); val; val = val->next) {
       if (val->type & PE_REGS_STR) {
         notify_format(who, " %.2X(%.2X) %-10s: %s", val->type & 0xFF,
                       (val->type & 0xFFFF00) >> 8, val->name, val->val.sval);
@@ -833,10 +850,8 @@ pe_regs_create_real(int pr_flags, const char *name)
   ADD_CHECK(name);
 
   pe_regs->name = name;
-  pe_regs->qcount = 0;
-  pe_regs->count = 0;
   pe_regs->flags = pr_flags;
-  pe_regs->vals = NULL;
+  pe_regs->tab = NULL;
   pe_regs->prev = NULL;
   return pe_regs;
 }
@@ -866,6 +881,183 @@ pe_reg_val_free(PE_REG_VAL *val)
   DEL_CHECK("pe_reg_val_slab");
 }
 
+/** Is the given key a named register (not A-Z or 0-9)?
+ */
+bool
+is_named_register(const char *key)
+{
+  if (!key || !*key)
+    return 1;
+
+  if (key[1] != '\0')
+    return 1;
+
+  if ((key[0] >= 'a' && key[0] <= 'z') || (key[0] >= 'A' && key[0] <= 'Z') ||
+      (key[0] >= '0' && key[0] <= '9'))
+    return 0;
+
+  return 1;
+}
+
+/* Find the interned copy of an upper-cased register name, or NULL if
+ * no register has that name. */
+static const char *
+pe_reg_intern(const char *key)
+{
+  if (key[0] && !key[1] && pe_reg_charnames[(unsigned char) key[0]])
+    return pe_reg_charnames[(unsigned char) key[0]];
+  return st_find(key, &pe_reg_names);
+}
+
+static inline uint32_t
+pe_reg_hash(const char *name)
+{
+  uint32_t h = (uint32_t) ((uintptr_t) name >> 4);
+
+  h ^= h >> 16;
+  h *= 0x45d9f3b;
+  h ^= h >> 16;
+  return h;
+}
+
+static void
+pe_reg_tab_unhash(PE_REG_TAB *tab)
+{
+  if (tab->hash) {
+    mush_free(tab->hash, "pe_reg_hash");
+    tab->hash = NULL;
+    tab->hsize = 0;
+  }
+}
+
+static void
+pe_reg_hash_insert(PE_REG_TAB *tab, PE_REG_VAL *val)
+{
+  uint32_t mask = tab->hsize - 1;
+  uint32_t h;
+
+  for (h = pe_reg_hash(val->name) & mask; tab->hash[h]; h = (h + 1) & mask)
+    ;
+  tab->hash[h] = val;
+}
+
+/* (Re)build a table's hash index, at no more than 1/4 full. Vals are
+ * inserted newest first, so a probe meets them in the same order as a
+ * walk of the list would. */
+static void
+pe_reg_tab_rehash(PE_REG_TAB *tab)
+{
+  PE_REG_VAL *val;
+  int size = 16;
+
+  while (size < tab->count * 4)
+    size <<= 1;
+  pe_reg_tab_unhash(tab);
+  tab->hash = mush_calloc(size, sizeof(PE_REG_VAL *), "pe_reg_hash");
+  tab->hsize = size;
+  for (val = tab->vals; val; val = val->next)
+    pe_reg_hash_insert(tab, val);
+}
+
+/* Find a value in a single PE_REGS, by interned name. */
+static PE_REG_VAL *
+pe_regs_find(PE_REGS *pe_regs, int type, const char *name)
+{
+  PE_REG_TAB *tab = pe_regs->tab;
+  PE_REG_VAL *val;
+  uint32_t mask, h;
+
+  if (!tab || !name)
+    return NULL;
+  if (!tab->hash && tab->count >= PE_REGS_HASH_MIN)
+    pe_reg_tab_rehash(tab);
+  if (tab->hash) {
+    mask = tab->hsize - 1;
+    for (h = pe_reg_hash(name) & mask; (val = tab->hash[h]);
+         h = (h + 1) & mask) {
+      if (val->name == name && (val->type & type & PE_REGS_TYPE))
+        return val;
+    }
+    return NULL;
+  }
+  for (val = tab->vals; val; val = val->next) {
+    if (val->name == name && (val->type & type & PE_REGS_TYPE))
+      return val;
+  }
+  return NULL;
+}
+
+static PE_REG_TAB *
+pe_reg_tab_new(void)
+{
+  PE_REG_TAB *tab = slab_malloc(pe_reg_tab_slab, NULL);
+  ADD_CHECK("pe_reg_tab_slab");
+
+  tab->refcount = 1;
+  tab->count = 0;
+  tab->qcount = 0;
+  tab->hsize = 0;
+  tab->hash = NULL;
+  tab->vals = NULL;
+  return tab;
+}
+
+/* Drop a reference to a table, freeing it when it's no longer used. */
+static void
+pe_reg_tab_release(PE_REG_TAB *tab)
+{
+  PE_REG_VAL *val, *next;
+
+  if (--tab->refcount > 0)
+    return;
+  for (val = tab->vals; val; val = next) {
+    next = val->next;
+    pe_reg_val_free(val);
+  }
+  pe_reg_tab_unhash(tab);
+  slab_free(pe_reg_tab_slab, tab);
+  DEL_CHECK("pe_reg_tab_slab");
+}
+
+/* Get a table of pe_regs's values that is safe to change, copying them
+ * first if the table is shared with another PE_REGS. */
+static PE_REG_TAB *
+pe_regs_writable(PE_REGS *pe_regs)
+{
+  PE_REG_TAB *tab = pe_regs->tab;
+  PE_REG_TAB *copy;
+  PE_REG_VAL *val, *nval, **tail;
+
+  if (!tab) {
+    pe_regs->tab = pe_reg_tab_new();
+    return pe_regs->tab;
+  }
+  if (tab->refcount == 1)
+    return tab;
+
+  copy = pe_reg_tab_new();
+  tail = &copy->vals;
+  for (val = tab->vals; val; val = val->next) {
+    nval = slab_malloc(pe_reg_val_slab, NULL);
+    ADD_CHECK("pe_reg_val_slab");
+    *nval = *val;
+    nval->name = st_insert(val->name, &pe_reg_names);
+    ADD_CHECK("pe_reg_val-name");
+    if ((val->type & PE_REGS_STR) && !(val->type & PE_REGS_NOCOPY)) {
+      nval->val.sval = st_insert(val->val.sval, &pe_reg_vals);
+      ADD_CHECK("pe_reg_val-val");
+    }
+    nval->next = NULL;
+    *tail = nval;
+    tail = &nval->next;
+  }
+  copy->count = tab->count;
+  copy->qcount = tab->qcount;
+  tab->refcount--;
+  pe_regs->tab = copy;
+  return copy;
+}
+
 /** Free all values from a PE_REGS context.
  *
  * \param pe_regs The pe_regs to clear
@@ -873,17 +1065,10 @@ pe_reg_val_free(PE_REG_VAL *val)
 void
 pe_regs_clear(PE_REGS *pe_regs)
 {
-  PE_REG_VAL *val = pe_regs->vals;
-  PE_REG_VAL *next;
-
-  while (val) {
-    next = val->next;
-    pe_reg_val_free(val);
-    val = next;
+  if (pe_regs->tab) {
+    pe_reg_tab_release(pe_regs->tab);
+    pe_regs->tab = NULL;
   }
-  pe_regs->count = 0;
-  pe_regs->qcount = 0;
-  pe_regs->vals = NULL;
 }
 
 /** Free all values of a specific type from a PE_REGS context.
@@ -894,18 +1079,27 @@ pe_regs_clear(PE_REGS *pe_regs)
 void
 pe_regs_clear_type(PE_REGS *pe_regs, int type)
 {
-  PE_REG_VAL *val = pe_regs->vals;
+  PE_REG_TAB *tab;
+  PE_REG_VAL *val;
   PE_REG_VAL *next;
   PE_REG_VAL *prev = NULL;
 
+  if (!pe_regs->tab)
+    return;
+  tab = pe_regs_writable(pe_regs);
+  pe_reg_tab_unhash(tab);
+  val = tab->vals;
   while (val) {
     next = val->next;
     if (val->type & type) {
       if (prev) {
         prev->next = next;
       } else {
-        pe_regs->vals = next;
+        tab->vals = next;
       }
+      tab->count--;
+      if ((val->type & PE_REGS_Q) && is_named_register(val->name))
+        tab->qcount--;
       pe_reg_val_free(val);
     } else {
       prev = val;
@@ -954,32 +1148,49 @@ pe_regs_restore(NEW_PE_INFO *pe_info, PE_REGS *pe_regs)
   pe_info->regvals = pe_regs->prev;
 }
 
-#define FIND_PVAL(pval, key, type)                                             \
-  do {                                                                         \
-    if (!pval)                                                                 \
-      break;                                                                   \
-    if ((pval->type & type & PE_REGS_TYPE) && !strcmp(pval->name, key)) {      \
-      break;                                                                   \
-    }                                                                          \
-    pval = pval->next;                                                         \
-  } while (pval)
-
-/** Is the given key a named register (not A-Z or 0-9)?
- */
-bool
-is_named_register(const char *key)
+/* Find or add the val that pe_regs_set() and pe_regs_set_int() fill in,
+ * freeing any old value it has. Returns NULL if the register exists
+ * and override is false. */
+static PE_REG_VAL *
+pe_regs_slot(PE_REGS *pe_regs, int type, const char *lckey, int override)
 {
-  if (!key || !*key)
-    return 1;
-
-  if (key[1] != '\0')
-    return 1;
-
-  if ((key[0] >= 'a' && key[0] <= 'z') || (key[0] >= 'A' && key[0] <= 'Z') ||
-      (key[0] >= '0' && key[0] <= '9'))
-    return 0;
+  PE_REG_TAB *tab;
+  PE_REG_VAL *pval;
+  const char *name;
+  char key[PE_KEY_LEN];
 
-  return 1;
+  strupper_r(lckey, key, sizeof key);
+  name = pe_reg_intern(key);
+  if (!override && pe_regs_find(pe_regs, type, name))
+    return NULL;
+  tab = pe_regs_writable(pe_regs);
+  pval = pe_regs_find(pe_regs, type, name);
+  if (pval) {
+    /* Delete its value */
+    pe_reg_val_free_val(pval);
+    return pval;
+  }
+
+  pval = slab_malloc(pe_reg_val_slab, NULL);
+  ADD_CHECK("pe_reg_val_slab");
+  pval->name = st_insert(key, &pe_reg_names);
+  ADD_CHECK("pe_reg_val-name");
+  pval->type = type;
+  pval->next = tab->vals;
+  tab->vals = pval;
+  tab->count++;
+  if (type & PE_REGS_Q) {
+    if (is_named_register(key)) {
+      tab->qcount++;
+    }
+  }
+  if (tab->hash) {
+    if (tab->count * 2 > tab->hsize)
+      pe_reg_tab_rehash(tab);
+    else
+      pe_reg_hash_insert(tab, pval);
+  }
+  return pval;
 }
 
 /** Set a string value in a PE_REGS structure.
@@ -1000,36 +1211,17 @@ pe_regs_set_if(PE_REGS *pe_regs, int type, const char *lckey, const char *val,
 {
   /* pe_regs_set is authoritative: it ignores flags set on the PE_REGS,
    * it doesn't recurse up the chain, etc. */
-  PE_REG_VAL *pval = pe_regs->vals;
-  char key[PE_KEY_LEN];
+  PE_REG_VAL *pval;
   static const char noval[] = "";
-  strupper_r(lckey, key, sizeof key);
-  FIND_PVAL(pval, key, type);
   if (!(type & PE_REGS_NOCOPY)) {
     if (!val || !val[0]) {
       val = noval;
       type |= PE_REGS_NOCOPY;
     }
   }
-  if (pval) {
-    if (!override)
-      return;
-    /* Delete its value */
-    pe_reg_val_free_val(pval);
-  } else {
-    pval = slab_malloc(pe_reg_val_slab, NULL);
-    ADD_CHECK("pe_reg_val_slab");
-    pval->name = st_insert(key, &pe_reg_names);
-    ADD_CHECK("pe_reg_val-name");
-    pval->next = pe_regs->vals;
-    pe_regs->vals = pval;
-    pe_regs->count++;
-    if (type & PE_REGS_Q) {
-      if (is_named_register(key)) {
-        pe_regs->qcount++;
-      }
-    }
-  }
+  pval = pe_regs_slot(pe_regs, type, lckey, override);
+  if (!pval)
+    return;
   if (type & PE_REGS_NOCOPY) {
     pval->type = type | PE_REGS_STR;
     pval->val.sval = val;
@@ -1056,39 +1248,28 @@ void
 pe_regs_set_int_if(PE_REGS *pe_regs, int type, const char *lckey, int val,
                    int override)
 {
-  PE_REG_VAL *pval = pe_regs->vals;
-  char key[PE_KEY_LEN];
-  strupper_r(lckey, key, sizeof key);
-  FIND_PVAL(pval, key, type);
-  if (pval) {
-    if (!override)
-      return;
-    pe_reg_val_free_val(pval);
-  } else {
-    pval = slab_malloc(pe_reg_val_slab, NULL);
-    ADD_CHECK("pe_reg_val_slab");
-    pval->name = st_insert(key, &pe_reg_names);
-    ADD_CHECK("pe_reg_val-name");
-    pval->next = pe_regs->vals;
-    pe_regs->vals = pval;
-    pe_regs->count++;
-    if (type & PE_REGS_Q) {
-      if (is_named_register(key)) {
-        pe_regs->qcount++;
-      }
-    }
-  }
+  PE_REG_VAL *pval = pe_regs_slot(pe_regs, type, lckey, override);
+  if (!pval)
+    return;
   pval->type = type | PE_REGS_INT;
   pval->val.ival = val;
 }
 
-const char *
-pe_regs_get(PE_REGS *pe_regs, int type, const char *lckey)
+/* Look up a register in one PE_REGS, by upper-cased name. */
+static PE_REG_VAL *
+pe_regs_lookup(PE_REGS *pe_regs, int type, const char *lckey)
 {
-  PE_REG_VAL *pval = pe_regs->vals;
   char key[PE_KEY_LEN];
+
+  if (!pe_regs->tab)
+    return NULL;
   strupper_r(lckey, key, sizeof key);
-  FIND_PVAL(pval, key, type);
+  return pe_regs_find(pe_regs, type, pe_reg_intern(key));
+}
+
+static const char *
+pe_reg_val_str(PE_REG_VAL *pval)
+{
   if (!pval)
     return NULL;
   if (pval->type & PE_REGS_STR) {
@@ -1099,6 +1280,12 @@ pe_regs_get(PE_REGS *pe_regs, int type, const char *lckey)
   return NULL;
 }
 
+const char *
+pe_regs_get(PE_REGS *pe_regs, int type, const char *lckey)
+{
+  return pe_reg_val_str(pe_regs_lookup(pe_regs, type, lckey));
+}
+
 /** Get a typed value from a pe_regs structure, returned as an integer.
  *
  * \param pe_regs The PE_REGS to fetch from.
@@ -1108,10 +1295,7 @@ pe_regs_get(PE_REGS *pe_regs, int type, const char *lckey)
 int
 pe_regs_get_int(PE_REGS *pe_regs, int type, const char *lckey)
 {
-  PE_REG_VAL *pval = pe_regs->vals;
-  char key[PE_KEY_LEN];
-  strupper_r(lckey, key, sizeof key);
-  FIND_PVAL(pval, key, type);
+  PE_REG_VAL *pval = pe_regs_lookup(pe_regs, type, lckey);
   if (!pval)
     return 0;
   if (pval->type & PE_REGS_STR) {
@@ -1122,6 +1306,49 @@ pe_regs_get_int(PE_REGS *pe_regs, int type, const char *lckey)
   return 0;
 }
 
+/* Copying a stack of PE_REGS into an empty one can just share a table
+ * when only one PE_REGS in the stack has anything to copy, and all of
+ * its values would be copied unchanged. Values that don't own their
+ * strings (NOCOPY) and the renumbered iter and switch values rule it
+ * out. */
+static bool
+pe_regs_share(PE_REGS *new_regs, PE_REGS *pe_regs, int copytypes,
+              bool argstop)
+{
+  PE_REGS *source = NULL;
+  PE_REG_VAL *val;
+  bool some, all;
+
+  if (new_regs->tab && new_regs->tab->count)
+    return 0;
+  for (; pe_regs; pe_regs = pe_regs->prev) {
+    some = 0;
+    all = 1;
+    for (val = PE_REGS_VALS(pe_regs); val; val = val->next) {
+      if (!(val->type & copytypes)) {
+        all = 0;
+        continue;
+      }
+      if (val->type & (PE_REGS_SWITCH | PE_REGS_ITER | PE_REGS_NOCOPY))
+        return 0;
+      some = 1;
+    }
+    if (some) {
+      if (source || !all)
+        return 0;
+      source = pe_regs;
+    }
+    if (argstop && (pe_regs->flags & PE_REGS_ARG))
+      copytypes &= ~PE_REGS_ARG;
+  }
+  if (!source)
+    return 0;
+  pe_regs_clear(new_regs);
+  new_regs->tab = source->tab;
+  new_regs->tab->refcount++;
+  return 1;
+}
+
 /** Copy Q-reg values to one PE_REGS from another.
  * \param dst The PE_REGS to copy to.
  * \param src The PE_REGS to copy from.
@@ -1130,8 +1357,10 @@ void
 pe_regs_qcopy(PE_REGS *dst, PE_REGS *src)
 {
   PE_REG_VAL *val;
+  if (pe_regs_share(dst, src, PE_REGS_Q, 0))
+    return;
   while (src) {
-    for (val = src->vals; val; val = val->next) {
+    for (val = PE_REGS_VALS(src); val; val = val->next) {
       if (val->type & PE_REGS_Q) {
         if (val->type & PE_REGS_STR) {
           pe_regs_set(dst, val->type, val->name, val->val.sval);
@@ -1157,25 +1386,31 @@ pe_regs_copystack(PE_REGS *new_regs, PE_REGS *pe_regs, int copytypes,
   /* Disable PE_REGS_NOCOPY: If we're copying, we want to copy. */
   int andflags = 0xFF;
   char numbuff[10];
+  PE_REG_TAB *tab;
   PE_REG_VAL *val, *prev, *next;
   prev = NULL;
 
   if (!pe_regs)
     return;
 
-  if (override && (copytypes & PE_REGS_ARG) && (pe_regs->flags & PE_REGS_ARG)) {
+  if (pe_regs_share(new_regs, pe_regs, copytypes, 1))
+    return;
+
+  if (override && (copytypes & PE_REGS_ARG) && (pe_regs->flags & PE_REGS_ARG) &&
+      new_regs->tab) {
     /* Look for all PE_REGS_ARG flags in new_regs, and delete them. */
-    for (val = new_regs->vals; val; val = next) {
+    tab = pe_regs_writable(new_regs);
+    pe_reg_tab_unhash(tab);
+    for (val = tab->vals; val; val = next) {
       next = val->next;
       if (val->type & PE_REGS_ARG) {
         if (prev) {
           prev->next = next;
-          val->next = NULL;
-          pe_reg_val_free(val);
         } else {
-          new_regs->vals = next;
-          pe_reg_val_free(val);
+          tab->vals = next;
         }
+        tab->count--;
+        pe_reg_val_free(val);
       } else {
         prev = val;
       }
@@ -1184,7 +1419,7 @@ pe_regs_copystack(PE_REGS *new_regs, PE_REGS *pe_regs, int copytypes,
 
   /* Whatever it is, it's copied for a QUEUE entry */
   for (; pe_regs; pe_regs = pe_regs->prev) {
-    for (val = pe_regs->vals; val; val = val->next) {
+    for (val = PE_REGS_VALS(pe_regs); val; val = val->next) {
       if (val->type & copytypes) {
         if (val->type & (PE_REGS_SWITCH | PE_REGS_ITER)) {
           /* It is t<num> or n<num>. Bump it up as necessary. */
@@ -1261,7 +1496,7 @@ pi_regs_has_type(NEW_PE_INFO *pe_info, int type)
 
   while (pe_regs) {
     if (pe_regs->flags & type) {
-      val = pe_regs->vals;
+      val = PE_REGS_VALS(pe_regs);
       while (val) {
         if (val->type & type)
           return 1;
@@ -1310,7 +1545,7 @@ pi_regs_setq(NEW_PE_INFO *pe_info, const char *key, const char *val)
   int count = 0;
   while (pe_regs) {
     if ((pe_regs->flags & (PE_REGS_Q | PE_REGS_LET)) == PE_REGS_Q) {
-      count = pe_regs->qcount;
+      count = pe_regs->tab ? pe_regs->tab->qcount : 0;
       break;
     }
     pe_regs = pe_regs->prev;
@@ -1348,15 +1583,23 @@ pi_regs_setq(NEW_PE_INFO *pe_info, const char *key, const char *val)
 }
 
 const char *
-pi_regs_getq(NEW_PE_INFO *pe_info, const char *key)
+pi_regs_getq(NEW_PE_INFO *pe_info, const char *lckey)
 {
-  const char *ret;
+  PE_REG_VAL *pval;
   PE_REGS *pe_regs = pe_info->regvals;
+  const char *name;
+  char key[PE_KEY_LEN];
+
+  /* Intern the name once, rather than for every PE_REGS on the way up. */
+  strupper_r(lckey, key, sizeof key);
+  name = pe_reg_intern(key);
+  if (!name)
+    return NULL;
   while (pe_regs) {
     if (pe_regs->flags & PE_REGS_Q) {
-      ret = pe_regs_get(pe_regs, PE_REGS_Q, key);
-      if (ret)
-        return ret;
+      pval = pe_regs_find(pe_regs, PE_REGS_Q, name);
+      if (pval)
+        return pe_reg_val_str(pval);
     }
     /* If it's marked QSTOP, it stops. */
     if (pe_regs->flags & PE_REGS_QSTOP) {
@@ -1573,7 +1816,7 @@ pi_regs_get_ilev(NEW_PE_INFO *pe_info, int type)
 
   while (pe_regs) {
     if (pe_regs->flags & type) {
-      val = pe_regs->vals;
+      val = PE_REGS_VALS(pe_regs);
       while (val) {
         if ((val->type & type) && *(val->name) == 'T') {
           count++;
@@ -1661,7 +1904,7 @@ pi_regs_get_envc(NEW_PE_INFO *pe_info)
 
   while (pe_regs) {
     if (pe_regs->flags & PE_REGS_ARG) {
-      for (val = pe_regs->vals; val; val = val->next) {
+      for (val = PE_REGS_VALS(pe_regs); val; val = val->next) {
         if (val->type & PE_REGS_ARG) {
           if (sscanf(val->name, "%d", &num) == 1) {
             /* only check numeric args, ignore named ones */
@@ -1915,14 +2158,74 @@ pe_info_from(NEW_PE_INFO *old_pe_info, int flags, PE_REGS *pe_regs)
  * \retval 0 success.
  * \retval 1 CPU time limit exceeded.
  */
+static int pe_eval(char *buff, char **bp, char const **str, dbref executor,
+                   dbref caller, dbref enactor, int eflags, int tflags,
+                   NEW_PE_INFO *pe_info, const struct pe_frame *code,
+                   const char *base);
+
 int
 process_expression(char *buff, char **bp, char const **str, dbref executor,
                    dbref caller, dbref enactor, int eflags, int tflags,
                    NEW_PE_INFO *pe_info)
+{
+  return pe_eval(buff, bp, str, executor, caller, enactor, eflags, tflags,
+                 pe_info, NULL, NULL);
+}
+
+/** Evaluate a compiled attribute.
+ * This works just like process_expression(), and gives the same
+ * results; the compiled form only saves the parser some work.
+ * \param buff buffer to store returns of parsing.
+ * \param bp pointer to pointer into buff marking insert position.
+ * \param str string to parse, which must be the compiled text.
+ * \param executor dbref of the object invoking the function.
+ * \param caller dbref of  the last object to use u()
+ * \param enactor dbref of the enactor.
+ * \param eflags flags to control what is evaluated.
+ * \param tflags flags to control what terminates an expression.
+ * \param pe_info pointer to parser context data.
+ * \param code the compiled expression.
+ * \retval 0 success.
+ * \retval 1 CPU time limit exceeded.
+ */
+int
+process_compiled_expression(char *buff, char **bp, char const **str,
+                            dbref executor, dbref caller, dbref enactor,
+                            int eflags, int tflags, NEW_PE_INFO *pe_info,
+                            PE_CODE *code)
+{
+  return pe_eval(buff, bp, str, executor, caller, enactor, eflags, tflags,
+                 pe_info, pe_code_frame(code), str ? *str : NULL);
+}
+
+/* Point op at the compiled op for the parser's current spot, if there
+ * is one and the parser is in the state the compiler expected. */
+#define PE_FIND_OP()                                                           \
+  do {                                                                         \
+    int here = *str - base;                                                    \
+    while (pc < code->nops && code->ops[pc].off < here)                        \
+      pc++;                                                                    \
+    op = (pc < code->nops && code->ops[pc].off == here &&                      \
+          code->ops[pc].eflags == eflags)                                      \
+           ? &code->ops[pc]                                                    \
+           : NULL;                                                             \
+  } while (0)
+
+/* The compiled frame for the group starting at op, if any */
+#define PE_GROUP() (op && op->type == PE_OP_GROUP ? op->u.group : NULL)
+
+/* The parser proper. If code isn't NULL, it's the compiled form of
+ * this frame, and base is the start of the text it was compiled from.
+ */
+static int
+pe_eval(char *buff, char **bp, char const **str, dbref executor,
+        dbref caller, dbref enactor, int eflags, int tflags,
+        NEW_PE_INFO *pe_info, const struct pe_frame *code, const char *base)
 {
   int debugging = 0, made_info = 0;
   char *debugstr = NULL, *sourcestr = NULL;
   char *realbuff = NULL, *realbp = NULL;
+  ARENA_MARK realmark;
   int gender = -1;
   int inum_this;
   char *startpos = *bp;
@@ -1936,6 +2239,9 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
   PE_REGS *pe_regs;
   const char *stmp;
   int itmp;
+  const struct pe_op *op = NULL;
+  int pc = 0;
+  uint64_t activity = 0;
   /* Part of r1628's deprecation of unescaped commas as the final arg of a
    * function,
    * added 17 Sep 2012. Remove when this behaviour is removed. */
@@ -1944,6 +2250,9 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
 
   if (!buff || !bp || !str || !*str)
     return 0;
+  if (code && (*str != base + code->start || eflags != code->eflags ||
+               tflags != code->tflags))
+    code = NULL;
   if (cpu_time_limit_hit) {
     if (!cpu_limit_warning_sent) {
       cpu_limit_warning_sent = 1;
@@ -1976,20 +2285,17 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
       pe_info->debugging = 0;
   }
 
-  /* If we've been asked to evaluate, log the expression if:
-   * (a) the last thing we logged wasn't an expression, and
-   * (b) this expression isn't a substring of the last thing we logged
-   */
-  if ((eflags & PE_EVALUATE) &&
-      ((last_activity_type() != LA_PE) || !strstr(last_activity(), *str))) {
-    log_activity(LA_PE, executor, *str);
-  }
+  /* If we've been asked to evaluate, log the expression, unless it's
+   * part of one that's logged and still being evaluated. */
+  if (eflags & PE_EVALUATE)
+    activity = activity_enter(executor, *str);
 
   if (eflags != PE_NOTHING) {
     if (((*bp) - buff) > (BUFFER_LEN - SBUF_LEN)) {
       realbuff = buff;
       realbp = *bp;
-      buff = mush_malloc(BUFFER_LEN, "process_expression.buffer_extension");
+      realmark = arena_mark();
+      buff = arena_alloc(BUFFER_LEN);
       *bp = buff;
       startpos = buff;
     }
@@ -2053,6 +2359,22 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
     eflags &= ~PE_COMMAND_BRACES;
 
   for (;;) {
+    /* See if the compiler left anything for this spot. */
+    if (code) {
+      PE_FIND_OP();
+      if (op && op->type == PE_OP_TEXT) {
+        int len = op->u.text.len, len2 = BUFFER_LEN - 1 - (*bp - buff);
+        if (len > len2)
+          len = len2;
+        memcpy(*bp, op->u.text.text, len);
+        *bp += len;
+        *str += op->u.text.srclen;
+        if (op->u.text.space)
+          had_space = 1;
+        continue;
+      }
+    }
+
     /* Find the first "interesting" character */
     {
       char const *pos = *str;
@@ -2107,6 +2429,8 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
         memcpy(*bp, pos, len);
         *bp += len;
       }
+      if (code && *str != pos)
+        PE_FIND_OP();
     }
 
     switch (**str) {
@@ -2200,8 +2524,9 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
           /* Look for a named or numbered subexpression */
           char *nbp = subspace;
           (*str)++;
-          if (process_expression(subspace, &nbp, str, executor, caller, enactor,
-                                 eflags & ~PE_STRIP_BRACES, PT_GT, pe_info)) {
+          if (pe_eval(subspace, &nbp, str, executor, caller, enactor,
+                      eflags & ~PE_STRIP_BRACES, PT_GT, pe_info, PE_GROUP(),
+                      base)) {
             retval = 1;
             break;
           }
@@ -2216,8 +2541,9 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
         safe_chr('$', buff, bp);
         (*str)++;
         if ((**str) == '<') {
-          if (process_expression(buff, bp, str, executor, caller, enactor,
-                                 eflags & ~PE_STRIP_BRACES, PT_GT, pe_info)) {
+          if (pe_eval(buff, bp, str, executor, caller, enactor,
+                      eflags & ~PE_STRIP_BRACES, PT_GT, pe_info, PE_GROUP(),
+                      base)) {
             retval = 1;
             break;
           }
@@ -2252,8 +2578,9 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
           safe_chr(savec, buff, bp);
           if (savec == '<') {
             (*str)++;
-            process_expression(buff, bp, str, executor, caller, enactor,
-                               eflags & ~PE_STRIP_BRACES, PT_GT, pe_info);
+            pe_eval(buff, bp, str, executor, caller, enactor,
+                    eflags & ~PE_STRIP_BRACES, PT_GT, pe_info, PE_GROUP(),
+                    base);
           } else {
             (*str)++;
           }
@@ -2479,9 +2806,9 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
           if (nextc == '<') {
             char subspace[BUFFER_LEN];
             char *nbp = subspace;
-            if (process_expression(subspace, &nbp, str, executor, caller,
-                                   enactor, eflags & ~PE_STRIP_BRACES, PT_GT,
-                                   pe_info)) {
+            if (pe_eval(subspace, &nbp, str, executor, caller, enactor,
+                        eflags & ~PE_STRIP_BRACES, PT_GT, pe_info, PE_GROUP(),
+                        base)) {
               retval = 1;
               break;
             }
@@ -2560,12 +2887,11 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
       if (!(eflags & (PE_STRIP_BRACES | PE_COMMAND_BRACES)))
         safe_chr('{', buff, bp);
       (*str)++;
-      if (process_expression(
-            buff, bp, str, executor, caller, enactor,
-            eflags & PE_COMMAND_BRACES
-              ? (eflags & ~PE_COMMAND_BRACES)
-              : (eflags & ~(PE_STRIP_BRACES | PE_FUNCTION_CHECK)),
-            PT_BRACE, pe_info)) {
+      if (pe_eval(buff, bp, str, executor, caller, enactor,
+                  eflags & PE_COMMAND_BRACES
+                    ? (eflags & ~PE_COMMAND_BRACES)
+                    : (eflags & ~(PE_STRIP_BRACES | PE_FUNCTION_CHECK)),
+                  PT_BRACE, pe_info, PE_GROUP(), base)) {
         retval = 1;
         break;
       }
@@ -2594,8 +2920,8 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
       } else
         temp_eflags = eflags | PE_FUNCTION_CHECK | PE_FUNCTION_MANDATORY;
       (*str)++;
-      if (process_expression(buff, bp, str, executor, caller, enactor,
-                             temp_eflags, PT_BRACKET, pe_info)) {
+      if (pe_eval(buff, bp, str, executor, caller, enactor, temp_eflags,
+                  PT_BRACKET, pe_info, PE_GROUP(), base)) {
         retval = 1;
         break;
       }
@@ -2617,8 +2943,9 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
           safe_chr(**str, buff, bp);
           (*str)++;
         }
-        if (process_expression(buff, bp, str, executor, caller, enactor,
-                               eflags & ~PE_STRIP_BRACES, PT_PAREN, pe_info))
+        if (pe_eval(buff, bp, str, executor, caller, enactor,
+                    eflags & ~PE_STRIP_BRACES, PT_PAREN, pe_info, PE_GROUP(),
+                    base))
           retval = 1;
         if (**str == ')') {
           if (eflags & PE_COMPRESS_SPACES && (*str)[-1] == ' ')
@@ -2629,6 +2956,7 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
         break;
       } else {
         char *onearg;
+        ARENA_MARK argmark;
         char *sargs[10];
         char **fargs;
         int sarglens[10];
@@ -2650,12 +2978,21 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
         }
         args_alloced = 10;
         eflags &= ~PE_FUNCTION_CHECK;
-        /* Get the function name */
-        for (sp = startpos, tp = name; sp < *bp; sp++)
-          safe_chr(UPCASE(*sp), name, &tp);
-        *tp = '\0';
-        fp = (eflags & PE_BUILTINONLY) ? builtin_func_hash_lookup(name)
-                                       : func_hash_lookup(name);
+        if (op && op->type == PE_OP_CALL &&
+            op->u.call.generation == function_generation &&
+            *bp - startpos == op->u.call.namelen &&
+            !memcmp(startpos, op->u.call.name, op->u.call.namelen)) {
+          /* Already looked up */
+          fp = op->u.call.fp;
+          tp = name;
+        } else {
+          /* Get the function name */
+          for (sp = startpos, tp = name; sp < *bp; sp++)
+            safe_chr(UPCASE(*sp), name, &tp);
+          *tp = '\0';
+          fp = (eflags & PE_BUILTINONLY) ? builtin_func_hash_lookup(name)
+                                         : func_hash_lookup(name);
+        }
         eflags &= ~PE_BUILTINONLY; /* Only applies to the outermost call */
         if (!fp) {
           if (eflags & PE_FUNCTION_MANDATORY) {
@@ -2681,8 +3018,8 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
             safe_chr(**str, buff, bp);
             (*str)++;
           }
-          if (process_expression(buff, bp, str, executor, caller, enactor,
-                                 eflags, PT_PAREN, pe_info)) {
+          if (pe_eval(buff, bp, str, executor, caller, enactor, eflags,
+                      PT_PAREN, pe_info, PE_GROUP(), base)) {
             retval = 1;
             break;
           }
@@ -2742,8 +3079,10 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
             ~(PE_COMPRESS_SPACES | PE_EVALUATE | PE_FUNCTION_CHECK);
         temp_tflags = PT_COMMA | PT_PAREN;
         nfargs = 0;
-        onearg = mush_malloc(BUFFER_LEN,
-                             "process_expression.single_function_argument");
+        /* The args, and anything the function itself takes from the
+         * arena, are all released in one go once the call is done. */
+        argmark = arena_mark();
+        onearg = arena_alloc(BUFFER_LEN);
         do {
           char *argp;
           char *lca_safe_func_name = NULL;
@@ -2767,27 +3106,30 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
           if (nfargs >= args_alloced) {
             char **nargs;
             int *narglens;
-            nargs = mush_calloc(nfargs + 10, sizeof(char *),
-                                "process_expression.function_arglist");
-            narglens = mush_calloc(nfargs + 10, sizeof(int),
-                                   "process_expression.function_arglens");
+            nargs = arena_alloc((nfargs + 10) * sizeof(char *));
+            narglens = arena_alloc((nfargs + 10) * sizeof(int));
             for (j = 0; j < nfargs; j++) {
               nargs[j] = fargs[j];
               narglens[j] = arglens[j];
             }
-            if (fargs != sargs)
-              mush_free(fargs, "process_expression.function_arglist");
-            if (arglens != sarglens)
-              mush_free(arglens, "process_expression.function_arglens");
+            for (; j < nfargs + 10; j++) {
+              nargs[j] = NULL;
+              narglens[j] = 0;
+            }
             fargs = nargs;
             arglens = narglens;
             args_alloced += 10;
           }
-          fargs[nfargs] = mush_malloc_zero(
-            BUFFER_LEN + SSE_OFFSET, "process_expression.function_argument");
+          fargs[nfargs] = arena_alloc(BUFFER_LEN + SSE_OFFSET);
+          *fargs[nfargs] = '\0';
           argp = onearg;
-          if (process_expression(onearg, &argp, str, executor, caller, enactor,
-                                 temp_eflags, temp_tflags, pe_info)) {
+          if (pe_eval(onearg, &argp, str, executor, caller, enactor,
+                      temp_eflags, temp_tflags, pe_info,
+                      (op && op->type == PE_OP_CALL && op->u.call.fp == fp &&
+                       nfargs < op->u.call.nargs)
+                        ? op->u.call.args[nfargs]
+                        : NULL,
+                      base)) {
             retval = 1;
             nfargs++;
             /* Part of r1628's deprecation of unescaped commas as the final arg
@@ -2808,6 +3150,10 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
             strcpy(fargs[nfargs], onearg);
           }
           arglens[nfargs] = strlen(fargs[nfargs]);
+#if SSE_OFFSET > 0
+          /* SSE string code can read a little past the terminator */
+          memset(fargs[nfargs] + arglens[nfargs] + 1, 0, SSE_OFFSET);
+#endif
           /* Part of r1628's deprecation of unescaped commas as the final arg of
            * a function,
            * added 17 Sep 2012. Remove when this behaviour is removed. */
@@ -2844,7 +3190,6 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
            * Special case: zero args is recognized as one null arg.
            */
           if ((fp->minargs == 0) && (nfargs == 1) && !*fargs[0]) {
-            mush_free(fargs[0], "process_expression.function_argument");
             fargs[0] = NULL;
             arglens[0] = 0;
             nfargs = 0;
@@ -2870,6 +3215,7 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
             safe_integer(nfargs, buff, bp);
           } else {
             char *fbuff, *fbp;
+            int pframe;
 
             global_fun_recursions++;
             pe_info->fun_recursions++;
@@ -2888,6 +3234,7 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
               fbp = *bp;
             }
 
+            pframe = profile_enter(fp->name);
             if (fp->flags & FN_BUILTIN) {
               global_fun_invocations++;
               pe_info->fun_invocations++;
@@ -2934,6 +3281,7 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
                           caller, enactor, pe_info, PE_USERFN);
               }
             }
+            profile_leave(pframe);
             if (realbuff)
               realbp = fbp;
             else
@@ -2949,15 +3297,7 @@ process_expression(char *buff, char **bp, char const **str, dbref executor,
         }
       /* Free up the space allocated for the args */
       free_func_args:
-        for (j = 0; j < nfargs; j++)
-          if (fargs[j])
-            mush_free(fargs[j], "process_expression.function_argument");
-        if (fargs != sargs)
-          mush_free(fargs, "process_expression.function_arglist");
-        if (arglens != sarglens)
-          mush_free(arglens, "process_expression.function_arglens");
-        if (onearg)
-          mush_free(onearg, "process_expression.single_function_argument");
+        arena_release(argmark);
       }
       break;
     /* Space compression */
@@ -3053,7 +3393,7 @@ exit_sequence:
       **bp = '\0';
       *bp = realbp;
       safe_strl(buff, blen, realbuff, bp);
-      mush_free(buff, "process_expression.buffer_extension");
+      arena_release(realmark);
     }
   }
   /* Once we cross call limit, we stay in error */
@@ -3063,6 +3403,7 @@ exit_sequence:
     free_pe_info(pe_info);
   else
     pe_info->debugging = old_debugging;
+  activity_leave(activity);
   return retval;
 }
 
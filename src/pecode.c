@@ -0,0 +1,847 @@
+/** \file pecode.c
+ *
+ * \brief Compiling and caching attribute expressions.
+ *
+ * The compiler walks an attribute's text the same way
+ * process_expression() would, without evaluating anything, and notes
+ * what the parser is going to find at each point. See pecode.h for
+ * what comes out of it, and parse.c for how it gets used.
+ *
+ * Compiled expressions are cached by the chunk holding the attribute's
+ * text. Setting or clearing the attribute throws its entry away, and
+ * a cached expression is also checked against the text it's being
+ * asked to run before it's used, so a stale entry just gets compiled
+ * again.
+ */
+
+#include "copyrite.h"
+
+#include <string.h>
+
+#include "ansi.h"
+#include "case.h"
+#include "conf.h"
+#include "dbdefs.h"
+#include "externs.h"
+#include "function.h"
+#include "log.h"
+#include "mymalloc.h"
+#include "notify.h"
+#include "parse.h"
+#include "pecode.h"
+#include "strutil.h"
+
+/** Most compiled expressions to keep */
+#define PE_CODE_MAX 4096
+/** Hash buckets for the cache. Must be a power of 2. */
+#define PE_CODE_BUCKETS 1024
+/** Deepest nesting the compiler follows */
+#define PE_COMPILE_DEPTH 64
+/** Size of the blocks compiled expressions are allocated in */
+#define PE_BLOCK_SIZE 1024
+
+/** Memory for one compiled expression */
+struct pe_block {
+  struct pe_block *next; /**< Next block */
+  size_t used;           /**< Bytes handed out */
+  size_t size;           /**< Bytes available */
+  char data[];           /**< The memory */
+};
+
+/** A compiled attribute */
+struct pe_code {
+  PE_CODE *chain;         /**< Next expression in the same hash bucket */
+  PE_CODE *newer;         /**< Next more recently used expression */
+  PE_CODE *older;         /**< Next less recently used expression */
+  chunk_reference_t data; /**< Chunk of the attribute's text */
+  int eflags;             /**< Flags it was compiled for */
+  int generation;         /**< function_generation at compile time */
+  int refs;               /**< Evaluations using it right now */
+  bool cached;            /**< Is it in the cache? */
+  char *src;              /**< The text that was compiled */
+  size_t len;             /**< Length of src */
+  struct pe_frame *top;   /**< Outermost frame, or NULL if nothing to do */
+  struct pe_block *blocks; /**< Memory for the frames */
+  size_t bytes;           /**< Memory used */
+};
+
+static PE_CODE **buckets = NULL;
+static PE_CODE *newest = NULL, *oldest = NULL;
+
+/** Cache totals */
+static struct {
+  unsigned long hits;       /**< Evaluations using a cached expression */
+  unsigned long compiles;   /**< Expressions compiled */
+  unsigned long evicted;    /**< Expressions pushed out to make room */
+  unsigned long forgotten;  /**< Expressions dropped by attribute changes */
+  unsigned long mismatches; /**< compiled_eval_check failures */
+  int entries;              /**< Expressions in the cache */
+  size_t bytes;             /**< Memory used by cached expressions */
+} pe_code_totals;
+
+/* Compiling */
+
+/** Compiler state */
+struct pe_compiler {
+  PE_CODE *code;          /**< Expression being compiled */
+  const char *base;       /**< Start of the source */
+  int depth;              /**< Current nesting */
+  char text[BUFFER_LEN];  /**< Output of the text op being built */
+  int textlen;            /**< Length of text */
+  char name[BUFFER_LEN];  /**< Output of the current frame, while static */
+  int namelen;            /**< Length of name */
+};
+
+/** A frame being compiled */
+struct frame_build {
+  struct pe_op *ops; /**< Ops so far */
+  int nops;          /**< Number of ops */
+  int maxops;        /**< Space in ops */
+  int text_off;      /**< Start of the open text op, or -1 */
+  int text_eflags;   /**< eflags for the open text op */
+  bool text_space;   /**< Does the open text op have a space in it? */
+  bool is_static;    /**< Is everything output so far plain text? */
+};
+
+static void *
+code_alloc(PE_CODE *code, size_t len)
+{
+  struct pe_block *b = code->blocks;
+  void *p;
+
+  len = (len + 7) & ~(size_t) 7;
+  if (!b || b->used + len > b->size) {
+    size_t size = len > PE_BLOCK_SIZE ? len : PE_BLOCK_SIZE;
+
+    b = mush_malloc(sizeof *b + size, "pe_code.block");
+    b->next = code->blocks;
+    b->used = 0;
+    b->size = size;
+    code->blocks = b;
+    code->bytes += sizeof *b + size;
+  }
+  p = b->data + b->used;
+  b->used += len;
+  return p;
+}
+
+static struct pe_op *
+new_op(struct frame_build *f, int off, int eflags, enum pe_op_type type)
+{
+  struct pe_op *op;
+
+  if (f->nops >= f->maxops) {
+    f->maxops = f->maxops ? f->maxops * 2 : 8;
+    f->ops = mush_realloc(f->ops, f->maxops * sizeof *f->ops, "pe_code.ops");
+  }
+  op = &f->ops[f->nops++];
+  memset(op, 0, sizeof *op);
+  op->off = off;
+  op->eflags = eflags;
+  op->type = type;
+  return op;
+}
+
+/* Add output that needs no evaluation, starting at source offset off. */
+static void
+add_text(struct pe_compiler *c, struct frame_build *f, int off, int eflags,
+         const char *s, int len)
+{
+  if (f->text_off < 0) {
+    f->text_off = off;
+    f->text_eflags = eflags;
+    f->text_space = 0;
+    c->textlen = 0;
+  }
+  if (len > BUFFER_LEN - 1 - c->textlen)
+    len = BUFFER_LEN - 1 - c->textlen;
+  memcpy(c->text + c->textlen, s, len);
+  c->textlen += len;
+  if (f->is_static) {
+    if (len > BUFFER_LEN - 1 - c->namelen)
+      len = BUFFER_LEN - 1 - c->namelen;
+    memcpy(c->name + c->namelen, s, len);
+    c->namelen += len;
+  }
+}
+
+/* Close the open text op, which ends at source offset end. */
+static void
+flush_text(struct pe_compiler *c, struct frame_build *f, int end)
+{
+  struct pe_op *op;
+  char *text;
+
+  if (f->text_off < 0)
+    return;
+  op = new_op(f, f->text_off, f->text_eflags, PE_OP_TEXT);
+  text = code_alloc(c->code, c->textlen);
+  memcpy(text, c->text, c->textlen);
+  op->u.text.text = text;
+  op->u.text.len = c->textlen;
+  op->u.text.srclen = end - f->text_off;
+  op->u.text.space = f->text_space;
+  f->text_off = -1;
+}
+
+static void
+add_group(struct frame_build *f, int off, int eflags, struct pe_frame *group)
+{
+  if (group)
+    new_op(f, off, eflags, PE_OP_GROUP)->u.group = group;
+}
+
+/** Compile one call to process_expression().
+ * This follows process_expression() closely; when the two disagree
+ * the ops just don't get used.
+ * \param c compiler state.
+ * \param str pointer to the source, left at the terminator like p_e().
+ * \param eflags eflags the parser would be called with.
+ * \param tflags tflags the parser would be called with.
+ * \param complete set to false if the end of the frame couldn't be found.
+ * \return the frame, or NULL if it has no ops.
+ */
+static struct pe_frame *
+compile_frame(struct pe_compiler *c, char const **str, int eflags, int tflags,
+              bool *complete)
+{
+  struct frame_build f;
+  struct pe_frame *frame, *sub;
+  int start = *str - c->base;
+  int in_eflags = eflags, in_tflags = tflags;
+  int off, temp_eflags;
+  bool ok = 1;
+  char savec;
+
+#define HERE (int) (*str - c->base)
+
+  memset(&f, 0, sizeof f);
+  f.text_off = -1;
+  f.is_static = 1;
+  c->namelen = 0;
+
+  if (++c->depth > PE_COMPILE_DEPTH) {
+    ok = 0;
+    goto finish;
+  }
+
+  if (eflags & PE_COMPRESS_SPACES)
+    while (**str == ' ')
+      (*str)++;
+  if (!**str)
+    goto finish;
+  if (**str != '{')
+    eflags &= ~PE_COMMAND_BRACES;
+
+  for (;;) {
+    switch (**str) {
+    case '}':
+      if (tflags & PT_BRACE)
+        goto finish;
+      break;
+    case ']':
+      if (tflags & PT_BRACKET)
+        goto finish;
+      break;
+    case ')':
+      if (tflags & PT_PAREN)
+        goto finish;
+      break;
+    case ',':
+      if (tflags & PT_COMMA)
+        goto finish;
+      tflags &= ~PT_NOT_COMMA;
+      break;
+    case ';':
+      if (tflags & PT_SEMI)
+        goto finish;
+      break;
+    case '=':
+      if (tflags & PT_EQUALS)
+        goto finish;
+      break;
+    case ' ':
+      if (tflags & PT_SPACE)
+        goto finish;
+      break;
+    case '>':
+      if (tflags & PT_GT)
+        goto finish;
+      break;
+    case '\0':
+      goto finish;
+    }
+
+    off = HERE;
+    switch (**str) {
+    case TAG_START:
+    case ESC_CHAR: {
+      char end = (**str == TAG_START) ? TAG_END : 'm';
+      const char *p = *str;
+
+      while (*p && *p != end)
+        p++;
+      if (*p)
+        p++;
+      add_text(c, &f, off, eflags, *str, p - *str);
+      *str = p;
+      break;
+    }
+    case '$':
+      if ((eflags & (PE_DOLLAR | PE_EVALUATE)) == (PE_DOLLAR | PE_EVALUATE)) {
+        /* What this does depends on regexp captures, so it's never
+         * plain text. If it's a $<, assume there aren't any. */
+        flush_text(c, &f, off);
+        f.is_static = 0;
+      } else if ((*str)[1] != '<') {
+        add_text(c, &f, off, eflags, "$", 1);
+        (*str)++;
+        break;
+      }
+      (*str)++;
+      if (**str == '<') {
+        flush_text(c, &f, off);
+        f.is_static = 0;
+        sub = compile_frame(c, str, eflags & ~PE_STRIP_BRACES, PT_GT, &ok);
+        add_group(&f, off, eflags, sub);
+        if (!ok)
+          goto finish;
+      }
+      break;
+    case '%':
+      if (eflags & PE_LITERAL) {
+        add_text(c, &f, off, eflags, "%", 1);
+        (*str)++;
+        break;
+      }
+      flush_text(c, &f, off);
+      f.is_static = 0;
+      (*str)++;
+      savec = **str;
+      if (!savec)
+        goto finish;
+      (*str)++;
+      switch (savec) {
+      case 'I':
+      case 'i':
+      case '$':
+        if (!(eflags & PE_EVALUATE))
+          break;
+      /* FALL THROUGH */
+      case 'V':
+      case 'v':
+      case 'W':
+      case 'w':
+      case 'X':
+      case 'x':
+        if (!**str)
+          goto finish;
+        (*str)++;
+        break;
+      case 'Q':
+      case 'q':
+        savec = **str;
+        if (!savec)
+          goto finish;
+        (*str)++;
+        if (savec == '<') {
+          sub = compile_frame(c, str, eflags & ~PE_STRIP_BRACES, PT_GT, &ok);
+          add_group(&f, off, eflags, sub);
+          if (!ok)
+            goto finish;
+          if ((eflags & PE_EVALUATE) && **str == '>')
+            (*str)++;
+        }
+        break;
+      }
+      break;
+    case '{':
+      if (eflags & PE_LITERAL) {
+        add_text(c, &f, off, eflags, "{", 1);
+        (*str)++;
+        break;
+      }
+      flush_text(c, &f, off);
+      f.is_static = 0;
+      (*str)++;
+      sub = compile_frame(c, str,
+                          eflags & PE_COMMAND_BRACES
+                            ? (eflags & ~PE_COMMAND_BRACES)
+                            : (eflags & ~(PE_STRIP_BRACES | PE_FUNCTION_CHECK)),
+                          PT_BRACE, &ok);
+      add_group(&f, off, eflags, sub);
+      if (!ok)
+        goto finish;
+      if (**str == '}')
+        (*str)++;
+      eflags &= ~PE_COMMAND_BRACES;
+      break;
+    case '[':
+      if (eflags & PE_LITERAL) {
+        add_text(c, &f, off, eflags, "[", 1);
+        (*str)++;
+        break;
+      }
+      flush_text(c, &f, off);
+      f.is_static = 0;
+      if (!(eflags & PE_EVALUATE))
+        temp_eflags = eflags & ~PE_STRIP_BRACES;
+      else
+        temp_eflags = eflags | PE_FUNCTION_CHECK | PE_FUNCTION_MANDATORY;
+      (*str)++;
+      sub = compile_frame(c, str, temp_eflags, PT_BRACKET, &ok);
+      add_group(&f, off, eflags, sub);
+      if (!ok)
+        goto finish;
+      if (**str == ']')
+        (*str)++;
+      break;
+    case '(':
+      flush_text(c, &f, off);
+      (*str)++;
+      if (!(eflags & PE_EVALUATE) || !(eflags & PE_FUNCTION_CHECK)) {
+        f.is_static = 0;
+        if (**str == ' ')
+          (*str)++;
+        sub = compile_frame(c, str, eflags & ~PE_STRIP_BRACES, PT_PAREN, &ok);
+        add_group(&f, off, eflags, sub);
+        if (!ok)
+          goto finish;
+        if (**str == ')')
+          (*str)++;
+      } else {
+        char uname[BUFFER_LEN];
+        struct pe_op *op;
+        struct pe_frame **args = NULL;
+        int nargs = 0, maxargs = 0, i;
+        int op_eflags = eflags;
+        int temp_tflags;
+        FUN *fp;
+
+        eflags &= ~PE_FUNCTION_CHECK;
+        if (!f.is_static) {
+          /* The name comes from evaluating something. */
+          ok = 0;
+          goto finish;
+        }
+        f.is_static = 0;
+        for (i = 0; i < c->namelen; i++)
+          uname[i] = UPCASE(c->name[i]);
+        uname[i] = '\0';
+        fp = (eflags & PE_BUILTINONLY) ? builtin_func_hash_lookup(uname)
+                                       : func_hash_lookup(uname);
+        eflags &= ~PE_BUILTINONLY;
+        if (!fp) {
+          if (eflags & PE_FUNCTION_MANDATORY) {
+            compile_frame(c, str, PE_NOTHING, PT_PAREN, &ok);
+            if (!ok)
+              goto finish;
+          } else {
+            if (**str == ' ')
+              (*str)++;
+            sub = compile_frame(c, str, eflags, PT_PAREN, &ok);
+            add_group(&f, off, op_eflags, sub);
+            if (!ok)
+              goto finish;
+          }
+          if (**str == ')')
+            (*str)++;
+          break;
+        }
+
+        op = new_op(&f, off, op_eflags, PE_OP_CALL);
+        op->u.call.fp = fp;
+        op->u.call.generation = function_generation;
+        op->u.call.namelen = c->namelen;
+        op->u.call.name = code_alloc(c->code, c->namelen);
+        memcpy((char *) op->u.call.name, c->name, c->namelen);
+
+        temp_eflags = (eflags & ~PE_FUNCTION_MANDATORY) | PE_COMPRESS_SPACES |
+                      PE_EVALUATE | PE_FUNCTION_CHECK;
+        switch (fp->flags & FN_ARG_MASK) {
+        case FN_LITERAL:
+          temp_eflags |= PE_LITERAL;
+        /* FALL THROUGH */
+        case FN_NOPARSE:
+          temp_eflags &=
+            ~(PE_COMPRESS_SPACES | PE_EVALUATE | PE_FUNCTION_CHECK);
+          break;
+        }
+        if ((fp->flags & FN_USERFN) && !(eflags & PE_USERFN))
+          temp_eflags &=
+            ~(PE_COMPRESS_SPACES | PE_EVALUATE | PE_FUNCTION_CHECK);
+        temp_tflags = PT_COMMA | PT_PAREN;
+        do {
+          if ((fp->maxargs < 0) && ((nargs + 1) >= -fp->maxargs)) {
+            if (fp->flags & FN_LITERAL)
+              temp_tflags = PT_PAREN;
+            else
+              temp_tflags = PT_PAREN | PT_NOT_COMMA;
+          }
+          sub = compile_frame(c, str, temp_eflags, temp_tflags, &ok);
+          if (nargs >= maxargs) {
+            maxargs = maxargs ? maxargs * 2 : 4;
+            args =
+              mush_realloc(args, maxargs * sizeof *args, "pe_code.args");
+          }
+          args[nargs++] = sub;
+          if (!ok)
+            break;
+          (*str)++;
+        } while ((*str)[-1] == ',');
+
+        op->u.call.nargs = nargs;
+        op->u.call.args = code_alloc(c->code, nargs * sizeof *args);
+        memcpy(op->u.call.args, args, nargs * sizeof *args);
+        mush_free(args, "pe_code.args");
+        if (!ok)
+          goto finish;
+        if ((*str)[-1] != ')')
+          (*str)--;
+      }
+      break;
+    case ' ': {
+      const char *p = *str;
+
+      if (eflags & PE_COMPRESS_SPACES) {
+        add_text(c, &f, off, eflags, " ", 1);
+        while (*p == ' ')
+          p++;
+      } else {
+        while (*p == ' ')
+          p++;
+        add_text(c, &f, off, eflags, *str, p - *str);
+      }
+      f.text_space = 1;
+      *str = p;
+      break;
+    }
+    case ',':
+      if (in_tflags & PT_NOT_COMMA) {
+        /* Might need to warn about it, so let the parser see it */
+        flush_text(c, &f, off);
+        if (f.is_static && c->namelen < BUFFER_LEN - 1)
+          c->name[c->namelen++] = ',';
+        (*str)++;
+        break;
+      }
+      add_text(c, &f, off, eflags, ",", 1);
+      (*str)++;
+      break;
+    case '\\':
+      if (eflags & PE_LITERAL) {
+        add_text(c, &f, off, eflags, "\\", 1);
+        (*str)++;
+        break;
+      }
+      if (!(*str)[1]) {
+        flush_text(c, &f, off);
+        (*str)++;
+        goto finish;
+      }
+      if (!(eflags & PE_EVALUATE))
+        add_text(c, &f, off, eflags, "\\", 1);
+      (*str)++;
+      add_text(c, &f, off, eflags, *str, 1);
+      (*str)++;
+      break;
+    default:
+      add_text(c, &f, off, eflags, *str, 1);
+      (*str)++;
+      break;
+    }
+  }
+
+finish:
+  if (ok)
+    flush_text(c, &f, HERE);
+  c->depth--;
+  *complete = ok;
+
+  /* Text ops are only useful to the parser if it's evaluating. */
+  if (!f.nops || !(in_eflags & PE_EVALUATE) || (in_eflags & PE_LITERAL)) {
+    mush_free(f.ops, "pe_code.ops");
+    return NULL;
+  }
+  frame = code_alloc(c->code, sizeof *frame);
+  frame->start = start;
+  frame->eflags = in_eflags;
+  frame->tflags = in_tflags;
+  frame->nops = f.nops;
+  frame->ops = code_alloc(c->code, f.nops * sizeof *f.ops);
+  memcpy(frame->ops, f.ops, f.nops * sizeof *f.ops);
+  mush_free(f.ops, "pe_code.ops");
+  return frame;
+#undef HERE
+}
+
+static PE_CODE *
+compile_code(chunk_reference_t data, const char *text, size_t len, int eflags)
+{
+  struct pe_compiler *c;
+  PE_CODE *code;
+  const char *s = text;
+  bool ok;
+
+  code = mush_malloc_zero(sizeof *code, "pe_code");
+  code->data = data;
+  code->eflags = eflags;
+  code->generation = function_generation;
+  code->len = len;
+  code->src = mush_malloc(len + 1, "pe_code.src");
+  memcpy(code->src, text, len + 1);
+  code->bytes = sizeof *code + len + 1;
+
+  c = mush_malloc(sizeof *c, "pe_code.compiler");
+  c->code = code;
+  c->base = text;
+  c->depth = 0;
+  code->top = compile_frame(c, &s, eflags, PT_DEFAULT, &ok);
+  mush_free(c, "pe_code.compiler");
+
+  pe_code_totals.compiles += 1;
+  return code;
+}
+
+static void
+free_code(PE_CODE *code)
+{
+  struct pe_block *b, *next;
+
+  for (b = code->blocks; b; b = next) {
+    next = b->next;
+    mush_free(b, "pe_code.block");
+  }
+  mush_free(code->src, "pe_code.src");
+  mush_free(code, "pe_code");
+}
+
+/* The cache */
+
+static unsigned int
+hash_data(chunk_reference_t data)
+{
+  uint64_t h = (uint64_t) data * UINT64_C(0x9E3779B97F4A7C15);
+
+  return (unsigned int) (h >> 32) & (PE_CODE_BUCKETS - 1);
+}
+
+static void
+lru_unlink(PE_CODE *code)
+{
+  if (code->newer)
+    code->newer->older = code->older;
+  else
+    newest = code->older;
+  if (code->older)
+    code->older->newer = code->newer;
+  else
+    oldest = code->newer;
+  code->newer = code->older = NULL;
+}
+
+static void
+lru_push(PE_CODE *code)
+{
+  code->newer = NULL;
+  code->older = newest;
+  if (newest)
+    newest->newer = code;
+  else
+    oldest = code;
+  newest = code;
+}
+
+/* Take the expression *pc points at out of the cache. It's freed now
+ * unless something is still running it. */
+static void
+uncache(PE_CODE **pc)
+{
+  PE_CODE *code = *pc;
+
+  *pc = code->chain;
+  lru_unlink(code);
+  code->cached = 0;
+  pe_code_totals.entries -= 1;
+  pe_code_totals.bytes -= code->bytes;
+  if (!code->refs)
+    free_code(code);
+}
+
+static PE_CODE **
+find_link(PE_CODE *code)
+{
+  PE_CODE **pc;
+
+  for (pc = &buckets[hash_data(code->data)]; *pc != code; pc = &(*pc)->chain)
+    ;
+  return pc;
+}
+
+/* Find or compile the expression for an attribute. */
+static PE_CODE *
+pe_code_fetch(chunk_reference_t data, const char *text, int eflags)
+{
+  PE_CODE **pc, *code;
+  size_t len = strlen(text);
+
+  if (!buckets)
+    buckets = mush_calloc(PE_CODE_BUCKETS, sizeof *buckets, "pe_code.buckets");
+
+  for (pc = &buckets[hash_data(data)]; *pc; pc = &(*pc)->chain) {
+    code = *pc;
+    if (code->data == data && code->eflags == eflags) {
+      if (code->generation == function_generation && code->len == len &&
+          memcmp(code->src, text, len) == 0) {
+        lru_unlink(code);
+        lru_push(code);
+        pe_code_totals.hits += 1;
+        return code;
+      }
+      uncache(pc);
+      break;
+    }
+  }
+
+  if (pe_code_totals.entries >= PE_CODE_MAX) {
+    pe_code_totals.evicted += 1;
+    uncache(find_link(oldest));
+  }
+
+  code = compile_code(data, text, len, eflags);
+  pc = &buckets[hash_data(data)];
+  code->chain = *pc;
+  *pc = code;
+  code->cached = 1;
+  lru_push(code);
+  pe_code_totals.entries += 1;
+  pe_code_totals.bytes += code->bytes;
+  return code;
+}
+
+/** Forget any compiled expressions for an attribute's text.
+ * Called whenever an attribute's chunk is freed.
+ * \param data the chunk.
+ */
+void
+pe_code_forget(chunk_reference_t data)
+{
+  PE_CODE **pc;
+
+  if (!buckets || data == NULL_CHUNK_REFERENCE)
+    return;
+  pc = &buckets[hash_data(data)];
+  while (*pc) {
+    if ((*pc)->data == data) {
+      pe_code_totals.forgotten += 1;
+      uncache(pc);
+    } else
+      pc = &(*pc)->chain;
+  }
+}
+
+/** The outermost frame of a compiled expression.
+ * \param code the expression.
+ * \return its frame, or NULL.
+ */
+const struct pe_frame *
+pe_code_frame(PE_CODE *code)
+{
+  return code ? code->top : NULL;
+}
+
+/* Evaluate an expression both ways and complain if they differ. */
+static int
+check_compiled(char *buff, char **bp, char const **str, dbref executor,
+               dbref caller, dbref enactor, int eflags, NEW_PE_INFO *pe_info,
+               PE_CODE *code)
+{
+  char *check, *cp;
+  char const *cs = *str;
+  size_t prefix = *bp - buff;
+  int plain_ret, retval;
+
+  check = mush_malloc(BUFFER_LEN, "pe_code.check");
+  memcpy(check, buff, prefix);
+  cp = check + prefix;
+  plain_ret = process_expression(check, &cp, &cs, executor, caller, enactor,
+                                 eflags, PT_DEFAULT, pe_info);
+  retval = process_compiled_expression(buff, bp, str, executor, caller,
+                                       enactor, eflags, PT_DEFAULT, pe_info,
+                                       code);
+  if (cp - check != *bp - buff || cs != *str || plain_ret != retval ||
+      memcmp(check + prefix, buff + prefix, cp - check - prefix)) {
+    pe_code_totals.mismatches += 1;
+    *cp = '\0';
+    **bp = '\0';
+    do_rawlog(LT_ERR,
+              "Compiled evaluation mismatch on #%d: '%s' gave '%s', "
+              "expected '%s'",
+              executor, code->src, buff + prefix, check + prefix);
+    notify_format(Owner(executor),
+                  T("Compiled evaluation mismatch on #%d: got '%s', "
+                    "expected '%s'"),
+                  executor, buff + prefix, check + prefix);
+  }
+  mush_free(check, "pe_code.check");
+  return retval;
+}
+
+/** Evaluate an attribute's text, using its compiled form if possible.
+ * The arguments are the same as process_expression(), except that tflags
+ * is always PT_DEFAULT and data is the chunk the text came from.
+ * \param buff buffer to store returns of parsing.
+ * \param bp pointer to pointer into buff marking insert position.
+ * \param str string to parse, a copy of the attribute's value.
+ * \param data the attribute's chunk, or NULL_CHUNK_REFERENCE.
+ * \param executor dbref of the object invoking the function.
+ * \param caller dbref of  the last object to use u()
+ * \param enactor dbref of the enactor.
+ * \param eflags flags to control what is evaluated.
+ * \param pe_info pointer to parser context data.
+ * \retval 0 success.
+ * \retval 1 CPU time limit exceeded.
+ */
+int
+process_attr_expression(char *buff, char **bp, char const **str,
+                        chunk_reference_t data, dbref executor, dbref caller,
+                        dbref enactor, int eflags, NEW_PE_INFO *pe_info)
+{
+  PE_CODE *code;
+  int retval;
+
+  if (!COMPILED_EVAL || data == NULL_CHUNK_REFERENCE || !*str)
+    return process_expression(buff, bp, str, executor, caller, enactor,
+                              eflags, PT_DEFAULT, pe_info);
+
+  code = pe_code_fetch(data, *str, eflags);
+  code->refs += 1;
+  if (COMPILED_EVAL_CHECK)
+    retval = check_compiled(buff, bp, str, executor, caller, enactor, eflags,
+                            pe_info, code);
+  else
+    retval = process_compiled_expression(buff, bp, str, executor, caller,
+                                         enactor, eflags, PT_DEFAULT, pe_info,
+                                         code);
+  code->refs -= 1;
+  if (!code->refs && !code->cached)
+    free_code(code);
+  return retval;
+}
+
+/** Show compiled expression statistics, for \@stats/tables.
+ * \param player the player to tell.
+ */
+void
+pe_code_stats(dbref player)
+{
+  notify(player, "Compiled Attributes:");
+  notify_format(player,
+                " %d cached, using %lu bytes. %lu hits, %lu compiled, %lu "
+                "evicted, %lu forgotten.",
+                pe_code_totals.entries, (unsigned long) pe_code_totals.bytes,
+                pe_code_totals.hits, pe_code_totals.compiles,
+                pe_code_totals.evicted, pe_code_totals.forgotten);
+  if (COMPILED_EVAL_CHECK || pe_code_totals.mismatches)
+    notify_format(player, " %lu mismatches.", pe_code_totals.mismatches);
+}
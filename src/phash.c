@@ -0,0 +1,282 @@
+/**
+ * \file phash.c
+ *
+ * \brief Case-insensitive perfect hash tables.
+ *
+ * These use hash and displace: every name is hashed once, and the hash
+ * picks both a bucket and a starting slot and stride. The buckets are
+ * placed biggest first, and each one gets the smallest displacement
+ * that moves all its names into free slots along their strides. If
+ * some bucket can't be placed, the whole thing is tried again with a
+ * new seed. With at most half the slots in use, the first seed almost
+ * always works.
+ *
+ * Names are hashed a character at a time through UPCASE(), so a
+ * lookup doesn't need an upcased copy of the name.
+ */
+
+#include "copyrite.h"
+#include "phash.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include "case.h"
+#include "conf.h"
+#include "memcheck.h"
+#include "mymalloc.h"
+#include "notify.h"
+
+/** How many seeds to try before giving up. */
+#define PHASH_MAX_TRIES 32
+
+/** Hash a name, ignoring case.
+ * This is FNV-1a, with the MurmurHash3 finalizer to spread the low
+ * bits around, since those pick the bucket.
+ * \param key the name.
+ * \param seed seed for this table.
+ * \return the hash.
+ */
+static uint64_t
+phash_hash(const char *key, uint64_t seed)
+{
+  uint64_t h = UINT64_C(14695981039346656037) ^ seed;
+
+  for (; *key; key++) {
+    h ^= (unsigned char) UPCASE((unsigned char) *key);
+    h *= UINT64_C(1099511628211);
+  }
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+/** Which slot a hash goes in for a displacement. */
+static inline uint32_t
+phash_slot(const PHASH *tab, uint64_t h, uint32_t d)
+{
+  uint32_t start = (uint32_t) (h >> 32);
+  uint32_t stride = ((uint32_t) h >> 8) | 1;
+  return (start + d * stride) & (tab->slots - 1);
+}
+
+/** Initialize an empty perfect hash table.
+ * \param tab the table.
+ */
+void
+phash_init(PHASH *tab)
+{
+  memset(tab, 0, sizeof *tab);
+}
+
+/** Free a perfect hash table, leaving it empty.
+ * \param tab the table.
+ */
+void
+phash_free(PHASH *tab)
+{
+  if (tab->disp)
+    mush_free(tab->disp, "phash.disp");
+  if (tab->keys)
+    mush_free(tab->keys, "phash.keys");
+  if (tab->data)
+    mush_free(tab->data, "phash.data");
+  if (tab->names)
+    mush_free(tab->names, "phash.names");
+  phash_init(tab);
+}
+
+/** Try to place every name using one seed.
+ * \param tab the table, with its sizes and seed set.
+ * \param n number of names.
+ * \param keys the names.
+ * \param hashes scratch space for n hashes.
+ * \param order scratch space for n indexes.
+ * \param first scratch space for buckets + 1 indexes.
+ * \param border scratch space for buckets indexes.
+ * \param used scratch space for a flag per slot.
+ * \return true if every name got its own slot.
+ */
+static bool
+phash_place(PHASH *tab, size_t n, const char *keys[], uint64_t *hashes,
+            uint32_t *order, uint32_t *first, uint32_t *border, char *used)
+{
+  uint32_t b, i, maxsize = 0;
+  size_t k;
+  uint32_t *fill = border; /* Reused as a counter until sorting */
+
+  memset(used, 0, tab->slots);
+  memset(first, 0, sizeof(uint32_t) * (tab->buckets + 1));
+  memset(tab->disp, 0, sizeof(uint32_t) * tab->buckets);
+
+  /* Group the names by bucket */
+  for (k = 0; k < n; k++) {
+    hashes[k] = phash_hash(keys[k], tab->seed);
+    first[(hashes[k] & (tab->buckets - 1)) + 1]++;
+  }
+  for (b = 0; b < tab->buckets; b++) {
+    if (first[b + 1] > maxsize)
+      maxsize = first[b + 1];
+    first[b + 1] += first[b];
+  }
+  for (b = 0; b < tab->buckets; b++)
+    fill[b] = first[b];
+  for (k = 0; k < n; k++)
+    order[fill[hashes[k] & (tab->buckets - 1)]++] = k;
+
+  /* Biggest buckets first, while there's the most room */
+  i = 0;
+  for (; maxsize > 0; maxsize--)
+    for (b = 0; b < tab->buckets; b++)
+      if (first[b + 1] - first[b] == maxsize)
+        border[i++] = b;
+
+  while (i-- > 0) {
+    uint32_t d, j;
+
+    b = border[i];
+    for (d = 0; d < tab->slots; d++) {
+      for (j = first[b]; j < first[b + 1]; j++) {
+        uint32_t s = phash_slot(tab, hashes[order[j]], d);
+        if (used[s])
+          break;
+        used[s] = 1;
+      }
+      if (j == first[b + 1])
+        break;
+      /* Collision; take back the ones already placed */
+      while (j-- > first[b])
+        used[phash_slot(tab, hashes[order[j]], d)] = 0;
+    }
+    if (d == tab->slots)
+      return false;
+    tab->disp[b] = d;
+  }
+  return true;
+}
+
+/** Build a perfect hash table from a list of names.
+ * The names must be different from each other, ignoring case. The
+ * table keeps its own copy of them; the data pointers are stored as
+ * they are.
+ * \param tab the table, which is freed first.
+ * \param n number of names.
+ * \param keys the names.
+ * \param data the data to go with each name.
+ * \return true on success, false if no seed worked (which leaves the
+ * table empty).
+ */
+bool
+phash_build(PHASH *tab, size_t n, const char *keys[], void *data[])
+{
+  uint64_t *hashes;
+  uint32_t *order, *first, *border;
+  char *used, *np;
+  size_t k, namelen = 0;
+  bool ok = false;
+
+  phash_free(tab);
+  if (n == 0)
+    return false;
+
+  for (tab->slots = 8; tab->slots < n * 2; tab->slots <<= 1)
+    ;
+  for (tab->buckets = 1; tab->buckets < n / 4; tab->buckets <<= 1)
+    ;
+  tab->disp = mush_calloc(tab->buckets, sizeof(uint32_t), "phash.disp");
+  hashes = mush_calloc(n, sizeof(uint64_t), "phash.scratch");
+  order = mush_calloc(n, sizeof(uint32_t), "phash.scratch");
+  first = mush_calloc(tab->buckets + 1, sizeof(uint32_t), "phash.scratch");
+  border = mush_calloc(tab->buckets, sizeof(uint32_t), "phash.scratch");
+  used = mush_malloc(tab->slots, "phash.scratch");
+
+  for (tab->tries = 1; tab->tries <= PHASH_MAX_TRIES; tab->tries++) {
+    tab->seed = (uint64_t) tab->tries * UINT64_C(0x9e3779b97f4a7c15);
+    if (phash_place(tab, n, keys, hashes, order, first, border, used)) {
+      ok = true;
+      break;
+    }
+  }
+
+  if (ok) {
+    for (k = 0; k < n; k++)
+      namelen += strlen(keys[k]) + 1;
+    tab->keys = mush_calloc(tab->slots, sizeof(char *), "phash.keys");
+    tab->data = mush_calloc(tab->slots, sizeof(void *), "phash.data");
+    tab->names = np = mush_malloc(namelen, "phash.names");
+    for (k = 0; k < n; k++) {
+      uint32_t b = hashes[k] & (tab->buckets - 1);
+      uint32_t s = phash_slot(tab, hashes[k], tab->disp[b]);
+      const char *p;
+
+      tab->keys[s] = np;
+      tab->data[s] = data[k];
+      for (p = keys[k]; *p; p++)
+        *np++ = UPCASE((unsigned char) *p);
+      *np++ = '\0';
+    }
+    tab->entries = n;
+  }
+
+  mush_free(hashes, "phash.scratch");
+  mush_free(order, "phash.scratch");
+  mush_free(first, "phash.scratch");
+  mush_free(border, "phash.scratch");
+  mush_free(used, "phash.scratch");
+  if (!ok)
+    phash_free(tab);
+  return ok;
+}
+
+/** Look up a name in a perfect hash table.
+ * \param tab the table.
+ * \param key the name to look up, in any case.
+ * \return the data for the name, or NULL if it isn't in the table.
+ */
+void *
+phash_find(const PHASH *tab, const char *key)
+{
+  uint64_t h;
+  uint32_t s;
+
+  if (!tab->entries || !key)
+    return NULL;
+  h = phash_hash(key, tab->seed);
+  s = phash_slot(tab, h, tab->disp[h & (tab->buckets - 1)]);
+  if (tab->keys[s] && strcasecmp(tab->keys[s], key) == 0)
+    return tab->data[s];
+  return NULL;
+}
+
+/** Header for report of perfect hash stats.
+ * \param player player to notify with table header.
+ */
+void
+phash_stats_header(dbref player)
+{
+  notify(player, "Table      Entries   Slots Buckets   Seeds ~Memory");
+}
+
+/** Data for one line of report of perfect hash stats.
+ * \param player player to notify with table.
+ * \param tab the table to summarize.
+ * \param pname name of the table, for row header.
+ */
+void
+phash_stats(dbref player, const PHASH *tab, const char *pname)
+{
+  size_t m = 0, k;
+
+  if (tab->entries) {
+    m = tab->buckets * sizeof(uint32_t) +
+        tab->slots * (sizeof(char *) + sizeof(void *));
+    for (k = 0; k < tab->slots; k++)
+      if (tab->keys[k])
+        m += strlen(tab->keys[k]) + 1;
+  }
+  notify_format(player, "%-10s %7d %7u %7u %7d %7d", pname, (int) tab->entries,
+                tab->slots, tab->buckets, tab->tries, (int) m);
+}
@@ -1529,16 +1529,14 @@ grep_util(dbref player, dbref thing, char *attrs, char *findstr, char *buff,
   if (flags & GREP_REGEXP) {
     /* regexp grep */
     struct regrep_data rgd;
+    CACHED_REGEXP *cre;
     const char *errptr;
-    int erroffset;
     int reflags = 0;
-    bool free_study = false;
 
     if (flags & GREP_NOCASE)
       reflags |= PCRE_CASELESS;
 
-    if ((rgd.re = pcre_compile(cleanfind, reflags, &errptr, &erroffset,
-                               tables)) == NULL) {
+    if ((cre = regexp_cache_get(cleanfind, reflags, &errptr)) == NULL) {
       /* Matching error. */
       if (buff) {
         safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
@@ -1548,26 +1546,8 @@ grep_util(dbref player, dbref thing, char *attrs, char *findstr, char *buff,
       }
       return 0;
     }
-    ADD_CHECK("pcre");
-    rgd.study = pcre_study(rgd.re, pcre_public_study_flags, &errptr);
-    if (errptr != NULL) {
-      if (buff) {
-        safe_str(T("#-1 REGEXP ERROR: "), buff, bp);
-        safe_str(errptr, buff, bp);
-      } else {
-        notify_format(player, T("Invalid regexp: %s"), errptr);
-      }
-      pcre_free(rgd.re);
-      DEL_CHECK("pcre");
-      return 0;
-    }
-    if (rgd.study) {
-      ADD_CHECK("pcre.extra");
-      free_study = true;
-      set_match_limit(rgd.study);
-    } else {
-      rgd.study = default_match_limit();
-    }
+    rgd.re = cre->re;
+    rgd.study = regexp_cache_extra(cre);
     rgd.buff = buff;
     rgd.bp = bp;
     rgd.count = 0;
@@ -1579,16 +1559,7 @@ grep_util(dbref player, dbref thing, char *attrs, char *findstr, char *buff,
       atr_iter_get(player, thing, attrs, AIG_NONE, regrep_helper,
                    (void *) &rgd);
     }
-    if (free_study) {
-#ifdef PCRE_CONFIG_JIT
-      pcre_free_study(rgd.study);
-#else
-      pcre_free(rgd.study);
-#endif
-      DEL_CHECK("pcre.extra");
-    }
-    pcre_free(rgd.re);
-    DEL_CHECK("pcre");
+    regexp_cache_release(cre);
 
     return rgd.count;
   } else {
@@ -0,0 +1,425 @@
+/** \file profile.c
+ *
+ * \brief Softcode profiler.
+ *
+ * Anything that wants to be timed calls profile_enter() before it
+ * starts and profile_leave() when it's done. The profiler keeps a
+ * stack of what's being timed, so each call's own time (not counting
+ * the calls it made) can be worked out, and so it can be added up
+ * both by name and by the whole stack of names above it.
+ *
+ * When it's not running, profile_enter() is just a test of a global,
+ * and nothing else is done.
+ */
+
+#include "copyrite.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+#include "conf.h"
+#include "dbdefs.h"
+#include "externs.h"
+#include "htab.h"
+#include "log.h"
+#include "mymalloc.h"
+#include "notify.h"
+#include "parse.h"
+#include "profile.h"
+#include "strutil.h"
+
+/** Deepest stack of calls that gets timed */
+#define PROFILE_MAX_DEPTH 256
+/** Bits of a frame handle that hold its depth; the rest hold the session */
+#define PROFILE_DEPTH_BITS 9
+/** Session numbers wrap around to fit in the rest of a frame handle */
+#define PROFILE_SESSION_MASK 0x3FFFFF
+/** Longest stack of names kept for flame graphs */
+#define PROFILE_PATH_LEN 2048
+/** Most distinct stacks kept. Time in any more is put in "(other)". */
+#define PROFILE_MAX_STACKS 20000
+/** Number of entries @profile/report shows by default */
+#define PROFILE_REPORT_COUNT 20
+/** Where @profile/export writes stacks */
+#define PROFILE_EXPORT_FILE "log/profile.folded"
+
+/** Totals for one name, or one stack of names */
+struct prof_entry {
+  char *name;          /**< The name or stack */
+  unsigned long calls; /**< Times it was called */
+  uint64_t total;      /**< Microseconds including calls it made */
+  uint64_t self;       /**< Microseconds not including calls it made */
+  uint64_t cpu;        /**< Microseconds of CPU time, including calls */
+  int active;          /**< How many times it's on the stack right now */
+};
+
+/** Something being timed */
+struct prof_frame {
+  struct prof_entry *entry; /**< Totals for its name */
+  uint64_t start;           /**< When it started */
+  uint64_t cpu_start;       /**< CPU time when it started */
+  uint64_t child;           /**< Microseconds spent in calls it made */
+  size_t pathlen;           /**< Length of the stack of names, with it */
+};
+
+bool profiling = false; /**< Is the profiler running? */
+
+static HASHTAB prof_names;  /**< Totals by name */
+static HASHTAB prof_stacks; /**< Totals by stack of names */
+static bool prof_inited = false;
+static struct prof_frame prof_stack[PROFILE_MAX_DEPTH];
+static int prof_depth = 0;
+static int prof_session = 0; /**< Bumped whenever the stack is thrown away */
+static char prof_path[PROFILE_PATH_LEN];
+static uint64_t prof_started = 0; /**< When the profiler last started */
+static uint64_t prof_elapsed = 0; /**< Time it ran before that */
+static dbref prof_owner = NOTHING;
+
+/** The current time, in microseconds. */
+static uint64_t
+profile_usecs(void)
+{
+#ifdef WIN32
+  LARGE_INTEGER li, frequency;
+  QueryPerformanceCounter(&li);
+  QueryPerformanceFrequency(&frequency);
+  return li.QuadPart * 1000000.0 / frequency.QuadPart;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return 1000000ULL * tv.tv_sec + tv.tv_usec;
+#endif
+}
+
+/** CPU time used by the process, in microseconds. */
+static uint64_t
+profile_cpu_usecs(void)
+{
+  return (uint64_t) ((double) clock() * 1000000.0 / CLOCKS_PER_SEC);
+}
+
+static void
+free_prof_entry(void *data)
+{
+  struct prof_entry *e = data;
+  mush_free(e->name, "profile.name");
+  mush_free(e, "profile.entry");
+}
+
+/** Find the totals for a name, adding them if they're new.
+ * \param tab table to look in.
+ * \param name the name.
+ * \return the totals.
+ */
+static struct prof_entry *
+profile_entry(HASHTAB *tab, const char *name)
+{
+  struct prof_entry *e;
+
+  e = hashfind(name, tab);
+  if (e)
+    return e;
+  if (tab == &prof_stacks && tab->entries >= PROFILE_MAX_STACKS) {
+    e = hashfind("(other)", tab);
+    if (e)
+      return e;
+    name = "(other)";
+  }
+  e = mush_malloc_zero(sizeof *e, "profile.entry");
+  e->name = mush_strdup(name, "profile.name");
+  hashadd(e->name, e, tab);
+  return e;
+}
+
+/** Start timing something. Use the profile_enter() macro instead.
+ * \param name what it's called in the profile.
+ * \return a frame to pass to profile_leave(), or 0 if it's not
+ * being timed. It holds the depth of the stack with this on top, and
+ * the session it was pushed in.
+ */
+int
+profile_push(const char *name)
+{
+  struct prof_frame *f;
+  size_t pathlen, len;
+
+  if (prof_depth >= PROFILE_MAX_DEPTH)
+    return 0;
+  f = &prof_stack[prof_depth];
+  f->entry = profile_entry(&prof_names, name);
+  f->entry->calls++;
+  f->entry->active++;
+  f->child = 0;
+
+  pathlen = prof_depth ? prof_stack[prof_depth - 1].pathlen : 0;
+  len = strlen(name);
+  if (pathlen + len + 2 <= sizeof prof_path) {
+    if (pathlen)
+      prof_path[pathlen++] = ';';
+    memcpy(prof_path + pathlen, name, len);
+    pathlen += len;
+  }
+  f->pathlen = pathlen;
+
+  prof_depth++;
+  f->cpu_start = profile_cpu_usecs();
+  f->start = profile_usecs();
+  return (prof_session << PROFILE_DEPTH_BITS) | prof_depth;
+}
+
+/** Start timing an attribute. Use the profile_enter_attr() macro
+ * instead.
+ * \param thing object the attribute is on.
+ * \param attrname name of the attribute.
+ * \return a frame to pass to profile_leave(), or 0.
+ */
+int
+profile_push_attr(dbref thing, const char *attrname)
+{
+  char name[BUFFER_LEN];
+
+  if (attrname)
+    snprintf(name, sizeof name, "#%d/%s", thing, attrname);
+  else
+    snprintf(name, sizeof name, "#%d", thing);
+  return profile_push(name);
+}
+
+/** Finish timing the frame on top of the stack. */
+static void
+profile_pop_one(void)
+{
+  struct prof_frame *f;
+  struct prof_entry *e;
+  uint64_t elapsed, self;
+
+  f = &prof_stack[--prof_depth];
+  e = f->entry;
+  elapsed = profile_usecs() - f->start;
+  self = elapsed > f->child ? elapsed - f->child : 0;
+  e->self += self;
+  if (--e->active == 0) {
+    /* Recursive calls are already counted by the outermost one */
+    e->total += elapsed;
+    e->cpu += profile_cpu_usecs() - f->cpu_start;
+  }
+  if (prof_depth)
+    prof_stack[prof_depth - 1].child += elapsed;
+
+  prof_path[f->pathlen] = '\0';
+  e = profile_entry(&prof_stacks, prof_path);
+  e->calls++;
+  e->self += self;
+}
+
+/** Stop timing something. Use the profile_leave() macro instead.
+ * Anything started after it and not finished yet is finished too.
+ * \param frame what profile_enter() returned.
+ */
+void
+profile_pop(int frame)
+{
+  int depth = frame & ((1 << PROFILE_DEPTH_BITS) - 1);
+
+  if ((frame >> PROFILE_DEPTH_BITS) != prof_session)
+    return; /* The profiler was stopped or cleared since */
+  while (prof_depth >= depth)
+    profile_pop_one();
+}
+
+/** Throw away the stack of things being timed. */
+static void
+profile_unwind(void)
+{
+  while (prof_depth > 0)
+    prof_stack[--prof_depth].entry->active--;
+  /* Frames from before this can't be popped any more, even once the
+   * stack is that deep again. */
+  prof_session = (prof_session + 1) & PROFILE_SESSION_MASK;
+}
+
+/** Start the profiler.
+ * \param player the enactor.
+ */
+void
+do_profile_start(dbref player)
+{
+  if (profiling) {
+    notify(player, T("The profiler is already running."));
+    return;
+  }
+  if (!prof_inited) {
+    hash_init(&prof_names, 256, free_prof_entry);
+    hash_init(&prof_stacks, 1024, free_prof_entry);
+    prof_inited = true;
+  }
+  profiling = true;
+  prof_owner = player;
+  prof_started = profile_usecs();
+  do_log(LT_WIZ, player, NOTHING, "Profiler started.");
+  notify(player, T("Profiler started."));
+}
+
+/** Stop the profiler. What it collected is kept until it's cleared.
+ * \param player the enactor.
+ */
+void
+do_profile_stop(dbref player)
+{
+  if (!profiling) {
+    notify(player, T("The profiler isn't running."));
+    return;
+  }
+  profile_unwind();
+  profiling = false;
+  prof_elapsed += profile_usecs() - prof_started;
+  do_log(LT_WIZ, player, NOTHING, "Profiler stopped.");
+  notify(player, T("Profiler stopped."));
+}
+
+/** Throw away everything the profiler has collected.
+ * \param player the enactor.
+ */
+void
+do_profile_clear(dbref player)
+{
+  if (prof_inited) {
+    profile_unwind();
+    hashflush(&prof_names, 256);
+    hashflush(&prof_stacks, 1024);
+  }
+  prof_elapsed = 0;
+  prof_started = profile_usecs();
+  notify(player, T("Profile cleared."));
+}
+
+/** How long the profiler has been running, in microseconds */
+static uint64_t
+profile_runtime(void)
+{
+  return prof_elapsed + (profiling ? profile_usecs() - prof_started : 0);
+}
+
+/** Tell a player whether the profiler is running.
+ * \param player the enactor.
+ */
+void
+do_profile_status(dbref player)
+{
+  if (profiling)
+    notify_format(player, T("The profiler was started by %s, and has run for "
+                            "%.3f seconds."),
+                  GoodObject(prof_owner) ? Name(prof_owner) : T("someone"),
+                  profile_runtime() / 1000000.0);
+  else if (prof_elapsed)
+    notify_format(player,
+                  T("The profiler is stopped, after running for %.3f seconds."),
+                  prof_elapsed / 1000000.0);
+  else
+    notify(player, T("The profiler isn't running."));
+  if (prof_inited)
+    notify_format(player, T("Names: %d   Stacks: %d"), prof_names.entries,
+                  prof_stacks.entries);
+}
+
+static int
+prof_entry_cmp(const void *a, const void *b)
+{
+  const struct prof_entry *const *ea = a;
+  const struct prof_entry *const *eb = b;
+
+  if ((*ea)->self > (*eb)->self)
+    return -1;
+  else if ((*ea)->self < (*eb)->self)
+    return 1;
+  else
+    return strcmp((*ea)->name, (*eb)->name);
+}
+
+/** Show the names that took the most time.
+ * \param player the enactor.
+ * \param count how many to show.
+ */
+void
+do_profile_report(dbref player, const char *count)
+{
+  struct prof_entry **entries, *e;
+  int n = 0, max = PROFILE_REPORT_COUNT, i;
+  uint64_t runtime;
+
+  if (count && *count) {
+    if (!is_strict_integer(count) || (max = parse_integer(count)) < 1) {
+      notify(player, T("How many entries do you want to see?"));
+      return;
+    }
+  }
+  if (!prof_inited || !prof_names.entries) {
+    notify(player, T("Nothing has been profiled."));
+    return;
+  }
+
+  entries = mush_calloc(prof_names.entries, sizeof *entries, "profile.report");
+  for (e = hash_firstentry(&prof_names); e; e = hash_nextentry(&prof_names))
+    entries[n++] = e;
+  qsort(entries, n, sizeof *entries, prof_entry_cmp);
+
+  runtime = profile_runtime();
+  notify_format(player, T("Profile of %.3f seconds, by time spent in each:"),
+                runtime / 1000000.0);
+  notify_format(player, "%-32s %9s %11s %11s %11s %6s", T("Name"), T("Calls"),
+                T("Total ms"), T("Self ms"), T("CPU ms"), T("Self%"));
+  for (i = 0; i < n && i < max; i++) {
+    e = entries[i];
+    notify_format(player, "%-32.32s %9lu %11.3f %11.3f %11.3f %5.1f%%",
+                  e->name, e->calls, e->total / 1000.0, e->self / 1000.0,
+                  e->cpu / 1000.0,
+                  runtime ? e->self * 100.0 / runtime : 0.0);
+  }
+  if (n > max)
+    notify_format(player, T("(%d more not shown)"), n - max);
+  mush_free(entries, "profile.report");
+}
+
+/** Write the time spent in each stack of names to a file, in the
+ * collapsed format that flame graph tools read: the names separated
+ * by semicolons, a space, and the microseconds spent there.
+ * \param player the enactor.
+ */
+void
+do_profile_export(dbref player)
+{
+  struct prof_entry *e;
+  FILE *fp;
+  int n = 0;
+
+  if (!prof_inited || !prof_stacks.entries) {
+    notify(player, T("Nothing has been profiled."));
+    return;
+  }
+  fp = fopen(PROFILE_EXPORT_FILE, "w");
+  if (!fp) {
+    notify_format(player, T("Unable to open %s: %s"), PROFILE_EXPORT_FILE,
+                  strerror(errno));
+    return;
+  }
+  for (e = hash_firstentry(&prof_stacks); e; e = hash_nextentry(&prof_stacks)) {
+    if (!e->self)
+      continue;
+    fprintf(fp, "%s %" PRIu64 "\n", e->name, e->self);
+    n++;
+  }
+  fclose(fp);
+  notify_format(player, T("Wrote %d stacks to %s."), n, PROFILE_EXPORT_FILE);
+}
@@ -20,6 +20,7 @@
 #include "strutil.h"
 
 #define EPSILON 0.000000001 /**< limit of precision for float equality */
+#define SLIST_RUN 8 /**< Runs slist_sort() insertion sorts before merging */
 
 /** If sort_order is positive, sort forward. If negative, it sorts backward. */
 #define ASCENDING 1
@@ -129,7 +130,7 @@ u_comp(const void *s1, const void *s2, dbref executor, dbref enactor,
   /* Our two arguments are passed as %0 and %1 to the sortby u-function. */
 
   /* Note that this function is for use in conjunction with our own
-   * sane_qsort routine, NOT with the standard library qsort!
+   * sane_msort routine, NOT with the standard library qsort!
    */
   pe_regs = pe_regs_create(PE_REGS_ARG, "u_comp");
   pe_regs_setenv_nocopy(pe_regs, 0, (char *) s1);
@@ -148,76 +149,76 @@ u_comp(const void *s1, const void *s2, dbref executor, dbref enactor,
   return n;
 }
 
+/** Merge two sorted runs of a sortby() array.
+ * array[left..mid] and array[mid+1..right] are each sorted; merge them
+ * through tmp, taking from the left run on ties so the sort is stable.
+ */
+static void
+sane_merge(void *array[], void *tmp[], int left, int mid, int right,
+           comp_func compare, dbref executor, dbref enactor,
+           ufun_attrib *ufun, NEW_PE_INFO *pe_info)
+{
+  int i = left, j = mid + 1, k = 0;
+
+  while (i <= mid && j <= right) {
+    if (compare(array[j], array[i], executor, enactor, ufun, pe_info) < 0)
+      tmp[k++] = array[j++];
+    else
+      tmp[k++] = array[i++];
+  }
+  while (i <= mid)
+    tmp[k++] = array[i++];
+  /* Anything left in the right run is already in place. */
+  memcpy(array + left, tmp, k * sizeof *tmp);
+}
+
 /** Used with fun_sortby()
  *
- * Based on Andrew Molitor's qsort, which doesn't require transitivity
- * between comparisons (essential for preventing crashes due to
- * boneheads who write comparison functions where a > b doesn't mean b
- * < a).
+ * A bottom-up merge sort. Every comparison calls back into softcode, so
+ * what matters is how many comparisons it makes, and a merge sort makes
+ * fewer than a quicksort does, skips the merge entirely for runs that
+ * are already in order, and is stable, so elements the comparison
+ * function calls equal keep their order.
+ *
+ * Like Andrew Molitor's qsort that this replaces, it doesn't need the
+ * comparisons to be transitive or commutative (essential for preventing
+ * crashes due to boneheads who write comparison functions where a > b
+ * doesn't mean b < a); the result just won't be sorted.
  *
- * Actually, this sort doesn't require commutivity.
- * Sorting doesn't make sense without transitivity...
+ * \param array the elements to sort.
+ * \param n the number of elements.
+ * \param compare the comparison function.
+ * \param executor executor of the sort.
+ * \param enactor enactor of the sort.
+ * \param ufun the comparison ufun, passed to compare.
+ * \param pe_info the pe_info, passed to compare.
  */
-
 void
-sane_qsort(void *array[], int left, int right, comp_func compare,
-           dbref executor, dbref enactor, ufun_attrib *ufun,
-           NEW_PE_INFO *pe_info)
+sane_msort(void *array[], int n, comp_func compare, dbref executor,
+           dbref enactor, ufun_attrib *ufun, NEW_PE_INFO *pe_info)
 {
+  void **tmp;
+  int width, left, mid, right;
 
-  int i, last;
-  void *tmp;
-
-loop:
-  if (left >= right)
+  if (n < 2)
     return;
 
-  /* Pick something at random at swap it into the leftmost slot   */
-  /* This is the pivot, we'll put it back in the right spot later */
-
-  i = get_random_u32(left, right);
-  tmp = array[i];
-  array[i] = array[left];
-  array[left] = tmp;
-
-  last = left;
-  for (i = left + 1; i <= right; i++) {
-
-    /* Walk the array, looking for stuff that's less than our */
-    /* pivot. If it is, swap it with the next thing along     */
-
-    if (compare(array[i], array[left], executor, enactor, ufun, pe_info) < 0) {
-      last++;
-      if (last == i)
+  tmp = mush_calloc(n, sizeof *tmp, "sane_msort");
+  for (width = 1; width < n; width *= 2) {
+    for (left = 0; left < n - width; left += width * 2) {
+      mid = left + width - 1;
+      right = left + width * 2 - 1;
+      if (right >= n)
+        right = n - 1;
+      /* Already in order? */
+      if (compare(array[mid + 1], array[mid], executor, enactor, ufun,
+                  pe_info) >= 0)
         continue;
-
-      tmp = array[last];
-      array[last] = array[i];
-      array[i] = tmp;
+      sane_merge(array, tmp, left, mid, right, compare, executor, enactor,
+                 ufun, pe_info);
     }
   }
-
-  /* Now we put the pivot back, it's now in the right spot, we never */
-  /* need to look at it again, trust me.                             */
-
-  tmp = array[last];
-  array[last] = array[left];
-  array[left] = tmp;
-
-  /* At this point everything underneath the 'last' index is < the */
-  /* entry at 'last' and everything above it is not < it.          */
-
-  if ((last - left) < (right - last)) {
-    sane_qsort(array, left, last - 1, compare, executor, enactor, ufun,
-               pe_info);
-    left = last + 1;
-    goto loop;
-  } else {
-    sane_qsort(array, last + 1, right, compare, executor, enactor, ufun,
-               pe_info);
-    right = last - 1;
-    goto loop;
-  }
+  mush_free(tmp, "sane_msort");
 }
 
 /****************************** gensort ************/
@@ -893,15 +894,60 @@ slist_build(dbref player, char *keys[], char *strs[], int n, ListTypeInfo *lti)
 
 /**
  * Given an array of s_rec items, sort them in-place using a specified
- * ListTypeInformation.
+ * ListTypeInformation. The keys were all worked out by slist_build(),
+ * so comparisons are cheap; this is a stable merge sort, so items with
+ * equal keys stay in the order they were in, which matters for
+ * sortkey().
  * \param sp the array of sort_records, returned by slist_build
  * \param n Number of items in sp
  * \param lti List Type Info describing how it's sorted and built.
  */
 void
-slist_qsort(s_rec *sp, int n, ListTypeInfo *lti)
+slist_sort(s_rec *sp, int n, ListTypeInfo *lti)
 {
-  qsort((void *) sp, n, sizeof(s_rec), lti->sorter);
+  s_rec *tmp;
+  int width, left, mid, right, i, j, k;
+
+  if (n < 2)
+    return;
+
+  /* Insertion sort short runs first. */
+  for (left = 0; left < n; left += SLIST_RUN) {
+    right = left + SLIST_RUN < n ? left + SLIST_RUN : n;
+    for (i = left + 1; i < right; i++) {
+      s_rec rec = sp[i];
+      for (j = i; j > left && lti->sorter(&sp[j - 1], &rec) > 0; j--)
+        sp[j] = sp[j - 1];
+      sp[j] = rec;
+    }
+  }
+  if (n <= SLIST_RUN)
+    return;
+
+  tmp = mush_calloc(n, sizeof *tmp, "slist_sort");
+  for (width = SLIST_RUN; width < n; width *= 2) {
+    for (left = 0; left < n - width; left += width * 2) {
+      mid = left + width - 1;
+      right = left + width * 2 - 1;
+      if (right >= n)
+        right = n - 1;
+      if (lti->sorter(&sp[mid], &sp[mid + 1]) <= 0)
+        continue;
+      i = left;
+      j = mid + 1;
+      k = 0;
+      while (i <= mid && j <= right) {
+        if (lti->sorter(&sp[j], &sp[i]) < 0)
+          tmp[k++] = sp[j++];
+        else
+          tmp[k++] = sp[i++];
+      }
+      while (i <= mid)
+        tmp[k++] = sp[i++];
+      memcpy(sp + left, tmp, k * sizeof *tmp);
+    }
+  }
+  mush_free(tmp, "slist_sort");
 }
 
 /**
@@ -986,7 +1032,7 @@ do_gensort(dbref player, char *keys[], char *strs[], int n, SortType sort_type)
 
   lti = get_list_type_info(sort_type);
   sp = slist_build(player, keys, strs, n, lti);
-  slist_qsort(sp, n, lti);
+  slist_sort(sp, n, lti);
 
   /* Change keys and strs around. */
   for (i = 0; i < n; i++) {
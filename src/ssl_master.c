@@ -154,6 +154,8 @@ make_ssl_slave(void)
     strcpy(cf.ca_dir, options.ssl_ca_dir);
     cf.require_client_cert = options.ssl_require_client_cert;
     cf.keepalive_timeout = options.keepalive_timeout;
+    cf.dns_cache_ttl = DNS_CACHE_TTL;
+    cf.dns_cache_size = DNS_CACHE_SIZE;
 
     if (write(ssl_slave_ctl_fd, &cf, sizeof cf) < 0) {
       do_rawlog(LT_ERR, "Unable to send ssl_slave config options: %s",
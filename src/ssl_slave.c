@@ -42,6 +42,7 @@
 #include "mysocket.h"
 #include "myssl.h"
 #include "ssl_slave.h"
+#include "hostcache.h"
 #include "wait.h"
 
 void errprintf(FILE *, const char *, ...)
@@ -55,6 +56,7 @@ void errputs(FILE *, const char *);
 pid_t parent_pid = -1;
 int ssl_sock = -1;
 int keepalive_timeout = 300;
+int dns_cache_ttl = 3600;
 const char *socket_file = NULL;
 struct event_base *main_loop = NULL;
 struct evdns_base *resolver = NULL;
@@ -247,37 +249,11 @@ local_connected(struct conn *c)
   free(hostid);
 }
 
-void address_resolved(int result, char type, int count,
-                      int ttl __attribute__((__unused__)), void *addresses,
-                      void *data);
-/** Called after the remote hostname has been resolved. */
-void
-address_resolved(int result, char type, int count,
-                 int ttl __attribute__((__unused__)), void *addresses,
-                 void *data)
+/** Open the local connection to the mush once the remote hostname is known. */
+static void
+connect_to_mush(struct conn *c)
 {
-  struct conn *c = data;
   struct sockaddr_un addr;
-  struct hostname_info *ipaddr;
-
-  c->resolver_req = NULL;
-
-  if (result == DNS_ERR_CANCEL) {
-    /*  Called on a connection that gets dropped while still doing the hostname
-     * lookup */
-    return;
-  }
-
-  if (result != DNS_ERR_NONE || !addresses || type != DNS_PTR || count == 0) {
-    ipaddr = ip_convert(&c->remote_addr.addr, c->remote_addrlen);
-    c->remote_host = strdup(ipaddr->hostname);
-    c->remote_ip = strdup(ipaddr->hostname);
-  } else {
-    const char *hostname = ((const char **) addresses)[0];
-    c->remote_host = strdup(hostname);
-    ipaddr = ip_convert(&c->remote_addr.addr, c->remote_addrlen);
-    c->remote_ip = strdup(ipaddr->hostname);
-  }
 
 #if SSL_DEBUG_LEVEL > 0
   errprintf(stdout,
@@ -294,10 +270,44 @@ address_resolved(int result, char type, int count,
     main_loop, -1, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_DEFER_CALLBACKS);
   bufferevent_socket_connect(c->local_bev, (struct sockaddr *) &addr,
                              sizeof addr);
-  bufferevent_setcb(c->local_bev, NULL, NULL, ssl_event_cb, data);
+  bufferevent_setcb(c->local_bev, NULL, NULL, ssl_event_cb, c);
   bufferevent_enable(c->local_bev, EV_WRITE);
 }
 
+void address_resolved(int result, char type, int count, int ttl,
+                      void *addresses, void *data);
+/** Called after the remote hostname has been resolved. */
+void
+address_resolved(int result, char type, int count, int ttl, void *addresses,
+                 void *data)
+{
+  struct conn *c = data;
+  struct hostname_info *ipaddr;
+  bool resolved;
+
+  c->resolver_req = NULL;
+
+  if (result == DNS_ERR_CANCEL) {
+    /*  Called on a connection that gets dropped while still doing the hostname
+     * lookup */
+    return;
+  }
+
+  resolved =
+    result == DNS_ERR_NONE && addresses && type == DNS_PTR && count > 0;
+  ipaddr = ip_convert(&c->remote_addr.addr, c->remote_addrlen);
+  c->remote_ip = strdup(ipaddr->hostname);
+  if (resolved) {
+    c->remote_host = strdup(((const char **) addresses)[0]);
+  } else {
+    c->remote_host = strdup(ipaddr->hostname);
+  }
+  hostcache_add(c->remote_ip, c->remote_host, time(NULL),
+                hostcache_ttl(resolved, ttl, dns_cache_ttl));
+
+  connect_to_mush(c);
+}
+
 void ssl_connected(struct conn *c);
 /** Called after the SSL connection and initial handshaking is complete. */
 void
@@ -305,6 +315,8 @@ ssl_connected(struct conn *c)
 {
   X509 *peer;
   SSL *ssl = bufferevent_openssl_get_ssl(c->remote_bev);
+  struct hostname_info *ipaddr;
+  const char *host;
 
 #if SSL_DEBUG_LEVEL > 0
   errprintf(
@@ -331,6 +343,13 @@ ssl_connected(struct conn *c)
   }
 
   c->state = C_HOSTNAME_LOOKUP;
+  ipaddr = ip_convert(&c->remote_addr.addr, c->remote_addrlen);
+  if (ipaddr && (host = hostcache_find(ipaddr->hostname, time(NULL)))) {
+    c->remote_ip = strdup(ipaddr->hostname);
+    c->remote_host = strdup(host);
+    connect_to_mush(c);
+    return;
+  }
   c->resolver_req =
     evdns_getnameinfo(resolver, &c->remote_addr.addr, 0, address_resolved, c);
 }
@@ -570,6 +589,8 @@ main(int argc __attribute__((__unused__)),
   }
 
   socket_file = cf.socket_file;
+  dns_cache_ttl = cf.dns_cache_ttl;
+  hostcache_init(cf.dns_cache_size);
 
   main_loop = event_base_new();
   resolver = evdns_base_new(main_loop, 1);
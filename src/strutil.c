@@ -1156,17 +1156,34 @@ char *
 replace_string2(const char *const old[2], const char *const newbits[2],
                 const char *restrict string)
 {
-  char *result, *rp;
-  char firsts[3] = {'\0', '\0', '\0'};
-  size_t oldlens[2], newlens[2];
+  char *result;
 
   if (!string)
     return NULL;
 
-  rp = result = mush_malloc(BUFFER_LEN, "replace_string.buff");
+  result = mush_malloc(BUFFER_LEN, "replace_string.buff");
   if (!result)
     mush_panic("Couldn't allocate memory in replace_string2!");
 
+  return replace_string2_buf(old, newbits, string, result);
+}
+
+/** Like replace_string2(), but puts the result in a buffer supplied
+ * by the caller instead of allocating one.
+ * \param old array of two strings to find.
+ * \param newbits array of two strings to replace old with.
+ * \param string string to search for old.
+ * \param result buffer of BUFFER_LEN bytes to hold the result.
+ * \return result.
+ */
+char *
+replace_string2_buf(const char *const old[2], const char *const newbits[2],
+                    const char *restrict string, char *restrict result)
+{
+  char *rp = result;
+  char firsts[3] = {'\0', '\0', '\0'};
+  size_t oldlens[2], newlens[2];
+
   firsts[0] = old[0][0];
   firsts[1] = old[1][0];
 
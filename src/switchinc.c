@@ -1,6 +1,6 @@
 /* AUTOGENERATED FILE. DO NOT EDIT! */
-static const int max_switch = 190;
-SWITCH_VALUE switch_list[191] = {
+static const int max_switch = 197;
+SWITCH_VALUE switch_list[198] = {
   {"ACCESS", SWITCH_ACCESS, 0},
   {"ADD", SWITCH_ADD, 0},
   {"AFTER", SWITCH_AFTER, 0},
@@ -47,6 +47,7 @@ SWITCH_VALUE switch_list[191] = {
   {"EQSPLIT", SWITCH_EQSPLIT, 0},
   {"ERR", SWITCH_ERR, 0},
   {"EXITS", SWITCH_EXITS, 0},
+  {"EXPORT", SWITCH_EXPORT, 0},
   {"EXTEND", SWITCH_EXTEND, 0},
   {"FILE", SWITCH_FILE, 0},
   {"FIRST", SWITCH_FIRST, 0},
@@ -91,6 +92,7 @@ SWITCH_VALUE switch_list[191] = {
   {"MOTD", SWITCH_MOTD, 0},
   {"MUTE", SWITCH_MUTE, 0},
   {"NAME", SWITCH_NAME, 0},
+  {"NET", SWITCH_NET, 0},
   {"NO", SWITCH_NO, 0},
   {"NOBREAK", SWITCH_NOBREAK, 0},
   {"NOCASE", SWITCH_NOCASE, 0},
@@ -125,6 +127,7 @@ SWITCH_VALUE switch_list[191] = {
   {"PRIVS", SWITCH_PRIVS, 0},
   {"PURGE", SWITCH_PURGE, 0},
   {"PUT", SWITCH_PUT, 0},
+  {"QUEUE", SWITCH_QUEUE, 0},
   {"QUEUED", SWITCH_QUEUED, 0},
   {"QUICK", SWITCH_QUICK, 0},
   {"QUIET", SWITCH_QUIET, 0},
@@ -137,6 +140,7 @@ SWITCH_VALUE switch_list[191] = {
   {"REMIT", SWITCH_REMIT, 0},
   {"REMOVE", SWITCH_REMOVE, 0},
   {"RENAME", SWITCH_RENAME, 0},
+  {"REPORT", SWITCH_REPORT, 0},
   {"RESTART", SWITCH_RESTART, 0},
   {"RESTORE", SWITCH_RESTORE, 0},
   {"RESTRICT", SWITCH_RESTRICT, 0},
@@ -160,14 +164,17 @@ SWITCH_VALUE switch_list[191] = {
   {"SKIPDEFAULTS", SWITCH_SKIPDEFAULTS, 0},
   {"SPEAK", SWITCH_SPEAK, 0},
   {"SPOOF", SWITCH_SPOOF, 0},
+  {"START", SWITCH_START, 0},
   {"STATS", SWITCH_STATS, 0},
   {"STATUS", SWITCH_STATUS, 0},
+  {"STOP", SWITCH_STOP, 0},
   {"SUMMARY", SWITCH_SUMMARY, 0},
   {"TABLES", SWITCH_TABLES, 0},
   {"TAG", SWITCH_TAG, 0},
   {"TELEPORT", SWITCH_TELEPORT, 0},
   {"TF", SWITCH_TF, 0},
   {"THINGS", SWITCH_THINGS, 0},
+  {"TIMERS", SWITCH_TIMERS, 0},
   {"TITLE", SWITCH_TITLE, 0},
   {"TRACE", SWITCH_TRACE, 0},
   {"TRIM", SWITCH_TRIM, 0},
@@ -394,52 +394,271 @@ reset_cpu_timer(void)
 #endif /* PROFILING */
 }
 
-/** System queue stuff. Timed events like dbcks and purges are handled
- *  through this system. */
+/** The time in milliseconds on a clock that only moves forward, even
+ * if the system clock is changed. It's never 0.
+ * \return the time in milliseconds.
+ */
+uint64_t
+monotonic_msecs(void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec now;
 
-struct squeue *sq_head = NULL;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000 + 1;
+#endif
+  return (uint64_t) time(NULL) * 1000;
+}
 
-/** Register a callback function to be executed at a certain time.
- * \param w when to run the event
- * \param f the callback function
- * \param d data to pass to the callback
- * \param ev Softcode event to trigger at the same time.
- * \return pointer to the newly added squeue
+/** The time in microseconds on the same clock as monotonic_msecs().
+ * It's never 0.
+ * \return the time in microseconds.
  */
-struct squeue *
-sq_register(time_t w, sq_func f, void *d, const char *ev)
+uint64_t
+monotonic_usecs(void)
 {
-  struct squeue *sq;
+#ifdef CLOCK_MONOTONIC
+  struct timespec now;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000 + 1;
+#endif
+  return (uint64_t) time(NULL) * 1000000;
+}
+
+/* System queue stuff. Timed events like dbcks and purges are handled
+ * through this system.
+ *
+ * Pending events are kept in a hierarchical timing wheel with one
+ * millisecond ticks. Level 0 has a slot for each of the next 64
+ * milliseconds, level 1 a slot for each of the next 64 runs of level 0,
+ * and so on. An event goes in the lowest level where its time only
+ * differs from sq_now in that level's bits, and is moved down a level
+ * when sq_now reaches the start of its slot. Adding and cancelling an
+ * event is O(1), and finding the next slot with anything in it is a
+ * matter of checking a bitmap per level. Events too far off for the
+ * top level wait in sq_overflow until it wraps around.
+ */
+
+#define SQ_WHEEL_BITS 6
+#define SQ_WHEEL_SLOTS (1 << SQ_WHEEL_BITS)
+#define SQ_WHEEL_LEVELS 5
+/** Shift for the bits of a time that pick its slot at a level */
+#define SQ_SHIFT(level) ((level) *SQ_WHEEL_BITS)
+
+static struct squeue *sq_wheel[SQ_WHEEL_LEVELS][SQ_WHEEL_SLOTS];
+static uint64_t sq_used[SQ_WHEEL_LEVELS]; /**< Bitmaps of non-empty slots */
+static struct squeue *sq_overflow = NULL; /**< Events past the top level */
+static struct squeue *sq_due = NULL;      /**< Events ready to run */
+static struct squeue **sq_due_tail = &sq_due;
+static uint64_t sq_now = 0;       /**< Time the wheel has been run up to */
+static int sq_pending = 0;        /**< Number of events registered */
+static slab *squeue_slab = NULL;  /**< Pool of squeue nodes */
+static struct squeue *sq_running = NULL; /**< Event being run right now */
+static struct squeue *sq_every_second = NULL; /**< on_every_second's event */
+
+/** Link an event into the front of a list. */
+static void
+sq_link(struct squeue **head, struct squeue *sq)
+{
+  sq->next = *head;
+  if (sq->next)
+    sq->next->pprev = &sq->next;
+  sq->pprev = head;
+  *head = sq;
+}
+
+/** Unlink an event from whatever list it's in. */
+static void
+sq_unlink(struct squeue *sq)
+{
+  int level = sq->level;
+
+  if (level < 0 && sq_due_tail == &sq->next)
+    sq_due_tail = sq->pprev;
+  if (sq->next)
+    sq->next->pprev = sq->pprev;
+  *sq->pprev = sq->next;
+  if (level >= 0 && level < SQ_WHEEL_LEVELS && !sq_wheel[level][sq->slot])
+    sq_used[level] &= ~(UINT64_C(1) << sq->slot);
+  sq->next = NULL;
+  sq->pprev = NULL;
+}
+
+/** Put an event where it belongs for its time. */
+static void
+sq_place(struct squeue *sq)
+{
+  uint64_t diff;
+  int level;
+
+  if (sq->when <= sq_now) {
+    /* Already due; add it to the end of the due list */
+    sq->level = -1;
+    sq->next = NULL;
+    sq->pprev = sq_due_tail;
+    *sq_due_tail = sq;
+    sq_due_tail = &sq->next;
+    return;
+  }
+  diff = sq->when ^ sq_now;
+  for (level = 0; level < SQ_WHEEL_LEVELS; level++)
+    if ((diff >> SQ_SHIFT(level + 1)) == 0)
+      break;
+  if (level == SQ_WHEEL_LEVELS) {
+    sq->level = SQ_WHEEL_LEVELS;
+    sq_link(&sq_overflow, sq);
+    return;
+  }
+  sq->level = level;
+  sq->slot = (sq->when >> SQ_SHIFT(level)) & (SQ_WHEEL_SLOTS - 1);
+  sq_link(&sq_wheel[level][sq->slot], sq);
+  sq_used[level] |= UINT64_C(1) << sq->slot;
+}
+
+/** Move all the events in a list back through sq_place(). */
+static void
+sq_replace_all(struct squeue **head)
+{
+  struct squeue *sq, *next;
+
+  sq = *head;
+  *head = NULL;
+  for (; sq; sq = next) {
+    next = sq->next;
+    sq_place(sq);
+  }
+}
 
-  sq = mush_malloc(sizeof *sq, "squeue.node");
+/** The lowest set bit in a non-zero bitmap. */
+static inline int
+sq_lowest_bit(uint64_t bits)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(bits);
+#else
+  int n = 0;
+  while (!(bits & 1)) {
+    bits >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+/** The earliest time anything in the wheel might be due.
+ * For levels above 0 this is the start of the slot, which is when its
+ * events get moved down a level.
+ * \return the time, or UINT64_MAX if the wheel is empty.
+ */
+static uint64_t
+sq_next_slot(void)
+{
+  uint64_t best = UINT64_MAX;
+  int level;
+
+  for (level = 0; level < SQ_WHEEL_LEVELS; level++) {
+    int cur = (sq_now >> SQ_SHIFT(level)) & (SQ_WHEEL_SLOTS - 1);
+    uint64_t later, start;
+
+    if (cur == SQ_WHEEL_SLOTS - 1)
+      continue;
+    later = sq_used[level] & (~UINT64_C(0) << (cur + 1));
+    if (!later)
+      continue;
+    start = (sq_now >> SQ_SHIFT(level + 1)) << SQ_SHIFT(level + 1);
+    start |= (uint64_t) sq_lowest_bit(later) << SQ_SHIFT(level);
+    if (start < best)
+      best = start;
+    /* Anything on a higher level is later than this */
+    break;
+  }
+  if (best == UINT64_MAX && sq_overflow)
+    best = ((sq_now >> SQ_SHIFT(SQ_WHEEL_LEVELS)) + 1)
+           << SQ_SHIFT(SQ_WHEEL_LEVELS);
+  return best;
+}
+
+/** Run the wheel up to a time, moving events that are due onto the due
+ * list.
+ * \param now the time to run up to.
+ */
+static void
+sq_advance(uint64_t now)
+{
+  while (sq_now < now) {
+    uint64_t next = sq_next_slot();
+    int level;
+
+    if (next > now) {
+      sq_now = now;
+      return;
+    }
+    sq_now = next;
+    if ((sq_now & ((UINT64_C(1) << SQ_SHIFT(SQ_WHEEL_LEVELS)) - 1)) == 0)
+      sq_replace_all(&sq_overflow);
+    for (level = SQ_WHEEL_LEVELS - 1; level >= 0; level--) {
+      int slot;
+
+      if (sq_now & ((UINT64_C(1) << SQ_SHIFT(level)) - 1))
+        continue;
+      slot = (sq_now >> SQ_SHIFT(level)) & (SQ_WHEEL_SLOTS - 1);
+      sq_used[level] &= ~(UINT64_C(1) << slot);
+      sq_replace_all(&sq_wheel[level][slot]);
+    }
+  }
+}
 
-  sq->when = w;
+/** Add an event to run at a time on the monotonic_msecs() clock. */
+static struct squeue *
+sq_add(uint64_t when, int loop, sq_func f, void *d, const char *ev)
+{
+  struct squeue *sq;
+
+  if (!squeue_slab) {
+    squeue_slab = slab_create("squeue nodes", sizeof(struct squeue));
+    sq_now = monotonic_msecs();
+  }
+  sq = slab_malloc(squeue_slab, NULL);
+  sq->when = when;
+  sq->loop = loop;
   sq->fun = f;
   sq->data = d;
   if (ev)
     sq->event = strupper_a(ev, "squeue.event");
   else
     sq->event = NULL;
-  sq->next = NULL;
+  sq_place(sq);
+  sq_pending++;
+  return sq;
+}
 
-  if (!sq_head)
-    sq_head = sq;
-  else if (difftime(w, sq_head->when) <= 0) {
-    sq->next = sq_head;
-    sq_head = sq;
-  } else {
-    struct squeue *c, *prev = NULL;
-    for (prev = sq_head, c = sq_head->next; c; prev = c, c = c->next) {
-      if (difftime(w, c->when) <= 0) {
-        sq->next = c;
-        prev->next = sq;
-        return sq;
-      }
-    }
-    prev->next = sq;
-  }
+/** Get rid of an event that's been taken out of the wheel. */
+static void
+sq_free(struct squeue *sq)
+{
+  if (sq->event)
+    mush_free(sq->event, "squeue.event");
+  slab_free(squeue_slab, sq);
+  sq_pending--;
+}
 
-  return sq;
+/** Register a callback function to be executed at a certain time.
+ * \param w when to run the event
+ * \param f the callback function
+ * \param d data to pass to the callback
+ * \param ev Softcode event to trigger at the same time.
+ * \return pointer to the newly added squeue
+ */
+struct squeue *
+sq_register(time_t w, sq_func f, void *d, const char *ev)
+{
+  double secs = difftime(w, time(NULL));
+  uint64_t now = monotonic_msecs();
+
+  if (secs < 0)
+    secs = 0;
+  return sq_add(now + (uint64_t) (secs * 1000), 0, f, d, ev);
 }
 
 /** Cancel an entry in the system queue.
@@ -448,25 +667,17 @@ sq_register(time_t w, sq_func f, void *d, const char *ev)
 void
 sq_cancel(struct squeue *sq)
 {
-  struct squeue *tmp, *prev = NULL;
-
   if (!sq)
     return;
-
-  /* Remove from list */
-  for (tmp = sq_head; tmp; tmp = tmp->next) {
-    if (tmp == sq) {
-      if (prev)
-        prev->next = tmp->next;
-      else
-        sq_head = tmp->next;
-      if (sq->event)
-        mush_free(sq->event, "squeue.event");
-      mush_free(sq, "squeue.node");
-      return;
-    }
-    prev = tmp;
+  if (sq == sq_running) {
+    /* sq_run_one() frees it when the callback returns */
+    sq->fun = NULL;
+    return;
   }
+  if (sq == sq_every_second)
+    sq_every_second = NULL;
+  sq_unlink(sq);
+  sq_free(sq);
 }
 
 /** Register a callback function to be executed in N seconds.
@@ -479,32 +690,11 @@ sq_cancel(struct squeue *sq)
 struct squeue *
 sq_register_in(int n, sq_func f, void *d, const char *ev)
 {
-  time_t now;
-  time(&now);
-  return sq_register(now + n, f, d, ev);
-}
-
-/** A timed event that runs on a loop */
-struct sq_loop {
-  sq_func fun;       /**< The function to run for the event */
-  void *data;        /**< The data for the event */
-  const char *event; /**< The name of the event attr to trigger */
-  int secs;          /**< How often to run the event */
-};
-
-static bool
-sq_loop_fun(void *arg)
-{
-  struct sq_loop *loop = arg;
-  bool res;
-
-  res = loop->fun(loop->data);
-  sq_register_in(loop->secs, sq_loop_fun, arg, loop->event);
-
-  return res;
+  return sq_add(monotonic_msecs() + (uint64_t) n * 1000, 0, f, d, ev);
 }
 
 /** Register a callback function to run every N seconds.
+ * The same squeue is put back in the wheel after every run.
  * \param n the number of seconds to wait between calls.
  * \param f the callback function.
  * \param d data to pass to the callback.
@@ -513,18 +703,11 @@ sq_loop_fun(void *arg)
 void
 sq_register_loop(int n, sq_func f, void *d, const char *ev)
 {
-  struct sq_loop *loop;
-
-  loop = mush_malloc(sizeof *loop, "squeue.node");
-  loop->fun = f;
-  loop->data = d;
-  if (ev)
-    loop->event = strupper_a(ev, "squeue.event");
-  else
-    loop->event = NULL;
-  loop->secs = n;
+  struct squeue *sq;
 
-  sq_register_in(n, sq_loop_fun, loop, ev);
+  sq = sq_add(monotonic_msecs() + (uint64_t) n * 1000, n * 1000, f, d, ev);
+  if (f == on_every_second)
+    sq_every_second = sq;
 }
 
 /** Execute a single pending system queue event.
@@ -533,25 +716,27 @@ sq_register_loop(int n, sq_func f, void *d, const char *ev)
 bool
 sq_run_one(void)
 {
-  time_t now;
-  struct squeue *n;
-
-  time(&now);
-
-  if (sq_head) {
-    if (difftime(sq_head->when, now) <= 0) {
-      bool r = sq_head->fun(sq_head->data);
-      if (r && sq_head->event)
-        queue_event(SYSEVENT, sq_head->event, "%s", "");
-      n = sq_head->next;
-      if (sq_head->event)
-        mush_free(sq_head->event, "squeue.event");
-      mush_free(sq_head, "squeue.node");
-      sq_head = n;
-      return true;
-    }
-  }
-  return false;
+  struct squeue *sq;
+  bool r;
+
+  if (!sq_due)
+    sq_advance(monotonic_msecs());
+  if (!sq_due)
+    return false;
+
+  sq = sq_due;
+  sq_unlink(sq);
+  sq_running = sq;
+  r = sq->fun(sq->data);
+  sq_running = NULL;
+  if (r && sq->event)
+    queue_event(SYSEVENT, sq->event, "%s", "");
+  if (sq->loop && sq->fun) {
+    sq->when = monotonic_msecs() + sq->loop;
+    sq_place(sq);
+  } else
+    sq_free(sq);
+  return true;
 }
 
 /** Run all pending system queue events.
@@ -570,15 +755,91 @@ sq_run_all(void)
   return any;
 }
 
+/** How long until the next system queue event might be due.
+ * The once a second queue housekeeping doesn't count, so an idle game
+ * doesn't have to wake up for it.
+ * \return milliseconds, which may be less than the real time left.
+ */
 int
-sq_secs_till_next(void)
+sq_msecs_till_next(void)
 {
-  time_t now = time(NULL);
-  for (struct squeue *s = sq_head; s; s = s->next) {
-    if (s->fun == sq_loop_fun &&
-        ((struct sq_loop *) s->data)->fun == on_every_second)
-      continue;
-    return difftime(s->when, now);
+  uint64_t next, now;
+
+  if (sq_due)
+    return 0;
+  if (sq_every_second)
+    sq_unlink(sq_every_second);
+  next = sq_next_slot();
+  if (sq_every_second)
+    sq_place(sq_every_second);
+  now = monotonic_msecs();
+  if (next <= now)
+    return 0;
+  if (next - now > 500000)
+    return 500000;
+  return (int) (next - now);
+}
+
+static int
+sq_when_cmp(const void *a, const void *b)
+{
+  const struct squeue *sa = *(struct squeue *const *) a;
+  const struct squeue *sb = *(struct squeue *const *) b;
+
+  if (sa->when < sb->when)
+    return -1;
+  return sa->when > sb->when;
+}
+
+/** Add the events in a list to an array. */
+static void
+sq_collect(struct squeue *sq, struct squeue **list, int *n)
+{
+  for (; sq && *n < sq_pending; sq = sq->next)
+    list[(*n)++] = sq;
+}
+
+/** List pending system queue events, for \@stats/timers.
+ * \param player the player to tell.
+ */
+void
+sq_stats(dbref player)
+{
+  struct squeue **list;
+  uint64_t now = monotonic_msecs();
+  int n = 0, i, level, slot;
+
+  notify_format(player, T("Pending system events: %d"), sq_pending);
+  for (level = 0; level < SQ_WHEEL_LEVELS; level++) {
+    int count = 0;
+    for (slot = 0; slot < SQ_WHEEL_SLOTS; slot++)
+      for (struct squeue *sq = sq_wheel[level][slot]; sq; sq = sq->next)
+        count++;
+    notify_format(player, T("Wheel level %d (%lums slots): %d"), level,
+                  (unsigned long) (UINT64_C(1) << SQ_SHIFT(level)), count);
+  }
+  if (!sq_pending)
+    return;
+
+  list = mush_calloc(sq_pending, sizeof *list, "squeue.stats");
+  sq_collect(sq_due, list, &n);
+  sq_collect(sq_overflow, list, &n);
+  for (level = 0; level < SQ_WHEEL_LEVELS; level++)
+    for (slot = 0; slot < SQ_WHEEL_SLOTS; slot++)
+      sq_collect(sq_wheel[level][slot], list, &n);
+  qsort(list, n, sizeof *list, sq_when_cmp);
+
+  notify(player, T("       Due In      Every  Event"));
+  for (i = 0; i < n; i++) {
+    uint64_t left = list[i]->when > now ? list[i]->when - now : 0;
+    char every[20];
+
+    if (list[i]->loop)
+      snprintf(every, sizeof every, "%ds", list[i]->loop / 1000);
+    else
+      strcpy(every, "-");
+    notify_format(player, "%12.3fs %10s  %s", left / 1000.0, every,
+                  list[i]->event ? list[i]->event : "-");
   }
-  return 500;
+  mush_free(list, "squeue.stats");
 }
@@ -42,6 +42,7 @@
 #include "attrib.h"
 #include "conf.h"
 #include "externs.h"
+#include "htab.h"
 #include "log.h"
 #include "mymalloc.h"
 #include "parse.h"
@@ -385,6 +386,107 @@ free_tzinfo(struct tzinfo *tz)
   mush_free(tz, "timezone");
 }
 
+/* Loaded time zones.
+ *
+ * Time functions with a zone argument are often called over and over
+ * with the same few zones (an iter() over the WHO list, say), so zones
+ * are kept after they're read, keyed on their name. Zones that don't
+ * exist are remembered too. Each zone's file is checked for changes
+ * every TZ_CACHE_CHECK seconds, and the whole cache is thrown out on
+ * \@readcache and SIGHUP.
+ */
+
+#ifdef HAVE_ZONEINFO
+/** Most time zones to keep loaded */
+#define TZ_CACHE_SIZE 64
+/** How often to check a loaded zone's file for changes, in seconds */
+#define TZ_CACHE_CHECK 60
+
+/** A loaded time zone */
+struct tz_cache_entry {
+  struct tzinfo *tz; /**< The zone, or NULL if there's no such zone */
+  time_t mtime;      /**< Modification time of its file, or 0 */
+  time_t checked;    /**< When mtime was last checked */
+};
+
+static HASHTAB tz_cache;
+static bool tz_cache_inited = false;
+
+static void
+free_tz_cache_entry(void *data)
+{
+  struct tz_cache_entry *entry = data;
+
+  if (entry->tz)
+    free_tzinfo(entry->tz);
+  mush_free(entry, "timezone.cache");
+}
+
+/** Modification time of a zone's file, or 0 if it can't be read. */
+static time_t
+tzfile_mtime(const char *tzname)
+{
+  struct stat info;
+  char path[BUFFER_LEN];
+
+  snprintf(path, sizeof path, "%s/%s", TZDIR, tzname);
+  if (stat(path, &info) < 0)
+    return 0;
+  return info.st_mtime;
+}
+
+/** Get a time zone, reading it if it isn't already loaded. The result
+ * belongs to the cache; don't free it, or keep it past the next call.
+ * \param tzname the name of the zone.
+ * \return the zone, or NULL if there's no such zone.
+ */
+static struct tzinfo *
+cached_tzfile(const char *tzname)
+{
+  struct tz_cache_entry *entry;
+
+  if (!is_valid_tzname(tzname))
+    return NULL;
+
+  if (!tz_cache_inited) {
+    hash_init(&tz_cache, TZ_CACHE_SIZE, free_tz_cache_entry);
+    tz_cache_inited = true;
+  }
+
+  entry = hashfind(tzname, &tz_cache);
+  if (entry && mudtime - entry->checked >= TZ_CACHE_CHECK) {
+    if (tzfile_mtime(tzname) != entry->mtime) {
+      hashdelete(tzname, &tz_cache);
+      entry = NULL;
+    } else {
+      entry->checked = mudtime;
+    }
+  }
+  if (entry)
+    return entry->tz;
+
+  if (tz_cache.entries >= TZ_CACHE_SIZE)
+    flush_tz_cache();
+  entry = mush_malloc(sizeof *entry, "timezone.cache");
+  entry->mtime = tzfile_mtime(tzname);
+  entry->tz = read_tzfile(tzname);
+  entry->checked = mudtime;
+  hashadd(tzname, entry, &tz_cache);
+  return entry->tz;
+}
+#endif /* HAVE_ZONEINFO */
+
+/** Forget all loaded time zones, so they're read again when next used.
+ */
+void
+flush_tz_cache(void)
+{
+#ifdef HAVE_ZONEINFO
+  if (tz_cache_inited)
+    hashflush(&tz_cache, TZ_CACHE_SIZE);
+#endif
+}
+
 /** Given a time zone struct and a time, return the offset in seconds from GMT
  * at that time.
  * \param tz the time zone description struct
@@ -394,7 +496,7 @@ free_tzinfo(struct tzinfo *tz)
 int32_t
 offset_for_tzinfo(struct tzinfo *tz, time_t when)
 {
-  int n;
+  int n, lo, hi;
 
   if (tz->timecnt == 0 || when < tz->transitions[0]) {
     for (n = 0; n < tz->typecnt; n += 1)
@@ -404,11 +506,18 @@ offset_for_tzinfo(struct tzinfo *tz, time_t when)
     return tz->offsets[0].tt_gmtoff;
   }
 
-  for (n = 0; n < tz->timecnt - 1; n += 1)
-    if (when >= tz->transitions[n] && when < tz->transitions[n + 1])
-      return tz->offsets[tz->offset_indexes[n]].tt_gmtoff;
+  /* Binary search for the last transition at or before when. */
+  lo = 0;
+  hi = tz->timecnt - 1;
+  while (lo < hi) {
+    n = lo + (hi - lo + 1) / 2;
+    if (tz->transitions[n] <= when)
+      lo = n;
+    else
+      hi = n - 1;
+  }
 
-  return tz->offsets[tz->offset_indexes[n]].tt_gmtoff;
+  return tz->offsets[tz->offset_indexes[lo]].tt_gmtoff;
 }
 
 /** Parse a softcode timezone request.
@@ -471,7 +580,7 @@ parse_timezone_arg(const char *arg, time_t when, struct tz_result *res)
     static char tz_path[BUFFER_LEN];
 
     if (is_valid_tzname(arg)) {
-      tz = read_tzfile(arg);
+      tz = cached_tzfile(arg);
       snprintf(tz_path, sizeof tz_path, ":%s", arg);
     } else if (is_strict_integer(arg)) {
       int offset;
@@ -484,13 +593,12 @@ parse_timezone_arg(const char *arg, time_t when, struct tz_result *res)
       offset = -offset;
 
       snprintf(tzname, sizeof tzname, "Etc/GMT%+d", offset);
-      tz = read_tzfile(tzname);
+      tz = cached_tzfile(tzname);
       snprintf(tz_path, sizeof tz_path, ":%s", tzname);
     }
 
     if (tz) {
       res->tz_offset = offset_for_tzinfo(tz, when);
-      free_tzinfo(tz);
       res->tz_name = tz_path;
       res->tz_has_file = 1;
       return 1;
@@ -51,6 +51,8 @@
 #include "mushdb.h"
 #include "mymalloc.h"
 #include "parse.h"
+#include "pecode.h"
+#include "profile.h"
 #include "strutil.h"
 #include "pcg_basic.h"
 
@@ -114,6 +116,7 @@ fetch_ufun_attrib(const char *attrstring, dbref executor, ufun_attrib *ufun,
   ufun->thing = executor;
   ufun->pe_flags = PE_UDEFAULT;
   ufun->ufun_flags = flags;
+  ufun->data = NULL_CHUNK_REFERENCE;
 
   ufun->thing = executor;
   thingname = NULL;
@@ -226,6 +229,7 @@ fetch_ufun_attrib(const char *attrstring, dbref executor, ufun_attrib *ufun,
   /* Populate the ufun object */
   mush_strncpy(ufun->contents, atr_value(attrib), BUFFER_LEN);
   mush_strncpy(ufun->attrname, AL_NAME(attrib), ATTRIBUTE_NAME_LIMIT + 1);
+  ufun->data = attrib->data;
 
   /* We're good */
   return 1;
@@ -261,6 +265,7 @@ call_ufun_int(ufun_attrib *ufun, char *ret, dbref caller, dbref enactor,
   PE_REGS *pe_regs;
   PE_REGS *pe_regs_old;
   int pe_reg_flags = 0;
+  int pframe;
 
   /* Make sure we have a ufun first */
   if (!ufun)
@@ -318,8 +323,10 @@ call_ufun_int(ufun_attrib *ufun, char *ret, dbref caller, dbref enactor,
 
   /* And now, make the call! =) */
   ap = ufun->contents;
-  pe_ret = process_expression(ret, &rp, &ap, ufun->thing, caller, enactor,
-                              ufun->pe_flags, PT_DEFAULT, pe_info);
+  pframe = profile_enter(*ufun->attrname ? pe_info->attrname : "#LAMBDA");
+  pe_ret = process_attr_expression(ret, &rp, &ap, ufun->data, ufun->thing,
+                                   caller, enactor, ufun->pe_flags, pe_info);
+  profile_leave(pframe);
   *rp = '\0';
 
   if ((ufun->ufun_flags & UFUN_NAME) && np == rp) {
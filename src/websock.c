@@ -19,6 +19,7 @@
 #include "confmagic.h"
 #include "strutil.h"
 #include "notify.h"
+#include "mymalloc.h"
 
 #ifndef WITHOUT_WEBSOCKETS
 #include "websock.h"
@@ -49,6 +50,27 @@ enum WebSocketOp {
   /* 0xB - 0xF reserved for control frames */
 };
 
+#ifdef HAVE_LIBZ
+/* RSV1 marks a compressed message (RFC 7692, section 6). */
+#define WS_RSV1 0x40
+
+/* Most a compressed message from a client may expand to. */
+#define WS_INFLATE_LIMIT (16 * BUFFER_LEN)
+
+/* Every compressed message ends with these bytes, which are left off. */
+static const char deflate_tail[4] = {0x00, 0x00, (char) 0xFF, (char) 0xFF};
+
+static int deflate_window_bits(void);
+static bool accept_deflate_offer(DESC *d, char *offer);
+static void parse_extensions(DESC *d, const char *value);
+static bool start_deflate(DESC *d);
+static char *write_deflated_message(struct ws_deflate *wd, char *dst,
+                                    char *const dstend, const char *src,
+                                    size_t srclen, char channel);
+static bool inflate_payload(DESC *d, const char *src, size_t srclen,
+                            bool last, unsigned char *first);
+#endif /* HAVE_LIBZ */
+
 /* Base64 encoder. PennMUSH's version uses the heavyweight OpenSSL API. */
 static void
 encode64(char *dst, const char *src, size_t srclen)
@@ -122,6 +144,7 @@ abort_handshake(DESC *d)
     RESPONSE_LEN = strlen(RESPONSE);
   }
 
+  ws_deflate_free(d);
   queue_newwrite(d, RESPONSE, RESPONSE_LEN);
 }
 
@@ -148,8 +171,31 @@ complete_handshake(DESC *d)
   compute_websocket_accept(bp, d->checksum);
   bp += WEBSOCKET_ACCEPT_LEN;
 
-  memcpy(bp, "\r\n\r\n", 4);
-  bp += 4;
+  memcpy(bp, "\r\n", 2);
+  bp += 2;
+
+#ifdef HAVE_LIBZ
+  if (d->ws_deflate && start_deflate(d)) {
+    struct ws_deflate *wd = d->ws_deflate;
+
+    /* We always ask for client_no_context_takeover: client messages are
+     * short commands that gain little from it, and it lets incoming
+     * compression survive a reboot. */
+    safe_str("Sec-WebSocket-Extensions: permessage-deflate; "
+             "client_no_context_takeover",
+             buf, &bp);
+    if (wd->out_reset)
+      safe_str("; server_no_context_takeover", buf, &bp);
+    if (wd->out_bits < 15)
+      safe_format(buf, &bp, "; server_max_window_bits=%d", wd->out_bits);
+    if (wd->in_limited && wd->in_bits < 15)
+      safe_format(buf, &bp, "; client_max_window_bits=%d", wd->in_bits);
+    safe_str("\r\n", buf, &bp);
+  }
+#endif /* HAVE_LIBZ */
+
+  memcpy(bp, "\r\n", 2);
+  bp += 2;
 
   queue_newwrite(d, buf, bp - buf);
 
@@ -193,11 +239,14 @@ int
 process_websocket_request(DESC *d, const char *command)
 {
   static const char *const KEY_HEADER = "Sec-WebSocket-Key:";
+  static const char *const EXT_HEADER = "Sec-WebSocket-Extensions:";
 
   static size_t KEY_HEADER_LEN = 0;
+  static size_t EXT_HEADER_LEN = 0;
 
   if (!KEY_HEADER_LEN) {
     KEY_HEADER_LEN = strlen(KEY_HEADER);
+    EXT_HEADER_LEN = strlen(EXT_HEADER);
   }
 
   /* TODO: Full implementation should verify entire request. */
@@ -218,21 +267,77 @@ process_websocket_request(DESC *d, const char *command)
       memcpy(d->checksum, value, WEBSOCKET_KEY_LEN + 1);
     }
   }
+#ifdef HAVE_LIBZ
+  else if (strncasecmp(command, EXT_HEADER, EXT_HEADER_LEN) == 0) {
+    parse_extensions(d, command + EXT_HEADER_LEN);
+  }
+#endif /* HAVE_LIBZ */
 
   return 1;
 }
 
+/* Add a byte of a text message's payload to the command input. *first is
+ * 1 while the channel byte is still to come, 2 if the rest of the message
+ * is being ignored, and 0 otherwise. */
+static inline char *
+payload_byte(char *wp, unsigned char *first, char ch)
+{
+  switch (*first) {
+  case 0:
+    /* Continue frame. */
+    *wp++ = ch;
+    break;
+
+  case 1:
+    /* Channel byte. */
+    *first = 0;
+
+    if (ch != WEBSOCKET_CHANNEL_TEXT) {
+      /* TODO: Support other channel types later. */
+      *first = 2;
+    }
+    break;
+
+  case 2:
+    /* Ignore channel. */
+    break;
+  }
+
+  return wp;
+}
+
+#ifdef HAVE_LIBZ
+/* Hand the plain text gathered so far over for processing, then
+ * decompress the payload gathered since zp and hand that over too. */
+static bool
+flush_zipped(DESC *d, char *tbuf1, char **wp, char **zp, bool last,
+             unsigned char *first)
+{
+  char *start = *zp ? *zp : *wp;
+  bool ok;
+
+  if (start > tbuf1)
+    process_input_text(d, tbuf1, start - tbuf1);
+  ok = inflate_payload(d, start, *wp - start, last, first);
+  *wp = tbuf1;
+  *zp = NULL;
+  return ok;
+}
+#endif /* HAVE_LIBZ */
+
 int
 process_websocket_frame(DESC *d, char *tbuf1, int got)
 {
   char mask[1 + 4 + 1 + 1];
-  unsigned char state, type, first, channel;
+  unsigned char state, type, first;
   uint64_t len;
-  char *wp;
+  char *wp, *zp;
   const char *cp, *end;
   enum WebSocketOp op;
+  bool zipped = 0, frame_end;
 
   wp = tbuf1;
+  zp = NULL; /* Where compressed payload starts, if there's any at wp. */
 
   /* Restore state. */
   memcpy(mask, d->checksum, sizeof(mask));
@@ -240,11 +345,16 @@ process_websocket_frame(DESC *d, char *tbuf1, int got)
   type = mask[5];
   first = mask[6];
   len = d->ws_frame_len;
+#ifdef HAVE_LIBZ
+  zipped = d->ws_deflate && d->ws_deflate->inflating;
+#endif /* HAVE_LIBZ */
 
   /* Process buffer bytes. */
   for (cp = tbuf1, end = tbuf1 + got; cp != end; ++cp) {
     const unsigned char ch = *cp;
 
+    frame_end = 0;
+
     switch (state++) {
     case 4:
       /* Received frame type. */
@@ -254,18 +364,28 @@ process_websocket_frame(DESC *d, char *tbuf1, int got)
       case WS_OP_CONTINUATION:
         /* Continue the previous opcode. */
         /* TODO: Error handling (only data frames can be continued). */
-        first = 0;
+        if (!zipped)
+          first = 0;
         op = type & 0x0F;
         break;
 
       case WS_OP_TEXT:
         /* First frame of a new message. */
         first = 1;
+#ifdef HAVE_LIBZ
+        zipped = (ch & WS_RSV1) && d->ws_deflate;
+        if (zipped) {
+          inflateReset(&d->ws_deflate->in);
+          d->ws_deflate->msg_in = 0;
+        }
+#endif /* HAVE_LIBZ */
         break;
 
       default:
         /* Ignore unrecognized opcode. */
         first = 2;
+        if (!(op & 0x08))
+          zipped = 0;
         break;
       }
 
@@ -335,33 +455,19 @@ process_websocket_frame(DESC *d, char *tbuf1, int got)
       } else {
         /* Empty payload. */
         state = 4;
-
-        /* TODO: Handle end of frame. */
+        frame_end = 1;
       }
       break;
 
     default:
       /* Payload data; handle according to opcode. */
-      switch (first) {
-      case 0:
-        /* Continue frame. */
+      if (zipped && !(type & 0x08)) {
+        /* Compressed; gather it up to decompress at the end. */
+        if (!zp)
+          zp = wp;
         *wp++ = ch ^ mask[state];
-        break;
-
-      case 1:
-        /* Channel byte. */
-        first = 0;
-        channel = ch ^ mask[state];
-
-        if (channel != WEBSOCKET_CHANNEL_TEXT) {
-          /* TODO: Support other channel types later. */
-          first = 2;
-        }
-        break;
-
-      case 2:
-        /* Ignore channel. */
-        break;
+      } else {
+        wp = payload_byte(wp, &first, ch ^ mask[state]);
       }
 
       if (--len) {
@@ -370,13 +476,31 @@ process_websocket_frame(DESC *d, char *tbuf1, int got)
       } else {
         /* Last payload byte. */
         state = 4;
-
-        /* TODO: Handle end of frame. */
+        frame_end = 1;
       }
       break;
     }
+
+#ifdef HAVE_LIBZ
+    if (frame_end && zipped && !(type & 0x08)) {
+      /* End of a compressed data frame; if it's the end of the message,
+       * the compressed data is complete. */
+      if (!flush_zipped(d, tbuf1, &wp, &zp, type & 0x80, &first))
+        return 0;
+      if (type & 0x80)
+        zipped = 0;
+    }
+#endif /* HAVE_LIBZ */
   }
 
+#ifdef HAVE_LIBZ
+  /* Decompress what's arrived of a compressed frame so far. */
+  if (zp && !flush_zipped(d, tbuf1, &wp, &zp, 0, &first))
+    return 0;
+  if (d->ws_deflate)
+    d->ws_deflate->inflating = zipped;
+#endif /* HAVE_LIBZ */
+
   /* Preserve state. */
   mask[0] = state;
   mask[5] = type;
@@ -387,14 +511,48 @@ process_websocket_frame(DESC *d, char *tbuf1, int got)
   return wp - tbuf1;
 }
 
+/* Write a frame header for a payload of the given length. */
 static char *
-write_message(char *dst, char *const dstend, const char *src,
+write_frame_header(char *dst, unsigned char head, size_t len)
+{
+  *dst++ = head;
+
+  if (len < 126) {
+    *dst++ = len;
+  } else if (len < 65536) {
+    *dst++ = 126;
+
+    *dst++ = (len >> 8) & 0xFF;
+    *dst++ = len & 0xFF;
+  } else {
+    /* Probably never going to need this code path for typical BUFFER_LEN. */
+    int ii;
+
+    *dst++ = 127;
+
+    for (ii = 56; ii >= 0; ii -= 8) {
+      *dst++ = (len >> ii) & 0xFF;
+    }
+  }
+
+  return dst;
+}
+
+static char *
+write_message(DESC *d, char *dst, char *const dstend, const char *src,
               const char *const srcend, char channel)
 {
   size_t dstlen = dstend - dst;
   size_t srclen = srcend - src;
   enum WebSocketOp op;
 
+#ifdef HAVE_LIBZ
+  if (d->ws_deflate && d->ws_deflate->started) {
+    return write_deflated_message(d->ws_deflate, dst, dstend, src, srclen,
+                                  channel);
+  }
+#endif /* HAVE_LIBZ */
+
   /* Check bounds. */
   dstlen = dstend - dst;
   srclen = srcend - src;
@@ -415,26 +573,7 @@ write_message(char *dst, char *const dstend, const char *src,
 
   /* Write frame header. */
   op = WS_OP_TEXT;
-  dstlen = 1 + srclen;
-  *dst++ = 0x80 | op;
-
-  if (dstlen < 126) {
-    *dst++ = dstlen;
-  } else if (dstlen < 65536) {
-    *dst++ = 126;
-
-    *dst++ = (dstlen >> 8) & 0xFF;
-    *dst++ = dstlen & 0xFF;
-  } else {
-    /* Probably never going to need this code path for typical BUFFER_LEN. */
-    int ii;
-
-    *dst++ = 127;
-
-    for (ii = 56; ii >= 0; ii -= 8) {
-      *dst++ = (dstlen >> ii) & 0xFF;
-    }
-  }
+  dst = write_frame_header(dst, 0x80 | op, 1 + srclen);
 
   /* Write frame payload. Note server doesn't mask. */
   if (op == WS_OP_TEXT) {
@@ -448,7 +587,7 @@ write_message(char *dst, char *const dstend, const char *src,
 }
 
 void
-to_websocket_frame(const char **bp, int *np, char channel)
+to_websocket_frame(DESC *d, const char **bp, int *np, char channel)
 {
   /* TODO: Not sure what the largest possible buffer is yet. */
   static char buf[4 * BUFFER_LEN];
@@ -475,7 +614,8 @@ to_websocket_frame(const char **bp, int *np, char channel)
         }
 
         if (!suppress && start != end) {
-          dst = write_message(dst, dstend, start, end, WEBSOCKET_CHANNEL_TEXT);
+          dst = write_message(d, dst, dstend, start, end,
+                              WEBSOCKET_CHANNEL_TEXT);
         }
 
         tag = end + 1;
@@ -513,7 +653,7 @@ to_websocket_frame(const char **bp, int *np, char channel)
 
           default:
             /* Unencoded tag. */
-            dst = write_message(dst, dstend, tag, end, channel);
+            dst = write_message(d, dst, dstend, tag, end, channel);
             break;
           }
 
@@ -527,11 +667,11 @@ to_websocket_frame(const char **bp, int *np, char channel)
 
     /* Send tail. */
     if (!suppress && start != end && !tag) {
-      dst = write_message(dst, dstend, start, end, WEBSOCKET_CHANNEL_TEXT);
+      dst = write_message(d, dst, dstend, start, end, WEBSOCKET_CHANNEL_TEXT);
     }
   } else {
     /* Send entire buffer on specified channel. */
-    dst = write_message(dst, dstend, *bp, *bp + *np, channel);
+    dst = write_message(d, dst, dstend, *bp, *bp + *np, channel);
   }
 
   /* Replace old arguments. */
@@ -539,6 +679,347 @@ to_websocket_frame(const char **bp, int *np, char channel)
   *np = dst - buf;
 }
 
+#ifdef HAVE_LIBZ
+/* The window bits to use for permessage-deflate, or 0 if it's disabled. */
+static int
+deflate_window_bits(void)
+{
+  if (options.ws_deflate_bits <= 0)
+    return 0;
+  if (options.ws_deflate_bits < 9)
+    return 9; /* zlib can't compress with a smaller window. */
+  if (options.ws_deflate_bits > 15)
+    return 15;
+  return options.ws_deflate_bits;
+}
+
+/* Parse a *_max_window_bits value, returning -1 if it's not valid. */
+static int
+window_bits_value(char *val)
+{
+  int n;
+
+  /* The value may be quoted. */
+  if (*val == '"' && val[1] && val[strlen(val) - 1] == '"') {
+    val[strlen(val) - 1] = '\0';
+    val++;
+  }
+  if (!*val || val[strspn(val, "0123456789")])
+    return -1;
+  n = atoi(val);
+  return (n >= 8 && n <= 15) ? n : -1;
+}
+
+/* Check one offered extension, and accept it if it's a permessage-deflate
+ * we can handle (RFC 7692, section 7.1). */
+static bool
+accept_deflate_offer(DESC *d, char *offer)
+{
+  struct ws_deflate *wd;
+  char *param, *val;
+  int bits = deflate_window_bits();
+  int out_bits = bits, in_bits = 15, n;
+  bool out_reset = 0, in_limited = 0;
+  int seen = 0;
+
+  param = trim_space_sep(split_token(&offer, ';'), ' ');
+  if (strcasecmp(param, "permessage-deflate"))
+    return 0;
+
+  while (offer) {
+    param = split_token(&offer, ';');
+    val = strchr(param, '=');
+    if (val) {
+      *val++ = '\0';
+      val = trim_space_sep(val, ' ');
+    }
+    param = trim_space_sep(param, ' ');
+
+    /* Any unknown or repeated parameter means the offer is declined. */
+    if (!strcasecmp(param, "server_no_context_takeover")) {
+      if (val || (seen & 0x1))
+        return 0;
+      seen |= 0x1;
+      out_reset = 1;
+    } else if (!strcasecmp(param, "client_no_context_takeover")) {
+      if (val || (seen & 0x2))
+        return 0;
+      seen |= 0x2;
+    } else if (!strcasecmp(param, "server_max_window_bits")) {
+      if (!val || (seen & 0x4))
+        return 0;
+      seen |= 0x4;
+      n = window_bits_value(val);
+      if (n < 9)
+        return 0;
+      if (n < out_bits)
+        out_bits = n;
+    } else if (!strcasecmp(param, "client_max_window_bits")) {
+      if (seen & 0x8)
+        return 0;
+      seen |= 0x8;
+      n = val ? window_bits_value(val) : 15;
+      if (n < 0)
+        return 0;
+      in_limited = 1;
+      in_bits = (n < bits) ? n : bits;
+    } else if (*param) {
+      return 0;
+    }
+  }
+
+  wd = mush_calloc(1, sizeof(struct ws_deflate), "ws_deflate");
+  if (!wd)
+    mush_panic("Out of memory");
+  wd->out_bits = out_bits;
+  wd->in_bits = in_bits;
+  wd->out_reset = out_reset;
+  wd->in_limited = in_limited;
+  d->ws_deflate = wd;
+  return 1;
+}
+
+/* Look through a Sec-WebSocket-Extensions header for the first offer of
+ * permessage-deflate we can accept. */
+static void
+parse_extensions(DESC *d, const char *value)
+{
+  char buf[BUFFER_LEN];
+  char *list, *offer;
+
+  if (d->ws_deflate || !deflate_window_bits())
+    return;
+
+  mush_strncpy(buf, value, sizeof buf);
+  list = buf;
+  while (list) {
+    offer = split_token(&list, ',');
+    if (accept_deflate_offer(d, offer))
+      return;
+  }
+}
+
+/* Set up zlib for an accepted permessage-deflate offer. */
+static bool
+start_deflate(DESC *d)
+{
+  struct ws_deflate *wd = d->ws_deflate;
+  int level = options.ws_deflate_mem_level;
+
+  if (level < 1)
+    level = 1;
+  else if (level > MAX_MEM_LEVEL)
+    level = MAX_MEM_LEVEL;
+
+  /* Negative window bits give a raw deflate stream, with no zlib header. */
+  if (deflateInit2(&wd->out, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -wd->out_bits,
+                   level, Z_DEFAULT_STRATEGY) != Z_OK) {
+    do_rawlog(LT_ERR, "[%d/%s/%s] Unable to start websocket compression.",
+              d->descriptor, d->addr, d->ip);
+    ws_deflate_free(d);
+    return 0;
+  }
+  if (inflateInit2(&wd->in, -wd->in_bits) != Z_OK) {
+    do_rawlog(LT_ERR, "[%d/%s/%s] Unable to start websocket decompression.",
+              d->descriptor, d->addr, d->ip);
+    deflateEnd(&wd->out);
+    ws_deflate_free(d);
+    return 0;
+  }
+  wd->started = 1;
+  return 1;
+}
+
+/* Compress a message and write it out as a single frame with RSV1 set
+ * (RFC 7692, section 7.2.1). */
+static char *
+write_deflated_message(struct ws_deflate *wd, char *dst, char *const dstend,
+                       const char *src, size_t srclen, char channel)
+{
+  /* Maximum header size is 1 + 1 + 8. Incompressible text comes out a
+   * few bytes longer than it went in, so allow a little slack too. */
+  const size_t header = 10, slack = 64;
+  size_t room, zlen;
+  char *zdst;
+
+  if ((size_t) (dstend - dst) < header + slack)
+    return dst;
+
+  room = dstend - dst - header;
+  if (srclen > room - slack) {
+    /* Silently truncate excess source, like write_message(). */
+    srclen = room - slack;
+  }
+
+  /* Compress past the longest possible header, and move it into place
+   * once the length is known. */
+  zdst = dst + header;
+  wd->out.next_out = (Bytef *) zdst;
+  wd->out.avail_out = room;
+  wd->out.next_in = (Bytef *) &channel;
+  wd->out.avail_in = 1;
+  deflate(&wd->out, Z_NO_FLUSH);
+  wd->out.next_in = (Bytef *) src;
+  wd->out.avail_in = srclen;
+  if (deflate(&wd->out, Z_SYNC_FLUSH) != Z_OK || wd->out.avail_out == 0) {
+    /* Shouldn't happen. Drop the message, and make sure nothing sent
+     * later refers back to it. */
+    deflateReset(&wd->out);
+    return dst;
+  }
+
+  zlen = room - wd->out.avail_out;
+  if (zlen >= sizeof deflate_tail &&
+      memcmp(zdst + zlen - sizeof deflate_tail, deflate_tail,
+             sizeof deflate_tail) == 0)
+    zlen -= sizeof deflate_tail;
+
+  if (wd->out_reset)
+    deflateReset(&wd->out);
+  wd->raw_out += 1 + srclen;
+  wd->zipped_out += zlen;
+
+  dst = write_frame_header(dst, 0x80 | WS_RSV1 | WS_OP_TEXT, zlen);
+  memmove(dst, zdst, zlen);
+  return dst + zlen;
+}
+
+/* Decompress part of an incoming message and hand the text over for
+ * processing. If it's the last of the message, the deflate_tail the client
+ * left off is put back (RFC 7692, section 7.2.2). */
+static bool
+inflate_payload(DESC *d, const char *src, size_t srclen, bool last,
+                unsigned char *first)
+{
+  struct ws_deflate *wd = d->ws_deflate;
+  char buf[BUFFER_LEN];
+  char *rp, *wp;
+  int ret;
+
+  wd->zipped_in += srclen;
+  for (;;) {
+    wd->in.next_in = (Bytef *) src;
+    wd->in.avail_in = srclen;
+    do {
+      wd->in.next_out = (Bytef *) buf;
+      wd->in.avail_out = sizeof buf;
+      ret = inflate(&wd->in, Z_SYNC_FLUSH);
+      if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END) {
+        do_rawlog(LT_CONN, "[%d/%s/%s] Websocket decompression error: %s",
+                  d->descriptor, d->addr, d->ip,
+                  wd->in.msg ? wd->in.msg : "unknown error");
+        d->conn_flags |= CONN_SOCKET_ERROR;
+        return 0;
+      }
+      wd->raw_in += sizeof buf - wd->in.avail_out;
+      wd->msg_in += sizeof buf - wd->in.avail_out;
+      if (wd->msg_in > WS_INFLATE_LIMIT) {
+        do_rawlog(LT_CONN, "[%d/%s/%s] Websocket message too large.",
+                  d->descriptor, d->addr, d->ip);
+        d->conn_flags |= CONN_SOCKET_ERROR;
+        return 0;
+      }
+
+      for (rp = wp = buf; rp < (char *) wd->in.next_out; rp++)
+        wp = payload_byte(wp, first, *rp);
+      if (wp > buf)
+        process_input_text(d, buf, wp - buf);
+    } while (wd->in.avail_out == 0);
+
+    if (!last)
+      return 1;
+    src = deflate_tail;
+    srclen = sizeof deflate_tail;
+    last = 0;
+  }
+}
+#endif /* HAVE_LIBZ */
+
+/** Describe a websocket's permessage-deflate settings as a number, for
+ * the reboot db.
+ * \param d the descriptor.
+ * \return the settings, or 0 if it isn't compressing.
+ */
+int
+ws_deflate_params(DESC *d)
+{
+#ifdef HAVE_LIBZ
+  struct ws_deflate *wd = d->ws_deflate;
+
+  if (wd && wd->started)
+    return wd->out_bits | (wd->in_bits << 4) | (wd->out_reset << 8) |
+           (wd->in_limited << 9);
+#endif /* HAVE_LIBZ */
+  return 0;
+}
+
+/** Restart permessage-deflate on a websocket after a reboot.
+ * The client's decompressor still has the old history, but a fresh
+ * compressor never refers back to it, so output can carry on; and the
+ * client starts every message afresh anyway, thanks to
+ * client_no_context_takeover.
+ * \param d the descriptor.
+ * \param params settings from ws_deflate_params().
+ */
+void
+ws_deflate_restore(DESC *d, int params)
+{
+  d->ws_deflate = NULL;
+#ifdef HAVE_LIBZ
+  if (params) {
+    struct ws_deflate *wd;
+
+    wd = mush_calloc(1, sizeof(struct ws_deflate), "ws_deflate");
+    if (!wd)
+      mush_panic("Out of memory");
+    wd->out_bits = params & 0xF;
+    wd->in_bits = (params >> 4) & 0xF;
+    wd->out_reset = (params >> 8) & 0x1;
+    wd->in_limited = (params >> 9) & 0x1;
+    d->ws_deflate = wd;
+    start_deflate(d);
+  }
+#endif /* HAVE_LIBZ */
+}
+
+/** Handle a compressing websocket's output queue filling up.
+ * The message that didn't fit has already gone through the compressor,
+ * so it's dropped and the compressor reset, so that nothing sent later
+ * refers back to text the client never got.
+ * \param d the descriptor.
+ * \retval 1 the message was dropped.
+ * \retval 0 the connection isn't compressing; flush the queue as usual.
+ */
+int
+ws_deflate_overflow(DESC *d)
+{
+#ifdef HAVE_LIBZ
+  if (d->ws_deflate && d->ws_deflate->started) {
+    deflateReset(&d->ws_deflate->out);
+    return 1;
+  }
+#endif /* HAVE_LIBZ */
+  return 0;
+}
+
+/** Free a websocket's permessage-deflate state.
+ * \param d the descriptor.
+ */
+void
+ws_deflate_free(DESC *d)
+{
+#ifdef HAVE_LIBZ
+  if (!d->ws_deflate)
+    return;
+  if (d->ws_deflate->started) {
+    deflateEnd(&d->ws_deflate->out);
+    inflateEnd(&d->ws_deflate->in);
+  }
+  mush_free(d->ws_deflate, "ws_deflate");
+#endif /* HAVE_LIBZ */
+  d->ws_deflate = NULL;
+}
+
 int
 markup_websocket(char *buff, char **bp, char *data, int datalen, char *alt,
                  int altlen, char channel)
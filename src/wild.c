@@ -36,6 +36,8 @@
 #include "memcheck.h"
 #include "mymalloc.h"
 #include "mypcre.h"
+#include "notify.h"
+#include "htab.h"
 #include "parse.h"
 #include "strutil.h"
 
@@ -53,6 +55,193 @@ const unsigned char *tables = NULL; /** Pointer to character tables */
 int pcre_study_flags = PCRE_STUDY_JIT_COMPILE;
 int pcre_public_study_flags = 0;
 
+/** Most compiled regexps to keep in the cache */
+#define REGEXP_CACHE_SIZE 256
+
+static HASHTAB regexp_cache;
+static bool regexp_cache_inited = false;
+static CACHED_REGEXP *regexp_newest = NULL; /**< Most recently used */
+static CACHED_REGEXP *regexp_oldest = NULL; /**< Least recently used */
+
+/** Regexp cache statistics */
+static struct {
+  unsigned long hits;     /**< Lookups that found a compiled regexp */
+  unsigned long compiles; /**< Lookups that had to compile one */
+  unsigned long evicted;  /**< Regexps pushed out to make room */
+} regexp_totals;
+
+/** Free a compiled regexp. */
+static void
+regexp_cache_free(CACHED_REGEXP *cre)
+{
+  pcre_free(cre->re);
+  DEL_CHECK("pcre");
+  if (cre->extra) {
+#ifdef PCRE_CONFIG_JIT
+    pcre_free_study(cre->extra);
+#else
+    pcre_free(cre->extra);
+#endif
+    DEL_CHECK("pcre.extra");
+  }
+  mush_free(cre->key, "regexp_cache.key");
+  mush_free(cre, "regexp_cache.entry");
+}
+
+/** Unlink a regexp from the LRU list. */
+static void
+regexp_cache_unlink(CACHED_REGEXP *cre)
+{
+  if (cre->newer)
+    cre->newer->older = cre->older;
+  else
+    regexp_newest = cre->older;
+  if (cre->older)
+    cre->older->newer = cre->newer;
+  else
+    regexp_oldest = cre->newer;
+  cre->newer = cre->older = NULL;
+}
+
+/** Take a regexp out of the cache. It's freed once nobody is using it.
+ */
+static void
+regexp_cache_remove(CACHED_REGEXP *cre)
+{
+  regexp_cache_unlink(cre);
+  hashdelete(cre->key, &regexp_cache);
+  cre->cached = false;
+  if (!cre->refs)
+    regexp_cache_free(cre);
+}
+
+/** Get a compiled, studied regexp, from the cache if possible.
+ * The same pattern is often matched over and over (regmatch() in an
+ * iter(), say), so compiled patterns are kept in a small LRU cache
+ * shared by all the regexp functions and commands. Call
+ * regexp_cache_release() when done with the result, and don't free its
+ * re or extra.
+ * \param pattern the regexp.
+ * \param flags options for pcre_compile().
+ * \param errptr where to put an error message if it doesn't compile.
+ * \return the compiled regexp, or NULL on error.
+ */
+CACHED_REGEXP *
+regexp_cache_get(const char *pattern, int flags, const char **errptr)
+{
+  char key[BUFFER_LEN + 16];
+  CACHED_REGEXP *cre;
+  pcre *re;
+  pcre_extra *extra;
+  int erroffset;
+
+  if (!regexp_cache_inited) {
+    hashinit(&regexp_cache, REGEXP_CACHE_SIZE);
+    regexp_cache_inited = true;
+  }
+
+  snprintf(key, sizeof key, "%x:%s", (unsigned) flags, pattern);
+  cre = hashfind(key, &regexp_cache);
+  if (cre && cre->tables != tables) {
+    /* Character tables changed with the locale */
+    regexp_cache_remove(cre);
+    cre = NULL;
+  }
+  if (cre) {
+    regexp_totals.hits++;
+    if (cre != regexp_newest) {
+      regexp_cache_unlink(cre);
+      cre->older = regexp_newest;
+      regexp_newest->newer = cre;
+      regexp_newest = cre;
+    }
+    cre->refs++;
+    return cre;
+  }
+
+  if ((re = pcre_compile(pattern, flags, errptr, &erroffset, tables)) ==
+      NULL)
+    return NULL;
+  ADD_CHECK("pcre");
+  *errptr = NULL;
+  extra = pcre_study(re, pcre_public_study_flags, errptr);
+  if (*errptr) {
+    pcre_free(re);
+    DEL_CHECK("pcre");
+    return NULL;
+  }
+  if (extra)
+    ADD_CHECK("pcre.extra");
+  regexp_totals.compiles++;
+
+  while (regexp_cache.entries >= REGEXP_CACHE_SIZE && regexp_oldest) {
+    regexp_totals.evicted++;
+    regexp_cache_remove(regexp_oldest);
+  }
+
+  cre = mush_malloc_zero(sizeof *cre, "regexp_cache.entry");
+  cre->re = re;
+  cre->extra = extra;
+  cre->key = mush_strdup(key, "regexp_cache.key");
+  cre->tables = tables;
+  cre->refs = 1;
+  cre->cached = hashadd(cre->key, cre, &regexp_cache);
+  if (cre->cached) {
+    cre->older = regexp_newest;
+    if (regexp_newest)
+      regexp_newest->newer = cre;
+    else
+      regexp_oldest = cre;
+    regexp_newest = cre;
+  }
+  return cre;
+}
+
+/** Stop using a regexp from regexp_cache_get().
+ * \param cre the regexp.
+ */
+void
+regexp_cache_release(CACHED_REGEXP *cre)
+{
+  if (!cre)
+    return;
+  if (--cre->refs == 0 && !cre->cached)
+    regexp_cache_free(cre);
+}
+
+/** The pcre_extra to match a cached regexp with, with the match limit
+ * set.
+ * \param cre the regexp.
+ * \return its study data, or the default.
+ */
+pcre_extra *
+regexp_cache_extra(CACHED_REGEXP *cre)
+{
+  if (cre->extra) {
+    set_match_limit(cre->extra);
+    return cre->extra;
+  }
+  return default_match_limit();
+}
+
+/** Show regexp cache statistics.
+ * \param player who to tell.
+ */
+void
+regexp_cache_stats(dbref player)
+{
+  unsigned long lookups = regexp_totals.hits + regexp_totals.compiles;
+
+  notify(player, "Regexp Cache:");
+  notify_format(player,
+                " %d cached of %d. %lu hits, %lu compiled (%.1f%% hit rate), "
+                "%lu evicted.",
+                regexp_cache_inited ? regexp_cache.entries : 0,
+                REGEXP_CACHE_SIZE, regexp_totals.hits, regexp_totals.compiles,
+                lookups ? regexp_totals.hits * 100.0 / lookups : 0.0,
+                regexp_totals.evicted);
+}
+
 /** Do a wildcard match, without remembering the wild data.
  *
  * This routine will cause crashes if fed NULLs instead of strings.
@@ -225,6 +414,307 @@ real_atr_wild(const char *restrict tstr, const char *restrict dstr,
   return 0;
 }
 
+/* Compiled wildcard patterns.
+ *
+ * $-commands, lattr() patterns, @search and the like match one pattern
+ * against lots of strings, so patterns are compiled once into a list of
+ * ops with the escapes already handled and the case already folded,
+ * and kept in a small LRU cache. A compiled pattern also knows the
+ * literal text any match has to start and end with, its longest
+ * literal run, and the shortest string it can match, so most strings
+ * that can't match are turned away without running the matcher.
+ */
+
+/** Kinds of op in a compiled wildcard pattern */
+enum wild_op {
+  WILD_LIT,  /**< Literal character */
+  WILD_ONE,  /**< ? */
+  WILD_STAR, /**< * */
+  WILD_END   /**< End of the pattern */
+};
+
+/** A compiled wildcard pattern */
+typedef struct wild_pattern WILD_PATTERN;
+struct wild_pattern {
+  char *key;          /**< Cache key, or NULL if not cached */
+  char *kinds;        /**< An enum wild_op for each op */
+  char *chars;        /**< The character of each WILD_LIT op */
+  int nops;           /**< Number of ops, not counting WILD_END */
+  int minlen;         /**< Length of the shortest string that can match */
+  bool star;          /**< Does it have a '*'? */
+  int prefix;         /**< Number of WILD_LIT ops it starts with */
+  int tail;           /**< First op of the fixed-length part after the last
+                         '*', or nops if there's none */
+  int lit;            /**< First op of the longest literal run between the
+                         prefix and the tail */
+  int litlen;         /**< Length of that run */
+  WILD_PATTERN *newer; /**< Next more recently used pattern */
+  WILD_PATTERN *older; /**< Next less recently used pattern */
+};
+
+/** Most compiled wildcard patterns to keep in the cache */
+#define WILD_CACHE_SIZE 256
+
+static HASHTAB wild_cache;
+static bool wild_cache_inited = false;
+static WILD_PATTERN *wild_newest = NULL; /**< Most recently used */
+static WILD_PATTERN *wild_oldest = NULL; /**< Least recently used */
+
+/** Wildcard cache statistics */
+static struct {
+  unsigned long hits;     /**< Lookups that found a compiled pattern */
+  unsigned long compiles; /**< Lookups that had to compile one */
+  unsigned long rejects;  /**< Strings turned away before matching */
+  unsigned long matches;  /**< Strings that went through the matcher */
+} wild_totals;
+
+/** Compile a wildcard pattern.
+ * \param pat the pattern, with markup already removed.
+ * \param cs if 1, case-sensitive; if 0, case-insensitive.
+ * \return the compiled pattern.
+ */
+static WILD_PATTERN *
+wild_compile(const char *pat, bool cs)
+{
+  WILD_PATTERN *wp;
+  size_t plen = strlen(pat);
+  int n, i, run;
+
+  wp = mush_malloc_zero(sizeof *wp, "wild_pattern");
+  wp->kinds = mush_malloc(plen * 2 + 2, "wild_pattern.ops");
+  wp->chars = wp->kinds + plen + 1;
+
+  for (n = 0; *pat; pat++, n++) {
+    switch (*pat) {
+    case '*':
+      wp->kinds[n] = WILD_STAR;
+      wp->chars[n] = '*';
+      wp->star = 1;
+      break;
+    case '?':
+      wp->kinds[n] = WILD_ONE;
+      wp->chars[n] = '?';
+      wp->minlen++;
+      break;
+    case '\\':
+      /* Literal match of the next character, which may be a * or ?. A
+       * trailing \ matches nothing, so it's a literal NUL. */
+      if (!pat[1]) {
+        wp->kinds[n] = WILD_LIT;
+        wp->chars[n] = '\0';
+        wp->minlen++;
+        break;
+      }
+      pat++;
+      /* Fall through */
+    default:
+      wp->kinds[n] = WILD_LIT;
+      wp->chars[n] = cs ? *pat : UPCASE(*pat);
+      wp->minlen++;
+    }
+  }
+  wp->kinds[n] = WILD_END;
+  wp->chars[n] = '\0';
+  wp->nops = n;
+
+  while (wp->prefix < n && wp->kinds[wp->prefix] == WILD_LIT)
+    wp->prefix++;
+  if (!wp->star) {
+    /* The prefix check covers all of it. */
+    wp->tail = n;
+    return wp;
+  }
+  for (wp->tail = n; wp->tail > 0 && wp->kinds[wp->tail - 1] != WILD_STAR;
+       wp->tail--)
+    ;
+
+  for (i = wp->prefix, run = 0; i < wp->tail; i++) {
+    if (wp->kinds[i] == WILD_LIT) {
+      if (++run > wp->litlen) {
+        wp->litlen = run;
+        wp->lit = i - run + 1;
+      }
+    } else {
+      run = 0;
+    }
+  }
+  return wp;
+}
+
+/** Free a compiled wildcard pattern. */
+static void
+wild_free(WILD_PATTERN *wp)
+{
+  if (wp->key)
+    mush_free(wp->key, "wild_pattern.key");
+  mush_free(wp->kinds, "wild_pattern.ops");
+  mush_free(wp, "wild_pattern");
+}
+
+/** Unlink a pattern from the LRU list. */
+static void
+wild_cache_unlink(WILD_PATTERN *wp)
+{
+  if (wp->newer)
+    wp->newer->older = wp->older;
+  else
+    wild_newest = wp->older;
+  if (wp->older)
+    wp->older->newer = wp->newer;
+  else
+    wild_oldest = wp->newer;
+  wp->newer = wp->older = NULL;
+}
+
+/** Get a compiled wildcard pattern, from the cache if possible. Patterns
+ * too long to cache are compiled every time, and have no key; free them
+ * with wild_free() when done.
+ * \param pat the pattern.
+ * \param cs if 1, case-sensitive; if 0, case-insensitive.
+ * \return the compiled pattern.
+ */
+static WILD_PATTERN *
+wild_cache_get(const char *pat, bool cs)
+{
+  char key[BUFFER_LEN + 1];
+  char pbuff[BUFFER_LEN];
+  WILD_PATTERN *wp;
+  size_t plen = strlen(pat);
+
+  if (plen < BUFFER_LEN) {
+    if (!wild_cache_inited) {
+      hashinit(&wild_cache, WILD_CACHE_SIZE);
+      wild_cache_inited = true;
+    }
+    key[0] = cs ? 'C' : 'I';
+    memcpy(key + 1, pat, plen + 1);
+    wp = hashfind(key, &wild_cache);
+    if (wp) {
+      wild_totals.hits++;
+      if (wp != wild_newest) {
+        wild_cache_unlink(wp);
+        wp->older = wild_newest;
+        wild_newest->newer = wp;
+        wild_newest = wp;
+      }
+      return wp;
+    }
+  }
+
+  wild_totals.compiles++;
+  mush_strncpy(pbuff, remove_markup(pat, NULL), sizeof pbuff);
+  wp = wild_compile(pbuff, cs);
+  if (plen >= BUFFER_LEN)
+    return wp;
+
+  while (wild_cache.entries >= WILD_CACHE_SIZE && wild_oldest) {
+    WILD_PATTERN *old = wild_oldest;
+    wild_cache_unlink(old);
+    hashdelete(old->key, &wild_cache);
+    wild_free(old);
+  }
+  wp->key = mush_strdup(key, "wild_pattern.key");
+  if (hashadd(wp->key, wp, &wild_cache)) {
+    wp->older = wild_newest;
+    if (wild_newest)
+      wild_newest->newer = wp;
+    else
+      wild_oldest = wp;
+    wild_newest = wp;
+  } else {
+    mush_free(wp->key, "wild_pattern.key");
+    wp->key = NULL;
+  }
+  return wp;
+}
+
+/** Fold a character of the string being matched to the case of the
+ * compiled pattern. */
+#define WILD_FOLD(cs, c) ((cs) ? (c) : (char) UPCASE(c))
+
+/** Check for things that rule out a match without running the matcher:
+ * the string is too short or (with no '*') the wrong length, doesn't
+ * start with the literal prefix, doesn't end with the fixed-length
+ * tail, or doesn't contain the longest literal run.
+ * \param wp the compiled pattern.
+ * \param str the string to check.
+ * \param slen length of str.
+ * \param cs if 1, case-sensitive; if 0, case-insensitive.
+ * \retval 1 str might match.
+ * \retval 0 str can't match.
+ */
+static bool
+wild_prefilter(const WILD_PATTERN *wp, const char *str, int slen, bool cs)
+{
+  int i, j, end;
+  const char *lit, *p;
+
+  if (slen < wp->minlen || (!wp->star && slen != wp->minlen))
+    return 0;
+
+  for (i = 0; i < wp->prefix; i++)
+    if (WILD_FOLD(cs, str[i]) != wp->chars[i])
+      return 0;
+  if (!wp->star) {
+    /* Fixed length, so check everything after the prefix too. */
+    for (; i < wp->nops; i++)
+      if (wp->kinds[i] == WILD_LIT && WILD_FOLD(cs, str[i]) != wp->chars[i])
+        return 0;
+    return 1;
+  }
+
+  for (i = wp->tail, j = slen - (wp->nops - wp->tail); i < wp->nops;
+       i++, j++)
+    if (wp->kinds[i] == WILD_LIT && WILD_FOLD(cs, str[j]) != wp->chars[i])
+      return 0;
+
+  if (wp->litlen < 2)
+    return 1;
+  /* The run has to be somewhere between the prefix and the tail. */
+  lit = wp->chars + wp->lit;
+  end = slen - (wp->nops - wp->tail) - wp->litlen;
+  if (cs) {
+    for (p = str + wp->prefix; p <= str + end; p++) {
+      p = memchr(p, *lit, end - (p - str) + 1);
+      if (!p)
+        return 0;
+      if (!memcmp(p, lit, wp->litlen))
+        return 1;
+    }
+  } else {
+    for (i = wp->prefix; i <= end; i++) {
+      for (j = 0; j < wp->litlen; j++)
+        if (WILD_FOLD(cs, str[i + j]) != lit[j])
+          break;
+      if (j == wp->litlen)
+        return 1;
+    }
+  }
+  return 0;
+}
+
+/** Show wildcard cache statistics.
+ * \param player who to tell.
+ */
+void
+wild_cache_stats(dbref player)
+{
+  unsigned long lookups = wild_totals.hits + wild_totals.compiles;
+  unsigned long tested = wild_totals.rejects + wild_totals.matches;
+
+  notify(player, "Wildcard Cache:");
+  notify_format(player,
+                " %d cached of %d. %lu hits, %lu compiled (%.1f%% hit rate).",
+                wild_cache_inited ? wild_cache.entries : 0, WILD_CACHE_SIZE,
+                wild_totals.hits, wild_totals.compiles,
+                lookups ? wild_totals.hits * 100.0 / lookups : 0.0);
+  notify_format(player,
+                " %lu strings tested, %lu (%.1f%%) rejected without "
+                "matching.",
+                tested, wild_totals.rejects,
+                tested ? wild_totals.rejects * 100.0 / tested : 0.0);
+}
+
 /** Wildcard match, possibly case-sensitive, and remember the wild match
  * start+lengths.
  *
@@ -248,26 +738,34 @@ wild_match_test(const char *restrict pat, const char *restrict str, bool cs,
   int pbase = 0, sbase = 0; /* Guaranteed matched so far. */
   int matchi = 0, mbase = 0;
   int slen;
-  char pbuff[BUFFER_LEN];
-  char tbuff[BUFFER_LEN];
+  bool result = 0;
+  WILD_PATTERN *wp;
+  const char *kinds, *chars;
 
   for (i = 0; i < nmatches; i++) {
     matches[i * 2] = -1;
     matches[i * 2 + 1] = 0;
   }
 
-  pat = mush_strncpy(pbuff, remove_markup(pat, NULL), sizeof pbuff);
-  str = mush_strncpy(tbuff, remove_markup(str, NULL), sizeof tbuff);
+  wp = wild_cache_get(pat, cs);
+  kinds = wp->kinds;
+  chars = wp->chars;
+
+  if (has_markup(str))
+    str = remove_markup(str, NULL);
   slen = strlen(str);
+  if (slen >= BUFFER_LEN)
+    slen = BUFFER_LEN - 1;
 
-  if (!cs) {
-    upcasestr(pbuff);
-    upcasestr(tbuff);
+  if (!wild_prefilter(wp, str, slen, cs)) {
+    wild_totals.rejects++;
+    goto done;
   }
+  wild_totals.matches++;
 
   for (i = 0, pi = 0; (sbase + i) < slen;) {
-    switch (pat[pbase + pi]) {
-    case '?':
+    switch (kinds[pbase + pi]) {
+    case WILD_ONE:
       /* No complaints here. Auto-match */
       if (matchi < nmatches) {
         matches[matchi * 2] = sbase + i;
@@ -277,14 +775,14 @@ wild_match_test(const char *restrict pat, const char *restrict str, bool cs,
       pi++;
       i++;
       break;
-    case '*':
+    case WILD_STAR:
       /* Everything so far is guaranteed matched. */
       pbase += pi;
       sbase += i;
       globbing = 1;
       i = pi = 0;
       /* Skip past multiple globs. */
-      while (pat[pbase] == '*') {
+      while (kinds[pbase] == WILD_STAR) {
         pbase++;
         mbase = matchi++;
         if (mbase < nmatches) {
@@ -292,26 +790,23 @@ wild_match_test(const char *restrict pat, const char *restrict str, bool cs,
           matches[mbase * 2 + 1] = 0;
         }
       }
-      if (!pat[pbase]) {
+      if (kinds[pbase] == WILD_END) {
         /* This pattern is the last thing, we match the rest. */
         if (mbase < nmatches) {
           matches[mbase * 2 + 1] = slen - sbase;
         }
-        return 1;
+        result = 1;
+        goto done;
       }
       break;
-    case '\\':
-      /* Literal match of the next character, which may be a * or ?. */
-      pi++;
-    /* Fall through */
-    default:
-      if (str[sbase + i] == pat[pbase + pi]) {
+    case WILD_LIT:
+      if (WILD_FOLD(cs, str[sbase + i]) == chars[pbase + pi]) {
         pi++;
         i++;
         break;
       }
     /* Fall through */
-    case 0: /* Pattern is too short to match */
+    case WILD_END: /* Pattern is too short to match */
       /* If we're dealing with a glob, advance it by 1 character. */
       if (globbing) {
         if (mbase < nmatches) {
@@ -323,13 +818,18 @@ wild_match_test(const char *restrict pat, const char *restrict str, bool cs,
         i = pi = 0;
         matchi = mbase + 1;
       } else {
-        return 0;
+        goto done;
       }
     }
   }
-  while (pat[pbase + pi] == '*')
+  while (kinds[pbase + pi] == WILD_STAR)
     pi++;
-  return !pat[pbase + pi];
+  result = kinds[pbase + pi] == WILD_END;
+
+done:
+  if (!wp->key)
+    wild_free(wp);
+  return result;
 }
 
 /** Wildcard match, possibly case-sensitive, and remember the wild data
@@ -455,6 +955,7 @@ regexp_match_case_r(const char *restrict s, const char *restrict val, bool cs,
                     char **matches, size_t nmatches, char *data, ssize_t len,
                     PE_REGS *pe_regs, int pe_reg_flags)
 {
+  CACHED_REGEXP *cre;
   pcre *re;
   pcre_extra *extra;
   size_t i;
@@ -462,7 +963,6 @@ regexp_match_case_r(const char *restrict s, const char *restrict val, bool cs,
   ansi_string *as = NULL;
   const char *d;
   size_t delenn;
-  int erroffset;
   int offsets[99];
   int subpatterns;
   int totallen = 0;
@@ -470,8 +970,7 @@ regexp_match_case_r(const char *restrict s, const char *restrict val, bool cs,
   for (i = 0; i < nmatches; i++)
     matches[i] = NULL;
 
-  if ((re = pcre_compile(s, (cs ? 0 : PCRE_CASELESS), &errptr, &erroffset,
-                         tables)) == NULL) {
+  if ((cre = regexp_cache_get(s, (cs ? 0 : PCRE_CASELESS), &errptr)) == NULL) {
     /*
      * This is a matching error. We have an error message in
      * errptr that we can ignore, since we're doing
@@ -479,7 +978,7 @@ regexp_match_case_r(const char *restrict s, const char *restrict val, bool cs,
      */
     return 0;
   }
-  ADD_CHECK("pcre");
+  re = cre->re;
 
   /* The ansi string */
   if (has_markup(val)) {
@@ -491,7 +990,7 @@ regexp_match_case_r(const char *restrict s, const char *restrict val, bool cs,
     delenn = strlen(d);
   }
 
-  extra = default_match_limit();
+  extra = regexp_cache_extra(cre);
   /*
    * Now we try to match the pattern. The relevant fields will
    * automatically be filled in by this.
@@ -499,8 +998,7 @@ regexp_match_case_r(const char *restrict s, const char *restrict val, bool cs,
   if ((subpatterns = pcre_exec(re, extra, d, delenn, 0, 0, offsets, 99)) < 0) {
     if (as)
       free_ansi_string(as);
-    pcre_free(re);
-    DEL_CHECK("pcre");
+    regexp_cache_release(cre);
     return 0;
   }
 
@@ -555,8 +1053,7 @@ regexp_match_case_r(const char *restrict s, const char *restrict val, bool cs,
 
   if (as)
     free_ansi_string(as);
-  pcre_free(re);
-  DEL_CHECK("pcre");
+  regexp_cache_release(cre);
   return 1;
 }
 
@@ -575,12 +1072,10 @@ bool
 quick_regexp_match(const char *restrict s, const char *restrict d, bool cs,
                    const char **report_err)
 {
-  pcre *re;
-  pcre_extra *extra;
+  CACHED_REGEXP *cre;
   const char *sptr;
   size_t slen;
   const char *errptr;
-  int erroffset;
   int offsets[99];
   int r;
   int flags = 0; /* There's a PCRE_NO_AUTO_CAPTURE flag to turn all raw
@@ -591,7 +1086,7 @@ quick_regexp_match(const char *restrict s, const char *restrict d, bool cs,
   if (!cs)
     flags |= PCRE_CASELESS;
 
-  if ((re = pcre_compile(s, flags, &errptr, &erroffset, tables)) == NULL) {
+  if ((cre = regexp_cache_get(s, flags, &errptr)) == NULL) {
     /*
      * This is a matching error. We have an error message in
      * errptr that we can ignore, since we're doing
@@ -602,17 +1097,15 @@ quick_regexp_match(const char *restrict s, const char *restrict d, bool cs,
     }
     return 0;
   }
-  ADD_CHECK("pcre");
   sptr = remove_markup(d, &slen);
-  extra = default_match_limit();
   /*
    * Now we try to match the pattern. The relevant fields will
    * automatically be filled in by this.
    */
-  r = pcre_exec(re, extra, sptr, slen - 1, 0, 0, offsets, 99);
+  r = pcre_exec(cre->re, regexp_cache_extra(cre), sptr, slen - 1, 0, 0,
+                offsets, 99);
 
-  pcre_free(re);
-  DEL_CHECK("pcre");
+  regexp_cache_release(cre);
 
   return r >= 0;
 }
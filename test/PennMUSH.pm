@@ -95,6 +95,21 @@ sub start {
   }
 }
 
+sub stop {
+  my $self = shift;
+  my $pid = $self->{PID};
+  return unless $pid;
+  kill("INT", $pid);
+  # The CHLD handler reaps it; wait for that before the next start()
+  # removes the game directory out from under it.
+  foreach my $j (1..30) {
+    last unless kill(0, $pid);
+    sleep 1;
+  }
+  @pids = grep { $_ != $pid } @pids;
+  delete $self->{PID};
+}
+
 sub copyConfig {
   my $from = shift;
   my $to = shift;
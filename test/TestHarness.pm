@@ -2,7 +2,7 @@ package TestHarness;
 use strict;
 use warnings;
 use vars qw/%tests $testcount @failures $alltests @allfailures $allexpected/;
-use vars qw/$testfiles $use_mortal/;
+use vars qw/$testfiles/;
 use subs qw/test summary/;
 use feature qw/say/;
 
@@ -10,7 +10,6 @@ $alltests = 0;
 @allfailures = ();
 $allexpected = 0;
 $testfiles = 0;
-$use_mortal = 0;
 
 sub new {
     my $class = shift;
@@ -18,6 +17,8 @@ sub new {
     my %self = ( 
         -expected => 0,
         -depends => [],
+        -config => {},
+        -mortal => 0,
         -test => undef,
     );
 #    print "Looking at $script\n";
@@ -40,7 +41,10 @@ sub new {
         }
         if (/^\s*login mortal$/) {
             $code .= 'my $mortal = shift;' . "\n";
-            $use_mortal = 1;
+            $self{-mortal} = 1;
+        }
+        if (/^config (\w+) (.*)$/o) {
+            $self{-config}->{$1} = $2;
         }
     }
     while (<$IN>) {
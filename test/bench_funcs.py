@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""Micro-benchmark for builtin function lookups in PennMUSH.
+
+Connects to a running game as One and uses benchmark() to time an
+expression made of lots of calls to cheap builtin functions, with
+their names in mixed case. The expression is typed in rather than kept
+in an attribute, so it's parsed afresh each time and every call has to
+look its function up by name.
+
+Usage:
+  bench_funcs.py [host [port [calls]]]
+"""
+
+import sys
+
+import benchlib
+
+_CALLS = 100
+
+# How many times benchmark() runs the expression in each command.
+_RUNS = 100
+
+# Calls that do next to no work of their own, so that the time goes on
+# parsing and looking up the names.
+_FUNCTIONS = ['abs(-1)', 'NOT(0)', 't(1)', 'Strlen(abc)', 'add(1,2)',
+              'SUB(3,1)', 'mul(2,2)', 'First(a b)', 'rest(a b)',
+              'WORDS(a b c)', 'isnum(5)', 'Lit(x)', 'max(1,2)', 'MIN(1,2)',
+              'inc(1)', 'dec(2)', 'eq(1,1)', 'GT(2,1)', 'and(1,1)', 'Or(0,1)',
+              'xor(1,0)', 'left(abc,1)', 'RIGHT(abc,1)', 'mid(abcd,1,2)',
+              'Trim(x)', 'ucstr(a)', 'LCSTR(A)', 'capstr(a)', 'Null(x)',
+              'strcat(a,b)']
+
+
+def main():
+    """The main function!"""
+    host, port = benchlib.game_address()
+    calls = int(sys.argv[3]) if len(sys.argv) > 3 else _CALLS
+
+    expr = ''.join('[%s]' % _FUNCTIONS[i % len(_FUNCTIONS)]
+                   for i in range(calls))
+    game_socket = benchlib.connect_to_game(host, port)
+    game_socket.sendall(('think %s\n' % expr).encode())
+    text = benchlib.read_until_idle(game_socket).decode('latin-1')
+    if '#-1' in text:
+        sys.exit('Function call failed:\n' + text)
+
+    average, best = benchlib.run_benchmark(game_socket, expr, _RUNS)
+    print('%d builtin function calls: average %.1f, best %d microseconds.' %
+          (calls, average, best))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
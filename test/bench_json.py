@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Micro-benchmark for json_query() lookups in PennMUSH.
+
+Connects to a running game as One, stores a JSON document of about 4KB
+(a character sheet, with stats, skills and an inventory) in an
+attribute, and uses benchmark() to time softcode that pulls a handful
+of values out of it with json_query(), the way a +sheet command might.
+
+Usage:
+  bench_json.py [host [port [lookups]]]
+"""
+
+import json
+import sys
+
+import benchlib
+
+_LOOKUPS = 10
+
+# How many times benchmark() runs the expression in each command.
+_RUNS = 20
+
+_STATS = ['strength', 'dexterity', 'stamina', 'charisma', 'manipulation',
+          'appearance', 'perception', 'intelligence', 'wits']
+_SKILLS = ['athletics', 'brawl', 'dodge', 'empathy', 'expression',
+           'intimidation', 'leadership', 'streetwise', 'subterfuge',
+           'animal ken', 'crafts', 'drive', 'etiquette', 'firearms',
+           'melee', 'performance', 'stealth', 'survival', 'academics',
+           'computer', 'finance', 'investigation', 'law', 'medicine',
+           'occult', 'politics', 'science']
+
+
+def _document():
+    """Builds the JSON document.
+
+    Returns:
+      The document, as compact JSON text.
+    """
+    sheet = {
+        'name': 'Elizabeth Anne Whitmore',
+        'player': 'One',
+        'concept': 'Disgraced antiquities dealer',
+        'stats': dict((stat, i % 5 + 1) for i, stat in enumerate(_STATS)),
+        'skills': [{'name': skill, 'dots': i % 4,
+                    'specialty': skill + ' (general)' if i % 3 == 0 else None}
+                   for i, skill in enumerate(_SKILLS)],
+        'inventory': [{'item': 'item %d' % i, 'weight': i * 0.5,
+                       'equipped': i % 2 == 0,
+                       'notes': 'found in crate %d, room %d' % (i, i * 7)}
+                      for i in range(26)],
+        'xp': {'total': 142, 'spent': 131},
+        'approved': True,
+    }
+    return json.dumps(sheet, separators=(',', ':'))
+
+
+def main():
+    """The main function!"""
+    host, port = benchlib.game_address()
+    lookups = int(sys.argv[3]) if len(sys.argv) > 3 else _LOOKUPS
+
+    doc = _document()
+    game_socket = benchlib.connect_to_game(host, port)
+    game_socket.sendall(('&jb`doc me=%s\n' % doc).encode())
+    # Each lookup fetches a different value, as a sheet display would.
+    paths = [',stats,' + _STATS[i % len(_STATS)] if i % 2 else
+             ',skills,%d,dots' % (i % len(_SKILLS)) for i in range(lookups)]
+    game_socket.sendall(('&jb`sheet me=%s\n' % ''.join(
+        '[json_query(v(jb`doc),get%s)]' % path for path in paths)).encode())
+    benchlib.read_until_idle(game_socket)
+    game_socket.sendall(b'think u(jb`sheet)\n')
+    text = benchlib.read_until_idle(game_socket).decode('latin-1')
+    if '#-1' in text:
+        sys.exit('json_query() failed:\n' + text)
+
+    average, best = benchlib.run_benchmark(game_socket, 'u(jb`sheet)', _RUNS)
+    print('%d json_query() lookups in a %d byte document: average %.1f, '
+          'best %d microseconds.' % (lookups, len(doc), average, best))
+
+    game_socket.sendall(b'@wipe me/jb\n')
+    benchlib.read_until_idle(game_socket)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Micro-benchmark for the output queue code in PennMUSH.
+
+Connects to a running game as One, sends a burst of lines to itself with
+@dolist/inline while not reading them, so that they pile up in the game's
+output queue, and then reads them all back. Reports how many writes and queue
+buffer allocations the game needed for it, using the counters shown by
+@stats/net.
+
+Usage:
+  bench_output.py [host [port [lines]]]
+"""
+
+import re
+import sys
+import time
+
+import benchlib
+
+_LINES = 2000
+
+# Keep the client's receive buffer small, so output backs up quickly.
+_RCVBUF = 4096
+# How long to leave output unread.
+_PAUSE = 2
+
+_DONE = b'BENCH-DONE'
+_STATS_RE = re.compile(
+    r'Output: (\d+) bytes in (\d+) writes\. (\d+) blocks queued, using '
+    r'(\d+) buffers\.')
+
+
+def _output_stats(game_socket):
+    """Fetches the output queue counters from @stats/net.
+
+    Returns:
+      A tuple of (bytes, writes, blocks, buffers).
+    """
+    game_socket.sendall(b'@stats/net\n')
+    text = benchlib.read_until_idle(game_socket).decode('latin-1')
+    match = _STATS_RE.search(text)
+    if not match:
+        sys.exit('Unable to read @stats/net output:\n' + text)
+    return tuple(int(n) for n in match.groups())
+
+
+def main():
+    """The main function!"""
+    host, port = benchlib.game_address()
+    lines = int(sys.argv[3]) if len(sys.argv) > 3 else _LINES
+
+    game_socket = benchlib.connect_to_game(host, port, _RCVBUF)
+    before = _output_stats(game_socket)
+
+    start = time.time()
+    # Two lines per iteration, to stay inside the length limit on lnum().
+    game_socket.sendall(
+        ('@dolist/inline lnum(1,%d)={think Line ##a of the output queue '
+         'benchmark.;think Line ##b of the output queue benchmark.}\n'
+         'think %s\n' % ((lines + 1) // 2, _DONE.decode())).encode())
+    time.sleep(_PAUSE)
+    data = benchlib.read_until(game_socket, _DONE)
+    elapsed = time.time() - start - _PAUSE
+
+    after = _output_stats(game_socket)
+    # The @stats/net output itself goes through the same counters.
+    stats = [b - a for a, b in zip(before, after)]
+    print('%d lines, %d bytes received in %.3f seconds after the pause.' %
+          (data.count(b'\n'), len(data), elapsed))
+    print('Game output: %d bytes in %d writes; %d blocks queued, using %d '
+          'buffers.' % tuple(stats))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""Micro-benchmark for q-register lookups in PennMUSH.
+
+Connects to a running game as One and times softcode that sets a lot of
+named q-registers at each of several levels of nested ulocal(), and
+then reads the outermost ones back with r(), using benchmark().
+
+Usage:
+  bench_qregs.py [host [port [registers [depth]]]]
+"""
+
+import sys
+
+import benchlib
+
+_REGISTERS = 40
+_DEPTH = 10
+
+# How many times benchmark() runs the expression in each command. Keeping
+# it small keeps it under the function invocation limit.
+_RUNS = 10
+
+# qb`nest sets %0 named registers, then calls itself through ulocal()
+# until it's %1 levels deep, each level with registers of its own. The
+# innermost level reads the outermost level's registers back, ten
+# times each, so every lookup has to get past all the levels between.
+_ATTRS = [
+    '&qb`set me=[iter(lnum(1,%0),setq(l%1_##,value ##))]',
+    '&qb`read me=[iter(lnum(1,10),iter(lnum(1,%0),r(l%1_##)))]',
+    '&qb`nest me=[u(qb`set,%0,%1)]'
+    '[if(%1,ulocal(qb`nest,%0,dec(%1),%2),strlen(ulocal(qb`read,%0,%2)))]',
+]
+
+
+def main():
+    """The main function!"""
+    host, port = benchlib.game_address()
+    registers = int(sys.argv[3]) if len(sys.argv) > 3 else _REGISTERS
+    depth = int(sys.argv[4]) if len(sys.argv) > 4 else _DEPTH
+
+    game_socket = benchlib.connect_to_game(host, port)
+    for attr in _ATTRS:
+        game_socket.sendall(attr.encode() + b'\n')
+    benchlib.read_until_idle(game_socket)
+
+    average, best = benchlib.run_benchmark(
+        game_socket, 'u(qb`nest,%d,%d,%d)' % (registers, depth, depth), _RUNS)
+    print('%d registers read through %d ulocal()s: average %.1f, best %d '
+          'microseconds.' % (registers, depth, average, best))
+
+    game_socket.sendall(b'@wipe me/qb\n')
+    benchlib.read_until_idle(game_socket)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
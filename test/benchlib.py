@@ -0,0 +1,114 @@
+"""Shared code for the bench_*.py micro-benchmarks.
+
+Each benchmark connects to a running game as One, sets up its workload,
+and times it, usually with benchmark(). This has the parts they have in
+common: the connection, reading output back, and running benchmark()
+a number of times.
+"""
+
+import re
+import socket
+import sys
+
+HOST = '127.0.0.1'
+PORT = 4201
+ARBITRARY_TIMEOUT = 0.5
+
+# How many separate benchmark() commands to average over, by default.
+ROUNDS = 10
+
+_LOGIN_STRING = b'connect one\n'
+_BENCH_RE = re.compile(r'Average: ([\d.]+)   Min: (\d+)   Max: (\d+)')
+
+
+def game_address():
+    """Gets the game's address from the first two arguments, if given.
+
+    Returns:
+      A tuple of (host, port).
+    """
+    host = sys.argv[1] if len(sys.argv) > 1 else HOST
+    port = int(sys.argv[2]) if len(sys.argv) > 2 else PORT
+    return host, port
+
+
+def connect_to_game(host, port, rcvbuf=None):
+    """Connects to the game and logs in.
+
+    Args:
+      host: the game's host.
+      port: the game's port.
+      rcvbuf: if given, the size of the socket's receive buffer.
+
+    Returns:
+      A socket that's connected to the game.
+    """
+    game_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    if rcvbuf:
+        game_socket.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, rcvbuf)
+    game_socket.connect((host, port))
+    game_socket.settimeout(ARBITRARY_TIMEOUT)
+    # Wait for the connect screen before logging in.
+    read_until(game_socket, b'\n')
+    read_until_idle(game_socket)
+    game_socket.sendall(_LOGIN_STRING)
+    read_until_idle(game_socket)
+    return game_socket
+
+
+def read_until_idle(game_socket):
+    """Reads from the socket until reads start hitting the timeout.
+
+    Returns:
+      Everything read.
+    """
+    data = b''
+    while True:
+        try:
+            chunk = game_socket.recv(65536)
+        except socket.timeout:
+            return data
+        if not chunk:
+            return data
+        data += chunk
+
+
+def read_until(game_socket, marker):
+    """Reads from the socket until marker has been seen."""
+    data = b''
+    while marker not in data:
+        try:
+            chunk = game_socket.recv(65536)
+        except socket.timeout:
+            continue
+        if not chunk:
+            break
+        data += chunk
+    return data
+
+
+def run_benchmark(game_socket, expr, runs, rounds=ROUNDS):
+    """Times softcode with benchmark().
+
+    Args:
+      game_socket: a socket that's connected to the game.
+      expr: the softcode to time.
+      runs: how many times each benchmark() call runs it.
+      rounds: how many benchmark() calls to make. Splitting the runs up
+        keeps each one under the function invocation limit.
+
+    Returns:
+      A tuple of (average, best), in microseconds.
+    """
+    averages = []
+    mins = []
+    for _ in range(rounds):
+        game_socket.sendall(('think benchmark(%s,%d)\n' %
+                             (expr, runs)).encode())
+        text = read_until_idle(game_socket).decode('latin-1')
+        match = _BENCH_RE.search(text)
+        if not match:
+            sys.exit('Unable to read benchmark() output:\n' + text)
+        averages.append(float(match.group(1)))
+        mins.append(int(match.group(2)))
+    return sum(averages) / len(averages), min(mins)
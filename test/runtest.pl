@@ -13,18 +13,35 @@ GetOptions "valgrind" => \$valgrind,
     "host" => \$host,
     "port" => \$port;
 
-my $mush = PennMUSH->new($host, $port, $valgrind);
-
 my @tests = map { TestHarness->new($_); } @ARGV;
 
-my $god = $mush->loginGod;
+# Tests that change the game's configuration get a game of their own;
+# the rest share one.
+my @shared = grep { !%{$_->{-config}} } @tests;
+my @own = grep { %{$_->{-config}} } @tests;
 
-my $mortal = undef;
-if ($TestHarness::use_mortal) {
-    $god->command('@pcreate Mortal=mortal');
-    $mortal = $mush->login("Mortal", "mortal");
+run_tests(\@shared) if @shared;
+foreach my $test (@own) {
+    run_tests([$test], %{$test->{-config}});
 }
 
-foreach my $test (@tests) {
-    $test->run($god, $mortal);
+sub run_tests {
+    my $tests = shift;
+    my $mush = PennMUSH->new($host, $port, $valgrind, @_);
+
+    my $god = $mush->loginGod;
+
+    my $mortal = undef;
+    if (grep { $_->{-mortal} } @$tests) {
+        $god->command('@pcreate Mortal=mortal');
+        $mortal = $mush->login("Mortal", "mortal");
+    }
+
+    foreach my $test (@$tests) {
+        $test->run($god, $mortal);
+    }
+
+    $mortal->disconnect if $mortal;
+    $god->disconnect;
+    $mush->stop;
 }
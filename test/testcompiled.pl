@@ -0,0 +1,35 @@
+run tests:
+# Attributes called as ufuns are compiled and cached. With
+# compiled_eval_check on, every call is also run through the plain
+# parser, and the owner hears about any difference.
+test("compiled.1", $god, "\@config/set compiled_eval_check=yes", "Option set");
+test("compiled.2", $god, "&text me=plain text,  with   spaces", "Set");
+test("compiled.3", $god, "think u(text)", ['^plain text, with spaces$', '!mismatch']);
+test("compiled.4", $god, "think u(text)", ['^plain text, with spaces$', '!mismatch']);
+test("compiled.5", $god, "&subs me=%0-%1:%#:[add(%0,%1)]", "Set");
+test("compiled.6", $god, "think u(subs,2,3)", ['^2-3:#1:5$', '!mismatch']);
+test("compiled.7", $god, "think u(subs,4,5)", ['^4-5:#1:9$', '!mismatch']);
+test("compiled.8", $god, "&nest me=[strlen(mid(%0,1,[sub(strlen(%0),2)]))] {a,[b]} \\[x\\]", "Set");
+test("compiled.9", $god, "think u(nest,abcdef)", ['^4 a,b \[x\]$', '!mismatch']);
+test("compiled.10", $god, "think u(nest,abcdefgh)", ['^6 a,b \[x\]$', '!mismatch']);
+test("compiled.11", $god, "&qreg me=[setq(foo,%0)]%q<foo>-%q<f[lit(oo)]>", "Set");
+test("compiled.12", $god, "think u(qreg,bar)", ['^bar-bar$', '!mismatch']);
+test("compiled.13", $god, "think u(qreg,baz)", ['^baz-baz$', '!mismatch']);
+test("compiled.14", $god, "&unknown me=[nosuchfun(1)] lit(a,b) (x,y)", "Set");
+test("compiled.15", $god, "think u(unknown)", ['FUNCTION \(NOSUCHFUN\) NOT FOUND', '!mismatch']);
+test("compiled.16", $god, "think u(unknown)", ['lit\(a,b\) \(x,y\)$', '!mismatch']);
+test("compiled.17", $god, "&dyn me=[%0(abc)]", "Set");
+test("compiled.18", $god, "think u(dyn,strlen)", ['^3$', '!mismatch']);
+test("compiled.19", $god, "think u(dyn,ucstr)", ['^ABC$', '!mismatch']);
+# Changing an attribute must drop its compiled code.
+test("compiled.20", $god, "&text me=new [add(1,1)]", "Set");
+test("compiled.21", $god, "think u(text)", ['^new 2$', '!mismatch']);
+# So must changing the function table.
+test("compiled.22", $god, "&strfun me=[myfun(%0)]", "Set");
+test("compiled.23", $god, "think u(strfun,abcd)", ['FUNCTION \(MYFUN\) NOT FOUND', '!mismatch']);
+test("compiled.24", $god, "&myfun me=<%0>", "Set");
+test("compiled.25", $god, "\@function myfun=me,myfun", "Function added");
+test("compiled.26", $god, "think u(strfun,abcd)", ['^<abcd>$', '!mismatch']);
+test("compiled.27", $god, "\@function/delete myfun", "Function deleted");
+test("compiled.28", $god, "think u(strfun,abcd)", ['FUNCTION \(MYFUN\) NOT FOUND', '!mismatch']);
+test("compiled.29", $god, "\@config/set compiled_eval_check=no", "Option set");
@@ -0,0 +1,16 @@
+run tests:
+test('functab.1', $god, 'think add(1,2) [ADD(3,4)] [aDd(5,6)]', '^3 7 11$');
+test('functab.2', $god, 'think [nosuchfunction(1)]', '^#-1 FUNCTION \(NOSUCHFUNCTION\) NOT FOUND');
+test('functab.3', $god, '@function/alias add=plusplus', ['Alias added.']);
+test('functab.4', $god, 'think [plusplus(2,3)] [PlusPlus(4,5)]', '^5 9$');
+test('functab.5', $god, '@function/delete plusplus', ['Function alias deleted.']);
+test('functab.6', $god, 'think [plusplus(2,3)] [add(2,3)]', '^#-1 FUNCTION \(PLUSPLUS\) NOT FOUND.* 5$');
+test('functab.7', $god, '@function/clone add=addclone', ['Function cloned.']);
+test('functab.8', $god, 'think [ADDCLONE(4,5)]', '^9$');
+test('functab.9', $god, '@function/delete addclone', ['Function clone deleted.']);
+test('functab.10', $god, 'think [addclone(4,5)]', '^#-1 FUNCTION \(ADDCLONE\) NOT FOUND');
+test('functab.11', $god, '@command/alias think=thunk', ['Alias set.']);
+test('functab.12', $god, 'THUNK alias works', ['alias works']);
+test('functab.13', $god, '@command/delete thunk', ['Removed THUNK from command table.']);
+test('functab.14', $god, 'thunk alias gone', ['Huh?']);
+test('functab.15', $god, 'thin prefix works', ['prefix works']);
@@ -34,3 +34,12 @@ test('json.patch.3', $mortal, 'think json_query(json(object,a,json(array,1,2),b,
 test('json.patch.4', $mortal, 'think json_query(json(object,a,1,b,2), patch, json(object,a,9,b,null,c,8))', '^{"a":9,"c":8}');
 test('json.patch.5', $mortal, 'think json_query(json(object,a,json(object,x,1,y,2),b,3), patch, json(object,a,json(object,y,9),c,8))', '^{"a":\{"x":1,"y":9\},"b":3,"c":8}');
 
+# Documents are parsed once and cached; the same lookups should still work.
+$mortal->command('&DOC me={"Name": "Bob", "stats": {"str": 10, "dex": 12}, "tags": ["a", "b"], "name": "dup"}');
+test('json.cache.1', $mortal, 'think json_query(v(doc),get,name)/[json_query(v(doc),get,NAME)]/[json_query(v(doc),get,stats,DEX)]', '^"Bob"/"Bob"/12$');
+test('json.cache.2', $mortal, 'think json_query(v(doc),exists,stats,con)[json_query(v(doc),exists,tags,1)][json_query(v(doc),get,tags,1)]', '^01"b"$');
+test('json.cache.3', $mortal, 'think json_query(v(doc),size)', '^4$');
+# A document still in use by json_map() while others push it out of the cache.
+$mortal->command('&MAPPER me=[words(iter(lnum(1,40),json_query(json(object,k,##),get,k)))]:%2=%1');
+test('json.cache.4', $mortal, 'think json_map(me/mapper,v(doc),|)', '^40:Name=Bob\|40:stats=\{"str":10,"dex":12\}\|40:tags=.*\|40:name=dup$');
+test('json.cache.5', $mortal, '@stats/tables', 'JSON Cache:');
@@ -0,0 +1,15 @@
+run tests:
+test("profile.1", $god, "\@profile", "The profiler isn't running");
+test("profile.2", $god, "\@profile/report", "Nothing has been profiled");
+test("profile.3", $god, "\@profile/start", "Profiler started");
+test("profile.4", $god, "\@profile/start", "already running");
+test("profile.5", $god, "&pfn me=[add(%0,1)][iter(lnum(1,3),mul(##,2))]", "Set");
+test("profile.6", $god, "think [u(pfn,1)][u(pfn,2)]", '^22 4 632 4 6$');
+test("profile.7", $god, "\@profile/report", ['\nITER\s+2\s', '\nMUL\s+6\s', '\n#1/PFN\s+2\s', '\nUFUN\s+2\s']);
+test("profile.8", $god, "\@profile/report 1", ['Name\s+Calls', 'more not shown']);
+test("profile.9", $god, "\@profile/report x", "How many entries");
+test("profile.10", $god, "\@profile/export", 'Wrote \d+ stacks to log/profile.folded');
+test("profile.11", $god, "\@profile/stop", "Profiler stopped");
+test("profile.12", $god, "\@profile", "The profiler is stopped");
+test("profile.13", $god, "\@profile/clear", "Profile cleared");
+test("profile.14", $god, "\@profile/report", "Nothing has been profiled");
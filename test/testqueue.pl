@@ -0,0 +1,13 @@
+run tests:
+test('queue.1', $god, 'think config(fair_queue)', '^Yes$');
+test('queue.2', $god, '&queuetest me=think ran', 'Set\.$');
+test('queue.3', $god, '@trigger me/queuetest', 'Triggered');
+test('queue.4', $god, '@stats/queue', ['^Fair share queueing is on\. \d+ commands ready to run\.', 'Owner +Queued +Oldest +Run +AvgWait +MaxWait', '\(#1\) +0 +0ms +[1-9]']);
+test('queue.5', $god, '@ps/all', ['Owner Queues:', 'Queue Done']);
+test('queue.6', $god, '@config/set fair_queue=no', 'set');
+test('queue.7', $god, '@stats/queue', '^Fair share queueing is off\.');
+test('queue.8', $god, '@config/set fair_queue=yes', 'set');
+test('queue.9', $god, 'think [words(queuestats(player))] [gt(first(queuestats(player)),0)]', '^6 1$');
+test('queue.10', $god, 'think queuestats(all,run,50 100)', '^[\d.]+ [\d.]+$');
+test('queue.11', $god, 'think queuestats(bogus)|[queuestats(player,run,101)]', '^#-1 INVALID QUEUE\|#-1 OUT OF RANGE$');
+test('queue.12', $god, '@stats/queue', ['^Fair share queueing is on\.', 'player +wait +[1-9]\d* +[\d.]+']);
@@ -0,0 +1,10 @@
+run tests:
+# The same pattern with different options is compiled separately.
+test('regcache.1', $god, 'think regmatch(ABC,abc)[regmatchi(ABC,abc)][regmatch(ABC,abc)]', '010');
+test('regcache.2', $god, 'think iter(a A b,regmatchi(##,a))', '1 1 0');
+test('regcache.3', $god, 'think iter(a A b,regmatch(##,a))', '1 0 0');
+# A pattern still in use by an outer call, matched again inside it.
+test('regcache.4', $god, 'think regeditall(foo bar,\\\\w+,[regmatch($0,\\\\w+)])', '1 1');
+test('regcache.5', $god, 'think reswitchall(xyz,y,[reswitch(y,y,1,0)],x,2,0)', '12');
+test('regcache.6', $god, 'think regmatch(abc,\\\\\\\\(\\\\\\\\()', '#-1 REGEXP ERROR');
+test('regcache.7', $god, '@stats/tables', 'Regexp Cache:');
@@ -5,3 +5,15 @@ run tests:
 test('sort.2', $god, 'think sort(0.0 0 0.3 *foo*,f)', '0 \*foo\* 0.3');
 test('sort.3', $god, 'think sort(a [ansi(h,a)] b [ansi(h,b)] c d [ansi(h,e)] f)', 'a a b b c d e f');
 test('sort.4', $god, 'think sort(3 [ansi(h,1)] [ansi(y,7)] 5)', '1 3 5 7');
+
+# sortby() and sortkey() should agree, and both keep ties in order.
+$god->command('&CMPLEN me=[sub(strlen(%0),strlen(%1))]');
+$god->command('&KEYLEN me=[strlen(%0)]');
+$god->command('&KEYCOUNT me=[setq(c,inc(%qc))][strlen(%0)]');
+$god->command('&CMPCOUNT me=[setq(c,inc(%qc))][sub(strlen(%0),strlen(%1))]');
+test('sort.5', $god, 'think sortby(cmplen,ccc b aa dd e fff g hh iii j)', 'b e g j aa dd hh ccc fff iii');
+test('sort.6', $god, 'think sortkey(keylen,ccc b aa dd e fff g hh iii j,n)', 'b e g j aa dd hh ccc fff iii');
+test('sort.7', $god, 'think [setq(l,iter(lnum(1,200),mod(mul(##,37),101)))][eq(comp(sortby(cmplen,%ql),sortkey(keylen,%ql,n)),0)]', '1');
+test('sort.8', $god, 'think [setq(c,0)][sortkey(keycount,ccc b aa dd e fff g hh iii j,n)] %qc', 'iii 10');
+test('sort.9', $god, 'think [setq(c,0)][sortby(cmpcount,lnum(1,100))] %qc', '100 99');
+test('sort.10', $god, 'think sortkey(keylen,10 9 100 8,n,%b,|)', '9|8|10|100');
@@ -0,0 +1,21 @@
+config command_burst 5
+config unconnected_command_burst 5
+run tests:
+use Time::HiRes qw/time/;
+
+# Keep the main loop waking up every few milliseconds, much more often
+# than commands are refilled, for the rest of the test.
+test('throttle.1', $god, '&tick me=@break gte(%0,4000);@wait .005=@trigger me/tick=inc(%0)', 'Set\.$');
+test('throttle.2', $god, '@trigger me/tick=0', 'Triggered\.$');
+
+# Let the command quota fill up, then spend it and three more. Those
+# three should come back about a second apart.
+sleep(6);
+my $socket = $god->[0];
+$god->read_to_empty();
+my $start = time;
+$socket->print("think throttled $_\r\n") foreach 1..8;
+$god->read_to_pattern('throttled 8');
+my $elapsed = time - $start;
+test('throttle.3', $god, "think [gte($elapsed,1.5)]", '^1$');
+test('throttle.4', $god, "think [lt($elapsed,5)]", '^1$');
@@ -0,0 +1,3 @@
+run tests:
+test('timers.1', $god, '@stats/timers', ['^Pending system events: \d+', 'Wheel level 0 \(1ms slots\)', '\d+\.\d{3}s +60s  PLAYER`INACTIVITY']);
+test('timers.2', $god, '@stats/timers', '(?s)DB`DBCK.*DB`WCHECK');
@@ -0,0 +1,7 @@
+run tests:
+test('tz.1', $god, 'think timefmt($H:$M,1700000000,America/New_York) [timefmt($H:$M,1690000000,America/New_York)]', '^17:13 00:26$');
+test('tz.2', $god, 'think iter(1 2 3,timefmt($H,1700000000,America/New_York))', '^17 17 17$');
+test('tz.3', $god, 'think timefmt($H,1700000000,-5) [timefmt($H,1700000000,UTC)]', '^17 22$');
+test('tz.4', $god, 'think isdaylight(1690000000,America/New_York)[isdaylight(1700000000,America/New_York)][isdaylight(1690000000,Europe/London)]', '^101$');
+test('tz.5', $god, 'think timefmt($H,0,Nowhere/Special) [timefmt($H,0,Nowhere/Special)]', '^#-1 INVALID TIME ZONE #-1 INVALID TIME ZONE$');
+test('tz.6', $god, 'think valid(timezone,Europe/Paris)[valid(timezone,Nowhere/Special)]', '^10$');
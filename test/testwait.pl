@@ -0,0 +1,34 @@
+# Keep the commands here from being throttled, which would throw off
+# the times they check.
+config command_burst 100000
+config unconnected_command_burst 100000
+run tests:
+test('wait.1', $god, '@wait 20=think c', '^$');
+test('wait.2', $god, '@wait 5.9=think a', '^$');
+test('wait.3', $god, '@wait 10.9=think b', '^$');
+test('wait.4', $god, 'think [iter(lpids(me,wait),pidinfo(##,command),%b,|)]', '^think a\|think b\|think c$');
+test('wait.5', $god, 'think [iter(lpids(me,wait),pidinfo(##,time))]', '^6 11 20$');
+test('wait.6', $god, '@wait/pid [first(lpids(me,wait))]=30', '^Queue entry with pid \d+ updated\.$');
+test('wait.7', $god, 'think [iter(lpids(me,wait),pidinfo(##,command),%b,|)]', '^think b\|think c\|think a$');
+test('wait.8', $god, '@wait/pid [last(lpids(me,wait))]=-25', '^Queue entry with pid \d+ updated\.$');
+test('wait.9', $god, 'think [iter(lpids(me,wait),pidinfo(##,command),%b,|)]', '^think a\|think b\|think c$');
+test('wait.10', $god, '@wait me/2.5=think s', '^$');
+test('wait.11', $god, 'think [words(lpids(me,wait))] [pidinfo(lpids(me,semaphore),time)]', '^3 3$');
+test('wait.12', $god, '@wait/pid [lpids(me,semaphore)]=+1.5', '^Queue entry with pid \d+ updated\.$');
+test('wait.13', $god, 'think [pidinfo(lpids(me,semaphore),time)]', '^4$');
+test('wait.14', $god, '@halt me', 'Halted');
+test('wait.15', $god, 'think [words(lpids(me))]', '^0$');
+test('wait.16', $god, '@wait me/SEMA=think a1', '^$');
+test('wait.17', $god, '@wait me/SEMB=think b1', '^$');
+test('wait.18', $god, '@wait me/SEMA/30=think a2', '^$');
+test('wait.19', $god, '@wait me=think s1', '^$');
+test('wait.20', $god, 'think [iter(getpids(me/sema),pidinfo(##,command),%b,|)]', '^think a1\|think a2$');
+test('wait.21', $god, 'think [words(getpids(me))] [get(me/SEMA)] [get(me/SEMB)]', '^4 2 1$');
+test('wait.22', $god, '@notify me/SEMB', 'Notified');
+test('wait.23', $god, 'think [words(getpids(me/SEMB))] [words(getpids(me))]', '^0 3$');
+test('wait.24', $god, '@notify/any me', 'Notified');
+test('wait.25', $god, 'think [iter(getpids(me),pidinfo(##,command),%b,|)]', '^think a2\|think s1$');
+test('wait.26', $god, '@halt/pid [getpids(me/SEMA)]', 'halted');
+test('wait.27', $god, 'think [getpids(me/SEMA)]|[get(me/SEMA)]', '^\|$');
+test('wait.28', $god, '@drain/all me', 'Drained');
+test('wait.29', $god, 'think [words(getpids(me))]', '^0$');
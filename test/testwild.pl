@@ -0,0 +1,11 @@
+run tests:
+test('wild.1', $god, 'think strmatch(foobar,f*r)[strmatch(foobar,F*R)][strmatch(foobar,f*z)]', '110');
+test('wild.2', $god, 'think strmatch(foo,f?o)[strmatch(fo,f?o)][strmatch(fooo,f?o)]', '100');
+test('wild.3', $god, 'think strmatch(a*b,a\\\\*b)[strmatch(axb,a\\\\*b)]', '10');
+test('wild.4', $god, 'think strmatch(abc,abc\\\\)[strmatch(abc\\\\,abc\\\\)]', '00');
+test('wild.5', $god, 'think match(foo bar baz,*a?)[match(foo bar baz,*x*)]', '20');
+test('wild.6', $god, 'think switch(Hello World,*o w*,$0-$1,no)', 'Hell-orld');
+test('wild.7', $god, 'think switch(abcabcabc,*bca*c,$0-$1,no)', 'a-bcab');
+test('wild.8', $god, 'think switch(Hello,hello,1,0)[switch(Hello,H*,1,0)]', '11');
+test('wild.9', $god, 'think iter(ab abab ba xaby,strmatch(##,*ab*))', '1 1 0 1');
+test('wild.10', $god, '@stats/tables', 'Wildcard Cache:');